@@ -3,6 +3,8 @@
 
 #include "source.h"
 #include "sink.h"
+#include "colors.h"
+#include "effect.h"
 
 namespace atolla {
 
@@ -19,6 +21,8 @@ namespace atolla {
         SetVersion(exports);
         Sink::Init(exports);
         Source::Init(exports);
+        InitColors(exports);
+        Effect::Init(exports);
     }
 
     void SetVersion(Handle<Object> exports) {
@@ -0,0 +1,51 @@
+// Compares converting CSS colors with tinycolor, like to-uint8-colors used to,
+// against the native parser writing into a reused Uint8Array.
+//
+//    npm install && node bench/colors.js
+
+const tinycolor = require('tinycolor2')
+const toUint8ArrayColors = require('../to-uint8-colors')
+
+const counts = [ 1, 300, 3000 ]
+const minDurationMs = 1000
+const samples = [
+  'red', 'rebeccapurple', '#f80', '#ff8800', 'rgb(255, 136, 0)',
+  'rgba(255, 136, 0, 0.5)', 'hsl(32, 100%, 50%)', 'hsla(200, 50%, 25%, 1)'
+]
+
+function tinycolorColors (colors) {
+  const converted = colors.reduce((converted, next) => {
+    const { r, g, b } = tinycolor(next).toRgb()
+    converted.push(r, g, b)
+    return converted
+  }, [])
+  return new Uint8Array(converted)
+}
+
+function measure (name, count, convert) {
+  let iterations = 0
+  const start = process.hrtime()
+  let elapsedMs = 0
+  while (elapsedMs < minDurationMs) {
+    for (let i = 0; i < 100; ++i) {
+      convert()
+    }
+    iterations += 100
+    const [ s, ns ] = process.hrtime(start)
+    elapsedMs = s * 1e3 + ns / 1e6
+  }
+
+  const nsPerColor = elapsedMs * 1e6 / (iterations * count)
+  console.log(`${name.padEnd(10)} ${String(count).padStart(5)} colors: ${nsPerColor.toFixed(1).padStart(8)} ns/color, ${(iterations * 1000 / elapsedMs).toFixed(0).padStart(9)} calls/s`)
+}
+
+for (const count of counts) {
+  const colors = []
+  for (let i = 0; i < count; ++i) {
+    colors.push(samples[i % samples.length])
+  }
+  const target = new Uint8Array(3 * count)
+
+  measure('tinycolor', count, () => tinycolorColors(colors))
+  measure('native', count, () => toUint8ArrayColors.into(colors, target))
+}
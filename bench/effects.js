@@ -0,0 +1,90 @@
+// Compares a native effect against JS painters producing the same colors: a
+// red sine wave combined with a white chase, for growing amounts of lights.
+// The first painter returns CSS strings per light like examples/sine-source,
+// the second writes into a reused Uint8Array.
+//
+//    node bench/effects.js
+
+const effect = require('../effect')
+const toUint8ArrayColors = require('../to-uint8-colors')
+
+const lightCounts = [ 60, 300, 3000 ]
+const minDurationMs = 1000
+const frameDurationSeconds = 0.017
+
+function jsCssPainter (lightsCount) {
+  return (time) => {
+    const colors = []
+    for (let i = 0; i < lightsCount; ++i) {
+      const [ r, g, b ] = light(i / lightsCount, time)
+      colors.push(`rgb(${Math.round(r * 255)}, ${Math.round(g * 255)}, ${Math.round(b * 255)})`)
+    }
+    return toUint8ArrayColors(colors)
+  }
+}
+
+function jsBufferPainter (lightsCount) {
+  const frame = new Uint8Array(3 * lightsCount)
+  return (time) => {
+    for (let i = 0; i < lightsCount; ++i) {
+      const pos = i / lightsCount
+      const wave = 0.5 + 0.5 * Math.sin(2 * Math.PI * (pos * 2 - time * 0.5))
+      const chase = chaseWeight(pos, time)
+      frame[3 * i] = Math.round(Math.max(wave, chase) * 255)
+      frame[3 * i + 1] = Math.round(chase * 255)
+      frame[3 * i + 2] = Math.round(chase * 255)
+    }
+    return frame
+  }
+}
+
+function light (pos, time) {
+  const wave = 0.5 + 0.5 * Math.sin(2 * Math.PI * (pos * 2 - time * 0.5))
+  const chase = chaseWeight(pos, time)
+  return [ Math.max(wave, chase), chase, chase ]
+}
+
+function chaseWeight (pos, time) {
+  const head = time % 1
+  let distance = (pos - head + 0.5) % 1
+  distance = (distance < 0 ? distance + 1 : distance) - 0.5
+  return Math.max(0, 1 - Math.abs(distance) / 0.05)
+}
+
+function nativePainter (lightsCount) {
+  const fx = effect(lightsCount)
+  const wave = fx.add('sine', { color: 'red', scale: 2, speed: 0.5 })
+  const chase = fx.add('chase', { color: 'white', width: 0.1, speed: 1 })
+  fx.add('blend', { a: wave, b: chase, mode: 'max' })
+
+  const frame = new Uint8Array(3 * lightsCount)
+  return (time) => {
+    fx.render(time, frame)
+    return frame
+  }
+}
+
+function measure (name, lightsCount, paint) {
+  let frames = 0
+  let time = 0
+  const start = process.hrtime()
+  let elapsedMs = 0
+  while (elapsedMs < minDurationMs) {
+    for (let i = 0; i < 20; ++i) {
+      paint(time)
+      time += frameDurationSeconds
+    }
+    frames += 20
+    const [ s, ns ] = process.hrtime(start)
+    elapsedMs = s * 1e3 + ns / 1e6
+  }
+
+  const usPerFrame = elapsedMs * 1e3 / frames
+  console.log(`${name.padEnd(10)} ${String(lightsCount).padStart(5)} lights: ${usPerFrame.toFixed(2).padStart(9)} us/frame`)
+}
+
+for (const lightsCount of lightCounts) {
+  measure('js css', lightsCount, jsCssPainter(lightsCount))
+  measure('js buffer', lightsCount, jsBufferPainter(lightsCount))
+  measure('native', lightsCount, nativePainter(lightsCount))
+}
@@ -0,0 +1,341 @@
+#include "impair.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+// Large enough for any datagram atolla sends
+static const size_t max_datagram_len = 65536;
+
+static int64_t impair_now_us();
+
+ImpairSpec impair_spec_none()
+{
+    ImpairSpec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.burst_len = 1;
+    spec.reorder_ms = 20;
+    spec.seed = 42;
+    return spec;
+}
+
+bool impair_spec_preset(const char* name, ImpairSpec* spec)
+{
+    ImpairSpec preset = impair_spec_none();
+
+    if(strcmp(name, "none") == 0)
+    {
+    }
+    else if(strcmp(name, "wifi") == 0)
+    {
+        // A home network with some interference
+        preset.loss = 0.01;
+        preset.burst_loss = 0.002;
+        preset.burst_len = 4;
+        preset.reorder = 0.005;
+        preset.duplicate = 0.001;
+        preset.delay_ms = 2;
+        preset.jitter_ms = 4;
+    }
+    else if(strcmp(name, "bad-wifi") == 0)
+    {
+        // A crowded network or a sink at the edge of its range
+        preset.loss = 0.05;
+        preset.burst_loss = 0.01;
+        preset.burst_len = 8;
+        preset.reorder = 0.02;
+        preset.duplicate = 0.005;
+        preset.delay_ms = 5;
+        preset.jitter_ms = 15;
+        preset.both_directions = true;
+    }
+    else
+    {
+        return false;
+    }
+
+    *spec = preset;
+    return true;
+}
+
+bool impair_parse_arg(int argc, char** argv, int* i, ImpairSpec* spec)
+{
+    const char* arg = argv[*i];
+    const bool has_value = (*i + 1) < argc;
+
+    if(strcmp(arg, "--both-directions") == 0)
+    {
+        spec->both_directions = true;
+        return true;
+    }
+
+    if(!has_value)
+    {
+        return false;
+    }
+
+    const char* value = argv[*i + 1];
+
+    if(strcmp(arg, "--impair") == 0)
+    {
+        if(!impair_spec_preset(value, spec))
+        {
+            return false;
+        }
+    }
+    else if(strcmp(arg, "--loss") == 0)
+    {
+        spec->loss = atof(value);
+    }
+    else if(strcmp(arg, "--burst-loss") == 0)
+    {
+        spec->burst_loss = atof(value);
+    }
+    else if(strcmp(arg, "--burst-len") == 0)
+    {
+        spec->burst_len = atof(value);
+    }
+    else if(strcmp(arg, "--reorder") == 0)
+    {
+        spec->reorder = atof(value);
+    }
+    else if(strcmp(arg, "--reorder-ms") == 0)
+    {
+        spec->reorder_ms = atoi(value);
+    }
+    else if(strcmp(arg, "--duplicate") == 0)
+    {
+        spec->duplicate = atof(value);
+    }
+    else if(strcmp(arg, "--delay-ms") == 0)
+    {
+        spec->delay_ms = atoi(value);
+    }
+    else if(strcmp(arg, "--jitter-ms") == 0)
+    {
+        spec->jitter_ms = atoi(value);
+    }
+    else if(strcmp(arg, "--seed") == 0)
+    {
+        spec->seed = (uint32_t) strtoul(value, NULL, 10);
+    }
+    else
+    {
+        return false;
+    }
+
+    if(spec->burst_len < 1)
+    {
+        spec->burst_len = 1;
+    }
+
+    ++*i;
+    return true;
+}
+
+bool impair_spec_active(const ImpairSpec* spec)
+{
+    return spec->loss > 0 || spec->burst_loss > 0 || spec->reorder > 0 ||
+           spec->duplicate > 0 || spec->delay_ms > 0 || spec->jitter_ms > 0;
+}
+
+ImpairRelay::ImpairRelay() :
+    started(false),
+    has_sender(false),
+    in_burst(false),
+    random_state(1),
+    next_seq(0)
+{
+    spec = impair_spec_none();
+    memset(&stats, 0, sizeof(stats));
+}
+
+ImpairRelay::~ImpairRelay()
+{
+    if(started)
+    {
+        udp_socket_free(&listen_socket);
+        udp_socket_free(&target_socket);
+    }
+}
+
+bool ImpairRelay::Start(const ImpairSpec* relay_spec, unsigned short listen_port, const char* target_host, unsigned short target_port)
+{
+    if(started)
+    {
+        return false;
+    }
+
+    spec = *relay_spec;
+    // xorshift must not start at zero
+    random_state = (spec.seed != 0) ? spec.seed : 1;
+
+    if(udp_socket_init_on_port(&listen_socket, listen_port).code != UDP_SOCKET_OK)
+    {
+        return false;
+    }
+
+    if(udp_socket_init(&target_socket).code != UDP_SOCKET_OK)
+    {
+        udp_socket_free(&listen_socket);
+        return false;
+    }
+
+    if(udp_socket_set_receiver(&target_socket, target_host, target_port).code != UDP_SOCKET_OK)
+    {
+        udp_socket_free(&listen_socket);
+        udp_socket_free(&target_socket);
+        return false;
+    }
+
+    started = true;
+    return true;
+}
+
+void ImpairRelay::Poll()
+{
+    if(!started)
+    {
+        return;
+    }
+
+    Receive(&listen_socket, true);
+    Receive(&target_socket, false);
+
+    const int64_t now = impair_now_us();
+    while(!delayed.empty() && delayed.top().release_us <= now)
+    {
+        Send(delayed.top());
+        delayed.pop();
+    }
+}
+
+void ImpairRelay::Receive(UdpSocket* socket, bool to_target)
+{
+    static uint8_t datagram[max_datagram_len];
+    size_t len;
+
+    for(;;)
+    {
+        UdpSocketResult result;
+        if(to_target)
+        {
+            UdpEndpoint from;
+            result = udp_socket_receive_from(socket, datagram, sizeof(datagram), &len, &from);
+            if(result.code == UDP_SOCKET_OK)
+            {
+                sender = from;
+                has_sender = true;
+            }
+        }
+        else
+        {
+            result = udp_socket_receive(socket, datagram, sizeof(datagram), &len, false);
+        }
+
+        if(result.code != UDP_SOCKET_OK)
+        {
+            break;
+        }
+
+        ++stats.received;
+        Impair(datagram, len, to_target, impair_now_us());
+    }
+}
+
+void ImpairRelay::Impair(const uint8_t* datagram, size_t len, bool to_target, int64_t now_us)
+{
+    if(!to_target && !spec.both_directions)
+    {
+        Schedule(datagram, len, to_target, now_us);
+        return;
+    }
+
+    if(!in_burst && spec.burst_loss > 0 && Random() < spec.burst_loss)
+    {
+        in_burst = true;
+    }
+
+    if(in_burst)
+    {
+        ++stats.burst_lost;
+        if(Random() < 1.0 / spec.burst_len)
+        {
+            in_burst = false;
+        }
+        return;
+    }
+
+    if(spec.loss > 0 && Random() < spec.loss)
+    {
+        ++stats.lost;
+        return;
+    }
+
+    const int copies = (spec.duplicate > 0 && Random() < spec.duplicate) ? 2 : 1;
+    if(copies > 1)
+    {
+        ++stats.duplicated;
+    }
+
+    for(int i = 0; i < copies; ++i)
+    {
+        int64_t release_us = now_us + spec.delay_ms * 1000 + (int64_t) (Random() * spec.jitter_ms * 1000);
+        if(spec.reorder > 0 && Random() < spec.reorder)
+        {
+            release_us += spec.reorder_ms * 1000;
+            ++stats.reordered;
+        }
+        Schedule(datagram, len, to_target, release_us);
+    }
+}
+
+void ImpairRelay::Schedule(const uint8_t* datagram, size_t len, bool to_target, int64_t release_us)
+{
+    Delayed entry;
+    entry.release_us = release_us;
+    entry.seq = next_seq++;
+    entry.to_target = to_target;
+    entry.datagram.assign(datagram, datagram + len);
+
+    // Sent right away if not delayed, without waiting for the next poll
+    if(release_us <= impair_now_us())
+    {
+        Send(entry);
+    }
+    else
+    {
+        delayed.push(entry);
+    }
+}
+
+void ImpairRelay::Send(const Delayed& entry)
+{
+    void* data = const_cast<uint8_t*>(&entry.datagram[0]);
+
+    if(entry.to_target)
+    {
+        udp_socket_send(&target_socket, data, entry.datagram.size());
+        ++stats.forwarded;
+    }
+    else if(has_sender)
+    {
+        udp_socket_send_to(&listen_socket, data, entry.datagram.size(), &sender);
+        ++stats.forwarded;
+    }
+}
+
+double ImpairRelay::Random()
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state / 4294967296.0;
+}
+
+static int64_t impair_now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
@@ -0,0 +1,174 @@
+#ifndef BENCH_IMPAIR_H
+#define BENCH_IMPAIR_H
+
+#include "../lib/atolla/udp_socket/udp_socket.h"
+
+#include <stdint.h>
+#include <queue>
+#include <vector>
+
+/**
+ * Describes how an impairment relay degrades the datagrams it forwards.
+ * Probabilities are in the range 0..1, times in milliseconds.
+ */
+struct ImpairSpec
+{
+    /**
+     * Probability that a single datagram is lost, independent of others.
+     */
+    double loss;
+    /**
+     * Probability that a burst of losses starts with a datagram. During a
+     * burst, every datagram is lost.
+     */
+    double burst_loss;
+    /**
+     * Average length of a burst in datagrams, bursts end after each datagram
+     * with a probability of 1 / burst_len.
+     */
+    double burst_len;
+    /**
+     * Probability that a datagram is held back for reorder_ms on top of its
+     * delay, so that datagrams sent after it overtake it.
+     */
+    double reorder;
+    int reorder_ms;
+    /**
+     * Probability that a datagram is forwarded twice, the copy is delayed
+     * independently.
+     */
+    double duplicate;
+    /**
+     * Every datagram is delayed by delay_ms plus a random time of up to
+     * jitter_ms. Like on real networks with jitter, this reorders datagrams
+     * sent less than jitter_ms apart.
+     */
+    int delay_ms;
+    int jitter_ms;
+    /**
+     * Whether datagrams from the target back to the sender are impaired too,
+     * otherwise only datagrams towards the target are.
+     */
+    bool both_directions;
+    /**
+     * Seed of the random number generator, equal seeds make equal decisions
+     * for equal traffic.
+     */
+    uint32_t seed;
+};
+
+struct ImpairStats
+{
+    unsigned int received;
+    unsigned int forwarded;
+    unsigned int lost;
+    unsigned int burst_lost;
+    unsigned int reordered;
+    unsigned int duplicated;
+};
+
+/**
+ * Returns a spec that forwards everything unchanged.
+ */
+ImpairSpec impair_spec_none();
+
+/**
+ * Sets spec to a named preset and returns true, or returns false for an
+ * unknown name. Known presets are none, wifi and bad-wifi.
+ */
+bool impair_spec_preset(const char* name, ImpairSpec* spec);
+
+/**
+ * Parses the impairment option at argv[*i] into spec, advancing *i past its
+ * value, and returns true, or returns false if it is not an impairment option
+ * or lacks a valid value. Presets given with --impair can be refined with
+ * options following them:
+ *
+ *    --impair <preset>       none, wifi or bad-wifi
+ *    --loss <p>              probability of losing a datagram
+ *    --burst-loss <p>        probability of a burst of losses starting
+ *    --burst-len <n>         average datagrams lost in a burst
+ *    --reorder <p>           probability of holding a datagram back
+ *    --reorder-ms <ms>       time datagrams are held back, defaults to 20
+ *    --duplicate <p>         probability of sending a datagram twice
+ *    --delay-ms <ms>         delay of every datagram
+ *    --jitter-ms <ms>        random additional delay of up to this time
+ *    --both-directions       also impairs datagrams from the target
+ *    --seed <n>              seed of the random decisions
+ */
+bool impair_parse_arg(int argc, char** argv, int* i, ImpairSpec* spec);
+
+/**
+ * Returns true if the spec changes anything about the forwarded datagrams.
+ */
+bool impair_spec_active(const ImpairSpec* spec);
+
+/**
+ * Relays UDP datagrams between a sender and a target on another port,
+ * degrading them on the way according to an ImpairSpec. Datagrams from the
+ * target are sent back to the sender that was last heard from, so a source
+ * connecting to the relay port talks to a sink on the target port as if it
+ * were connected directly.
+ *
+ * The relay does not run on its own, Poll has to be called
+ * regularly, and at least every millisecond for delays to be precise.
+ */
+class ImpairRelay
+{
+public:
+    ImpairRelay();
+    ~ImpairRelay();
+
+    /**
+     * Starts listening on listen_port and returns true, or returns false if
+     * the port could not be opened or the target not be resolved.
+     */
+    bool Start(const ImpairSpec* spec, unsigned short listen_port, const char* target_host, unsigned short target_port);
+
+    /**
+     * Receives all pending datagrams in both directions and sends all
+     * datagrams whose delay has passed.
+     */
+    void Poll();
+
+    const ImpairStats& Stats() const { return stats; }
+
+private:
+    struct Delayed
+    {
+        int64_t release_us;
+        // Keeps datagrams released at the same time in order
+        uint64_t seq;
+        bool to_target;
+        std::vector<uint8_t> datagram;
+
+        bool operator<(const Delayed& other) const
+        {
+            return (release_us != other.release_us)
+                       ? release_us > other.release_us
+                       : seq > other.seq;
+        }
+    };
+
+    void Receive(UdpSocket* socket, bool to_target);
+    void Impair(const uint8_t* datagram, size_t len, bool to_target, int64_t now_us);
+    void Schedule(const uint8_t* datagram, size_t len, bool to_target, int64_t release_us);
+    void Send(const Delayed& delayed);
+    double Random();
+
+    ImpairSpec spec;
+    bool started;
+    // Receives from senders and sends back to them
+    UdpSocket listen_socket;
+    // Sends to the target and receives its replies
+    UdpSocket target_socket;
+    UdpEndpoint sender;
+    bool has_sender;
+    bool in_burst;
+    uint32_t random_state;
+    uint64_t next_seq;
+    std::priority_queue<Delayed> delayed;
+    ImpairStats stats;
+};
+
+#endif // BENCH_IMPAIR_H
@@ -0,0 +1,113 @@
+// Forwards UDP datagrams from a port to a sink and back, losing, reordering,
+// duplicating and delaying them on the way, to see how sinks cope with
+// unreliable networks. Point a source at the relay port instead of the sink:
+//
+//    node-gyp build && ./build/Release/atolla_impair_relay --listen 10043 --target localhost:10042 --impair wifi --loss 0.03
+//
+// Prints what was done to the datagrams once per second, until interrupted or
+// until --seconds have passed. The impairment options are listed in
+// bench/impair.h. The same impairments can be applied in the loopback
+// harness, see bench/loopback.cpp.
+
+#include "impair.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_interrupt(int signal)
+{
+    interrupted = 1;
+}
+
+static void print_stats(const ImpairStats& stats)
+{
+    printf("received %u forwarded %u lost %u burst_lost %u reordered %u duplicated %u\n",
+        stats.received, stats.forwarded, stats.lost, stats.burst_lost, stats.reordered, stats.duplicated);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    ImpairSpec spec = impair_spec_none();
+    int listen_port = 0;
+    std::string target_host;
+    int target_port = 0;
+    double seconds = 0;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const bool has_value = (i + 1) < argc;
+
+        if(strcmp(argv[i], "--listen") == 0 && has_value)
+        {
+            listen_port = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--target") == 0 && has_value)
+        {
+            std::string target(argv[++i]);
+            size_t colon = target.rfind(':');
+            if(colon != std::string::npos)
+            {
+                target_host = target.substr(0, colon);
+                target_port = atoi(target.substr(colon + 1).c_str());
+            }
+        }
+        else if(strcmp(argv[i], "--seconds") == 0 && has_value)
+        {
+            seconds = atof(argv[++i]);
+        }
+        else if(!impair_parse_arg(argc, argv, &i, &spec))
+        {
+            fprintf(stderr, "Unknown or incomplete option %s, see the top of bench/impair_relay.cpp for usage\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if(listen_port <= 0 || target_host.empty() || target_port <= 0)
+    {
+        fprintf(stderr, "Usage: %s --listen <port> --target <host>:<port> [impairment options]\n", argv[0]);
+        return 1;
+    }
+
+    ImpairRelay relay;
+    if(!relay.Start(&spec, (unsigned short) listen_port, target_host.c_str(), (unsigned short) target_port))
+    {
+        fprintf(stderr, "Could not listen on port %d or resolve %s\n", listen_port, target_host.c_str());
+        return 1;
+    }
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point last_print = start;
+
+    while(!interrupted)
+    {
+        relay.Poll();
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(seconds > 0 && std::chrono::duration<double>(now - start).count() >= seconds)
+        {
+            break;
+        }
+        if(now - last_print >= std::chrono::seconds(1))
+        {
+            print_stats(relay.Stats());
+            last_print = now;
+        }
+
+        usleep(250);
+    }
+
+    print_stats(relay.Stats());
+    return 0;
+}
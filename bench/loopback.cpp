@@ -0,0 +1,1065 @@
+// Streams frames from sources to sinks over loopback and measures what arrives
+// at the sinks, for every combination of the given amounts of lights, frame
+// durations and buffer depths:
+//
+//    node-gyp build && ./build/Release/atolla_loopback --lights 30,300 --frame-ms 10,20 --buffer 4,16
+//
+// Every frame carries the time it was passed to the source and a sequence
+// number, so the sinks can tell when and which frame they show. Reported per
+// configuration:
+//
+// - fps: distinct frames shown per second, summed over all sinks
+// - latency: time from putting a frame until the sink first shows it, this
+//   includes the intended delay of buffer frames times the frame duration
+// - jitter: deviation of the time between distinct frames from the frame
+//   duration
+// - skew: with more than one sink, time from the first to the last sink
+//   showing the frame with the same sequence number
+// - gap fills: frames the sinks filled in because they arrived late or not
+//   at all, and frames that were never shown
+// - CPU per frame: user and system time of the process per shown frame, or
+//   per sent frame with --role source, including the polling of the harness
+//
+// By default, sources and sinks run in one process. With --role sink and
+// --role source, they can also run in separate processes on the same machine,
+// then only the first value of every list is used. Timestamps are taken from
+// the monotonic clock, which all processes on a machine share.
+//
+// Options:
+//    --lights <list>      amounts of lights, at least 4, defaults to 30,300
+//    --frame-ms <list>    frame durations in ms, defaults to 10,17,33
+//    --buffer <list>      buffered frames, defaults to 2,8,32
+//    --pairs <n>          sources and sinks streaming at the same time, defaults to 1
+//    --seconds <s>        measuring time per configuration, defaults to 3
+//    --warmup-ms <ms>     ignored time after connecting, defaults to 500
+//    --port <port>        port of the first sink, defaults to 10142
+//    --role <role>        both, source or sink, defaults to both
+//    --host <host>        host running the sinks for --role source
+//    --fec <n>            sends parity after every n frames, see fec_group_size
+//    --nack               lets sinks request lost frames again
+//    --lockstep           puts frames with presentation times on the clock
+//                         of the sources, which the sinks sync to, see
+//                         sync_clock, so that all sinks show them at once
+//    --multi              streams to all sinks from a single multi source
+//                         instead of one source per sink
+//    --fail-sink <idx>    with --multi, frees the sink with the given index
+//                         halfway through measuring, to check that the other
+//                         sinks keep playing and to report how long the multi
+//                         source takes to give up on it
+//    --json               prints JSON instead of a table
+//    --trace <file>       writes the events of every frame in Chrome trace
+//                         format, requires building with ATOLLA_ENABLE_TRACE
+//    --capture <file>     records what the first sink of the first
+//                         configuration receives, for bench/replay.cpp
+//
+// Any of the impairment options in bench/impair.h, e.g. --impair wifi, puts
+// an impairment relay between every source and its sink, to measure playout
+// under loss, reordering and jitter. The relay runs on the side of the
+// sources. Frames recovered from parity or by asking again are counted as
+// recovered, the relay reports what it did to the datagrams in JSON output.
+//
+// The trace holds the last events of every source and sink of every
+// configuration, and can be opened with chrome://tracing or ui.perfetto.dev.
+// Tracing is compiled in with:
+//
+//    node-gyp rebuild -- -Datolla_trace=1
+
+#include "../lib/atolla/atolla/multi_source.h"
+#include "../lib/atolla/atolla/sink.h"
+#include "../lib/atolla/atolla/source.h"
+#include "impair.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Bytes at the start of every frame: 8 bytes time in microseconds, 4 bytes
+// sequence number, both little endian
+static const size_t stamp_len = 12;
+// Sleep between polling all sources and sinks
+static const int poll_interval_us = 250;
+static const int connect_timeout_ms = 5000;
+
+enum Role
+{
+    ROLE_BOTH,
+    ROLE_SOURCE,
+    ROLE_SINK
+};
+
+struct Config
+{
+    int lights_count;
+    int frame_duration_ms;
+    int buffer_frames;
+};
+
+struct Options
+{
+    std::vector<int> lights;
+    std::vector<int> frame_ms;
+    std::vector<int> buffer;
+    int pairs;
+    double seconds;
+    int warmup_ms;
+    int port;
+    Role role;
+    const char* host;
+    int fec_group_size;
+    bool retransmit_lost_frames;
+    bool lockstep;
+    bool multi;
+    int fail_sink;
+    ImpairSpec impair;
+    bool json;
+    const char* trace_path;
+    const char* capture_path;
+};
+
+struct Pair
+{
+    AtollaSource source;
+    AtollaSink sink;
+    // Sits between source and sink if impairments are configured
+    ImpairRelay* relay;
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> shown;
+    uint32_t next_seq;
+    bool has_shown;
+    uint32_t last_seq;
+    int64_t last_shown_us;
+    // When the frame with the sequence number at the index was first shown
+    // while measuring, or -1
+    std::vector<int64_t> shown_at_us;
+};
+
+struct Measurement
+{
+    Config config;
+    bool ok;
+    double measured_s;
+    uint64_t sent_frames;
+    uint64_t shown_frames;
+    uint64_t never_shown_frames;
+    uint64_t gap_fills;
+    uint64_t recovered_frames;
+    ImpairStats impair;
+    std::vector<double> latencies_ms;
+    std::vector<double> jitters_ms;
+    std::vector<double> skews_ms;
+    double cpu_us;
+    // With --fail-sink, time from freeing the sink until the multi source
+    // put it into error state, or -1 if it never did
+    double fail_detect_ms;
+};
+
+static int64_t loopback_now_us();
+static double loopback_cpu_us();
+static void loopback_stamp(uint8_t* frame, int64_t time_us, uint32_t seq);
+static void loopback_read_stamp(const uint8_t* frame, int64_t* time_us, uint32_t* seq);
+static void loopback_poll_relays(std::vector<Pair>& pairs);
+static bool loopback_all_connected(std::vector<Pair>& pairs, Role role, AtollaMultiSource multi);
+static void loopback_put(Pair& pair, Measurement& m, bool measuring);
+static void loopback_put_multi(Pair& pair, AtollaMultiSource multi, Measurement& m, bool measuring);
+static void loopback_put_timed(Pair& pair, Measurement& m, bool measuring, const Config& config, unsigned int epoch_ms);
+static void loopback_get(Pair& pair, Measurement& m, bool measuring, int frame_duration_ms);
+static void loopback_measure_skew(std::vector<Pair>& pairs, Measurement& m);
+static Measurement loopback_run(const Options& options, const Config& config);
+static double percentile(std::vector<double>& sorted, double p);
+static std::vector<int> parse_list(const char* arg);
+static void print_table_header();
+static void print_table_row(const Measurement& m);
+static void print_json(const std::vector<Measurement>& measurements);
+#ifdef ATOLLA_ENABLE_TRACE
+static void loopback_write_trace(const Pair& pair, const Config& config, int pair_idx);
+
+static FILE* trace_file = NULL;
+static int trace_next_pid = 1;
+#endif
+// Only the first sink gets captured, later configurations would overwrite it
+static bool captured = false;
+
+int main(int argc, char** argv)
+{
+    Options options;
+    options.lights = parse_list("30,300");
+    options.frame_ms = parse_list("10,17,33");
+    options.buffer = parse_list("2,8,32");
+    options.pairs = 1;
+    options.seconds = 3;
+    options.warmup_ms = 500;
+    options.port = 10142;
+    options.role = ROLE_BOTH;
+    options.host = "127.0.0.1";
+    options.fec_group_size = 0;
+    options.retransmit_lost_frames = false;
+    options.lockstep = false;
+    options.multi = false;
+    options.fail_sink = -1;
+    options.impair = impair_spec_none();
+    options.json = false;
+    options.trace_path = NULL;
+    options.capture_path = NULL;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const bool has_value = (i + 1) < argc;
+
+        if(strcmp(argv[i], "--lights") == 0 && has_value)
+        {
+            options.lights = parse_list(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--frame-ms") == 0 && has_value)
+        {
+            options.frame_ms = parse_list(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--buffer") == 0 && has_value)
+        {
+            options.buffer = parse_list(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--pairs") == 0 && has_value)
+        {
+            options.pairs = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--seconds") == 0 && has_value)
+        {
+            options.seconds = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--warmup-ms") == 0 && has_value)
+        {
+            options.warmup_ms = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--port") == 0 && has_value)
+        {
+            options.port = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--role") == 0 && has_value)
+        {
+            const char* role = argv[++i];
+            options.role = (strcmp(role, "source") == 0) ? ROLE_SOURCE :
+                           (strcmp(role, "sink") == 0) ? ROLE_SINK : ROLE_BOTH;
+        }
+        else if(strcmp(argv[i], "--host") == 0 && has_value)
+        {
+            options.host = argv[++i];
+        }
+        else if(strcmp(argv[i], "--fec") == 0 && has_value)
+        {
+            options.fec_group_size = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--nack") == 0)
+        {
+            options.retransmit_lost_frames = true;
+        }
+        else if(strcmp(argv[i], "--lockstep") == 0)
+        {
+            options.lockstep = true;
+        }
+        else if(strcmp(argv[i], "--multi") == 0)
+        {
+            options.multi = true;
+        }
+        else if(strcmp(argv[i], "--fail-sink") == 0 && has_value)
+        {
+            options.fail_sink = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--json") == 0)
+        {
+            options.json = true;
+        }
+        else if(strcmp(argv[i], "--trace") == 0 && has_value)
+        {
+            options.trace_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--capture") == 0 && has_value)
+        {
+            options.capture_path = argv[++i];
+        }
+        else if(!impair_parse_arg(argc, argv, &i, &options.impair))
+        {
+            fprintf(stderr, "Unknown or incomplete option %s, see the top of bench/loopback.cpp for usage\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if(options.lights.empty() || options.frame_ms.empty() || options.buffer.empty() || options.pairs < 1)
+    {
+        fprintf(stderr, "Lists of lights, frame durations and buffer depths must not be empty, and pairs must be at least 1\n");
+        return 1;
+    }
+
+    if(options.multi && options.lockstep)
+    {
+        fprintf(stderr, "Multi sources cannot put timed frames, --multi and --lockstep cannot be combined\n");
+        return 1;
+    }
+
+    if(options.fail_sink >= 0 && (!options.multi || options.role != ROLE_BOTH || options.fail_sink >= options.pairs))
+    {
+        fprintf(stderr, "--fail-sink requires --multi in a single process and the index of one of the sinks\n");
+        return 1;
+    }
+
+    for(size_t i = 0; i < options.lights.size(); ++i)
+    {
+        if(3 * options.lights[i] < (int) stamp_len)
+        {
+            fprintf(stderr, "Frames need at least 4 lights to hold a timestamp and a sequence number\n");
+            return 1;
+        }
+    }
+
+    // Separate processes have to agree on a single configuration
+    if(options.role != ROLE_BOTH)
+    {
+        options.lights.resize(1);
+        options.frame_ms.resize(1);
+        options.buffer.resize(1);
+    }
+
+    if(options.trace_path != NULL)
+    {
+#ifdef ATOLLA_ENABLE_TRACE
+        trace_file = fopen(options.trace_path, "w");
+        if(trace_file == NULL)
+        {
+            fprintf(stderr, "Could not open %s for writing the trace\n", options.trace_path);
+            return 1;
+        }
+        fputs("[\n", trace_file);
+#else
+        fprintf(stderr, "--trace requires building with ATOLLA_ENABLE_TRACE, see the top of bench/loopback.cpp\n");
+        return 1;
+#endif
+    }
+
+    std::vector<Measurement> measurements;
+    if(!options.json)
+    {
+        print_table_header();
+    }
+
+    for(size_t l = 0; l < options.lights.size(); ++l)
+    {
+        for(size_t f = 0; f < options.frame_ms.size(); ++f)
+        {
+            for(size_t b = 0; b < options.buffer.size(); ++b)
+            {
+                Config config = { options.lights[l], options.frame_ms[f], options.buffer[b] };
+                Measurement m = loopback_run(options, config);
+                if(!options.json)
+                {
+                    print_table_row(m);
+                }
+                measurements.push_back(m);
+
+                // Sinks and relays of the next configuration get new ports,
+                // so that nothing still in flight for the last one is received
+                options.port += 2 * options.pairs;
+            }
+        }
+    }
+
+    if(options.json)
+    {
+        print_json(measurements);
+    }
+
+#ifdef ATOLLA_ENABLE_TRACE
+    if(trace_file != NULL)
+    {
+        fputs("\n]\n", trace_file);
+        fclose(trace_file);
+    }
+#endif
+
+    return 0;
+}
+
+static Measurement loopback_run(const Options& options, const Config& config)
+{
+    const size_t frame_len = 3 * config.lights_count;
+
+    Measurement m;
+    m.config = config;
+    m.ok = false;
+    m.measured_s = 0;
+    m.sent_frames = 0;
+    m.shown_frames = 0;
+    m.never_shown_frames = 0;
+    m.gap_fills = 0;
+    m.recovered_frames = 0;
+    m.fail_detect_ms = -1;
+    memset(&m.impair, 0, sizeof(m.impair));
+
+    const bool impaired = impair_spec_active(&options.impair) && options.role != ROLE_SINK;
+    m.cpu_us = 0;
+
+    AtollaMultiSource multi;
+    multi.internal = NULL;
+    std::vector<AtollaSinkAddr> multi_sinks(options.pairs);
+
+    std::vector<Pair> pairs(options.pairs);
+    for(int i = 0; i < options.pairs; ++i)
+    {
+        Pair& pair = pairs[i];
+        pair.frame.resize(frame_len);
+        pair.shown.resize(frame_len);
+        pair.next_seq = 0;
+        pair.has_shown = false;
+        pair.last_seq = 0;
+        pair.last_shown_us = 0;
+        pair.source.internal = NULL;
+        pair.sink.internal = NULL;
+        pair.relay = NULL;
+
+        for(size_t b = stamp_len; b < frame_len; ++b)
+        {
+            pair.frame[b] = (uint8_t) (b * 7 + i);
+        }
+
+        if(options.role != ROLE_SOURCE)
+        {
+            AtollaSinkSpec sink_spec;
+            sink_spec.port = options.port + i;
+            sink_spec.lights_count = config.lights_count;
+            pair.sink = atolla_sink_make(&sink_spec);
+
+            if(options.capture_path != NULL && !captured)
+            {
+                captured = true;
+                if(!atolla_sink_capture_start(pair.sink, options.capture_path))
+                {
+                    fprintf(stderr, "Could not capture into %s\n", options.capture_path);
+                }
+            }
+        }
+
+        // Relays listen on the ports after the ones of the sinks
+        const int relay_port = options.port + options.pairs + i;
+        if(impaired)
+        {
+            pair.relay = new ImpairRelay();
+            // Every relay decides differently, but reproducibly
+            ImpairSpec relay_spec = options.impair;
+            relay_spec.seed += i;
+            if(!pair.relay->Start(&relay_spec, relay_port, options.host, options.port + i))
+            {
+                fprintf(stderr, "Could not start impairment relay on port %d\n", relay_port);
+            }
+        }
+
+        if(options.role != ROLE_SINK && options.multi)
+        {
+            // All frames go out from the multi source made below
+            multi_sinks[i].hostname = impaired ? "127.0.0.1" : options.host;
+            multi_sinks[i].port = impaired ? relay_port : options.port + i;
+        }
+        else if(options.role != ROLE_SINK)
+        {
+            AtollaSourceSpec source_spec;
+            memset(&source_spec, 0, sizeof(source_spec));
+            source_spec.sink_hostname = impaired ? "127.0.0.1" : options.host;
+            source_spec.sink_port = impaired ? relay_port : options.port + i;
+            source_spec.frame_duration_ms = config.frame_duration_ms;
+            source_spec.max_buffered_frames = config.buffer_frames;
+            source_spec.fec_group_size = options.fec_group_size;
+            source_spec.retransmit_lost_frames = options.retransmit_lost_frames;
+            source_spec.sync_clock = options.lockstep;
+            source_spec.async_make = true;
+            pair.source = atolla_source_make(&source_spec);
+        }
+    }
+
+    if(options.role != ROLE_SINK && options.multi)
+    {
+        AtollaMultiSourceSpec multi_spec;
+        memset(&multi_spec, 0, sizeof(multi_spec));
+        multi_spec.sinks = &multi_sinks[0];
+        multi_spec.sinks_count = multi_sinks.size();
+        multi_spec.frame_duration_ms = config.frame_duration_ms;
+        multi_spec.max_buffered_frames = config.buffer_frames;
+        multi_spec.async_make = true;
+        multi = atolla_multi_source_make(&multi_spec);
+    }
+
+    // Sinks started on their own wait for a source indefinitely
+    const int64_t connect_start_us = loopback_now_us();
+    while(!loopback_all_connected(pairs, options.role, multi))
+    {
+        if(options.role != ROLE_SINK && (loopback_now_us() - connect_start_us) > connect_timeout_ms * 1000)
+        {
+            break;
+        }
+        loopback_poll_relays(pairs);
+        usleep(poll_interval_us);
+    }
+
+    if(loopback_all_connected(pairs, options.role, multi))
+    {
+        m.ok = true;
+
+        // All sources share a clock, the first frame is due once the sinks
+        // could have buffered it
+        unsigned int epoch_ms = 0;
+        if(options.role != ROLE_SINK && options.lockstep)
+        {
+            epoch_ms = atolla_source_clock_ms(pairs[0].source) + config.buffer_frames * config.frame_duration_ms;
+        }
+
+        const int64_t start_us = loopback_now_us();
+        const int64_t measure_start_us = start_us + options.warmup_ms * 1000;
+        const int64_t end_us = measure_start_us + (int64_t) (options.seconds * 1e6);
+        const int64_t fail_us = measure_start_us + (int64_t) (options.seconds * 0.5e6);
+        int64_t failed_at_us = -1;
+
+        std::vector<AtollaSinkStats> stats_before(options.pairs);
+        double cpu_before = 0;
+        bool measuring = false;
+
+        for(int64_t now = start_us; now < end_us; now = loopback_now_us())
+        {
+            if(!measuring && now >= measure_start_us)
+            {
+                measuring = true;
+                cpu_before = loopback_cpu_us();
+                for(int i = 0; i < options.pairs; ++i)
+                {
+                    if(options.role != ROLE_SOURCE)
+                    {
+                        atolla_sink_stats(pairs[i].sink, &stats_before[i]);
+                    }
+                }
+            }
+
+            if(options.fail_sink >= 0 && failed_at_us < 0 && now >= fail_us)
+            {
+                // The multi source only notices through missing reports
+                atolla_sink_free(pairs[options.fail_sink].sink);
+                pairs[options.fail_sink].sink.internal = NULL;
+                failed_at_us = now;
+            }
+            else if(failed_at_us >= 0 && m.fail_detect_ms < 0 &&
+                    atolla_multi_source_sink_state(multi, options.fail_sink) == ATOLLA_SOURCE_STATE_ERROR)
+            {
+                m.fail_detect_ms = (now - failed_at_us) / 1e3;
+            }
+
+            if(multi.internal != NULL)
+            {
+                loopback_put_multi(pairs[0], multi, m, measuring);
+            }
+
+            for(int i = 0; i < options.pairs; ++i)
+            {
+                if(options.role != ROLE_SINK && !options.multi && options.lockstep)
+                {
+                    loopback_put_timed(pairs[i], m, measuring, config, epoch_ms);
+                }
+                else if(options.role != ROLE_SINK && !options.multi)
+                {
+                    loopback_put(pairs[i], m, measuring);
+                }
+                if(options.role != ROLE_SOURCE && pairs[i].sink.internal != NULL)
+                {
+                    loopback_get(pairs[i], m, measuring, config.frame_duration_ms);
+                }
+            }
+
+            loopback_poll_relays(pairs);
+            usleep(poll_interval_us);
+        }
+
+        m.measured_s = (loopback_now_us() - measure_start_us) / 1e6;
+        m.cpu_us = loopback_cpu_us() - cpu_before;
+
+        if(options.role != ROLE_SOURCE)
+        {
+            loopback_measure_skew(pairs, m);
+        }
+
+        for(int i = 0; i < options.pairs; ++i)
+        {
+            if(options.role != ROLE_SOURCE && pairs[i].sink.internal != NULL)
+            {
+                AtollaSinkStats stats;
+                atolla_sink_stats(pairs[i].sink, &stats);
+                m.gap_fills += stats.lost_frames - stats_before[i].lost_frames;
+                m.recovered_frames += stats.fec_recovered_frames - stats_before[i].fec_recovered_frames;
+                m.recovered_frames += stats.late_recovered_frames - stats_before[i].late_recovered_frames;
+            }
+
+            if(pairs[i].relay != NULL)
+            {
+                const ImpairStats& impair = pairs[i].relay->Stats();
+                m.impair.received += impair.received;
+                m.impair.forwarded += impair.forwarded;
+                m.impair.lost += impair.lost;
+                m.impair.burst_lost += impair.burst_lost;
+                m.impair.reordered += impair.reordered;
+                m.impair.duplicated += impair.duplicated;
+            }
+        }
+    }
+
+    for(int i = 0; i < options.pairs; ++i)
+    {
+#ifdef ATOLLA_ENABLE_TRACE
+        if(trace_file != NULL)
+        {
+            loopback_write_trace(pairs[i], config, i);
+        }
+#endif
+
+        if(pairs[i].source.internal != NULL)
+        {
+            atolla_source_free(pairs[i].source);
+        }
+        if(pairs[i].sink.internal != NULL)
+        {
+            atolla_sink_free(pairs[i].sink);
+        }
+        delete pairs[i].relay;
+    }
+
+    if(multi.internal != NULL)
+    {
+        atolla_multi_source_free(multi);
+    }
+
+    std::sort(m.latencies_ms.begin(), m.latencies_ms.end());
+    std::sort(m.jitters_ms.begin(), m.jitters_ms.end());
+    std::sort(m.skews_ms.begin(), m.skews_ms.end());
+
+    return m;
+}
+
+#ifdef ATOLLA_ENABLE_TRACE
+/**
+ * Appends the events of the source and sink of a pair to the trace file, as
+ * separate processes named after the configuration.
+ */
+static void loopback_write_trace(const Pair& pair, const Config& config, int pair_idx)
+{
+    std::vector<char> json;
+    char name[96];
+
+    for(int side = 0; side < 2; ++side)
+    {
+        const bool is_source = side == 0;
+        if((is_source ? pair.source.internal : pair.sink.internal) == NULL)
+        {
+            continue;
+        }
+
+        snprintf(
+            name, sizeof(name), "%s %d: %d lights, %d ms, %d buffered",
+            is_source ? "source" : "sink", pair_idx,
+            config.lights_count, config.frame_duration_ms, config.buffer_frames
+        );
+
+        const int pid = trace_next_pid++;
+        // Measure first, then write into a buffer large enough
+        size_t len = is_source
+            ? atolla_source_trace_json(pair.source, pid, name, NULL, 0)
+            : atolla_sink_trace_json(pair.sink, pid, name, NULL, 0);
+        json.resize(len + 1);
+        if(is_source)
+        {
+            atolla_source_trace_json(pair.source, pid, name, &json[0], json.size());
+        }
+        else
+        {
+            atolla_sink_trace_json(pair.sink, pid, name, &json[0], json.size());
+        }
+
+        if(pid > 1)
+        {
+            fputs(",\n", trace_file);
+        }
+        fwrite(&json[0], 1, len, trace_file);
+    }
+}
+#endif
+
+static void loopback_poll_relays(std::vector<Pair>& pairs)
+{
+    for(size_t i = 0; i < pairs.size(); ++i)
+    {
+        if(pairs[i].relay != NULL)
+        {
+            pairs[i].relay->Poll();
+        }
+    }
+}
+
+static bool loopback_all_connected(std::vector<Pair>& pairs, Role role, AtollaMultiSource multi)
+{
+    bool connected = multi.internal == NULL || atolla_multi_source_state(multi) == ATOLLA_SOURCE_STATE_OPEN;
+
+    for(size_t i = 0; i < pairs.size(); ++i)
+    {
+        // Sinks only reply to sources when their state is updated
+        if(role != ROLE_SOURCE && atolla_sink_state(pairs[i].sink) != ATOLLA_SINK_STATE_LENT)
+        {
+            connected = false;
+        }
+        if(role != ROLE_SINK && multi.internal == NULL && atolla_source_state(pairs[i].source) != ATOLLA_SOURCE_STATE_OPEN)
+        {
+            connected = false;
+        }
+    }
+
+    return connected;
+}
+
+static void loopback_put(Pair& pair, Measurement& m, bool measuring)
+{
+    for(int ready = atolla_source_put_ready_count(pair.source); ready > 0; --ready)
+    {
+        loopback_stamp(&pair.frame[0], loopback_now_us(), pair.next_seq);
+        if(!atolla_source_put(pair.source, &pair.frame[0], pair.frame.size()))
+        {
+            break;
+        }
+
+        ++pair.next_seq;
+        if(measuring)
+        {
+            ++m.sent_frames;
+        }
+    }
+}
+
+/**
+ * Puts frames like loopback_put, but with the multi source, so that every sink
+ * receives the frames stamped for the given pair.
+ */
+static void loopback_put_multi(Pair& pair, AtollaMultiSource multi, Measurement& m, bool measuring)
+{
+    for(int ready = atolla_multi_source_put_ready_count(multi); ready > 0; --ready)
+    {
+        loopback_stamp(&pair.frame[0], loopback_now_us(), pair.next_seq);
+        if(!atolla_multi_source_put(multi, &pair.frame[0], pair.frame.size()))
+        {
+            break;
+        }
+
+        ++pair.next_seq;
+        if(measuring)
+        {
+            ++m.sent_frames;
+        }
+    }
+}
+
+/**
+ * Puts the frames due within the buffer depth after the shared epoch, one
+ * frame duration apart, so that atolla_source_put_timed does not block and
+ * every source puts the frame with the same sequence number at the same
+ * presentation time.
+ */
+static void loopback_put_timed(Pair& pair, Measurement& m, bool measuring, const Config& config, unsigned int epoch_ms)
+{
+    const int window_ms = config.buffer_frames * config.frame_duration_ms;
+
+    for(;;)
+    {
+        const unsigned int pts = epoch_ms + pair.next_seq * config.frame_duration_ms;
+        if((int) (pts - atolla_source_clock_ms(pair.source)) > window_ms)
+        {
+            break;
+        }
+
+        loopback_stamp(&pair.frame[0], loopback_now_us(), pair.next_seq);
+        if(!atolla_source_put_timed(pair.source, &pair.frame[0], pair.frame.size(), pts))
+        {
+            break;
+        }
+
+        ++pair.next_seq;
+        if(measuring)
+        {
+            ++m.sent_frames;
+        }
+    }
+}
+
+static void loopback_get(Pair& pair, Measurement& m, bool measuring, int frame_duration_ms)
+{
+    // Receives from the source, atolla_sink_get only plays out
+    atolla_sink_state(pair.sink);
+
+    if(!atolla_sink_get(pair.sink, &pair.shown[0], pair.shown.size()))
+    {
+        return;
+    }
+
+    int64_t sent_us;
+    uint32_t seq;
+    loopback_read_stamp(&pair.shown[0], &sent_us, &seq);
+
+    if(pair.has_shown && seq == pair.last_seq)
+    {
+        return;
+    }
+
+    const int64_t now = loopback_now_us();
+
+    if(measuring)
+    {
+        ++m.shown_frames;
+        m.latencies_ms.push_back((now - sent_us) / 1e3);
+
+        if(pair.has_shown)
+        {
+            // Frames shown out of order count as skipped, not as negative
+            if(seq > pair.last_seq + 1)
+            {
+                m.never_shown_frames += seq - pair.last_seq - 1;
+            }
+            m.jitters_ms.push_back(fabs((now - pair.last_shown_us) / 1e3 - frame_duration_ms));
+        }
+
+        if(seq >= pair.shown_at_us.size())
+        {
+            pair.shown_at_us.resize(seq + 1, -1);
+        }
+        if(pair.shown_at_us[seq] < 0)
+        {
+            pair.shown_at_us[seq] = now;
+        }
+    }
+
+    pair.has_shown = true;
+    pair.last_seq = seq;
+    pair.last_shown_us = now;
+}
+
+/**
+ * Collects the time from the first to the last sink showing each frame that
+ * all sinks showed while measuring. Sinks failed with --fail-sink are left
+ * out.
+ */
+static void loopback_measure_skew(std::vector<Pair>& pairs, Measurement& m)
+{
+    std::vector<const Pair*> sinks;
+    for(size_t i = 0; i < pairs.size(); ++i)
+    {
+        if(pairs[i].sink.internal != NULL)
+        {
+            sinks.push_back(&pairs[i]);
+        }
+    }
+
+    if(sinks.size() < 2)
+    {
+        return;
+    }
+
+    size_t frame_count = sinks[0]->shown_at_us.size();
+    for(size_t i = 1; i < sinks.size(); ++i)
+    {
+        frame_count = std::min(frame_count, sinks[i]->shown_at_us.size());
+    }
+
+    for(size_t seq = 0; seq < frame_count; ++seq)
+    {
+        int64_t first = sinks[0]->shown_at_us[seq];
+        int64_t last = first;
+        bool shown_by_all = first >= 0;
+
+        for(size_t i = 1; i < sinks.size() && shown_by_all; ++i)
+        {
+            const int64_t shown = sinks[i]->shown_at_us[seq];
+            shown_by_all = shown >= 0;
+            first = std::min(first, shown);
+            last = std::max(last, shown);
+        }
+
+        if(shown_by_all)
+        {
+            m.skews_ms.push_back((last - first) / 1e3);
+        }
+    }
+}
+
+static int64_t loopback_now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+static double loopback_cpu_us()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec +
+           usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+}
+
+static void loopback_stamp(uint8_t* frame, int64_t time_us, uint32_t seq)
+{
+    for(int i = 0; i < 8; ++i)
+    {
+        frame[i] = (uint8_t) ((uint64_t) time_us >> (8 * i));
+    }
+    for(int i = 0; i < 4; ++i)
+    {
+        frame[8 + i] = (uint8_t) (seq >> (8 * i));
+    }
+}
+
+static void loopback_read_stamp(const uint8_t* frame, int64_t* time_us, uint32_t* seq)
+{
+    uint64_t time = 0;
+    for(int i = 0; i < 8; ++i)
+    {
+        time |= (uint64_t) frame[i] << (8 * i);
+    }
+    *time_us = (int64_t) time;
+
+    *seq = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+        *seq |= (uint32_t) frame[8 + i] << (8 * i);
+    }
+}
+
+static double percentile(std::vector<double>& sorted, double p)
+{
+    if(sorted.empty())
+    {
+        return 0;
+    }
+    size_t idx = (size_t) (p * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+static std::vector<int> parse_list(const char* arg)
+{
+    std::vector<int> values;
+    std::string list(arg);
+    size_t start = 0;
+
+    while(start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if(end == std::string::npos)
+        {
+            end = list.size();
+        }
+        if(end > start)
+        {
+            values.push_back(atoi(list.substr(start, end - start).c_str()));
+        }
+        start = end + 1;
+    }
+
+    return values;
+}
+
+static void print_table_header()
+{
+    printf("lights frame_ms buffer |    fps | latency p50   p90   p99   max ms | jitter p50   p99 ms | skew p50   p99 ms | gap fills never shown recovered | cpu us/frame\n");
+}
+
+static void print_table_row(const Measurement& m)
+{
+    if(!m.ok)
+    {
+        printf("%6d %8d %6d | failed to connect\n", m.config.lights_count, m.config.frame_duration_ms, m.config.buffer_frames);
+        return;
+    }
+
+    std::vector<double> latencies = m.latencies_ms;
+    std::vector<double> jitters = m.jitters_ms;
+    std::vector<double> skews = m.skews_ms;
+    const uint64_t frames = m.shown_frames ? m.shown_frames : m.sent_frames;
+
+    printf("%6d %8d %6d | %6.1f | %11.1f %5.1f %5.1f %5.1f    | %10.2f %5.2f    | %8.2f %5.2f    | %9u %11u %9u | %12.1f\n",
+        m.config.lights_count, m.config.frame_duration_ms, m.config.buffer_frames,
+        frames / m.measured_s,
+        percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99),
+        latencies.empty() ? 0 : latencies.back(),
+        percentile(jitters, 0.5), percentile(jitters, 0.99),
+        percentile(skews, 0.5), percentile(skews, 0.99),
+        (unsigned int) m.gap_fills, (unsigned int) m.never_shown_frames, (unsigned int) m.recovered_frames,
+        frames ? m.cpu_us / frames : 0);
+
+    if(m.fail_detect_ms >= 0)
+    {
+        printf("%22s | failed sink given up on after %.1f ms\n", "", m.fail_detect_ms);
+    }
+}
+
+static void print_json(const std::vector<Measurement>& measurements)
+{
+    printf("{\n  \"results\": [");
+
+    for(size_t i = 0; i < measurements.size(); ++i)
+    {
+        const Measurement& m = measurements[i];
+        std::vector<double> latencies = m.latencies_ms;
+        std::vector<double> jitters = m.jitters_ms;
+        std::vector<double> skews = m.skews_ms;
+        const uint64_t frames = m.shown_frames ? m.shown_frames : m.sent_frames;
+
+        printf("%s\n    { \"lights_count\": %d, \"frame_duration_ms\": %d, \"buffer_frames\": %d, \"ok\": %s",
+            (i > 0) ? "," : "",
+            m.config.lights_count, m.config.frame_duration_ms, m.config.buffer_frames,
+            m.ok ? "true" : "false");
+
+        if(m.ok)
+        {
+            printf(", \"seconds\": %.3f, \"sent_frames\": %u, \"shown_frames\": %u, \"fps\": %.2f",
+                m.measured_s, (unsigned int) m.sent_frames, (unsigned int) m.shown_frames, frames / m.measured_s);
+        }
+
+        // Only sinks know about latency, jitter and gaps
+        if(m.ok && m.shown_frames > 0)
+        {
+            printf(", \"latency_ms\": { \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f }",
+                percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99),
+                latencies.empty() ? 0 : latencies.back());
+            printf(", \"jitter_ms\": { \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f }",
+                percentile(jitters, 0.5), percentile(jitters, 0.99), jitters.empty() ? 0 : jitters.back());
+            if(!skews.empty())
+            {
+                printf(", \"skew_ms\": { \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f }",
+                    percentile(skews, 0.5), percentile(skews, 0.99), skews.back());
+            }
+            printf(", \"gap_fills\": %u, \"never_shown_frames\": %u, \"recovered_frames\": %u",
+                (unsigned int) m.gap_fills, (unsigned int) m.never_shown_frames, (unsigned int) m.recovered_frames);
+        }
+
+        if(m.ok && m.impair.received > 0)
+        {
+            printf(", \"impair\": { \"received\": %u, \"forwarded\": %u, \"lost\": %u, \"burst_lost\": %u, \"reordered\": %u, \"duplicated\": %u }",
+                m.impair.received, m.impair.forwarded, m.impair.lost, m.impair.burst_lost, m.impair.reordered, m.impair.duplicated);
+        }
+
+        if(m.ok && m.fail_detect_ms >= 0)
+        {
+            printf(", \"fail_detect_ms\": %.2f", m.fail_detect_ms);
+        }
+
+        if(m.ok)
+        {
+            printf(", \"cpu_us_per_frame\": %.2f", frames ? m.cpu_us / frames : 0);
+        }
+
+        printf(" }");
+    }
+
+    printf("\n  ]\n}\n");
+}
@@ -0,0 +1,505 @@
+// Microbenchmarks of the building blocks that run for every frame in sources
+// and sinks, for frames of growing amounts of lights. Results are printed to
+// stdout as JSON, so runs before and after a change can be compared:
+//
+//    node-gyp build && ./build/Release/atolla_bench > before.json
+//
+// Options:
+//    --min-time-ms <ms>   time spent measuring each case, defaults to 250
+//    --filter <text>      only runs cases with names containing the text
+//
+// Every case is measured in repetitions batches after calibrating the amount
+// of iterations per batch, the median is the number to compare, the minimum
+// helps telling noise apart from real changes.
+
+#include "../lib/atolla/mem/block.h"
+#include "../lib/atolla/mem/fill.h"
+#include "../lib/atolla/mem/ring.h"
+#include "../lib/atolla/msg/builder.h"
+#include "../lib/atolla/msg/iter.h"
+#include "../lib/atolla/udp_socket/udp_socket.h"
+#include "../lib/atolla/atolla/version.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+typedef void (*BenchFn)(void* ctx, size_t iterations);
+
+struct BenchResult
+{
+    const char* name;
+    const char* variant;
+    size_t frame_len;
+    size_t iterations;
+    double ns_median;
+    double ns_min;
+};
+
+// Frames of 1, 30, 100, 300 and 1000 lights
+static const size_t frame_lens[] = { 3, 90, 300, 900, 3000 };
+static const size_t frame_lens_count = sizeof(frame_lens) / sizeof(frame_lens[0]);
+static const int repetitions = 5;
+// Frames the rings can hold, like the pending frames of a sink
+static const size_t ring_frames = 16;
+// Like ATOLLA_SOURCE_MAX_DATAGRAM_LEN
+static const size_t max_datagram_len = 1024;
+// Frames of 300, 3000 and 20000 lights, sent whole in one datagram each
+static const size_t put_frame_lens[] = { 900, 9000, 60000 };
+static const size_t put_frame_lens_count = sizeof(put_frame_lens) / sizeof(put_frame_lens[0]);
+// Port on localhost that receives, and drops, the frames of the put cases
+static const unsigned short put_port = 10442;
+
+static double min_time_ms = 250;
+static const char* filter = NULL;
+static std::vector<BenchResult> results;
+
+// Results of the benchmarked functions are accumulated here, so the compiler
+// cannot optimize the calls away
+static volatile uint32_t bench_sink;
+
+static double bench_run_batch(BenchFn fn, void* ctx, size_t iterations);
+static void bench_measure(const char* name, const char* variant, size_t frame_len, BenchFn fn, void* ctx);
+static void bench_print_json();
+
+struct FrameCtx
+{
+    size_t frame_len;
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> out;
+};
+
+static FrameCtx frame_ctx_make(size_t frame_len)
+{
+    FrameCtx ctx;
+    ctx.frame_len = frame_len;
+    ctx.frame.resize(frame_len);
+    ctx.out.resize(frame_len);
+    for(size_t i = 0; i < frame_len; ++i)
+    {
+        ctx.frame[i] = (uint8_t) (i * 7);
+    }
+    return ctx;
+}
+
+struct BuilderCtx
+{
+    FrameCtx frame;
+    MsgBuilder builder;
+};
+
+static void bench_msg_builder_enqueue(void* ctx_ptr, size_t iterations)
+{
+    BuilderCtx* ctx = (BuilderCtx*) ctx_ptr;
+    uint32_t acc = 0;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        MemBlock* msg = msg_builder_enqueue(&ctx->builder, (uint8_t) i, &ctx->frame.frame[0], ctx->frame.frame_len);
+        acc += ((uint8_t*) msg->data)[msg->size - 1];
+    }
+
+    bench_sink += acc;
+}
+
+struct IterCtx
+{
+    std::vector<uint8_t> datagram;
+    MsgIter iter;
+};
+
+static void bench_msg_iter_enqueue(void* ctx_ptr, size_t iterations)
+{
+    IterCtx* ctx = (IterCtx*) ctx_ptr;
+    uint32_t acc = 0;
+    MsgDecoded msg;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        MsgIter iter = msg_iter_make(&ctx->datagram[0], ctx->datagram.size());
+        while(msg_iter_decode(&iter, &msg) == MSG_DECODE_OK)
+        {
+            if(msg.type == MSG_TYPE_ENQUEUE)
+            {
+                acc += msg.msg_id + msg.as.enqueue.frame_idx + (uint32_t) msg.as.enqueue.frame.size;
+            }
+        }
+    }
+
+    bench_sink += acc;
+}
+
+/**
+ * Decodes one message per iteration from a datagram holding as many messages
+ * as fit, starting over at its end, so the result is the cost per message.
+ */
+static void bench_msg_iter_decode_coalesced(void* ctx_ptr, size_t iterations)
+{
+    IterCtx* ctx = (IterCtx*) ctx_ptr;
+    uint32_t acc = 0;
+    MsgDecoded msg;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        if(msg_iter_decode(&ctx->iter, &msg) != MSG_DECODE_OK)
+        {
+            ctx->iter = msg_iter_make(&ctx->datagram[0], ctx->datagram.size());
+            msg_iter_decode(&ctx->iter, &msg);
+        }
+        acc += msg.msg_id + msg.as.enqueue.frame_idx + (uint32_t) msg.as.enqueue.frame.size;
+    }
+
+    bench_sink += acc;
+}
+
+static void bench_msg_iter_decode_malformed(void* ctx_ptr, size_t iterations)
+{
+    IterCtx* ctx = (IterCtx*) ctx_ptr;
+    uint32_t acc = 0;
+    MsgDecoded msg;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        MsgIter iter = msg_iter_make(&ctx->datagram[0], ctx->datagram.size());
+        acc += msg_iter_decode(&iter, &msg);
+    }
+
+    bench_sink += acc;
+}
+
+struct RingCtx
+{
+    FrameCtx frame;
+    MemRing ring;
+};
+
+static void bench_mem_ring_enqueue_dequeue(void* ctx_ptr, size_t iterations)
+{
+    RingCtx* ctx = (RingCtx*) ctx_ptr;
+    uint32_t acc = 0;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        mem_ring_enqueue(&ctx->ring, &ctx->frame.frame[0], ctx->frame.frame_len);
+        acc += mem_ring_dequeue(&ctx->ring, &ctx->frame.out[0], ctx->frame.frame_len);
+    }
+
+    bench_sink += acc + ctx->frame.out[0];
+}
+
+static void bench_mem_ring_enqueue_drop(void* ctx_ptr, size_t iterations)
+{
+    RingCtx* ctx = (RingCtx*) ctx_ptr;
+    uint32_t acc = 0;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        mem_ring_enqueue(&ctx->ring, &ctx->frame.frame[0], ctx->frame.frame_len);
+        acc += mem_ring_drop(&ctx->ring, ctx->frame.frame_len);
+    }
+
+    bench_sink += acc;
+}
+
+struct FillCtx
+{
+    FrameCtx frame;
+    size_t pattern_len;
+};
+
+static void bench_mem_fill_with_pattern(void* ctx_ptr, size_t iterations)
+{
+    FillCtx* ctx = (FillCtx*) ctx_ptr;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        mem_fill_with_pattern(&ctx->frame.out[0], ctx->frame.frame_len, &ctx->frame.frame[0], ctx->pattern_len);
+    }
+
+    bench_sink += ctx->frame.out[ctx->frame.frame_len - 1];
+}
+
+struct PutCtx
+{
+    FrameCtx frame;
+    MsgBuilder builder;
+    UdpSocket socket;
+};
+
+/**
+ * Builds an enqueue message with a copy of the frame and sends it, like
+ * sources did before sending header and frame as separate parts.
+ */
+static void bench_put_copy(void* ctx_ptr, size_t iterations)
+{
+    PutCtx* ctx = (PutCtx*) ctx_ptr;
+    uint32_t acc = 0;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        MemBlock* msg = msg_builder_enqueue(&ctx->builder, (uint8_t) i, &ctx->frame.frame[0], ctx->frame.frame_len);
+        acc += udp_socket_send(&ctx->socket, msg->data, msg->size).code;
+    }
+
+    bench_sink += acc;
+}
+
+/**
+ * Builds only the header and sends it together with the frame in place.
+ */
+static void bench_put_sendv(void* ctx_ptr, size_t iterations)
+{
+    PutCtx* ctx = (PutCtx*) ctx_ptr;
+    uint32_t acc = 0;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        MemBlock* header = msg_builder_enqueue_header(&ctx->builder, (uint8_t) i, ctx->frame.frame_len);
+        UdpPacketPart parts[] = {
+            { header->data, header->size },
+            { &ctx->frame.frame[0], ctx->frame.frame_len }
+        };
+        acc += udp_socket_sendv(&ctx->socket, parts, 2).code;
+    }
+
+    bench_sink += acc;
+}
+
+/**
+ * Measures building and sending an enqueue message over loopback, with and
+ * without copying the frame. Datagrams the receiver has no room for are
+ * dropped by the kernel without slowing down the sender.
+ */
+static void bench_put()
+{
+    UdpSocket receiver;
+    if(udp_socket_init_on_port(&receiver, put_port).code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Port %hu is in use, skipping the put cases\n", put_port);
+        return;
+    }
+
+    for(size_t i = 0; i < put_frame_lens_count; ++i)
+    {
+        PutCtx ctx;
+        ctx.frame = frame_ctx_make(put_frame_lens[i]);
+        msg_builder_init(&ctx.builder);
+        udp_socket_init(&ctx.socket);
+        udp_socket_set_receiver(&ctx.socket, "127.0.0.1", put_port);
+
+        bench_measure("put", "copy", put_frame_lens[i], bench_put_copy, &ctx);
+        bench_measure("put", "sendv", put_frame_lens[i], bench_put_sendv, &ctx);
+
+        udp_socket_free(&ctx.socket);
+        msg_builder_free(&ctx.builder);
+    }
+
+    udp_socket_free(&receiver);
+}
+
+struct EndpointCtx
+{
+    UdpEndpoint a;
+    UdpEndpoint b;
+};
+
+static void bench_udp_endpoint_equal(void* ctx_ptr, size_t iterations)
+{
+    EndpointCtx* ctx = (EndpointCtx*) ctx_ptr;
+    uint32_t acc = 0;
+
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        acc += udp_endpoint_equal(&ctx->a, &ctx->b);
+    }
+
+    bench_sink += acc;
+}
+
+static void bench_endpoints(const char* variant, const char* host_a, unsigned short port_a, const char* host_b, unsigned short port_b)
+{
+    EndpointCtx ctx;
+    UdpSocketResult result_a = udp_endpoint_resolve(&ctx.a, host_a, port_a);
+    UdpSocketResult result_b = udp_endpoint_resolve(&ctx.b, host_b, port_b);
+
+    // Not every machine supports IPv6, skip the case instead of failing
+    if(result_a.code == UDP_SOCKET_OK && result_b.code == UDP_SOCKET_OK)
+    {
+        bench_measure("udp_endpoint_equal", variant, 0, bench_udp_endpoint_equal, &ctx);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--min-time-ms") == 0 && (i + 1) < argc)
+        {
+            min_time_ms = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--filter") == 0 && (i + 1) < argc)
+        {
+            filter = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--min-time-ms <ms>] [--filter <text>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for(size_t i = 0; i < frame_lens_count; ++i)
+    {
+        const size_t frame_len = frame_lens[i];
+
+        BuilderCtx builder_ctx;
+        builder_ctx.frame = frame_ctx_make(frame_len);
+        msg_builder_init(&builder_ctx.builder);
+        bench_measure("msg_builder_enqueue", "", frame_len, bench_msg_builder_enqueue, &builder_ctx);
+
+        // Decodes a datagram like the ones sinks receive, the builder output
+        // is still around from the last enqueue
+        MemBlock* msg = msg_builder_enqueue(&builder_ctx.builder, 0, &builder_ctx.frame.frame[0], frame_len);
+        IterCtx iter_ctx;
+        iter_ctx.datagram.assign((uint8_t*) msg->data, (uint8_t*) msg->data + msg->size);
+        bench_measure("msg_iter_enqueue", "", frame_len, bench_msg_iter_enqueue, &iter_ctx);
+
+        // A datagram cut off in the middle of the frame, rejecting it should
+        // not cost more than the header
+        IterCtx malformed_ctx;
+        malformed_ctx.datagram.assign((uint8_t*) msg->data, (uint8_t*) msg->data + msg->size - 1);
+        bench_measure("msg_iter_decode", "truncated", frame_len, bench_msg_iter_decode_malformed, &malformed_ctx);
+
+        // Sources coalesce as many frames into a datagram as fit
+        IterCtx coalesced_ctx;
+        do
+        {
+            coalesced_ctx.datagram.insert(coalesced_ctx.datagram.end(), (uint8_t*) msg->data, (uint8_t*) msg->data + msg->size);
+        } while(coalesced_ctx.datagram.size() + msg->size <= max_datagram_len);
+        coalesced_ctx.iter = msg_iter_make(&coalesced_ctx.datagram[0], coalesced_ctx.datagram.size());
+        bench_measure("msg_iter_decode", "coalesced", frame_len, bench_msg_iter_decode_coalesced, &coalesced_ctx);
+        msg_builder_free(&builder_ctx.builder);
+
+        RingCtx ring_ctx;
+        ring_ctx.frame = frame_ctx_make(frame_len);
+        ring_ctx.ring = mem_ring_alloc(ring_frames * frame_len);
+        // Keep the ring half full, so the front wraps around regularly
+        for(size_t f = 0; f < ring_frames / 2; ++f)
+        {
+            mem_ring_enqueue(&ring_ctx.ring, &ring_ctx.frame.frame[0], frame_len);
+        }
+        bench_measure("mem_ring_enqueue_dequeue", "", frame_len, bench_mem_ring_enqueue_dequeue, &ring_ctx);
+        bench_measure("mem_ring_enqueue_drop", "", frame_len, bench_mem_ring_enqueue_drop, &ring_ctx);
+        mem_ring_free(&ring_ctx.ring);
+
+        // Sinks repeat a single color for frames of one light, and copy
+        // frames that match the amount of lights
+        FillCtx fill_ctx;
+        fill_ctx.frame = frame_ctx_make(frame_len);
+        fill_ctx.pattern_len = 3;
+        bench_measure("mem_fill_with_pattern", "one_light", frame_len, bench_mem_fill_with_pattern, &fill_ctx);
+        fill_ctx.pattern_len = frame_len;
+        bench_measure("mem_fill_with_pattern", "whole_frame", frame_len, bench_mem_fill_with_pattern, &fill_ctx);
+    }
+
+    bench_endpoints("ipv4_equal", "127.0.0.1", 10042, "127.0.0.1", 10042);
+    bench_endpoints("ipv4_other_port", "127.0.0.1", 10042, "127.0.0.1", 10043);
+    bench_endpoints("ipv6_equal", "::1", 10042, "::1", 10042);
+
+    bench_put();
+
+    bench_print_json();
+
+    return 0;
+}
+
+static double bench_run_batch(BenchFn fn, void* ctx, size_t iterations)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fn(ctx, iterations);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+/**
+ * Doubles the iterations until a batch takes long enough to be measured
+ * precisely, then runs repetitions batches that together take about
+ * min_time_ms and records the time per iteration.
+ */
+static void bench_measure(const char* name, const char* variant, size_t frame_len, BenchFn fn, void* ctx)
+{
+    if(filter != NULL && strstr(name, filter) == NULL)
+    {
+        return;
+    }
+
+    const double batch_ns = min_time_ms * 1e6 / repetitions;
+
+    size_t iterations = 1;
+    double elapsed_ns = bench_run_batch(fn, ctx, iterations);
+    while(elapsed_ns < batch_ns / 10)
+    {
+        iterations *= 2;
+        elapsed_ns = bench_run_batch(fn, ctx, iterations);
+    }
+
+    iterations = (size_t) (iterations * batch_ns / elapsed_ns);
+    if(iterations == 0)
+    {
+        iterations = 1;
+    }
+
+    double ns_per_iteration[repetitions];
+    for(int r = 0; r < repetitions; ++r)
+    {
+        ns_per_iteration[r] = bench_run_batch(fn, ctx, iterations) / iterations;
+    }
+    std::sort(ns_per_iteration, ns_per_iteration + repetitions);
+
+    BenchResult result;
+    result.name = name;
+    result.variant = variant;
+    result.frame_len = frame_len;
+    result.iterations = iterations;
+    result.ns_median = ns_per_iteration[repetitions / 2];
+    result.ns_min = ns_per_iteration[0];
+    results.push_back(result);
+}
+
+static void bench_print_json()
+{
+    printf("{\n");
+    printf("  \"library_version\": \"%d.%d.%d\",\n",
+           ATOLLA_VERSION_LIBRARY_MAJOR, ATOLLA_VERSION_LIBRARY_MINOR, ATOLLA_VERSION_LIBRARY_PATCH);
+    printf("  \"min_time_ms\": %g,\n", min_time_ms);
+    printf("  \"repetitions\": %d,\n", repetitions);
+    printf("  \"results\": [");
+
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& result = results[i];
+
+        printf("%s\n    { \"name\": \"%s\"", (i > 0) ? "," : "", result.name);
+        if(result.variant[0] != '\0')
+        {
+            printf(", \"variant\": \"%s\"", result.variant);
+        }
+        if(result.frame_len > 0)
+        {
+            printf(", \"frame_len\": %u", (unsigned int) result.frame_len);
+        }
+        printf(", \"iterations\": %u", (unsigned int) result.iterations);
+        printf(", \"ns_per_op_median\": %.2f, \"ns_per_op_min\": %.2f", result.ns_median, result.ns_min);
+        printf(", \"ops_per_s\": %.0f", 1e9 / result.ns_median);
+        if(result.frame_len > 0)
+        {
+            printf(", \"mb_per_s\": %.1f", result.frame_len * 1e3 / result.ns_median);
+        }
+        printf(" }");
+    }
+
+    printf("\n  ]\n}\n");
+}
@@ -0,0 +1,84 @@
+// Compares sending bursts of frames with one put call per frame against a
+// single putMany call per burst, passing the burst either as an array of
+// frames or as one contiguous buffer, streaming to a sink in the same process. Only
+// the time spent inside the calls is counted, waiting for the sink to make
+// room is not.
+//
+//    node bench/put-many.js
+
+const { Source, Sink } = require('../build/Release/atolla')
+
+// Every run gets its own port, the sinks of earlier runs are never freed
+const basePort = 10142
+const lightsCount = 300
+const frameDurationMs = 1
+const maxBufferedFrames = 64
+const durationMs = 2000
+
+function run (name, port, putBurst) {
+  return new Promise((resolve) => {
+    const sink = new Sink({ port, lightsCount })
+    const source = new Source({ hostname: '127.0.0.1', port, frameDurationMs, maxBufferedFrames })
+    const frames = new Uint8Array(maxBufferedFrames * 3 * lightsCount)
+    const views = []
+    for (let i = 0; i < maxBufferedFrames; ++i) {
+      views.push(frames.subarray(i * 3 * lightsCount, (i + 1) * 3 * lightsCount))
+    }
+    const sinkFrame = new Uint8Array(3 * lightsCount)
+
+    let calls = 0
+    let sent = 0
+    let busyNs = 0
+    const start = Date.now()
+
+    const timer = setInterval(() => {
+      sink.get(sinkFrame)
+      if (source.state() !== 'ATOLLA_SOURCE_STATE_OPEN') {
+        return
+      }
+
+      const readyCount = source.putReadyCount()
+      if (readyCount > 0) {
+        const before = process.hrtime.bigint()
+        const result = putBurst(source, frames, views, readyCount)
+        busyNs += Number(process.hrtime.bigint() - before)
+        calls += result.calls
+        sent += result.sent
+      }
+
+      if (Date.now() - start > durationMs) {
+        clearInterval(timer)
+        const busyS = busyNs / 1e9
+        console.log(`${name.padEnd(10)} ${String(sent).padStart(6)} frames, ` +
+                    `${(calls / busyS).toFixed(0).padStart(9)} calls/s, ` +
+                    `${(sent / busyS).toFixed(0).padStart(9)} frames/s, ` +
+                    `${(busyNs / 1e3 / sent).toFixed(2).padStart(7)} us/frame`)
+        resolve()
+      }
+    }, 1)
+  })
+}
+
+function putEach (source, frames, views, readyCount) {
+  let sent = 0
+  for (let i = 0; i < readyCount; ++i) {
+    if (source.put(views[i])) {
+      ++sent
+    }
+  }
+  return { calls: readyCount, sent }
+}
+
+function putManyArray (source, frames, views, readyCount) {
+  return { calls: 1, sent: source.putMany(views, readyCount) }
+}
+
+function putManyContiguous (source, frames, views, readyCount) {
+  const burst = frames.subarray(0, readyCount * 3 * lightsCount)
+  return { calls: 1, sent: source.putMany(burst, readyCount) }
+}
+
+run('put', basePort, putEach)
+  .then(() => run('array', basePort + 1, putManyArray))
+  .then(() => run('contiguous', basePort + 2, putManyContiguous))
+  .then(() => process.exit(0))
@@ -0,0 +1,326 @@
+// Feeds datagrams recorded by a sink back into a sink, to reproduce traffic
+// seen in the field or to measure how fast a sink evaluates it:
+//
+//    node-gyp build && ./build/Release/atolla_replay show.cap --speed max
+//
+// Captures are written by atolla_sink_capture_start, by the capture option of
+// sinks in JavaScript, or with --capture in bench/loopback.cpp.
+//
+// Options:
+//    --speed <x|max>      multiplies the original pace, max sends every
+//                         datagram right after the last, defaults to 1
+//    --mode <mode>        direct or socket, defaults to direct
+//    --port <port>        port of the sink, defaults to 10242
+//    --host <host>        host running the sink for --mode socket,
+//                         defaults to localhost
+//    --loop               starts over after the last datagram until
+//                         interrupted
+//
+// With --mode direct, a sink with the lights count of the capturing sink is
+// made on --port and every datagram is passed to atolla_sink_inject, skipping
+// the network. With --mode socket, the datagrams are sent to an already
+// running sink at --host and --port instead.
+//
+// Every sender in the capture is replaced with a socket of this process on the
+// ports following --port, so that replies of the sink never reach the original
+// senders and separate sources stay separate. Replies are received and
+// counted, but not evaluated.
+
+#include "../lib/atolla/atolla/sink.h"
+#include "../lib/atolla/capture/capture.h"
+#include "../lib/atolla/udp_socket/udp_socket.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+enum Mode
+{
+    MODE_DIRECT,
+    MODE_SOCKET
+};
+
+struct Options
+{
+    const char* capture_path;
+    // Zero means as fast as possible
+    double speed;
+    Mode mode;
+    int port;
+    const char* host;
+    bool loop;
+};
+
+struct Sender
+{
+    // Sender as found in the capture
+    UdpEndpoint captured;
+    // Socket standing in for the captured sender
+    UdpSocket socket;
+    // Address of the socket, passed to atolla_sink_inject in direct mode
+    UdpEndpoint local;
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_interrupt(int signal)
+{
+    interrupted = 1;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Finds the stand-in for the given captured sender, or opens a socket for it
+ * on the next free port. Returns NULL if no socket could be opened.
+ */
+static Sender* replay_sender(std::vector<Sender*>& senders, const Options& options, UdpEndpoint* captured)
+{
+    for(size_t i = 0; i < senders.size(); ++i)
+    {
+        if(udp_endpoint_equal(&senders[i]->captured, captured))
+        {
+            return senders[i];
+        }
+    }
+
+    Sender* sender = new Sender();
+    sender->captured = *captured;
+
+    const unsigned short port = (unsigned short) (options.port + 1 + senders.size());
+    if(udp_socket_init_on_port(&sender->socket, port).code != UDP_SOCKET_OK ||
+       udp_endpoint_resolve(&sender->local, "127.0.0.1", port).code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Could not open a socket on port %d for sender %zu\n", (int) port, senders.size());
+        delete sender;
+        return NULL;
+    }
+
+    if(options.mode == MODE_SOCKET &&
+       udp_socket_set_receiver(&sender->socket, options.host, (unsigned short) options.port).code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Could not resolve %s\n", options.host);
+        udp_socket_free(&sender->socket);
+        delete sender;
+        return NULL;
+    }
+
+    senders.push_back(sender);
+    return sender;
+}
+
+/**
+ * Receives and counts replies of the sink and lets the sink in direct mode
+ * play out, so it behaves like in normal operation.
+ */
+static void replay_poll(std::vector<Sender*>& senders, AtollaSink* sink, std::vector<uint8_t>& frame, uint64_t* replies)
+{
+    uint8_t reply[1024];
+    size_t reply_len;
+
+    for(size_t i = 0; i < senders.size(); ++i)
+    {
+        while(udp_socket_receive(&senders[i]->socket, reply, sizeof(reply), &reply_len, false).code == UDP_SOCKET_OK)
+        {
+            ++*replies;
+        }
+    }
+
+    if(sink != NULL && atolla_sink_state(*sink) == ATOLLA_SINK_STATE_LENT)
+    {
+        atolla_sink_get(*sink, &frame[0], frame.size());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    options.capture_path = NULL;
+    options.speed = 1;
+    options.mode = MODE_DIRECT;
+    options.port = 10242;
+    options.host = "localhost";
+    options.loop = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const bool has_value = (i + 1) < argc;
+
+        if(strcmp(argv[i], "--speed") == 0 && has_value)
+        {
+            ++i;
+            options.speed = (strcmp(argv[i], "max") == 0) ? 0 : atof(argv[i]);
+            if(options.speed < 0)
+            {
+                options.speed = 0;
+            }
+        }
+        else if(strcmp(argv[i], "--mode") == 0 && has_value)
+        {
+            ++i;
+            if(strcmp(argv[i], "direct") == 0)
+            {
+                options.mode = MODE_DIRECT;
+            }
+            else if(strcmp(argv[i], "socket") == 0)
+            {
+                options.mode = MODE_SOCKET;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown mode %s, use direct or socket\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--port") == 0 && has_value)
+        {
+            options.port = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--host") == 0 && has_value)
+        {
+            options.host = argv[++i];
+        }
+        else if(strcmp(argv[i], "--loop") == 0)
+        {
+            options.loop = true;
+        }
+        else if(argv[i][0] != '-' && options.capture_path == NULL)
+        {
+            options.capture_path = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "Unknown or incomplete option %s, see the top of bench/replay.cpp for usage\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if(options.capture_path == NULL || options.port <= 0)
+    {
+        fprintf(stderr, "Usage: %s <capture> [--speed <x|max>] [--mode direct|socket] [--port <port>] [--host <host>] [--loop]\n", argv[0]);
+        return 1;
+    }
+
+    CaptureReader reader;
+    if(!capture_reader_open(&reader, options.capture_path))
+    {
+        fprintf(stderr, "Could not read %s as a capture\n", options.capture_path);
+        return 1;
+    }
+
+    AtollaSink sink;
+    AtollaSink* direct_sink = NULL;
+    std::vector<uint8_t> frame(3 * (reader.lights_count > 0 ? reader.lights_count : 1));
+    if(options.mode == MODE_DIRECT)
+    {
+        AtollaSinkSpec sink_spec;
+        sink_spec.port = options.port;
+        sink_spec.lights_count = (int) reader.lights_count;
+        sink = atolla_sink_make(&sink_spec);
+        direct_sink = &sink;
+
+        if(atolla_sink_state(sink) == ATOLLA_SINK_STATE_ERROR)
+        {
+            fprintf(stderr, "Could not make a sink on port %d\n", options.port);
+            capture_reader_close(&reader);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+
+    std::vector<Sender*> senders;
+    uint64_t replayed = 0;
+    uint64_t replayed_bytes = 0;
+    uint64_t replies = 0;
+    bool failed = false;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // Capture time at which the current pass over the capture started
+    double pass_offset_s = 0;
+    double last_time_s = 0;
+    CaptureRecord record;
+
+    while(!interrupted && !failed)
+    {
+        if(!capture_reader_next(&reader, &record))
+        {
+            if(!options.loop || replayed == 0)
+            {
+                break;
+            }
+
+            capture_reader_rewind(&reader);
+            pass_offset_s = last_time_s;
+            continue;
+        }
+
+        last_time_s = pass_offset_s + record.time_us / 1000000.0;
+
+        if(options.speed > 0)
+        {
+            const double due_s = last_time_s / options.speed;
+            double wait_s;
+            while(!interrupted && (wait_s = due_s - seconds_since(start)) > 0)
+            {
+                replay_poll(senders, direct_sink, frame, &replies);
+                usleep((useconds_t) ((wait_s > 0.0005) ? 500 : (wait_s * 1000000)));
+            }
+        }
+
+        Sender* sender = replay_sender(senders, options, &record.sender);
+        if(sender == NULL)
+        {
+            failed = true;
+            break;
+        }
+
+        if(options.mode == MODE_DIRECT)
+        {
+            atolla_sink_inject(sink, record.datagram, record.datagram_len, &sender->local);
+        }
+        else
+        {
+            udp_socket_send(&sender->socket, (void*) record.datagram, record.datagram_len);
+        }
+
+        ++replayed;
+        replayed_bytes += record.datagram_len;
+
+        replay_poll(senders, direct_sink, frame, &replies);
+    }
+
+    const double elapsed_s = seconds_since(start);
+
+    printf("replayed %llu datagrams (%llu bytes) from %zu senders in %.3f s, %.0f datagrams/s, %llu replies\n",
+        (unsigned long long) replayed, (unsigned long long) replayed_bytes, senders.size(), elapsed_s,
+        (elapsed_s > 0) ? (replayed / elapsed_s) : 0.0, (unsigned long long) replies);
+
+    if(direct_sink != NULL)
+    {
+        AtollaSinkStats stats;
+        atolla_sink_stats(sink, &stats);
+        printf("sink received_packets %u malformed_packets %u received_frames %u lost_frames %u fec_recovered %u late_recovered %u too_late %u sent_nacks %u\n",
+            stats.received_packets, stats.malformed_packets, stats.received_frames, stats.lost_frames,
+            stats.fec_recovered_frames, stats.late_recovered_frames, stats.too_late_frames, stats.sent_nacks);
+        atolla_sink_free(sink);
+    }
+
+    for(size_t i = 0; i < senders.size(); ++i)
+    {
+        udp_socket_free(&senders[i]->socket);
+        delete senders[i];
+    }
+    capture_reader_close(&reader);
+
+    return failed ? 1 : 0;
+}
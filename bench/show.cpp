@@ -0,0 +1,304 @@
+// Records pre-rendered shows and streams them to a sink, or streams raw RGB
+// frames read from standard input, e.g. rendered by ffmpeg:
+//
+//    node-gyp build
+//    ffmpeg -i show.mp4 -vf scale=30:1 -r 50 -f rawvideo -pix_fmt rgb24 - | ./build/Release/atolla_show record show.atl --lights 30 --frame-ms 20 --delta
+//    ./build/Release/atolla_show play show.atl --host 192.168.1.42 --port 10042 --loop
+//    ffmpeg -re -i show.mp4 -vf scale=30:1 -r 50 -f rawvideo -pix_fmt rgb24 - | ./build/Release/atolla_show stream --lights 30 --frame-ms 20 --host 192.168.1.42
+//
+// Commands:
+//    record <file>        writes the frames on standard input into a show file
+//    play <file>          streams a show file, see atolla_source_stream_show
+//    stream               streams the frames on standard input as they come
+//
+// Options:
+//    --lights <n>         lights per frame on standard input, every frame is
+//                         three times as many bytes of red, green and blue
+//    --frame-ms <ms>      frame duration of standard input, defaults to 20
+//    --delta              records only changes to the frame before, which
+//                         makes still scenes take up almost no space
+//    --host <host>        host of the sink, defaults to localhost
+//    --port <port>        port of the sink, defaults to 10042
+//    --buffer <n>         frames buffered in the sink, defaults to 8
+//    --loop               plays the show again after the last frame until
+//                         interrupted
+//
+// The show file format is described in lib/atolla/show/show.h.
+
+#include "../lib/atolla/atolla/source.h"
+#include "../lib/atolla/show/show.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct Options
+{
+    const char* command;
+    const char* path;
+    int lights;
+    int frame_ms;
+    bool delta;
+    const char* host;
+    int port;
+    int buffer;
+    bool loop;
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_interrupt(int signal)
+{
+    interrupted = 1;
+}
+
+/**
+ * Reads exactly one frame from standard input, returns false at the end of
+ * the input.
+ */
+static bool show_read_stdin(std::vector<uint8_t>& frame)
+{
+    return fread(&frame[0], 1, frame.size(), stdin) == frame.size();
+}
+
+static bool show_make_source(const Options& options, int frame_ms, AtollaSource* source)
+{
+    AtollaSourceSpec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.sink_hostname = options.host;
+    spec.sink_port = options.port;
+    spec.frame_duration_ms = frame_ms;
+    spec.max_buffered_frames = options.buffer;
+    spec.async_make = false;
+
+    *source = atolla_source_make(&spec);
+    if(atolla_source_state(*source) != ATOLLA_SOURCE_STATE_OPEN)
+    {
+        fprintf(stderr, "Could not borrow sink at %s:%d: %s\n", options.host, options.port, atolla_source_error_msg(*source));
+        atolla_source_free(*source);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Keeps the borrow alive until the frames still buffered in the sink were
+ * played, then frees the source.
+ */
+static void show_finish(AtollaSource source, int frame_ms, int buffer)
+{
+    for(int waited_ms = 0; !interrupted && waited_ms < frame_ms * buffer; waited_ms += frame_ms)
+    {
+        atolla_source_state(source);
+        usleep(frame_ms * 1000);
+    }
+
+    AtollaSourceStats stats;
+    atolla_source_stats(source, &stats);
+    printf("sent %u frames, %u retransmitted, sink lost %u\n", stats.sent_frames, stats.retransmitted_frames, stats.sink_lost_frames);
+
+    atolla_source_free(source);
+}
+
+static int show_record(const Options& options)
+{
+    if(options.lights <= 0)
+    {
+        fprintf(stderr, "Recording needs --lights\n");
+        return 1;
+    }
+
+    ShowWriter writer;
+    if(!show_writer_open(&writer, options.path, options.lights, options.frame_ms, options.delta))
+    {
+        fprintf(stderr, "Could not create %s\n", options.path);
+        return 1;
+    }
+
+    std::vector<uint8_t> frame(options.lights * 3);
+    bool ok = true;
+    while(ok && !interrupted && show_read_stdin(frame))
+    {
+        ok = show_writer_append(&writer, &frame[0]);
+    }
+
+    unsigned int frame_count = writer.frame_count;
+    ok = show_writer_close(&writer) && ok;
+    if(!ok)
+    {
+        fprintf(stderr, "Could not write %s\n", options.path);
+        return 1;
+    }
+
+    printf("recorded %u frames\n", frame_count);
+    return 0;
+}
+
+static int show_play(const Options& options)
+{
+    // Only opened for the frame duration, the source maps the show itself
+    ShowReader show;
+    if(!show_reader_open(&show, options.path, 0))
+    {
+        fprintf(stderr, "Could not read %s as a show\n", options.path);
+        return 1;
+    }
+    const int frame_ms = (int) show.frame_duration_ms;
+    show_reader_close(&show);
+
+    AtollaSource source;
+    if(!show_make_source(options, frame_ms, &source))
+    {
+        return 1;
+    }
+
+    if(!atolla_source_stream_show(source, options.path, options.loop))
+    {
+        fprintf(stderr, "Could not stream %s\n", options.path);
+        atolla_source_free(source);
+        return 1;
+    }
+
+    while(!interrupted)
+    {
+        if(atolla_source_state(source) == ATOLLA_SOURCE_STATE_ERROR)
+        {
+            fprintf(stderr, "Streaming failed: %s\n", atolla_source_error_msg(source));
+            atolla_source_free(source);
+            return 1;
+        }
+
+        // Looping shows start over once all frames of a pass were sent
+        if(!options.loop && atolla_source_show_frames_left(source) == 0)
+        {
+            break;
+        }
+
+        int timeout = atolla_source_put_ready_timeout(source);
+        usleep(((timeout > 1) ? timeout : 1) * 1000);
+    }
+
+    show_finish(source, frame_ms, options.buffer);
+    return 0;
+}
+
+static int show_stream(const Options& options)
+{
+    if(options.lights <= 0)
+    {
+        fprintf(stderr, "Streaming needs --lights\n");
+        return 1;
+    }
+
+    AtollaSource source;
+    if(!show_make_source(options, options.frame_ms, &source))
+    {
+        return 1;
+    }
+
+    // A single frame for all of the input, atolla_source_put waits for room
+    std::vector<uint8_t> frame(options.lights * 3);
+    while(!interrupted && show_read_stdin(frame))
+    {
+        if(!atolla_source_put(source, &frame[0], frame.size()))
+        {
+            fprintf(stderr, "Streaming failed: %s\n", atolla_source_error_msg(source));
+            atolla_source_free(source);
+            return 1;
+        }
+    }
+
+    show_finish(source, options.frame_ms, options.buffer);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    options.command = NULL;
+    options.path = NULL;
+    options.lights = 0;
+    options.frame_ms = 20;
+    options.delta = false;
+    options.host = "localhost";
+    options.port = 10042;
+    options.buffer = 8;
+    options.loop = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const bool has_value = (i + 1) < argc;
+
+        if(strcmp(argv[i], "--lights") == 0 && has_value)
+        {
+            options.lights = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--frame-ms") == 0 && has_value)
+        {
+            options.frame_ms = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--delta") == 0)
+        {
+            options.delta = true;
+        }
+        else if(strcmp(argv[i], "--host") == 0 && has_value)
+        {
+            options.host = argv[++i];
+        }
+        else if(strcmp(argv[i], "--port") == 0 && has_value)
+        {
+            options.port = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--buffer") == 0 && has_value)
+        {
+            options.buffer = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--loop") == 0)
+        {
+            options.loop = true;
+        }
+        else if(argv[i][0] != '-' && options.command == NULL)
+        {
+            options.command = argv[i];
+        }
+        else if(argv[i][0] != '-' && options.path == NULL)
+        {
+            options.path = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "Unknown or incomplete option %s, see the top of bench/show.cpp for usage\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if(options.frame_ms < 10 || options.buffer < 1)
+    {
+        fprintf(stderr, "Frames must last at least 10 ms and at least one frame must be buffered\n");
+        return 1;
+    }
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+
+    if(options.command != NULL && strcmp(options.command, "record") == 0 && options.path != NULL)
+    {
+        return show_record(options);
+    }
+    else if(options.command != NULL && strcmp(options.command, "play") == 0 && options.path != NULL)
+    {
+        return show_play(options);
+    }
+    else if(options.command != NULL && strcmp(options.command, "stream") == 0)
+    {
+        return show_stream(options);
+    }
+
+    fprintf(stderr, "Usage: %s record <file> --lights <n> | play <file> | stream --lights <n> [options]\n", argv[0]);
+    return 1;
+}
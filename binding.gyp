@@ -1,4 +1,19 @@
 {
+  "variables": {
+    "atolla_trace%": 0
+  },
+  "target_defaults": {
+    "conditions": [
+      [
+        "atolla_trace==1",
+        {
+          "defines": [
+            "ATOLLA_ENABLE_TRACE"
+          ]
+        }
+      ]
+    ]
+  },
   "targets": [
     {
       "target_name": "atolla",
@@ -6,18 +21,131 @@
         "sink.cc",
         "source.cc",
         "atolla.cc",
+        "colors.cc",
+        "css_color.cc",
+        "effect.cc",
+        "effect_graph.cc",
+        "resolver.cc",
+        "lib/atolla/atolla/error_msg.cpp",
+        "lib/atolla/atolla/multi_source.cpp",
         "lib/atolla/atolla/sink.cpp",
         "lib/atolla/atolla/source.cpp",
+        "lib/atolla/capture/capture.cpp",
         "lib/atolla/mem/block.c",
+        "lib/atolla/mem/fill.c",
         "lib/atolla/mem/ring.c",
         "lib/atolla/msg/builder.c",
         "lib/atolla/msg/iter.c",
+        "lib/atolla/show/show.cpp",
         "lib/atolla/time/mach_gettime.c",
         "lib/atolla/time/now.c",
+        "lib/atolla/trace/trace.c",
+        "lib/atolla/udp_socket/udp_socket_base.cpp",
+        "lib/atolla/udp_socket/udp_socket_bsdlike.cpp",
+        "lib/atolla/udp_socket/udp_socket_results_internal.cpp"
+      ]
+    },
+    {
+      "target_name": "atolla_bench",
+      "type": "executable",
+      "sources": [
+        "bench/micro.cpp",
+        "lib/atolla/mem/block.c",
+        "lib/atolla/mem/fill.c",
+        "lib/atolla/mem/ring.c",
+        "lib/atolla/msg/builder.c",
+        "lib/atolla/msg/iter.c",
         "lib/atolla/udp_socket/udp_socket_base.cpp",
         "lib/atolla/udp_socket/udp_socket_bsdlike.cpp",
         "lib/atolla/udp_socket/udp_socket_results_internal.cpp"
       ]
     }
+  ],
+  "conditions": [
+    [
+      "OS!='win'",
+      {
+        "targets": [
+          {
+            "target_name": "atolla_loopback",
+            "type": "executable",
+            "sources": [
+              "bench/impair.cpp",
+              "bench/loopback.cpp",
+              "lib/atolla/atolla/error_msg.cpp",
+              "lib/atolla/atolla/multi_source.cpp",
+              "lib/atolla/atolla/sink.cpp",
+              "lib/atolla/atolla/source.cpp",
+              "lib/atolla/capture/capture.cpp",
+              "lib/atolla/mem/block.c",
+              "lib/atolla/mem/fill.c",
+              "lib/atolla/mem/ring.c",
+              "lib/atolla/msg/builder.c",
+              "lib/atolla/msg/iter.c",
+              "lib/atolla/show/show.cpp",
+              "lib/atolla/time/mach_gettime.c",
+              "lib/atolla/time/now.c",
+              "lib/atolla/trace/trace.c",
+              "lib/atolla/udp_socket/udp_socket_base.cpp",
+              "lib/atolla/udp_socket/udp_socket_bsdlike.cpp",
+              "lib/atolla/udp_socket/udp_socket_results_internal.cpp"
+            ]
+          },
+          {
+            "target_name": "atolla_impair_relay",
+            "type": "executable",
+            "sources": [
+              "bench/impair.cpp",
+              "bench/impair_relay.cpp",
+              "lib/atolla/udp_socket/udp_socket_base.cpp",
+              "lib/atolla/udp_socket/udp_socket_bsdlike.cpp",
+              "lib/atolla/udp_socket/udp_socket_results_internal.cpp"
+            ]
+          },
+          {
+            "target_name": "atolla_replay",
+            "type": "executable",
+            "sources": [
+              "bench/replay.cpp",
+              "lib/atolla/atolla/error_msg.cpp",
+              "lib/atolla/atolla/sink.cpp",
+              "lib/atolla/capture/capture.cpp",
+              "lib/atolla/mem/block.c",
+              "lib/atolla/mem/fill.c",
+              "lib/atolla/mem/ring.c",
+              "lib/atolla/msg/builder.c",
+              "lib/atolla/msg/iter.c",
+              "lib/atolla/time/mach_gettime.c",
+              "lib/atolla/time/now.c",
+              "lib/atolla/trace/trace.c",
+              "lib/atolla/udp_socket/udp_socket_base.cpp",
+              "lib/atolla/udp_socket/udp_socket_bsdlike.cpp",
+              "lib/atolla/udp_socket/udp_socket_results_internal.cpp"
+            ]
+          },
+          {
+            "target_name": "atolla_show",
+            "type": "executable",
+            "sources": [
+              "bench/show.cpp",
+              "lib/atolla/atolla/error_msg.cpp",
+              "lib/atolla/atolla/source.cpp",
+              "lib/atolla/mem/block.c",
+              "lib/atolla/mem/fill.c",
+              "lib/atolla/mem/ring.c",
+              "lib/atolla/msg/builder.c",
+              "lib/atolla/msg/iter.c",
+              "lib/atolla/show/show.cpp",
+              "lib/atolla/time/mach_gettime.c",
+              "lib/atolla/time/now.c",
+              "lib/atolla/trace/trace.c",
+              "lib/atolla/udp_socket/udp_socket_base.cpp",
+              "lib/atolla/udp_socket/udp_socket_bsdlike.cpp",
+              "lib/atolla/udp_socket/udp_socket_results_internal.cpp"
+            ]
+          }
+        ]
+      }
+    ]
   ]
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "colors.h"
+#include "css_color.h"
+
+#include <cassert>
+
+using namespace v8;
+using namespace atolla;
+
+// Longer strings cannot be reasonable CSS colors and are rejected without
+// copying them out of V8
+static const int cssColorMaxLen = 128;
+
+static void ParseColors(const FunctionCallbackInfo<Value>& args);
+static bool ParseColor(Local<Value> color, uint8_t* rgb);
+
+void atolla::InitColors(Handle<Object> exports) {
+    NODE_SET_METHOD(exports, "parseColors", ParseColors);
+}
+
+/**
+ * parseColors(colors, target[, offset]) parses either a single CSS color string
+ * or an array of them and writes the RGB triplets into the Uint8Array target,
+ * starting at the byte offset, or 0 if not given.
+ *
+ * Returns the amount of bytes written, or -1 if any of the colors was invalid,
+ * in which case target may already have been partially overwritten. Throws if
+ * target is too small to hold all colors.
+ */
+static void ParseColors(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    if(args.Length() < 2) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "parseColors requires colors and a target Uint8Array")));
+        return;
+    }
+
+    if(!args[0]->IsString() && !args[0]->IsArray()) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Colors argument must be a String or an Array of Strings")));
+        return;
+    }
+
+    if(!args[1]->IsUint8Array()) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Target argument is not a Uint8Array")));
+        return;
+    }
+
+    Local<Uint8Array> target = args[1].As<Uint8Array>();
+    v8::ArrayBuffer::Contents target_c = target->Buffer()->GetContents();
+    const size_t target_length = target->ByteLength();
+    uint8_t* const target_data = static_cast<uint8_t*>(target_c.Data()) + target->ByteOffset();
+
+    size_t offset = 0;
+    if(args.Length() >= 3 && !args[2]->IsUndefined()) {
+        if(!args[2]->IsNumber() || args[2]->NumberValue() < 0 || args[2]->NumberValue() > target_length) {
+            isolate->ThrowException(
+                Exception::TypeError(
+                    String::NewFromUtf8(isolate, "Offset argument must be a Number in range 0..target.length")));
+            return;
+        }
+        offset = (size_t) args[2]->NumberValue();
+    }
+
+    size_t colors_count;
+    Local<Array> colors;
+    if(args[0]->IsArray()) {
+        colors = args[0].As<Array>();
+        colors_count = colors->Length();
+    } else {
+        colors_count = 1;
+    }
+
+    if(colors_count * 3 > target_length - offset) {
+        isolate->ThrowException(
+            Exception::RangeError(
+                String::NewFromUtf8(isolate, "Target Uint8Array is too small for the given colors")));
+        return;
+    }
+
+    if(colors_count > 0) {
+        assert(target_data != nullptr);
+    }
+
+    uint8_t* rgb = target_data + offset;
+    bool ok;
+    if(args[0]->IsArray()) {
+        ok = true;
+        for(uint32_t i = 0; ok && i < colors_count; ++i, rgb += 3) {
+            ok = ParseColor(colors->Get(i), rgb);
+        }
+    } else {
+        ok = ParseColor(args[0], rgb);
+    }
+
+    args.GetReturnValue().Set(Number::New(isolate, ok ? (double) (colors_count * 3) : -1.0));
+}
+
+static bool ParseColor(Local<Value> color, uint8_t* rgb) {
+    if(!color->IsString()) {
+        return false;
+    }
+
+    Local<String> str = color.As<String>();
+    int len = str->Length();
+
+    // Characters outside Latin-1 would be truncated when copying and cannot
+    // occur in a valid color anyway
+    if(len > cssColorMaxLen || !str->ContainsOnlyOneByte()) {
+        return false;
+    }
+
+    uint8_t css[cssColorMaxLen];
+    str->WriteOneByte(css, 0, len, String::NO_NULL_TERMINATION);
+
+    return ParseCssColor(reinterpret_cast<const char*>(css), len, rgb);
+}
@@ -0,0 +1,14 @@
+#ifndef COLORS_H
+#define COLORS_H
+
+#include <node.h>
+
+namespace atolla {
+  /**
+   * Exports parseColors, which converts a CSS color string or an array of them
+   * into RGB triplets written to a caller-provided Uint8Array.
+   */
+  void InitColors(v8::Handle<v8::Object> exports);
+}
+
+#endif // COLORS_H
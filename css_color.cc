@@ -0,0 +1,489 @@
+#include "css_color.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace atolla;
+
+// Longest name in the table below is lightgoldenrodyellow
+static const size_t cssColorNameMaxLen = 20;
+
+static const double pi = 3.14159265358979323846;
+
+struct NamedColor {
+    const char* name;
+    uint8_t r, g, b;
+};
+
+// Sorted by name, so it can be binary searched
+static const NamedColor namedColors[] = {
+    { "aliceblue", 240, 248, 255 },
+    { "antiquewhite", 250, 235, 215 },
+    { "aqua", 0, 255, 255 },
+    { "aquamarine", 127, 255, 212 },
+    { "azure", 240, 255, 255 },
+    { "beige", 245, 245, 220 },
+    { "bisque", 255, 228, 196 },
+    { "black", 0, 0, 0 },
+    { "blanchedalmond", 255, 235, 205 },
+    { "blue", 0, 0, 255 },
+    { "blueviolet", 138, 43, 226 },
+    { "brown", 165, 42, 42 },
+    { "burlywood", 222, 184, 135 },
+    { "cadetblue", 95, 158, 160 },
+    { "chartreuse", 127, 255, 0 },
+    { "chocolate", 210, 105, 30 },
+    { "coral", 255, 127, 80 },
+    { "cornflowerblue", 100, 149, 237 },
+    { "cornsilk", 255, 248, 220 },
+    { "crimson", 220, 20, 60 },
+    { "cyan", 0, 255, 255 },
+    { "darkblue", 0, 0, 139 },
+    { "darkcyan", 0, 139, 139 },
+    { "darkgoldenrod", 184, 134, 11 },
+    { "darkgray", 169, 169, 169 },
+    { "darkgreen", 0, 100, 0 },
+    { "darkgrey", 169, 169, 169 },
+    { "darkkhaki", 189, 183, 107 },
+    { "darkmagenta", 139, 0, 139 },
+    { "darkolivegreen", 85, 107, 47 },
+    { "darkorange", 255, 140, 0 },
+    { "darkorchid", 153, 50, 204 },
+    { "darkred", 139, 0, 0 },
+    { "darksalmon", 233, 150, 122 },
+    { "darkseagreen", 143, 188, 143 },
+    { "darkslateblue", 72, 61, 139 },
+    { "darkslategray", 47, 79, 79 },
+    { "darkslategrey", 47, 79, 79 },
+    { "darkturquoise", 0, 206, 209 },
+    { "darkviolet", 148, 0, 211 },
+    { "deeppink", 255, 20, 147 },
+    { "deepskyblue", 0, 191, 255 },
+    { "dimgray", 105, 105, 105 },
+    { "dimgrey", 105, 105, 105 },
+    { "dodgerblue", 30, 144, 255 },
+    { "firebrick", 178, 34, 34 },
+    { "floralwhite", 255, 250, 240 },
+    { "forestgreen", 34, 139, 34 },
+    { "fuchsia", 255, 0, 255 },
+    { "gainsboro", 220, 220, 220 },
+    { "ghostwhite", 248, 248, 255 },
+    { "gold", 255, 215, 0 },
+    { "goldenrod", 218, 165, 32 },
+    { "gray", 128, 128, 128 },
+    { "green", 0, 128, 0 },
+    { "greenyellow", 173, 255, 47 },
+    { "grey", 128, 128, 128 },
+    { "honeydew", 240, 255, 240 },
+    { "hotpink", 255, 105, 180 },
+    { "indianred", 205, 92, 92 },
+    { "indigo", 75, 0, 130 },
+    { "ivory", 255, 255, 240 },
+    { "khaki", 240, 230, 140 },
+    { "lavender", 230, 230, 250 },
+    { "lavenderblush", 255, 240, 245 },
+    { "lawngreen", 124, 252, 0 },
+    { "lemonchiffon", 255, 250, 205 },
+    { "lightblue", 173, 216, 230 },
+    { "lightcoral", 240, 128, 128 },
+    { "lightcyan", 224, 255, 255 },
+    { "lightgoldenrodyellow", 250, 250, 210 },
+    { "lightgray", 211, 211, 211 },
+    { "lightgreen", 144, 238, 144 },
+    { "lightgrey", 211, 211, 211 },
+    { "lightpink", 255, 182, 193 },
+    { "lightsalmon", 255, 160, 122 },
+    { "lightseagreen", 32, 178, 170 },
+    { "lightskyblue", 135, 206, 250 },
+    { "lightslategray", 119, 136, 153 },
+    { "lightslategrey", 119, 136, 153 },
+    { "lightsteelblue", 176, 196, 222 },
+    { "lightyellow", 255, 255, 224 },
+    { "lime", 0, 255, 0 },
+    { "limegreen", 50, 205, 50 },
+    { "linen", 250, 240, 230 },
+    { "magenta", 255, 0, 255 },
+    { "maroon", 128, 0, 0 },
+    { "mediumaquamarine", 102, 205, 170 },
+    { "mediumblue", 0, 0, 205 },
+    { "mediumorchid", 186, 85, 211 },
+    { "mediumpurple", 147, 112, 219 },
+    { "mediumseagreen", 60, 179, 113 },
+    { "mediumslateblue", 123, 104, 238 },
+    { "mediumspringgreen", 0, 250, 154 },
+    { "mediumturquoise", 72, 209, 204 },
+    { "mediumvioletred", 199, 21, 133 },
+    { "midnightblue", 25, 25, 112 },
+    { "mintcream", 245, 255, 250 },
+    { "mistyrose", 255, 228, 225 },
+    { "moccasin", 255, 228, 181 },
+    { "navajowhite", 255, 222, 173 },
+    { "navy", 0, 0, 128 },
+    { "oldlace", 253, 245, 230 },
+    { "olive", 128, 128, 0 },
+    { "olivedrab", 107, 142, 35 },
+    { "orange", 255, 165, 0 },
+    { "orangered", 255, 69, 0 },
+    { "orchid", 218, 112, 214 },
+    { "palegoldenrod", 238, 232, 170 },
+    { "palegreen", 152, 251, 152 },
+    { "paleturquoise", 175, 238, 238 },
+    { "palevioletred", 219, 112, 147 },
+    { "papayawhip", 255, 239, 213 },
+    { "peachpuff", 255, 218, 185 },
+    { "peru", 205, 133, 63 },
+    { "pink", 255, 192, 203 },
+    { "plum", 221, 160, 221 },
+    { "powderblue", 176, 224, 230 },
+    { "purple", 128, 0, 128 },
+    { "rebeccapurple", 102, 51, 153 },
+    { "red", 255, 0, 0 },
+    { "rosybrown", 188, 143, 143 },
+    { "royalblue", 65, 105, 225 },
+    { "saddlebrown", 139, 69, 19 },
+    { "salmon", 250, 128, 114 },
+    { "sandybrown", 244, 164, 96 },
+    { "seagreen", 46, 139, 87 },
+    { "seashell", 255, 245, 238 },
+    { "sienna", 160, 82, 45 },
+    { "silver", 192, 192, 192 },
+    { "skyblue", 135, 206, 235 },
+    { "slateblue", 106, 90, 205 },
+    { "slategray", 112, 128, 144 },
+    { "slategrey", 112, 128, 144 },
+    { "snow", 255, 250, 250 },
+    { "springgreen", 0, 255, 127 },
+    { "steelblue", 70, 130, 180 },
+    { "tan", 210, 180, 140 },
+    { "teal", 0, 128, 128 },
+    { "thistle", 216, 191, 216 },
+    { "tomato", 255, 99, 71 },
+    { "transparent", 0, 0, 0 },
+    { "turquoise", 64, 224, 208 },
+    { "violet", 238, 130, 238 },
+    { "wheat", 245, 222, 179 },
+    { "white", 255, 255, 255 },
+    { "whitesmoke", 245, 245, 245 },
+    { "yellow", 255, 255, 0 },
+    { "yellowgreen", 154, 205, 50 },
+};
+
+static const size_t namedColorsCount = sizeof(namedColors) / sizeof(namedColors[0]);
+
+struct CssCursor {
+    const char* pos;
+    const char* end;
+};
+
+static bool ParseNamed(const char* css, size_t len, uint8_t* rgb);
+static bool ParseHex(const char* css, size_t len, uint8_t* rgb);
+static bool ParseFunction(const char* css, size_t len, uint8_t* rgb);
+static void SkipWhitespace(CssCursor& cursor);
+static bool SkipChar(CssCursor& cursor, char c);
+static bool SkipKeyword(CssCursor& cursor, const char* keyword);
+static bool ParseNumber(CssCursor& cursor, double& number);
+static bool ParseComponents(CssCursor& cursor, bool hsl, double* components);
+static uint8_t RoundComponent(double value);
+static double HueToRgb(double p, double q, double t);
+
+static inline bool IsWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static inline char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (c - 'A' + 'a') : c;
+}
+
+static inline int HexDigit(char c) {
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    } else if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else {
+        return -1;
+    }
+}
+
+bool atolla::ParseCssColor(const char* css, size_t len, uint8_t* rgb) {
+    while(len > 0 && IsWhitespace(css[0])) {
+        ++css;
+        --len;
+    }
+    while(len > 0 && IsWhitespace(css[len - 1])) {
+        --len;
+    }
+
+    if(len == 0) {
+        return false;
+    }
+
+    // Hex digits without # are only tried if there is no color of that name,
+    // the same precedence tinycolor uses
+    if(css[0] == '#') {
+        return ParseHex(css + 1, len - 1, rgb);
+    } else if(memchr(css, '(', len) != NULL) {
+        return ParseFunction(css, len, rgb);
+    } else {
+        return ParseNamed(css, len, rgb) || ParseHex(css, len, rgb);
+    }
+}
+
+static bool ParseNamed(const char* css, size_t len, uint8_t* rgb) {
+    if(len > cssColorNameMaxLen) {
+        return false;
+    }
+
+    char name[cssColorNameMaxLen + 1];
+    for(size_t i = 0; i < len; ++i) {
+        name[i] = ToLower(css[i]);
+    }
+    name[len] = '\0';
+
+    size_t lo = 0;
+    size_t hi = namedColorsCount;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, namedColors[mid].name);
+
+        if(cmp == 0) {
+            rgb[0] = namedColors[mid].r;
+            rgb[1] = namedColors[mid].g;
+            rgb[2] = namedColors[mid].b;
+            return true;
+        } else if(cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return false;
+}
+
+static bool ParseHex(const char* css, size_t len, uint8_t* rgb) {
+    int digits[8];
+
+    if(len != 3 && len != 4 && len != 6 && len != 8) {
+        return false;
+    }
+
+    for(size_t i = 0; i < len; ++i) {
+        digits[i] = HexDigit(css[i]);
+        if(digits[i] < 0) {
+            return false;
+        }
+    }
+
+    // Short forms repeat each digit, alpha is ignored in both forms
+    if(len <= 4) {
+        rgb[0] = (uint8_t) (digits[0] * 17);
+        rgb[1] = (uint8_t) (digits[1] * 17);
+        rgb[2] = (uint8_t) (digits[2] * 17);
+    } else {
+        rgb[0] = (uint8_t) (digits[0] * 16 + digits[1]);
+        rgb[1] = (uint8_t) (digits[2] * 16 + digits[3]);
+        rgb[2] = (uint8_t) (digits[4] * 16 + digits[5]);
+    }
+
+    return true;
+}
+
+static bool ParseFunction(const char* css, size_t len, uint8_t* rgb) {
+    CssCursor cursor = { css, css + len };
+    bool hsl;
+
+    if(SkipKeyword(cursor, "rgba") || SkipKeyword(cursor, "rgb")) {
+        hsl = false;
+    } else if(SkipKeyword(cursor, "hsla") || SkipKeyword(cursor, "hsl")) {
+        hsl = true;
+    } else {
+        return false;
+    }
+
+    double components[3];
+    if(!SkipChar(cursor, '(') || !ParseComponents(cursor, hsl, components)) {
+        return false;
+    }
+
+    SkipWhitespace(cursor);
+    if(!SkipChar(cursor, ')') || cursor.pos != cursor.end) {
+        return false;
+    }
+
+    if(hsl) {
+        double h = components[0];
+        double s = components[1];
+        double l = components[2];
+
+        if(s == 0) {
+            rgb[0] = rgb[1] = rgb[2] = RoundComponent(l * 255);
+        } else {
+            double q = (l < 0.5) ? (l * (1 + s)) : (l + s - l * s);
+            double p = 2 * l - q;
+            rgb[0] = RoundComponent(HueToRgb(p, q, h + 1.0 / 3) * 255);
+            rgb[1] = RoundComponent(HueToRgb(p, q, h) * 255);
+            rgb[2] = RoundComponent(HueToRgb(p, q, h - 1.0 / 3) * 255);
+        }
+    } else {
+        rgb[0] = RoundComponent(components[0]);
+        rgb[1] = RoundComponent(components[1]);
+        rgb[2] = RoundComponent(components[2]);
+    }
+
+    return true;
+}
+
+/**
+ * Parses the three color components and the optional alpha after the opening
+ * parenthesis. RGB components are returned in the range 0..255. For HSL, the
+ * hue is returned in turns in the range 0..1 and saturation and lightness as
+ * fractions.
+ */
+static bool ParseComponents(CssCursor& cursor, bool hsl, double* components) {
+    bool commas = false;
+
+    for(int i = 0; i < 3; ++i) {
+        SkipWhitespace(cursor);
+
+        if(i == 1) {
+            commas = SkipChar(cursor, ',');
+        } else if(i == 2 && commas && !SkipChar(cursor, ',')) {
+            return false;
+        }
+
+        SkipWhitespace(cursor);
+
+        double value;
+        if(!ParseNumber(cursor, value)) {
+            return false;
+        }
+
+        bool percent = SkipChar(cursor, '%');
+
+        if(hsl && i == 0) {
+            if(percent) {
+                return false;
+            } else if(SkipKeyword(cursor, "deg")) {
+                value /= 360;
+            } else if(SkipKeyword(cursor, "rad")) {
+                value /= 2 * pi;
+            } else if(SkipKeyword(cursor, "grad")) {
+                value /= 400;
+            } else if(SkipKeyword(cursor, "turn")) {
+                // already in turns
+            } else {
+                value /= 360;
+            }
+            value -= floor(value);
+        } else if(hsl) {
+            // Saturation and lightness are percentages, with or without %
+            value = fmin(fmax(value / 100, 0), 1);
+        } else if(percent) {
+            value = fmin(fmax(value * 255 / 100, 0), 255);
+        } else {
+            value = fmin(fmax(value, 0), 255);
+        }
+
+        components[i] = value;
+    }
+
+    // Optional alpha, separated with a comma in the legacy and a slash in the
+    // modern syntax, which is validated but otherwise ignored
+    SkipWhitespace(cursor);
+    if((commas && SkipChar(cursor, ',')) || (!commas && SkipChar(cursor, '/'))) {
+        double alpha;
+        SkipWhitespace(cursor);
+        if(!ParseNumber(cursor, alpha)) {
+            return false;
+        }
+        SkipChar(cursor, '%');
+    }
+
+    return true;
+}
+
+static void SkipWhitespace(CssCursor& cursor) {
+    while(cursor.pos != cursor.end && IsWhitespace(*cursor.pos)) {
+        ++cursor.pos;
+    }
+}
+
+static bool SkipChar(CssCursor& cursor, char c) {
+    if(cursor.pos != cursor.end && *cursor.pos == c) {
+        ++cursor.pos;
+        return true;
+    } else {
+        return false;
+    }
+}
+
+static bool SkipKeyword(CssCursor& cursor, const char* keyword) {
+    const char* pos = cursor.pos;
+
+    for(; *keyword != '\0'; ++keyword, ++pos) {
+        if(pos == cursor.end || ToLower(*pos) != *keyword) {
+            return false;
+        }
+    }
+
+    cursor.pos = pos;
+    return true;
+}
+
+static bool ParseNumber(CssCursor& cursor, double& number) {
+    const char* pos = cursor.pos;
+    double sign = 1;
+    double value = 0;
+    bool anyDigits = false;
+
+    if(pos != cursor.end && (*pos == '+' || *pos == '-')) {
+        sign = (*pos == '-') ? -1 : 1;
+        ++pos;
+    }
+
+    for(; pos != cursor.end && *pos >= '0' && *pos <= '9'; ++pos) {
+        value = value * 10 + (*pos - '0');
+        anyDigits = true;
+    }
+
+    if(pos != cursor.end && *pos == '.') {
+        double scale = 0.1;
+        for(++pos; pos != cursor.end && *pos >= '0' && *pos <= '9'; ++pos) {
+            value += (*pos - '0') * scale;
+            scale *= 0.1;
+            anyDigits = true;
+        }
+    }
+
+    if(!anyDigits) {
+        return false;
+    }
+
+    cursor.pos = pos;
+    number = sign * value;
+    return true;
+}
+
+static uint8_t RoundComponent(double value) {
+    return (uint8_t) floor(fmin(fmax(value, 0), 255) + 0.5);
+}
+
+static double HueToRgb(double p, double q, double t) {
+    if(t < 0) {
+        t += 1;
+    } else if(t > 1) {
+        t -= 1;
+    }
+
+    if(t < 1.0 / 6) {
+        return p + (q - p) * 6 * t;
+    } else if(t < 1.0 / 2) {
+        return q;
+    } else if(t < 2.0 / 3) {
+        return p + (q - p) * (2.0 / 3 - t) * 6;
+    } else {
+        return p;
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef CSS_COLOR_H
+#define CSS_COLOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace atolla {
+  /**
+   * Parses the CSS color in the given string of len bytes, which need not be
+   * null-terminated, and writes its red, green and blue components to rgb.
+   *
+   * Supported are hex colors with three, four, six or eight digits, with or
+   * without a leading #, rgb() and hsl() with their alpha variants in both the
+   * comma and the space separated syntax and all named CSS colors. Alpha is
+   * validated, but ignored. Surrounding whitespace and case are ignored.
+   *
+   * Returns false and leaves rgb untouched if the color could not be parsed.
+   */
+  bool ParseCssColor(const char* css, size_t len, uint8_t* rgb);
+}
+
+#endif // CSS_COLOR_H
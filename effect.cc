@@ -0,0 +1,347 @@
+#include "effect.h"
+#include "css_color.h"
+
+#include <cstring>
+
+using namespace v8;
+using namespace atolla;
+
+Persistent<Function> Effect::constructor;
+
+static const struct {
+    const char* name;
+    EffectNodeType type;
+} nodeTypes[] = {
+    { "solid", EFFECT_NODE_SOLID },
+    { "gradient", EFFECT_NODE_GRADIENT },
+    { "sine", EFFECT_NODE_SINE },
+    { "chase", EFFECT_NODE_CHASE },
+    { "noise", EFFECT_NODE_NOISE },
+    { "blend", EFFECT_NODE_BLEND },
+    { "gain", EFFECT_NODE_GAIN },
+    { "rotate", EFFECT_NODE_ROTATE },
+    { "mirror", EFFECT_NODE_MIRROR }
+};
+
+static const struct {
+    const char* name;
+    EffectBlendMode mode;
+} blendModes[] = {
+    { "mix", EFFECT_BLEND_MIX },
+    { "add", EFFECT_BLEND_ADD },
+    { "multiply", EFFECT_BLEND_MULTIPLY },
+    { "max", EFFECT_BLEND_MAX }
+};
+
+static const char* const floatParamNames[] = {
+    "scale", "speed", "phase", "width", "amount"
+};
+
+static void ThrowTypeError(Isolate* isolate, const char* msg);
+static bool ParseColorParam(Isolate* isolate, Local<Value> val, float* color);
+static bool ParseNodeIdx(Local<Value> val, const EffectGraph& graph, int node, int* idx);
+
+Effect::Effect(size_t lightsCount) : graph(lightsCount) {
+}
+
+Effect::~Effect() {
+}
+
+void Effect::Init(Handle<Object> exports) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  // Prepare constructor template
+  Local<FunctionTemplate> tpl = FunctionTemplate::New(isolate, New);
+  tpl->SetClassName(String::NewFromUtf8(isolate, "Effect"));
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  // Prototype
+  NODE_SET_PROTOTYPE_METHOD(tpl, "add", Add);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "set", Set);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "render", Render);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "lightsCount", LightsCount);
+
+  constructor.Reset(isolate, tpl->GetFunction());
+  exports->Set(String::NewFromUtf8(isolate, "Effect"),
+               tpl->GetFunction());
+}
+
+void Effect::New(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (args.IsConstructCall()) {
+    // Invoked as constructor: `new Effect(lightsCount)`
+
+    if(args.Length() < 1 || !args[0]->IsNumber() ||
+       args[0]->NumberValue() < 1 || args[0]->NumberValue() > 65535) {
+        ThrowTypeError(isolate, "lightsCount argument must be a Number in range 1..65535");
+        return;
+    }
+
+    Effect* obj = new Effect((size_t) args[0]->NumberValue());
+    obj->Wrap(args.This());
+    args.GetReturnValue().Set(args.This());
+  } else {
+    ThrowTypeError(isolate, "Effect constructor was called without new operator");
+    return;
+  }
+}
+
+/**
+ * add(type[, params]) adds a node of the given type name and returns its index,
+ * which can be used as an input of nodes added later.
+ */
+void Effect::Add(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Effect* obj = ObjectWrap::Unwrap<Effect>(args.Holder());
+
+    if(args.Length() < 1 || !args[0]->IsString()) {
+        ThrowTypeError(isolate, "Node type argument must be of type String");
+        return;
+    }
+
+    String::Utf8Value typeName(args[0]);
+    const size_t nodeTypesCount = sizeof(nodeTypes) / sizeof(nodeTypes[0]);
+    size_t typeIdx = 0;
+    while(typeIdx < nodeTypesCount && strcmp(*typeName, nodeTypes[typeIdx].name) != 0) {
+        ++typeIdx;
+    }
+
+    if(typeIdx == nodeTypesCount) {
+        ThrowTypeError(isolate, "Node type must be one of solid, gradient, sine, chase, noise, blend, gain, rotate or mirror");
+        return;
+    }
+
+    EffectGraph& graph = obj->graph;
+    int node = graph.Add(nodeTypes[typeIdx].type);
+    if(!ParseParams(isolate, args[1], graph, node)) {
+        // Do not leave a node with invalid parameters behind
+        graph.RemoveLast();
+        return;
+    }
+
+    args.GetReturnValue().Set(Number::New(isolate, node));
+}
+
+/**
+ * set(node, params) changes parameters of the node with the given index, any
+ * parameters missing in params are left unchanged.
+ */
+void Effect::Set(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Effect* obj = ObjectWrap::Unwrap<Effect>(args.Holder());
+
+    int node;
+    if(args.Length() < 2 || !ParseNodeIdx(args[0], obj->graph, (int) obj->graph.NodeCount(), &node)) {
+        ThrowTypeError(isolate, "Node argument must be the index of a node in this effect");
+        return;
+    }
+
+    ParseParams(isolate, args[1], obj->graph, node);
+}
+
+/**
+ * render(time, target[, output]) evaluates the effect for the given time in
+ * seconds into target, which must hold at least lightsCount RGB triplets, and
+ * returns the amount of bytes written. The output node defaults to the node
+ * added last.
+ */
+void Effect::Render(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Effect* obj = ObjectWrap::Unwrap<Effect>(args.Holder());
+    EffectGraph& graph = obj->graph;
+
+    if(args.Length() < 2 || !args[0]->IsNumber()) {
+        ThrowTypeError(isolate, "Time argument must be of type Number");
+        return;
+    }
+
+    if(!args[1]->IsUint8Array()) {
+        ThrowTypeError(isolate, "Target argument is not a Uint8Array");
+        return;
+    }
+
+    if(graph.NodeCount() == 0) {
+        ThrowTypeError(isolate, "Effect has no nodes to render");
+        return;
+    }
+
+    int output = (int) graph.NodeCount() - 1;
+    if(args.Length() >= 3 && !args[2]->IsUndefined() &&
+       !ParseNodeIdx(args[2], graph, (int) graph.NodeCount(), &output)) {
+        ThrowTypeError(isolate, "Output argument must be the index of a node in this effect");
+        return;
+    }
+
+    for(int node = 0; node <= output; ++node) {
+        if(!graph.InputsValid(node)) {
+            ThrowTypeError(isolate, "Effect has a node with missing inputs");
+            return;
+        }
+    }
+
+    Local<Uint8Array> target = args[1].As<Uint8Array>();
+    const size_t length = 3 * graph.LightsCount();
+    if(target->ByteLength() < length) {
+        isolate->ThrowException(
+            Exception::RangeError(
+                String::NewFromUtf8(isolate, "Target Uint8Array is too small for lightsCount colors")));
+        return;
+    }
+
+    v8::ArrayBuffer::Contents target_c = target->Buffer()->GetContents();
+    uint8_t* const target_data = static_cast<uint8_t*>(target_c.Data()) + target->ByteOffset();
+
+    graph.Render(args[0]->NumberValue(), output, target_data);
+
+    args.GetReturnValue().Set(Number::New(isolate, (double) length));
+}
+
+void Effect::LightsCount(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Effect* obj = ObjectWrap::Unwrap<Effect>(args.Holder());
+
+    args.GetReturnValue().Set(Number::New(isolate, (double) obj->graph.LightsCount()));
+}
+
+/**
+ * Applies the properties of the given params object to the node. Parameters
+ * are only changed if all of them are valid, otherwise an exception is thrown
+ * and false returned.
+ */
+bool Effect::ParseParams(Isolate* isolate, Local<Value> paramsVal, EffectGraph& graph, int node) {
+    if(paramsVal->IsUndefined()) {
+        return true;
+    }
+
+    if(!paramsVal->IsObject()) {
+        ThrowTypeError(isolate, "Node parameters must be an object");
+        return false;
+    }
+
+    Local<Context> context = isolate->GetCurrentContext();
+    Local<Object> params = paramsVal->ToObject(context).ToLocalChecked();
+    EffectNodeParams parsed = graph.Params(node);
+
+    Local<Value> colorVal = params->Get(context, String::NewFromUtf8(isolate, "color")).ToLocalChecked();
+    if(!colorVal->IsUndefined() && !ParseColorParam(isolate, colorVal, parsed.color)) {
+        return false;
+    }
+
+    Local<Value> color2Val = params->Get(context, String::NewFromUtf8(isolate, "color2")).ToLocalChecked();
+    if(!color2Val->IsUndefined() && !ParseColorParam(isolate, color2Val, parsed.color2)) {
+        return false;
+    }
+
+    float* floatParams[] = {
+        &parsed.scale, &parsed.speed, &parsed.phase, &parsed.width, &parsed.amount
+    };
+    for(size_t i = 0; i < sizeof(floatParamNames) / sizeof(floatParamNames[0]); ++i) {
+        Local<Value> val = params->Get(context, String::NewFromUtf8(isolate, floatParamNames[i])).ToLocalChecked();
+        if(val->IsUndefined()) {
+            continue;
+        } else if(!val->IsNumber()) {
+            ThrowTypeError(isolate, "scale, speed, phase, width and amount parameters must be of type Number");
+            return false;
+        }
+        *floatParams[i] = (float) val->NumberValue();
+    }
+
+    Local<Value> modeVal = params->Get(context, String::NewFromUtf8(isolate, "mode")).ToLocalChecked();
+    if(!modeVal->IsUndefined()) {
+        String::Utf8Value modeName(modeVal);
+        const size_t blendModesCount = sizeof(blendModes) / sizeof(blendModes[0]);
+        size_t modeIdx = 0;
+        while(modeIdx < blendModesCount && (!modeVal->IsString() || strcmp(*modeName, blendModes[modeIdx].name) != 0)) {
+            ++modeIdx;
+        }
+
+        if(modeIdx == blendModesCount) {
+            ThrowTypeError(isolate, "mode parameter must be one of mix, add, multiply or max");
+            return false;
+        }
+        parsed.mode = blendModes[modeIdx].mode;
+    }
+
+    Local<Value> aVal = params->Get(context, String::NewFromUtf8(isolate, "a")).ToLocalChecked();
+    if(!aVal->IsUndefined() && !ParseNodeIdx(aVal, graph, node, &parsed.a)) {
+        ThrowTypeError(isolate, "a parameter must be the index of an earlier node");
+        return false;
+    }
+
+    Local<Value> bVal = params->Get(context, String::NewFromUtf8(isolate, "b")).ToLocalChecked();
+    if(!bVal->IsUndefined() && !ParseNodeIdx(bVal, graph, node, &parsed.b)) {
+        ThrowTypeError(isolate, "b parameter must be the index of an earlier node");
+        return false;
+    }
+
+    graph.Params(node) = parsed;
+    return true;
+}
+
+static void ThrowTypeError(Isolate* isolate, const char* msg) {
+    isolate->ThrowException(
+        Exception::TypeError(
+            String::NewFromUtf8(isolate, msg)));
+}
+
+/**
+ * Parses either an array of three numbers in the range 0..255 or a CSS color
+ * string into a color with components in the range 0..1.
+ */
+static bool ParseColorParam(Isolate* isolate, Local<Value> val, float* color) {
+    uint8_t rgb[3];
+
+    if(val->IsString()) {
+        String::Utf8Value css(val);
+        if(!ParseCssColor(*css, css.length(), rgb)) {
+            ThrowTypeError(isolate, "color parameters must be valid CSS colors");
+            return false;
+        }
+    } else if(val->IsArray() && val.As<Array>()->Length() == 3) {
+        Local<Array> components = val.As<Array>();
+        for(uint32_t c = 0; c < 3; ++c) {
+            Local<Value> component = components->Get(c);
+            if(!component->IsNumber() || component->NumberValue() < 0 || component->NumberValue() > 255) {
+                ThrowTypeError(isolate, "color parameter components must be Numbers in range 0..255");
+                return false;
+            }
+            rgb[c] = (uint8_t) component->NumberValue();
+        }
+    } else {
+        ThrowTypeError(isolate, "color parameters must be CSS strings or arrays of three Numbers");
+        return false;
+    }
+
+    for(int c = 0; c < 3; ++c) {
+        color[c] = rgb[c] / 255.0f;
+    }
+    return true;
+}
+
+/**
+ * Gets a node index from the given value, which must refer to a node before
+ * the node with the index limit.
+ */
+static bool ParseNodeIdx(Local<Value> val, const EffectGraph& graph, int limit, int* idx) {
+    if(!val->IsNumber()) {
+        return false;
+    }
+
+    double number = val->NumberValue();
+    if(number < 0 || number >= limit || number >= graph.NodeCount() || number != (int) number) {
+        return false;
+    }
+
+    *idx = (int) number;
+    return true;
+}
@@ -0,0 +1,31 @@
+#ifndef EFFECT_H
+#define EFFECT_H
+
+#include <node.h>
+#include <node_object_wrap.h>
+
+#include "effect_graph.h"
+
+namespace atolla {
+  class Effect : public node::ObjectWrap {
+  public:
+    static void Init(v8::Handle<v8::Object> exports);
+
+  private:
+    explicit Effect(size_t lightsCount);
+    ~Effect();
+
+    static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void Add(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void Set(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void Render(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void LightsCount(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static v8::Persistent<v8::Function> constructor;
+
+    static bool ParseParams(v8::Isolate* isolate, v8::Local<v8::Value> paramsVal, EffectGraph& graph, int node);
+
+    EffectGraph graph;
+  };
+}
+
+#endif // EFFECT_H
@@ -0,0 +1,35 @@
+const { Effect } = require('./build/Release/atolla')
+
+/**
+ * Creates a procedural effect for the given amount of lights that is evaluated
+ * natively, as an alternative to painter functions running for every light in
+ * JS. Pass it as the effect property of a source spec to stream it.
+ *
+ * Effects are graphs of nodes that are added with add(type, params), which
+ * returns the index of the new node. Generator nodes produce colors from the
+ * position of each light and the time: solid, gradient, sine, chase and noise.
+ * Blend nodes combine two earlier nodes a and b with a mode of mix, add,
+ * multiply or max, and gain, rotate and mirror nodes transform an earlier node
+ * a. The node added last is the output of the effect.
+ *
+ * Parameters can be changed at any time with set(node, params) and are
+ * documented in effect_graph.h. Colors are CSS strings or arrays of three
+ * numbers in the range 0..255.
+ *
+ *    import { effect, source } from 'atolla'
+ *
+ *    const pulse = effect(60)
+ *    const wave = pulse.add('sine', { color: 'red', scale: 2, speed: 0.5 })
+ *    const chase = pulse.add('chase', { color: 'white', width: 0.1, speed: 1 })
+ *    pulse.add('blend', { a: wave, b: chase, mode: 'max' })
+ *
+ *    source({
+ *      hostname: 'localhost',
+ *      port: 10042,
+ *      frameDurationMs: 17,
+ *      effect: pulse
+ *    })
+ */
+module.exports = function effect (lightsCount) {
+  return new Effect(lightsCount)
+}
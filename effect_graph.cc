@@ -0,0 +1,284 @@
+#include "effect_graph.h"
+
+#include <cassert>
+#include <cmath>
+
+using namespace atolla;
+
+static inline float Fract(float x);
+static inline float Min(float a, float b);
+static inline float Max(float a, float b);
+static inline float SinTurns(float turns);
+static inline float NoiseLattice(uint32_t idx);
+
+EffectGraph::EffectGraph(size_t lightsCount) :
+    lightsCount(lightsCount),
+    positions(lightsCount),
+    weights(lightsCount)
+{
+    assert(lightsCount > 0);
+
+    for(size_t i = 0; i < lightsCount; ++i) {
+        positions[i] = (float) i / lightsCount;
+    }
+}
+
+int EffectGraph::Add(EffectNodeType type) {
+    Node node;
+    node.type = type;
+    node.params.color[0] = node.params.color[1] = node.params.color[2] = 1.0f;
+    node.params.color2[0] = node.params.color2[1] = node.params.color2[2] = 0.0f;
+    node.params.scale = 1.0f;
+    node.params.speed = 0.0f;
+    node.params.phase = 0.0f;
+    node.params.width = 0.1f;
+    node.params.amount = (type == EFFECT_NODE_BLEND) ? 0.5f : 1.0f;
+    node.params.mode = EFFECT_BLEND_MIX;
+    node.params.a = -1;
+    node.params.b = -1;
+    node.planes.resize(3 * lightsCount);
+
+    nodes.push_back(node);
+    return (int) nodes.size() - 1;
+}
+
+bool EffectGraph::InputsValid(int node) const {
+    const EffectNodeParams& params = nodes[node].params;
+
+    switch(nodes[node].type) {
+        case EFFECT_NODE_BLEND:
+            return params.a >= 0 && params.a < node &&
+                   params.b >= 0 && params.b < node;
+
+        case EFFECT_NODE_GAIN:
+        case EFFECT_NODE_ROTATE:
+        case EFFECT_NODE_MIRROR:
+            return params.a >= 0 && params.a < node;
+
+        default:
+            return true;
+    }
+}
+
+void EffectGraph::Render(double time, int output, uint8_t* rgb) {
+    assert(output >= 0 && output < (int) nodes.size());
+
+    for(int node = 0; node <= output; ++node) {
+        assert(InputsValid(node));
+        Evaluate(nodes[node], time);
+    }
+
+    // Local copy, since writing bytes to rgb could otherwise alias the member
+    const size_t n = lightsCount;
+    const float* r = &nodes[output].planes[0];
+    const float* g = r + n;
+    const float* b = g + n;
+
+    for(size_t i = 0; i < n; ++i) {
+        rgb[3 * i + 0] = (uint8_t) (Min(Max(r[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+        rgb[3 * i + 1] = (uint8_t) (Min(Max(g[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+        rgb[3 * i + 2] = (uint8_t) (Min(Max(b[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+void EffectGraph::Evaluate(Node& node, double time) {
+    const EffectNodeParams& params = node.params;
+    const size_t n = lightsCount;
+    const float* pos = &positions[0];
+    float* w = &weights[0];
+    float* out = &node.planes[0];
+
+    // Periodic effects only need the fraction of the elapsed periods, taking it
+    // in double precision keeps them smooth after running for a long time
+    double elapsed = time * params.speed;
+    double elapsedWhole = floor(elapsed);
+    const float shift = (float) (elapsed - elapsedWhole);
+
+    switch(node.type) {
+        case EFFECT_NODE_SOLID:
+            for(size_t i = 0; i < n; ++i) {
+                w[i] = 1.0f;
+            }
+            Modulate(node, w);
+            break;
+
+        case EFFECT_NODE_GRADIENT: {
+            // Fades from color to color2 and back, so repetitions have no seams
+            for(size_t i = 0; i < n; ++i) {
+                w[i] = 1.0f - fabsf(2.0f * Fract(pos[i] * params.scale - shift) - 1.0f);
+            }
+            for(int c = 0; c < 3; ++c) {
+                const float from = params.color[c];
+                const float delta = params.color2[c] - from;
+                float* plane = out + c * n;
+                for(size_t i = 0; i < n; ++i) {
+                    plane[i] = from + delta * w[i];
+                }
+            }
+            break;
+        }
+
+        case EFFECT_NODE_SINE:
+            for(size_t i = 0; i < n; ++i) {
+                w[i] = 0.5f + 0.5f * SinTurns(pos[i] * params.scale - shift + params.phase);
+            }
+            Modulate(node, w);
+            break;
+
+        case EFFECT_NODE_CHASE: {
+            const float head = Fract(shift + params.phase);
+            const float halfWidth = Max(0.5f * params.width, 0.5f / n);
+            for(size_t i = 0; i < n; ++i) {
+                // Signed distance to the head, wrapping around the ends
+                const float distance = Fract(pos[i] - head + 0.5f) - 0.5f;
+                w[i] = Max(0.0f, 1.0f - fabsf(distance) / halfWidth);
+            }
+            Modulate(node, w);
+            break;
+        }
+
+        case EFFECT_NODE_NOISE: {
+            // Noise does not repeat, so the whole features scrolled past are
+            // added to the lattice index instead of being dropped
+            const uint32_t base = (uint32_t) (int64_t) elapsedWhole;
+            for(size_t i = 0; i < n; ++i) {
+                const float x = pos[i] * params.scale + shift;
+                int32_t cell = (int32_t) x;
+                cell -= (x < (float) cell) ? 1 : 0;
+                const float f = x - (float) cell;
+                const float smooth = f * f * (3.0f - 2.0f * f);
+                const float left = NoiseLattice(base + (uint32_t) cell);
+                const float right = NoiseLattice(base + (uint32_t) cell + 1);
+                w[i] = left + (right - left) * smooth;
+            }
+            Modulate(node, w);
+            break;
+        }
+
+        case EFFECT_NODE_BLEND: {
+            const float* a = &nodes[params.a].planes[0];
+            const float* b = &nodes[params.b].planes[0];
+            const float amount = params.amount;
+            const size_t len = 3 * n;
+
+            switch(params.mode) {
+                case EFFECT_BLEND_MIX:
+                    for(size_t i = 0; i < len; ++i) {
+                        out[i] = a[i] + (b[i] - a[i]) * amount;
+                    }
+                    break;
+
+                case EFFECT_BLEND_ADD:
+                    for(size_t i = 0; i < len; ++i) {
+                        out[i] = a[i] + b[i] * amount;
+                    }
+                    break;
+
+                case EFFECT_BLEND_MULTIPLY:
+                    for(size_t i = 0; i < len; ++i) {
+                        out[i] = a[i] * (1.0f + (b[i] - 1.0f) * amount);
+                    }
+                    break;
+
+                case EFFECT_BLEND_MAX:
+                    for(size_t i = 0; i < len; ++i) {
+                        out[i] = Max(a[i], b[i] * amount);
+                    }
+                    break;
+            }
+            break;
+        }
+
+        case EFFECT_NODE_GAIN: {
+            const float* a = &nodes[params.a].planes[0];
+            const size_t len = 3 * n;
+            for(size_t i = 0; i < len; ++i) {
+                out[i] = a[i] * params.amount;
+            }
+            break;
+        }
+
+        case EFFECT_NODE_ROTATE: {
+            // Shifts by a fractional amount of lights, interpolating between
+            // the two lights that end up closest to each position
+            const float lights = Fract(shift + params.phase) * n;
+            const size_t whole = ((size_t) lights) % n;
+            const float f = lights - (float) (size_t) lights;
+            for(int c = 0; c < 3; ++c) {
+                const float* src = &nodes[params.a].planes[c * n];
+                float* dst = out + c * n;
+                for(size_t i = 0; i < n; ++i) {
+                    const size_t near = (i + n - whole) % n;
+                    const size_t far = (near + n - 1) % n;
+                    dst[i] = src[near] + (src[far] - src[near]) * f;
+                }
+            }
+            break;
+        }
+
+        case EFFECT_NODE_MIRROR:
+            for(int c = 0; c < 3; ++c) {
+                const float* src = &nodes[params.a].planes[c * n];
+                float* dst = out + c * n;
+                for(size_t i = 0; i < (n + 1) / 2; ++i) {
+                    dst[i] = src[i];
+                    dst[n - 1 - i] = src[i];
+                }
+            }
+            break;
+    }
+}
+
+/**
+ * Sets the colors of a generator to its color scaled with the given weight of
+ * each light.
+ */
+void EffectGraph::Modulate(Node& node, const float* weights) {
+    const size_t n = lightsCount;
+
+    for(int c = 0; c < 3; ++c) {
+        const float color = node.params.color[c];
+        float* plane = &node.planes[c * n];
+        for(size_t i = 0; i < n; ++i) {
+            plane[i] = color * weights[i];
+        }
+    }
+}
+
+static inline float Fract(float x) {
+    // Truncating and then correcting negative values avoids floorf, which
+    // would prevent vectorization where no rounding instruction is available
+    const float f = x - (float) (int32_t) x;
+    return f + (float) (f < 0.0f);
+}
+
+// Unlike fminf and fmaxf, these map directly to SIMD min and max instructions
+static inline float Min(float a, float b) {
+    return (a < b) ? a : b;
+}
+
+static inline float Max(float a, float b) {
+    return (a > b) ? a : b;
+}
+
+/**
+ * Approximates sin(2 pi turns) with a corrected parabola, which unlike sinf
+ * can be vectorized and is still far more precise than eight bit colors.
+ */
+static inline float SinTurns(float turns) {
+    const float x = Fract(turns + 0.5f) - 0.5f;
+    const float y = 8.0f * x - 16.0f * x * fabsf(x);
+    return 0.225f * (y * fabsf(y) - y) + y;
+}
+
+/**
+ * Hashes the index of a noise lattice point to a value in the range 0..1.
+ */
+static inline float NoiseLattice(uint32_t idx) {
+    idx ^= idx >> 16;
+    idx *= 0x7feb352du;
+    idx ^= idx >> 15;
+    idx *= 0x846ca68bu;
+    idx ^= idx >> 16;
+    return (float) (idx >> 8) * (1.0f / 16777216.0f);
+}
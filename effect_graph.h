@@ -0,0 +1,127 @@
+#ifndef EFFECT_GRAPH_H
+#define EFFECT_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace atolla {
+  enum EffectNodeType {
+    // Generators, producing colors from the position of each light and time
+    EFFECT_NODE_SOLID,
+    EFFECT_NODE_GRADIENT,
+    EFFECT_NODE_SINE,
+    EFFECT_NODE_CHASE,
+    EFFECT_NODE_NOISE,
+    // Combines the colors of the inputs a and b
+    EFFECT_NODE_BLEND,
+    // Transforms the colors of input a
+    EFFECT_NODE_GAIN,
+    EFFECT_NODE_ROTATE,
+    EFFECT_NODE_MIRROR
+  };
+
+  enum EffectBlendMode {
+    EFFECT_BLEND_MIX,
+    EFFECT_BLEND_ADD,
+    EFFECT_BLEND_MULTIPLY,
+    EFFECT_BLEND_MAX
+  };
+
+  /**
+   * Parameters of a node in an effect graph. Which of them are used depends on
+   * the type of the node, unused ones are ignored:
+   *
+   * - solid: color
+   * - gradient: fades from color to color2 and back along the lights, repeated
+   *   scale times and moving by speed repetitions per second
+   * - sine: color modulated by a sine wave with scale waves along the lights,
+   *   moving by speed waves per second, offset by phase waves
+   * - chase: color in a segment of width (a fraction of all lights) fading out
+   *   towards its ends, going around speed times per second, offset by phase
+   * - noise: color modulated by smooth value noise with scale features along
+   *   the lights, scrolling by speed features per second
+   * - blend: a and b combined with mode, mix fades from a to b by amount
+   * - gain: a multiplied with amount
+   * - rotate: a shifted by phase plus speed times time, in fractions of all
+   *   lights, wrapping around
+   * - mirror: the first half of a, mirrored onto the second half
+   *
+   * Colors are RGB in the range 0..1, inputs are indexes of earlier nodes.
+   */
+  struct EffectNodeParams {
+    float color[3];
+    float color2[3];
+    float scale;
+    float speed;
+    float phase;
+    float width;
+    float amount;
+    EffectBlendMode mode;
+    int a;
+    int b;
+  };
+
+  /**
+   * A small graph of procedural effects that is evaluated for every frame into
+   * RGB triplets, without allocating.
+   *
+   * Nodes can only use earlier nodes as inputs, so evaluating them in the order
+   * they were added is always valid. Every node keeps its colors in planar float
+   * buffers that are allocated once when adding the node, so that the kernels
+   * are simple loops over all lights the compiler can vectorize.
+   */
+  class EffectGraph {
+  public:
+    explicit EffectGraph(size_t lightsCount);
+
+    size_t LightsCount() const { return lightsCount; }
+    size_t NodeCount() const { return nodes.size(); }
+
+    /**
+     * Adds a node with default parameters and returns its index.
+     */
+    int Add(EffectNodeType type);
+
+    /**
+     * Removes the node that was added last.
+     */
+    void RemoveLast() { nodes.pop_back(); }
+
+    EffectNodeType Type(int node) const { return nodes[node].type; }
+    EffectNodeParams& Params(int node) { return nodes[node].params; }
+
+    /**
+     * Checks that the inputs of the node refer to earlier nodes, if used by
+     * its type.
+     */
+    bool InputsValid(int node) const;
+
+    /**
+     * Evaluates all nodes up to and including output for the given time in
+     * seconds and writes lightsCount RGB triplets of the output node to rgb.
+     * The inputs of all nodes must be valid.
+     */
+    void Render(double time, int output, uint8_t* rgb);
+
+  private:
+    struct Node {
+      EffectNodeType type;
+      EffectNodeParams params;
+      // lightsCount red, then green, then blue components
+      std::vector<float> planes;
+    };
+
+    void Evaluate(Node& node, double time);
+    void Modulate(Node& node, const float* weights);
+
+    size_t lightsCount;
+    std::vector<Node> nodes;
+    // Position of each light in the range 0..1
+    std::vector<float> positions;
+    // Per-light intermediate results of generators
+    std::vector<float> weights;
+  };
+}
+
+#endif // EFFECT_GRAPH_H
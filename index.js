@@ -1,10 +1,14 @@
 const atolla = require('./build/Release/atolla');
 const sink = require('./sink')
 const source = require('./source')
+const effect = require('./effect')
+const metrics = require('./metrics')
 const version = require('./version')
 
 module.exports = {
   version,
   sink,
-  source
+  source,
+  effect,
+  metrics
 }
\ No newline at end of file
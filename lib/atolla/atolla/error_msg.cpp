@@ -0,0 +1,29 @@
+#include "error_msg.h"
+#include "error_codes.h"
+
+const char* atolla_error_code_msg(uint8_t error_code)
+{
+    switch(error_code)
+    {
+        case ATOLLA_ERROR_CODE_NOT_BORROWED:
+            return "The sink signalled that is not currently borrowed by this source.";
+
+        case ATOLLA_ERROR_CODE_REQUESTED_BUFFER_TOO_LARGE:
+            return "The sink does not have enough memory for a frame queue of the requested length.";
+
+        case ATOLLA_ERROR_CODE_REQUESTED_FRAME_DURATION_TOO_SHORT:
+            return "The sink cannot accomodate the reqest for the given frame duration because it is too short. Try a shorter frame duration.";
+
+        case ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE:
+            return "The sink refused a request to borrow or enqueue because it is currently lent to another source. Try again later, when the other source has stopped transmission.";
+
+        case ATOLLA_ERROR_CODE_BAD_MSG:
+            return "The sink signalled that it could not understand a message or that a message contained a not further specified invalid value. This might be due to incompatible versions of the atolla protocol.";
+
+        case ATOLLA_ERROR_CODE_TIMEOUT:
+            return "The sink signalled that it did not receive packets for so long, it deems the connection no longer working. This might be due to bad signal quality or the source failing to enqueue frames for too long.";
+
+        default:
+            return "The sink signalled an unrecoverable error state.";
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef ATOLLA_ERROR_MSG_H
+#define ATOLLA_ERROR_MSG_H
+
+#include "primitives.h"
+
+/**
+ * Returns a human readable error message that describes the reason for a
+ * FAIL message with the given error code, from the perspective of a source.
+ *
+ * The returned string has static storage duration and must not be freed.
+ */
+const char* atolla_error_code_msg(uint8_t error_code);
+
+#endif // ATOLLA_ERROR_MSG_H
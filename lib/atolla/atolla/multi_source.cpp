@@ -0,0 +1,612 @@
+#include "multi_source.h"
+#include "error_msg.h"
+#include "../msg/builder.h"
+#include "../msg/iter.h"
+#include "../test/assert.h"
+#include "../time/now.h"
+#include "../time/sleep.h"
+#include "../udp_socket/udp_socket.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef ATOLLA_MULTI_SOURCE_RECV_BUF_LEN
+/**
+ * Determines the maximum size of incoming packets.
+ */
+#define ATOLLA_MULTI_SOURCE_RECV_BUF_LEN 32
+#endif
+
+static const size_t recv_buf_len = ATOLLA_MULTI_SOURCE_RECV_BUF_LEN;
+static const unsigned int retry_timeout_ms_default = 100;
+static const unsigned int disconnect_timeout_ms_default = 750;
+static const int max_buffered_frames_default = 16;
+static const int blocking_make_refresh_interval = 5;
+/** Release messages sent when freeing, more than one in case some get lost */
+static const int release_send_count = 3;
+/** Milliseconds between the release messages, so they do not get lost together */
+static const unsigned int release_send_interval = 2;
+/**
+ * Maximum amount of packets evaluated per sink in one update, so a flood of
+ * packets cannot stall the caller indefinitely.
+ */
+static const size_t max_receives_per_sink = 4;
+/** Special time value meant to represent no time set */
+static const unsigned int NULL_TIME = ~0;
+
+/**
+ * Connection to one of the sinks of a multi source.
+ */
+struct MultiSourceSink
+{
+    AtollaSourceState state;
+    UdpEndpoint endpoint;
+    unsigned int last_recv_lent_time;
+    /** Set after receiving the first report, older sinks reject release messages */
+    bool sends_reports;
+    const char* error_msg;
+};
+typedef struct MultiSourceSink MultiSourceSink;
+
+struct AtollaMultiSourcePrivate
+{
+    AtollaSourceState state;
+    UdpSocket sock;
+    uint8_t recv_buf[ATOLLA_MULTI_SOURCE_RECV_BUF_LEN];
+
+    MsgBuilder builder;
+
+    MultiSourceSink* sinks;
+    size_t sinks_count;
+    // Scratch space for the endpoints and outcomes of a single batched send
+    UdpEndpoint* send_endpoints;
+    size_t* send_sink_idxs;
+    UdpSocketResult* send_results;
+
+    int next_frame_idx;
+    unsigned int frame_duration_ms;
+    int max_buffered_frames;
+    unsigned int retry_timeout_ms;
+    unsigned int disconnect_timeout_ms;
+
+    unsigned int first_borrow_time;
+    unsigned int last_borrow_time;
+    unsigned int last_frame_time;
+
+    const char* error_msg;
+};
+typedef struct AtollaMultiSourcePrivate AtollaMultiSourcePrivate;
+
+static AtollaMultiSourcePrivate* multi_source_private_make(const AtollaMultiSourceSpec* spec);
+static void multi_source_await_make_completion(AtollaMultiSourcePrivate* source);
+static void multi_source_send_borrow(AtollaMultiSourcePrivate* source);
+static void multi_source_send_release(AtollaMultiSourcePrivate* source);
+static size_t multi_source_send(AtollaMultiSourcePrivate* source, UdpPacketPart* parts, size_t parts_count, AtollaSourceState to_state);
+static void multi_source_update(AtollaMultiSourcePrivate* source);
+static void multi_source_receive(AtollaMultiSourcePrivate* source);
+static void multi_source_iterate_recv_buf(AtollaMultiSourcePrivate* source, MultiSourceSink* sink, size_t received_bytes);
+static void multi_source_manage_borrow_packet_loss(AtollaMultiSourcePrivate* source);
+static void multi_source_ensure_lent_resent(AtollaMultiSourcePrivate* source);
+static void multi_source_update_state(AtollaMultiSourcePrivate* source);
+static MultiSourceSink* multi_source_find_sink(AtollaMultiSourcePrivate* source, UdpEndpoint* endpoint);
+static void multi_source_sink_lent(MultiSourceSink* sink);
+static void multi_source_sink_fail(MultiSourceSink* sink, const char* error_msg);
+
+AtollaMultiSource atolla_multi_source_make(const AtollaMultiSourceSpec* spec)
+{
+    assert(spec->sinks != NULL);
+    assert(spec->sinks_count > 0);
+
+    AtollaMultiSourcePrivate* source = multi_source_private_make(spec);
+
+    msg_builder_init(&source->builder);
+
+    UdpSocketResult result = udp_socket_init(&source->sock);
+    if(result.code == UDP_SOCKET_OK)
+    {
+        for(size_t i = 0; i < spec->sinks_count; ++i)
+        {
+            assert(spec->sinks[i].port >= 0 && spec->sinks[i].port < 65536);
+
+            result = udp_endpoint_resolve(
+                &source->sinks[i].endpoint,
+                spec->sinks[i].hostname,
+                (unsigned short) spec->sinks[i].port
+            );
+
+            if(result.code != UDP_SOCKET_OK)
+            {
+                multi_source_sink_fail(&source->sinks[i], "Sink hostname could not be resolved.");
+            }
+        }
+
+        source->first_borrow_time = time_now();
+        multi_source_send_borrow(source);
+    }
+    else
+    {
+        for(size_t i = 0; i < source->sinks_count; ++i)
+        {
+            multi_source_sink_fail(&source->sinks[i], "Sink could not bind to port.");
+        }
+    }
+
+    multi_source_update_state(source);
+
+    if(!spec->async_make)
+    {
+        multi_source_await_make_completion(source);
+    }
+
+    AtollaMultiSource source_handle = { source };
+    return source_handle;
+}
+
+static AtollaMultiSourcePrivate* multi_source_private_make(const AtollaMultiSourceSpec* spec)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) malloc(sizeof(AtollaMultiSourcePrivate));
+    assert(source != NULL);
+
+    memset(source, 0, sizeof(AtollaMultiSourcePrivate));
+
+    source->state = ATOLLA_SOURCE_STATE_WAITING;
+    source->next_frame_idx = 0;
+    source->frame_duration_ms = spec->frame_duration_ms;
+    source->max_buffered_frames = (spec->max_buffered_frames == 0) ? max_buffered_frames_default : spec->max_buffered_frames;
+    source->retry_timeout_ms = (spec->retry_timeout_ms == 0) ? retry_timeout_ms_default : spec->retry_timeout_ms;
+    source->disconnect_timeout_ms = (spec->disconnect_timeout_ms == 0) ? disconnect_timeout_ms_default : spec->disconnect_timeout_ms;
+    source->last_frame_time = NULL_TIME;
+
+    source->sinks_count = spec->sinks_count;
+    source->sinks = (MultiSourceSink*) calloc(spec->sinks_count, sizeof(MultiSourceSink));
+    source->send_endpoints = (UdpEndpoint*) calloc(spec->sinks_count, sizeof(UdpEndpoint));
+    source->send_sink_idxs = (size_t*) calloc(spec->sinks_count, sizeof(size_t));
+    source->send_results = (UdpSocketResult*) calloc(spec->sinks_count, sizeof(UdpSocketResult));
+    assert(source->sinks != NULL && source->send_endpoints != NULL &&
+           source->send_sink_idxs != NULL && source->send_results != NULL);
+
+    for(size_t i = 0; i < spec->sinks_count; ++i)
+    {
+        source->sinks[i].state = ATOLLA_SOURCE_STATE_WAITING;
+    }
+
+    return source;
+}
+
+static void multi_source_await_make_completion(AtollaMultiSourcePrivate* source)
+{
+    while(source->state == ATOLLA_SOURCE_STATE_WAITING)
+    {
+        if(blocking_make_refresh_interval > 0)
+        {
+            time_sleep(blocking_make_refresh_interval);
+        }
+        multi_source_update(source);
+    }
+}
+
+void atolla_multi_source_free(AtollaMultiSource source_handle)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+
+    multi_source_send_release(source);
+    udp_socket_free(&source->sock);
+    msg_builder_free(&source->builder);
+
+    free(source->sinks);
+    free(source->send_endpoints);
+    free(source->send_sink_idxs);
+    free(source->send_results);
+    free(source);
+}
+
+AtollaSourceState atolla_multi_source_state(AtollaMultiSource source_handle)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+
+    multi_source_update(source);
+
+    return source->state;
+}
+
+const char* atolla_multi_source_error_msg(AtollaMultiSource source_handle)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+    if(source->state == ATOLLA_SOURCE_STATE_ERROR) {
+        return source->error_msg;
+    } else {
+        return NULL;
+    }
+}
+
+size_t atolla_multi_source_sinks_count(AtollaMultiSource source_handle)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+    return source->sinks_count;
+}
+
+AtollaSourceState atolla_multi_source_sink_state(AtollaMultiSource source_handle, size_t sink_idx)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+    assert(sink_idx < source->sinks_count);
+    return source->sinks[sink_idx].state;
+}
+
+const char* atolla_multi_source_sink_error_msg(AtollaMultiSource source_handle, size_t sink_idx)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+    assert(sink_idx < source->sinks_count);
+
+    MultiSourceSink* sink = &source->sinks[sink_idx];
+    if(sink->state == ATOLLA_SOURCE_STATE_ERROR) {
+        return sink->error_msg;
+    } else {
+        return NULL;
+    }
+}
+
+int atolla_multi_source_put_ready_count(AtollaMultiSource source_handle)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+
+    multi_source_update(source);
+
+    if(source->state != ATOLLA_SOURCE_STATE_OPEN)
+    {
+        return 0;
+    }
+    else if(source->last_frame_time == NULL_TIME)
+    {
+        return source->max_buffered_frames;
+    }
+    else
+    {
+        return (time_now() - source->last_frame_time) / source->frame_duration_ms;
+    }
+}
+
+int atolla_multi_source_put_ready_timeout(AtollaMultiSource source_handle)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+
+    multi_source_update(source);
+
+    if(source->state != ATOLLA_SOURCE_STATE_OPEN)
+    {
+        return -1;
+    }
+    else if(source->last_frame_time == NULL_TIME)
+    {
+        return 0;
+    }
+    else
+    {
+        int readyCount = (time_now() - source->last_frame_time) / source->frame_duration_ms;
+
+        if(readyCount > 0) {
+            return 0;
+        } else {
+            return (source->last_frame_time + source->frame_duration_ms) - time_now();
+        }
+    }
+}
+
+bool atolla_multi_source_put(AtollaMultiSource source_handle, void* frame, size_t frame_len)
+{
+    AtollaMultiSourcePrivate* source = (AtollaMultiSourcePrivate*) source_handle.internal;
+
+    if(atolla_multi_source_state(source_handle) != ATOLLA_SOURCE_STATE_OPEN)
+    {
+        return false;
+    }
+
+    int timeout = atolla_multi_source_put_ready_timeout(source_handle);
+    if(timeout > 0)
+    {
+        time_sleep(timeout);
+    }
+
+    MemBlock* enqueue_header = msg_builder_enqueue_header(&source->builder, source->next_frame_idx, frame_len);
+    UdpPacketPart parts[] = {
+        { enqueue_header->data, enqueue_header->size },
+        { frame, frame_len }
+    };
+    size_t sent_count = multi_source_send(source, parts, sizeof(parts) / sizeof(UdpPacketPart), ATOLLA_SOURCE_STATE_OPEN);
+
+    // A sink may have failed while sending
+    multi_source_update_state(source);
+
+    if(sent_count == 0)
+    {
+        return false;
+    }
+
+    source->next_frame_idx = (source->next_frame_idx + 1) % 256;
+
+    if(source->last_frame_time == NULL_TIME)
+    {
+        source->last_frame_time = time_now() - (source->max_buffered_frames - 1) * source->frame_duration_ms;
+    }
+    else
+    {
+        source->last_frame_time += source->frame_duration_ms;
+    }
+
+    return true;
+}
+
+static void multi_source_send_borrow(AtollaMultiSourcePrivate* source)
+{
+    source->last_borrow_time = time_now();
+    MemBlock* borrow_msg = msg_builder_borrow(&source->builder, source->frame_duration_ms, source->max_buffered_frames, 0);
+    UdpPacketPart part = { borrow_msg->data, borrow_msg->size };
+    multi_source_send(source, &part, 1, ATOLLA_SOURCE_STATE_WAITING);
+}
+
+/**
+ * Tells all borrowed sinks that understand release messages that they can be
+ * borrowed by others again. Blocks for a few milliseconds between the
+ * repetitions.
+ */
+static void multi_source_send_release(AtollaMultiSourcePrivate* source)
+{
+    size_t to_count = 0;
+    for(size_t i = 0; i < source->sinks_count; ++i)
+    {
+        if(source->sinks[i].state == ATOLLA_SOURCE_STATE_OPEN && source->sinks[i].sends_reports)
+        {
+            source->send_endpoints[to_count++] = source->sinks[i].endpoint;
+        }
+    }
+
+    if(to_count == 0)
+    {
+        return;
+    }
+
+    for(int i = 0; i < release_send_count; ++i)
+    {
+        if(i > 0)
+        {
+            time_sleep(release_send_interval);
+        }
+
+        MemBlock* release_msg = msg_builder_release(&source->builder);
+        UdpPacketPart part = { release_msg->data, release_msg->size };
+        udp_socket_sendv_to_many(&source->sock, &part, 1, source->send_endpoints, to_count, NULL);
+    }
+}
+
+/**
+ * Sends the message assembled from the given parts to all sinks in the given
+ * state in a single batch and returns the amount of sinks the message could be
+ * sent to. Sinks that could not be sent to because of an error other than a
+ * full send buffer enter the error state.
+ */
+static size_t multi_source_send(AtollaMultiSourcePrivate* source, UdpPacketPart* parts, size_t parts_count, AtollaSourceState to_state)
+{
+    size_t to_count = 0;
+    for(size_t i = 0; i < source->sinks_count; ++i)
+    {
+        if(source->sinks[i].state == to_state)
+        {
+            source->send_endpoints[to_count] = source->sinks[i].endpoint;
+            source->send_sink_idxs[to_count] = i;
+            ++to_count;
+        }
+    }
+
+    if(to_count == 0)
+    {
+        return 0;
+    }
+
+    udp_socket_sendv_to_many(
+        &source->sock,
+        parts, parts_count,
+        source->send_endpoints, to_count,
+        source->send_results
+    );
+
+    size_t sent_count = 0;
+    for(size_t i = 0; i < to_count; ++i)
+    {
+        UdpSocketResultCode code = source->send_results[i].code;
+        if(code == UDP_SOCKET_OK)
+        {
+            ++sent_count;
+        }
+        else if(code != UDP_SOCKET_ERR_WOULDBLOCK)
+        {
+            multi_source_sink_fail(&source->sinks[source->send_sink_idxs[i]], "Sending to the sink failed.");
+        }
+    }
+
+    return sent_count;
+}
+
+static void multi_source_update(AtollaMultiSourcePrivate* source)
+{
+    multi_source_receive(source);
+    multi_source_manage_borrow_packet_loss(source);
+    multi_source_ensure_lent_resent(source);
+    multi_source_update_state(source);
+}
+
+static void multi_source_receive(AtollaMultiSourcePrivate* source)
+{
+    const size_t max_receives = source->sinks_count * max_receives_per_sink;
+
+    for(size_t i = 0; i < max_receives; ++i)
+    {
+        UdpEndpoint sender;
+        size_t received_len;
+
+        UdpSocketResult result = udp_socket_receive_from(
+            &source->sock,
+            source->recv_buf, recv_buf_len,
+            &received_len,
+            &sender
+        );
+
+        if(result.code != UDP_SOCKET_OK)
+        {
+            return;
+        }
+
+        MultiSourceSink* sink = multi_source_find_sink(source, &sender);
+        if(sink != NULL)
+        {
+            multi_source_iterate_recv_buf(source, sink, received_len);
+        }
+    }
+}
+
+static void multi_source_manage_borrow_packet_loss(AtollaMultiSourcePrivate* source)
+{
+    bool any_waiting = false;
+    for(size_t i = 0; i < source->sinks_count; ++i)
+    {
+        any_waiting = any_waiting || source->sinks[i].state == ATOLLA_SOURCE_STATE_WAITING;
+    }
+
+    if(!any_waiting)
+    {
+        return;
+    }
+
+    unsigned int now = time_now();
+    unsigned int time_since_first_borrow = now - source->first_borrow_time;
+    unsigned int time_since_last_borrow = now - source->last_borrow_time;
+
+    if(time_since_first_borrow > source->disconnect_timeout_ms)
+    {
+        for(size_t i = 0; i < source->sinks_count; ++i)
+        {
+            if(source->sinks[i].state == ATOLLA_SOURCE_STATE_WAITING)
+            {
+                multi_source_sink_fail(&source->sinks[i], "Tried to borrow the sink, but the attempt timed out.");
+            }
+        }
+    }
+    else if(time_since_last_borrow > source->retry_timeout_ms)
+    {
+        // Only re-sends to the sinks that are still waiting
+        multi_source_send_borrow(source);
+    }
+}
+
+static void multi_source_ensure_lent_resent(AtollaMultiSourcePrivate* source)
+{
+    unsigned int now = time_now();
+
+    for(size_t i = 0; i < source->sinks_count; ++i)
+    {
+        MultiSourceSink* sink = &source->sinks[i];
+        if(sink->state == ATOLLA_SOURCE_STATE_OPEN &&
+           (now - sink->last_recv_lent_time) >= source->disconnect_timeout_ms)
+        {
+            multi_source_sink_fail(sink, "The connection to the sink was lost.");
+        }
+    }
+}
+
+/**
+ * Derives the combined state from the states of the individual sinks.
+ */
+static void multi_source_update_state(AtollaMultiSourcePrivate* source)
+{
+    bool any_waiting = false;
+    bool any_open = false;
+
+    for(size_t i = 0; i < source->sinks_count; ++i)
+    {
+        any_waiting = any_waiting || source->sinks[i].state == ATOLLA_SOURCE_STATE_WAITING;
+        any_open = any_open || source->sinks[i].state == ATOLLA_SOURCE_STATE_OPEN;
+    }
+
+    if(any_waiting)
+    {
+        source->state = ATOLLA_SOURCE_STATE_WAITING;
+    }
+    else if(any_open)
+    {
+        source->state = ATOLLA_SOURCE_STATE_OPEN;
+    }
+    else
+    {
+        source->state = ATOLLA_SOURCE_STATE_ERROR;
+        source->error_msg = "All of the sinks failed, see the error messages of the individual sinks for details.";
+    }
+}
+
+static void multi_source_iterate_recv_buf(AtollaMultiSourcePrivate* source, MultiSourceSink* sink, size_t received_bytes)
+{
+    MsgIter iter = msg_iter_make(source->recv_buf, received_bytes);
+    MsgDecoded msg;
+    MsgDecodeResult result;
+
+    while((result = msg_iter_decode(&iter, &msg)) == MSG_DECODE_OK)
+    {
+        switch(msg.type)
+        {
+            case MSG_TYPE_LENT:
+            {
+                multi_source_sink_lent(sink);
+                sink->sends_reports = sink->sends_reports || msg.as.lent.has_report;
+                break;
+            }
+
+            case MSG_TYPE_FAIL:
+            {
+                multi_source_sink_fail(sink, atolla_error_code_msg(msg.as.fail.error_code));
+                break;
+            }
+
+            default:
+            {
+                result = MSG_DECODE_MALFORMED;
+                break;
+            }
+        }
+
+        if(result != MSG_DECODE_OK)
+        {
+            break;
+        }
+    }
+
+    if(result == MSG_DECODE_MALFORMED)
+    {
+        multi_source_sink_fail(sink, "Malformed or unknown message type received from sink. This might be due to incompatible versions of the atolla protocol.");
+    }
+}
+
+static MultiSourceSink* multi_source_find_sink(AtollaMultiSourcePrivate* source, UdpEndpoint* endpoint)
+{
+    for(size_t i = 0; i < source->sinks_count; ++i)
+    {
+        if(udp_endpoint_equal(&source->sinks[i].endpoint, endpoint))
+        {
+            return &source->sinks[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void multi_source_sink_lent(MultiSourceSink* sink)
+{
+    if(sink->state == ATOLLA_SOURCE_STATE_WAITING ||
+       sink->state == ATOLLA_SOURCE_STATE_OPEN)
+    {
+        sink->state = ATOLLA_SOURCE_STATE_OPEN;
+        sink->last_recv_lent_time = time_now();
+    }
+}
+
+static void multi_source_sink_fail(MultiSourceSink* sink, const char* error_msg)
+{
+    sink->state = ATOLLA_SOURCE_STATE_ERROR;
+    sink->error_msg = error_msg;
+}
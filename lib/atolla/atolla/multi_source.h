@@ -0,0 +1,175 @@
+#ifndef ATOLLA_MULTI_SOURCE_H
+#define ATOLLA_MULTI_SOURCE_H
+
+#include "primitives.h"
+#include "source.h"
+
+/**
+ * A source that streams the same light information to multiple sinks over
+ * unicast, e.g. on networks where multicast is not available.
+ *
+ * Every frame is encoded only once and then sent to all sinks that are
+ * currently lent to the multi source with as few system calls as the
+ * platform allows.
+ *
+ * Each sink is borrowed individually and tracks its own state. If one of the
+ * sinks fails, e.g. because it is lent to another source or because it became
+ * unreachable, it is no longer streamed to, but the remaining sinks are
+ * unaffected.
+ */
+struct AtollaMultiSource
+{
+    void* internal;
+};
+typedef struct AtollaMultiSource AtollaMultiSource;
+
+/**
+ * Address of one of the sinks a multi source streams to.
+ */
+struct AtollaSinkAddr
+{
+    /**
+     * IP address or hostname of the sink.
+     */
+    const char* hostname;
+    /**
+     * UDP port that the sink running on hostname is expected to run on.
+     */
+    int port;
+};
+typedef struct AtollaSinkAddr AtollaSinkAddr;
+
+/**
+ * Provides initialization parameters for a multi source that can be passed to
+ * atolla_multi_source_make.
+ *
+ * With the exception of the sink addresses, the parameters have the same
+ * meaning as in AtollaSourceSpec and apply to all of the sinks.
+ */
+struct AtollaMultiSourceSpec
+{
+    /**
+     * Points to an array of sinks_count sink addresses. The array is only
+     * accessed during the call to atolla_multi_source_make.
+     */
+    const AtollaSinkAddr* sinks;
+    /**
+     * Amount of sinks in the sinks array, must be at least one.
+     */
+    size_t sinks_count;
+    /**
+     * Time in milliseconds that one frame remains valid in the sinks.
+     */
+    int frame_duration_ms;
+    /**
+     * Determines how many frames should be sent to the sinks in advance and
+     * stored in a buffer for later use.
+     *
+     * A value of zero lets the implementation pick a default value.
+     */
+    int max_buffered_frames;
+    /**
+     * Holds the time in milliseconds after which a new borrow message is
+     * sent to sinks that did not respond yet.
+     *
+     * A value of zero lets the implementation pick a default value.
+     */
+    int retry_timeout_ms;
+    /**
+     * Holds the time in milliseconds after which an unresponsive sink is
+     * considered lost and enters the error state.
+     *
+     * A value of zero lets the implementation pick a default value.
+     */
+    int disconnect_timeout_ms;
+    /**
+     * If set to false, atolla_multi_source_make blocks until every sink has
+     * either been borrowed successfully or failed.
+     */
+    bool async_make;
+};
+typedef struct AtollaMultiSourceSpec AtollaMultiSourceSpec;
+
+/**
+ * Creates a new multi source and starts borrowing all of the sinks in the
+ * given spec.
+ *
+ * Sinks with hostnames that could not be resolved immediately enter the error
+ * state, the remaining sinks are in state ATOLLA_SOURCE_STATE_WAITING until
+ * they either respond or time out.
+ */
+AtollaMultiSource atolla_multi_source_make(const AtollaMultiSourceSpec* spec);
+
+/**
+ * Orderly shuts down the multi source and frees associated resources. The
+ * handle may not be used again after calling this function.
+ *
+ * Like atolla_source_free, tells borrowed sinks that they can be borrowed
+ * again right away.
+ */
+void atolla_multi_source_free(AtollaMultiSource source);
+
+/**
+ * Gets the combined state of the multi source and evaluates incoming packets.
+ *
+ * ATOLLA_SOURCE_STATE_WAITING is returned as long as at least one sink has not
+ * responded to the borrow request yet. Streaming starts only after all sinks
+ * have either been borrowed or failed, so that every sink receives the same
+ * sequence of frames.
+ *
+ * ATOLLA_SOURCE_STATE_OPEN is returned if no sink is waiting and at least one
+ * of the sinks is lent to the multi source.
+ *
+ * ATOLLA_SOURCE_STATE_ERROR is returned if all of the sinks have failed.
+ */
+AtollaSourceState atolla_multi_source_state(AtollaMultiSource source);
+
+/**
+ * If all sinks failed and the multi source is in error state, returns a
+ * pointer to a human readable error message, otherwise returns null.
+ *
+ * Use atolla_multi_source_sink_error_msg for the reasons individual sinks
+ * failed.
+ */
+const char* atolla_multi_source_error_msg(AtollaMultiSource source);
+
+/**
+ * Returns the amount of sinks the multi source was made with.
+ */
+size_t atolla_multi_source_sinks_count(AtollaMultiSource source);
+
+/**
+ * Gets the state of the sink at the given index in the spec the multi source
+ * was made with, without evaluating incoming packets.
+ */
+AtollaSourceState atolla_multi_source_sink_state(AtollaMultiSource source, size_t sink_idx);
+
+/**
+ * If the sink at the given index is in error state, returns a human readable
+ * error message explaining why, otherwise returns null.
+ */
+const char* atolla_multi_source_sink_error_msg(AtollaMultiSource source, size_t sink_idx);
+
+/**
+ * Works like atolla_source_put_ready_count, but for all lent sinks at once.
+ */
+int atolla_multi_source_put_ready_count(AtollaMultiSource source);
+
+/**
+ * Works like atolla_source_put_ready_timeout, but for all lent sinks at once.
+ */
+int atolla_multi_source_put_ready_timeout(AtollaMultiSource source);
+
+/**
+ * Encodes the given frame once and sends it to all sinks that are currently
+ * lent to the multi source.
+ *
+ * Blocking behavior is the same as for atolla_source_put.
+ *
+ * Returns true if the frame could be sent to at least one of the sinks.
+ * Sinks that could not be sent to because of an unrecoverable error enter the
+ * error state, while the others remain unaffected.
+ */
+bool atolla_multi_source_put(AtollaMultiSource source, void* frame, size_t frame_len);
+
+#endif // ATOLLA_MULTI_SOURCE_H
@@ -3,11 +3,14 @@
 
 #include "sink.h"
 #include "error_codes.h"
+#include "../capture/capture.h"
+#include "../mem/fill.h"
 #include "../mem/ring.h"
 #include "../msg/builder.h"
 #include "../msg/iter.h"
 #include "../udp_socket/udp_socket.h"
 #include "../time/now.h"
+#include "../trace/trace.h"
 #include "../test/assert.h"
 
 #include <stdlib.h>
@@ -36,9 +39,38 @@ static const unsigned int lent_send_interval = 500;
  * report an unrecoverable error to the sink.
  */
 static const int frame_length_ms_min = 10;
+/** Minimum time in milliseconds between two NACK messages */
+static const unsigned int nack_interval = 20;
+/** Time in milliseconds after which a frame is asked for again if the retransmission did not arrive */
+static const unsigned int nack_retry_interval = 100;
+/**
+ * Maximum amount of frame indexes per NACK message, which keeps NACK messages
+ * small enough for the receive buffer of sources with default settings.
+ */
+static const size_t nack_frames_max = 16;
+/** Amount of recent sync exchanges that the clock offset to the source is estimated from */
+static const size_t sync_samples = 8;
+/** Time between sync messages to borrowers that set MSG_BORROW_FLAG_SYNC */
+static const unsigned int sync_interval = 1000;
+/** Time between sync messages right after borrowing, until sync_samples answers arrived */
+static const unsigned int sync_interval_initial = 50;
+/** Maximum amount of sources waiting in line to borrow the sink after the borrower */
+static const size_t waiters_capacity = 4;
 
 static const unsigned int NULL_TIME = ~0;
 
+/** A source waiting in line to borrow the sink, as of its last borrow message */
+struct SinkWaiter
+{
+    UdpEndpoint endpoint;
+    uint16_t msg_id;
+    int frame_length_ms;
+    uint8_t flags;
+    /** Waiters are forgotten when no borrow message arrived for drop_timeout */
+    unsigned int last_borrow_time;
+};
+typedef struct SinkWaiter SinkWaiter;
+
 struct AtollaSinkPrivate
 {
     AtollaSinkState state;
@@ -46,6 +78,9 @@ struct AtollaSinkPrivate
 
     UdpSocket socket;
     UdpEndpoint borrower_endpoint;
+    /** Sources that set MSG_BORROW_FLAG_QUEUE while the sink was lent, next borrower first */
+    SinkWaiter waiters[waiters_capacity];
+    size_t waiters_count;
 
     unsigned int lights_count;
     unsigned int frame_duration_ms;
@@ -56,21 +91,83 @@ struct AtollaSinkPrivate
     MemBlock current_frame;
     // Holds preliminary data when assembling frame from msg
     MemBlock received_frame;
+    // Holds a frame reconstructed from a parity message
+    MemBlock recovered_frame;
     MemRing pending_frames;
+    /** For each frame index, whether the frame was lost and filled in with a copy of the next frame */
+    bool frame_missing[256];
+    /** For each frame index, when the frame was last asked for with a NACK, or NULL_TIME */
+    unsigned int frame_nack_time[256];
+    /**
+     * Whether the borrower sends timed enqueue messages, so that frames are
+     * shown at their presentation time rather than one per frame duration
+     */
+    bool timed;
+    /** For each frame index, the presentation time of the frame in timed sessions */
+    unsigned int frame_pts[256];
+    bool borrower_accepts_nack;
+    unsigned int last_nack_time;
+
+    // Clock synchronization with borrowers that set MSG_BORROW_FLAG_SYNC
+    bool borrower_syncs;
+    unsigned int last_sync_time;
+    /** Round trip times and clock offsets of recent sync exchanges, indexed by sync_count modulo sync_samples */
+    unsigned int sync_rtts[sync_samples];
+    int sync_offsets[sync_samples];
+    unsigned int sync_count;
+    /** Source clock minus sink clock, from the recent exchange with the shortest round trip */
+    int clock_offset;
+    /** Round trip of the exchange that clock_offset is from, or -1 if the clock is not synchronized yet */
+    int clock_rtt;
+
+    AtollaSinkStats stats;
 
     unsigned int time_origin;
     int last_enqueued_frame_idx;
 
     unsigned int last_recv_time;
     unsigned int last_send_lent_time;
+
+    // Receiver report sent back to the source with LENT messages
+    unsigned int lost_frames;
+    /** Interarrival jitter in sixteenths of a millisecond */
+    unsigned int jitter;
+    unsigned int last_enqueue_recv_time;
+    uint16_t last_borrower_msg_id;
+    unsigned int last_borrower_msg_time;
+
+#ifdef ATOLLA_ENABLE_TRACE
+    TraceRing trace;
+#endif
+
+#ifdef ATOLLA_CAPTURE_SUPPORTED
+    /** Receives a copy of every datagram while capturing, otherwise NULL */
+    CaptureWriter* capture;
+#endif
 };
 typedef struct AtollaSinkPrivate AtollaSinkPrivate;
 
 static AtollaSinkPrivate* sink_private_make(const AtollaSinkSpec* spec);
+static void sink_handle_datagram(AtollaSinkPrivate* sink, size_t received_bytes, UdpEndpoint* sender);
 static void sink_iterate_recv_buf(AtollaSinkPrivate* sink, size_t received_bytes, UdpEndpoint* sender);
-static void sink_handle_borrow(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, size_t buffer_length, UdpEndpoint* sender);
-static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t frame_idx, MemBlock frame, UdpEndpoint* sender);
-static void sink_enqueue(AtollaSinkPrivate* sink, MemBlock frame);
+static void sink_handle_borrow(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, size_t buffer_length, uint8_t flags, UdpEndpoint* sender);
+static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t frame_idx, bool timed, unsigned int pts, MemBlock frame, UdpEndpoint* sender);
+static void sink_handle_parity(AtollaSinkPrivate* sink, uint8_t first_frame_idx, uint8_t group_size, MemBlock parity, UdpEndpoint* sender);
+static bool sink_pending_frame(AtollaSinkPrivate* sink, uint8_t frame_idx, uint8_t** frame);
+static void sink_handle_late_frame(AtollaSinkPrivate* sink, uint8_t frame_idx, MemBlock frame);
+static void sink_handle_sync(AtollaSinkPrivate* sink, uint32_t ping_time_ms, uint32_t pong_time_ms, UdpEndpoint* sender);
+static void sink_handle_release(AtollaSinkPrivate* sink, UdpEndpoint* sender);
+static void sink_lend(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, uint8_t flags, UdpEndpoint* borrower, bool handover);
+static void sink_wait(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, uint8_t flags, UdpEndpoint* sender);
+static size_t sink_find_waiter(AtollaSinkPrivate* sink, UdpEndpoint* endpoint);
+static void sink_remove_waiter(AtollaSinkPrivate* sink, size_t position);
+static void sink_forget_stale_waiters(AtollaSinkPrivate* sink);
+static void sink_send_sync(AtollaSinkPrivate* sink);
+static void sink_send_nack(AtollaSinkPrivate* sink);
+static bool sink_enqueue(AtollaSinkPrivate* sink, MemBlock frame, bool missing, unsigned int pts);
+static bool sink_play_timed(AtollaSinkPrivate* sink);
+static void sink_record_arrival(AtollaSinkPrivate* sink, int frame_idx_diff, int expected_ms);
+static void sink_record_borrower_msg(AtollaSinkPrivate* sink, uint16_t msg_id);
 static void sink_send_lent(AtollaSinkPrivate* sink);
 static void sink_send_fail(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code);
 static void sink_send_fail_to(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code, UdpEndpoint* to);
@@ -79,8 +176,10 @@ static void sink_receive(AtollaSinkPrivate* sink);
 static void sink_send(AtollaSinkPrivate* sink);
 static void sink_drop_borrow(AtollaSinkPrivate* sink);
 static void sink_panic(AtollaSinkPrivate* sink, const char* error_msg);
+#ifdef ATOLLA_ENABLE_TRACE
+static void sink_trace_dequeued(AtollaSinkPrivate* sink, int dequeued_count);
+#endif
 
-static void fill_with_pattern(void* target, size_t target_len, void* pattern, size_t pattern_len);
 static int bounded_diff(int from, int to, int cap);
 
 
@@ -119,8 +218,13 @@ static AtollaSinkPrivate* sink_private_make(const AtollaSinkSpec* spec)
     sink->lights_count = spec->lights_count;
     sink->current_frame = mem_block_alloc(spec->lights_count * color_channel_count);
     sink->received_frame = mem_block_alloc(spec->lights_count * color_channel_count);
+    sink->recovered_frame = mem_block_alloc(spec->lights_count * color_channel_count);
     sink->pending_frames = mem_ring_alloc(spec->lights_count * color_channel_count * pending_frames_capacity);
 
+#ifdef ATOLLA_ENABLE_TRACE
+    sink->trace = trace_ring_alloc(ATOLLA_TRACE_CAPACITY);
+#endif
+
     return sink;
 }
 
@@ -128,14 +232,21 @@ void atolla_sink_free(AtollaSink sink_handle)
 {
     AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
 
+    atolla_sink_capture_stop(sink_handle);
+
     msg_builder_free(&sink->builder);
 
     udp_socket_free(&sink->socket);
 
     mem_block_free(&sink->current_frame);
     mem_block_free(&sink->received_frame);
+    mem_block_free(&sink->recovered_frame);
     mem_ring_free(&sink->pending_frames);
 
+#ifdef ATOLLA_ENABLE_TRACE
+    trace_ring_free(&sink->trace);
+#endif
+
     free(sink);
 }
 
@@ -151,12 +262,98 @@ AtollaSinkState atolla_sink_state(AtollaSink sink_handle)
     return sink->state;
 }
 
+void atolla_sink_stats(AtollaSink sink_handle, AtollaSinkStats* stats)
+{
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
+    *stats = sink->stats;
+
+    stats->buffered_frames = sink->pending_frames.len / sink->received_frame.capacity;
+    stats->waiting_sources = (unsigned int) sink->waiters_count;
+
+    if(sink->state == ATOLLA_SINK_STATE_LENT && sink->last_recv_time != NULL_TIME)
+    {
+        stats->last_recv_age_ms = (int) (time_now() - sink->last_recv_time);
+    }
+    else
+    {
+        stats->last_recv_age_ms = -1;
+    }
+
+    const bool synced = sink->state == ATOLLA_SINK_STATE_LENT && sink->borrower_syncs && sink->clock_rtt >= 0;
+    stats->clock_offset_ms = synced ? sink->clock_offset : 0;
+    stats->clock_rtt_ms = synced ? sink->clock_rtt : -1;
+}
+
+#ifdef ATOLLA_ENABLE_TRACE
+size_t atolla_sink_trace_json(AtollaSink sink_handle, int pid, const char* process_name, char* buf, size_t buf_len)
+{
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
+    return trace_ring_json(&sink->trace, pid, process_name, buf, buf_len);
+}
+#endif
+
 const char* atolla_sink_error_msg(AtollaSink sink_handle)
 {
     AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
     return sink->error_msg;
 }
 
+bool atolla_sink_inject(AtollaSink sink_handle, const void* datagram, size_t datagram_len, const UdpEndpoint* sender)
+{
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
+
+    if(sink->state == ATOLLA_SINK_STATE_ERROR)
+    {
+        return false;
+    }
+
+    // Truncated like datagrams received from the socket that are too long
+    size_t len = (datagram_len < recv_buf_len) ? datagram_len : recv_buf_len;
+    memcpy(sink->recv_buf, datagram, len);
+
+    UdpEndpoint sender_copy = *sender;
+    sink_handle_datagram(sink, len, &sender_copy);
+
+    return true;
+}
+
+bool atolla_sink_capture_start(AtollaSink sink_handle, const char* path)
+{
+#ifdef ATOLLA_CAPTURE_SUPPORTED
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
+
+    atolla_sink_capture_stop(sink_handle);
+
+    CaptureWriter* capture = (CaptureWriter*) malloc(sizeof(CaptureWriter));
+    assert(capture != NULL);
+
+    if(!capture_writer_open(capture, path, sink->lights_count))
+    {
+        free(capture);
+        return false;
+    }
+
+    sink->capture = capture;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void atolla_sink_capture_stop(AtollaSink sink_handle)
+{
+#ifdef ATOLLA_CAPTURE_SUPPORTED
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
+
+    if(sink->capture != NULL)
+    {
+        capture_writer_close(sink->capture);
+        free(sink->capture);
+        sink->capture = NULL;
+    }
+#endif
+}
+
 bool atolla_sink_get(AtollaSink sink_handle, void* frame, size_t frame_len)
 {
     AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
@@ -165,12 +362,23 @@ bool atolla_sink_get(AtollaSink sink_handle, void* frame, size_t frame_len)
 
     if(lent)
     {
-        if(sink->time_origin == NULL_TIME)
+        if(sink->timed)
+        {
+            if(!sink_play_timed(sink))
+            {
+                // nothing available yet
+                return false;
+            }
+        }
+        else if(sink->time_origin == NULL_TIME)
         {
             // Set origin on first dequeue
             bool ok = mem_ring_dequeue(&sink->pending_frames, sink->current_frame.data, sink->current_frame.capacity);
             if(ok) {
                 sink->time_origin = time_now();
+#ifdef ATOLLA_ENABLE_TRACE
+                sink_trace_dequeued(sink, 1);
+#endif
             } else {
                 // nothing available yet
                 return false;
@@ -179,19 +387,29 @@ bool atolla_sink_get(AtollaSink sink_handle, void* frame, size_t frame_len)
         else
         {
             unsigned int now = time_now();
+            int dequeued_count = 0;
             while((now - sink->time_origin) > sink->frame_duration_ms) {
                 bool ok = mem_ring_dequeue(&sink->pending_frames, sink->current_frame.data, sink->current_frame.capacity);
                 if(ok) {
                     sink->time_origin += sink->frame_duration_ms;
+                    ++dequeued_count;
                 } else {
                     // TODO Experiencing lag, maybe disconnect at this point, not when trying to receive
                     //      this way the unfinished buffer can finish showing
+                    // Do not accumulate lag while the buffer is empty, otherwise the next
+                    // frames would be skipped through to catch up and the buffer would
+                    // never fill up again
+                    sink->time_origin = now - sink->frame_duration_ms;
                     break;
                 }
             }
+
+#ifdef ATOLLA_ENABLE_TRACE
+            sink_trace_dequeued(sink, dequeued_count);
+#endif
         }
 
-        fill_with_pattern(frame, frame_len, sink->current_frame.data, sink->current_frame.capacity);
+        mem_fill_with_pattern(frame, frame_len, sink->current_frame.data, sink->current_frame.capacity);
     }
 
     return lent;
@@ -222,9 +440,7 @@ static void sink_receive(AtollaSinkPrivate* sink)
 
         if(result.code == UDP_SOCKET_OK)
         {
-            // If another packet available, iterate contained messages
-            sink_iterate_recv_buf(sink, received_bytes, &sender);
-            sink->last_recv_time = time_now();
+            sink_handle_datagram(sink, received_bytes, &sender);
         }
         else
         {
@@ -234,88 +450,250 @@ static void sink_receive(AtollaSinkPrivate* sink)
                 sink_send_fail(sink, 0, ATOLLA_ERROR_CODE_TIMEOUT);
                 sink_drop_borrow(sink);
             }
+            sink_forget_stale_waiters(sink);
             return;
         }
     }
 }
 
+/**
+ * Evaluates a datagram of the given length in the receive buffer, no matter if
+ * it was received from the socket or injected.
+ */
+static void sink_handle_datagram(AtollaSinkPrivate* sink, size_t received_bytes, UdpEndpoint* sender)
+{
+    ++sink->stats.received_packets;
+
+#ifdef ATOLLA_CAPTURE_SUPPORTED
+    if(sink->capture != NULL)
+    {
+        capture_writer_append(sink->capture, sink->recv_buf, received_bytes, sender);
+    }
+#endif
+
+    sink_iterate_recv_buf(sink, received_bytes, sender);
+
+    // Sources waiting in line must not keep the borrow of another source alive
+    if(udp_endpoint_equal(sender, &sink->borrower_endpoint))
+    {
+        sink->last_recv_time = time_now();
+    }
+}
+
 static void sink_iterate_recv_buf(AtollaSinkPrivate* sink, size_t received_bytes, UdpEndpoint* sender)
 {
     MsgIter iter = msg_iter_make(sink->recv_buf, received_bytes);
+    MsgDecoded msg;
+    MsgDecodeResult result;
+    bool has_unknown_msg = false;
 
-    for(; msg_iter_has_msg(&iter); msg_iter_next(&iter))
+    // A malformed message ends the loop, the rest of the datagram is ignored
+    while((result = msg_iter_decode(&iter, &msg)) == MSG_DECODE_OK)
     {
-        MsgType type = msg_iter_type(&iter);
-        uint16_t msg_id = msg_iter_msg_id(&iter);
-
-        switch(type)
+        switch(msg.type)
         {
             case MSG_TYPE_BORROW:
-            {
-                uint8_t frame_len = msg_iter_borrow_frame_length(&iter);
-                uint8_t buffer_len = msg_iter_borrow_buffer_length(&iter);
-                sink_handle_borrow(sink, msg_id, frame_len, buffer_len, sender);
+                sink_handle_borrow(sink, msg.msg_id, msg.as.borrow.frame_length_ms, msg.as.borrow.buffer_length, msg.as.borrow.flags, sender);
                 break;
-            }
 
             case MSG_TYPE_ENQUEUE:
-            {
-                uint8_t frame_idx = msg_iter_enqueue_frame_idx(&iter);
-                MemBlock frame = msg_iter_enqueue_frame(&iter);
-                sink_handle_enqueue(sink, msg_id, frame_idx, frame, sender);
+                sink_handle_enqueue(sink, msg.msg_id, msg.as.enqueue.frame_idx, false, 0, msg.as.enqueue.frame, sender);
+                break;
+
+            case MSG_TYPE_ENQUEUE_TIMED:
+                sink_handle_enqueue(sink, msg.msg_id, msg.as.enqueue.frame_idx, true, msg.as.enqueue.presentation_time_ms, msg.as.enqueue.frame, sender);
+                break;
+
+            case MSG_TYPE_PARITY:
+                sink_handle_parity(sink, msg.as.parity.first_frame_idx, msg.as.parity.group_size, msg.as.parity.data, sender);
+                break;
+
+            case MSG_TYPE_SYNC:
+                sink_handle_sync(sink, msg.as.sync.ping_time_ms, msg.as.sync.pong_time_ms, sender);
+                break;
+
+            case MSG_TYPE_RELEASE:
+                sink_handle_release(sink, sender);
                 break;
-            }
 
             default:
-            {
-                sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_BAD_MSG, sender);
+                sink_send_fail_to(sink, msg.msg_id, ATOLLA_ERROR_CODE_BAD_MSG, sender);
+                has_unknown_msg = true;
                 break;
-            }
         }
     }
+
+    if(result == MSG_DECODE_MALFORMED || has_unknown_msg)
+    {
+        ++sink->stats.malformed_packets;
+    }
 }
 
-static void sink_handle_borrow(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, size_t buffer_length, UdpEndpoint* sender)
+/**
+ * Lends the sink to the sender if it is open, or confirms the borrow if the
+ * sender is the borrower already. While lent to another source, the sender
+ * waits in line if it set MSG_BORROW_FLAG_QUEUE, otherwise the borrow fails.
+ */
+static void sink_handle_borrow(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, size_t buffer_length, uint8_t flags, UdpEndpoint* sender)
 {
-    if(sink->state == ATOLLA_SINK_STATE_OPEN ||
-       (sink->state == ATOLLA_SINK_STATE_LENT && udp_endpoint_equal(sender, &sink->borrower_endpoint))
-      )
+    if(sink->state == ATOLLA_SINK_STATE_ERROR)
+    {
+        return; // In error state, do not bother to respond
+    }
+
+    const bool from_borrower = sink->state == ATOLLA_SINK_STATE_LENT && udp_endpoint_equal(sender, &sink->borrower_endpoint);
+    const bool lent_to_other = sink->state == ATOLLA_SINK_STATE_LENT && !from_borrower;
+    size_t required_frame_buf_size = buffer_length * (sink->lights_count * color_channel_count);
+
+    if(lent_to_other && (flags & MSG_BORROW_FLAG_QUEUE) == 0)
+    {
+        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE, sender);
+    }
+    else if(required_frame_buf_size > sink->pending_frames.buf.capacity)
     {
-        size_t required_frame_buf_size = buffer_length * (sink->lights_count * color_channel_count);
+        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_BUFFER_TOO_LARGE, sender);
+        if(from_borrower) { sink_drop_borrow(sink); }
+    }
+    else if(frame_length_ms < frame_length_ms_min)
+    {
+        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_FRAME_DURATION_TOO_SHORT, sender);
+        if(from_borrower) { sink_drop_borrow(sink); }
+    }
+    else if(lent_to_other)
+    {
+        sink_wait(sink, msg_id, frame_length_ms, flags, sender);
+    }
+    else
+    {
+        sink_lend(sink, msg_id, frame_length_ms, flags, sender, false);
+    }
+}
 
-        if(required_frame_buf_size > sink->pending_frames.buf.capacity)
+/**
+ * Starts a new borrow by the given borrower. With handover set, the frames of
+ * the borrower before that are still pending are kept, and the frames of the
+ * new borrower are played right after them without restarting playout.
+ */
+static void sink_lend(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, uint8_t flags, UdpEndpoint* borrower, bool handover)
+{
+    sink->borrower_endpoint = *borrower;
+    sink->frame_duration_ms = frame_length_ms;
+    if(handover)
+    {
+        // Handed over frames are numbered before the first frame of the new
+        // borrower, lost frames among them are not asked for again
+        memset(sink->frame_missing, 0, sizeof(sink->frame_missing));
+    }
+    else
+    {
+        sink->time_origin = NULL_TIME;
+    }
+    sink->last_enqueued_frame_idx = NULL_TIME;
+    sink->last_recv_time = NULL_TIME;
+    sink->lost_frames = 0;
+    sink->jitter = 0;
+    sink->last_enqueue_recv_time = NULL_TIME;
+    sink->timed = false;
+    sink->borrower_accepts_nack = (flags & MSG_BORROW_FLAG_NACK) != 0;
+    sink->last_nack_time = 0;
+    sink->borrower_syncs = (flags & MSG_BORROW_FLAG_SYNC) != 0;
+    sink->sync_count = 0;
+    sink->clock_offset = 0;
+    sink->clock_rtt = -1;
+    sink->state = ATOLLA_SINK_STATE_LENT;
+    sink_record_borrower_msg(sink, msg_id);
+
+    sink_send_lent(sink);
+    if(sink->borrower_syncs)
+    {
+        sink_send_sync(sink);
+    }
+}
+
+/**
+ * Puts the sender in line to borrow the sink after the borrower, or keeps its
+ * place if it waits already, and tells it its position. Waiting sources keep
+ * sending borrow messages, like while the borrow message or the answer is
+ * lost, which keeps their place. The borrow fails if the line is full.
+ */
+static void sink_wait(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, uint8_t flags, UdpEndpoint* sender)
+{
+    size_t position = sink_find_waiter(sink, sender);
+    if(position == sink->waiters_count)
+    {
+        if(sink->waiters_count == waiters_capacity)
         {
-            sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_BUFFER_TOO_LARGE, sender);
-            if(sink->state == ATOLLA_SINK_STATE_LENT) { sink_drop_borrow(sink); }
+            sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE, sender);
+            return;
         }
-        else if(frame_length_ms < frame_length_ms_min)
+        ++sink->waiters_count;
+    }
+
+    SinkWaiter* waiter = &sink->waiters[position];
+    waiter->endpoint = *sender;
+    waiter->msg_id = msg_id;
+    waiter->frame_length_ms = frame_length_ms;
+    waiter->flags = flags;
+    waiter->last_borrow_time = time_now();
+
+    MemBlock* queued_msg = msg_builder_queued(&sink->builder, (uint8_t) position);
+    udp_socket_send_to(&sink->socket, queued_msg->data, queued_msg->size, sender);
+}
+
+/**
+ * Returns the position of the given source in line, or waiters_count if it
+ * is not waiting.
+ */
+static size_t sink_find_waiter(AtollaSinkPrivate* sink, UdpEndpoint* endpoint)
+{
+    size_t position = 0;
+    while(position < sink->waiters_count && !udp_endpoint_equal(endpoint, &sink->waiters[position].endpoint))
+    {
+        ++position;
+    }
+    return position;
+}
+
+static void sink_remove_waiter(AtollaSinkPrivate* sink, size_t position)
+{
+    --sink->waiters_count;
+    memmove(
+        &sink->waiters[position],
+        &sink->waiters[position + 1],
+        (sink->waiters_count - position) * sizeof(SinkWaiter)
+    );
+}
+
+/**
+ * Forgets waiting sources that stopped sending borrow messages, e.g. because
+ * they timed out or were shut down without releasing.
+ */
+static void sink_forget_stale_waiters(AtollaSinkPrivate* sink)
+{
+    unsigned int now = time_now();
+    size_t position = 0;
+    while(position < sink->waiters_count)
+    {
+        if((now - sink->waiters[position].last_borrow_time) > drop_timeout)
         {
-            sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_FRAME_DURATION_TOO_SHORT, sender);
-            if(sink->state == ATOLLA_SINK_STATE_LENT) { sink_drop_borrow(sink); }
+            sink_remove_waiter(sink, position);
         }
         else
         {
-            sink->borrower_endpoint = *sender;
-            sink->frame_duration_ms = frame_length_ms;
-            sink->time_origin = NULL_TIME;
-            sink->last_enqueued_frame_idx = NULL_TIME;
-            sink->last_recv_time = NULL_TIME;
-            sink->state = ATOLLA_SINK_STATE_LENT;
-
-            sink_send_lent(sink);
+            ++position;
         }
     }
-    else if(sink->state == ATOLLA_SINK_STATE_LENT)
-    {
-        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE, sender);
-    }
-    else
-    {
-        return; // In error state, do not bother to respond
-    }
 }
 
-static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t frame_idx, MemBlock frame, UdpEndpoint* sender)
+/**
+ * Evaluates an enqueue message, or with timed set, a timed enqueue message with
+ * the given presentation time.
+ *
+ * The first timed enqueue message turns the session into a timed session. Plain
+ * enqueue messages in a timed session are presented one frame duration after
+ * the frame before.
+ */
+static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t frame_idx, bool timed, unsigned int pts, MemBlock frame, UdpEndpoint* sender)
 {
     if(sink->state == ATOLLA_SINK_STATE_ERROR)
     {
@@ -338,15 +716,71 @@ static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t
             if(udp_endpoint_equal(sender, &sink->borrower_endpoint))
             {
                 int diff = bounded_diff(sink->last_enqueued_frame_idx, frame_idx, 256);
+                TRACE_RECORD(&sink->trace, TRACE_EVENT_RECEIVED, frame_idx, diff);
+
+                if(timed && !sink->timed)
+                {
+                    // Playout starts over from the presentation times
+                    sink->timed = true;
+                    sink->time_origin = NULL_TIME;
+                    if(sink->last_enqueued_frame_idx < 0)
+                    {
+                        // Frames handed over from the borrower before have no presentation times
+                        mem_ring_drop(&sink->pending_frames, sink->pending_frames.len);
+                    }
+                }
+
+                const bool has_last_frame = sink->last_enqueued_frame_idx >= 0;
+                const unsigned int last_pts = has_last_frame ? sink->frame_pts[sink->last_enqueued_frame_idx] : 0;
+                if(sink->timed && !timed)
+                {
+                    pts = has_last_frame ? (last_pts + sink->frame_duration_ms) : 0;
+                }
+
                 if(diff > 128)
                 {
-                    // If would have to skip more than 128, this is an out of order package.
-                    // We just drop it.
+                    // If would have to skip more than 128, this is an out of order package,
+                    // or a retransmission of a lost frame
+                    if(timed && sink->frame_missing[frame_idx])
+                    {
+                        sink->frame_pts[frame_idx] = pts;
+                    }
+                    sink_handle_late_frame(sink, frame_idx, frame);
                     return;
                 }
 
+                sink_record_borrower_msg(sink, msg_id);
+                sink_record_arrival(
+                    sink,
+                    diff,
+                    (sink->timed && has_last_frame) ? (int) (pts - last_pts) : (diff * (int) sink->frame_duration_ms)
+                );
+
+                if(diff > 0)
+                {
+                    ++sink->stats.received_frames;
+                }
+
+                const int gap = diff;
                 while(diff > 0) {
-                    sink_enqueue(sink, frame);
+                    // All but the last enqueued frame are copies filling in for lost frames
+                    bool missing = diff > 1;
+                    unsigned int frame_pts = pts;
+                    if(missing && has_last_frame)
+                    {
+                        // Spread the copies evenly up to this frame, where the lost frames most likely were
+                        frame_pts = last_pts + (unsigned int) (((uint64_t) (pts - last_pts)) * (gap - diff + 1) / gap);
+                    }
+                    if(!sink_enqueue(sink, frame, missing, frame_pts))
+                    {
+                        // Buffer full, the rest is dropped and filled in later
+                        break;
+                    }
+                    if(missing)
+                    {
+                        ++sink->lost_frames;
+                        ++sink->stats.lost_frames;
+                    }
                     diff = bounded_diff(sink->last_enqueued_frame_idx, frame_idx, 256);
                 }
             }
@@ -358,16 +792,337 @@ static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t
     }
 }
 
-static void sink_enqueue(AtollaSinkPrivate* sink, MemBlock frame)
+/**
+ * Ends the borrow right away when the borrower is done with the sink, so the
+ * next source does not have to wait for the drop timeout, or takes a waiting
+ * source out of line. Sources send the message more than once, repetitions
+ * and messages of other sources are ignored.
+ */
+static void sink_handle_release(AtollaSinkPrivate* sink, UdpEndpoint* sender)
+{
+    if(sink->state != ATOLLA_SINK_STATE_LENT)
+    {
+        return;
+    }
+
+    if(udp_endpoint_equal(sender, &sink->borrower_endpoint))
+    {
+        sink_drop_borrow(sink);
+    }
+    else
+    {
+        size_t position = sink_find_waiter(sink, sender);
+        if(position < sink->waiters_count)
+        {
+            sink_remove_waiter(sink, position);
+        }
+    }
+}
+
+/**
+ * Reconstructs a single lost frame of a group of frames from the parity of the
+ * group and the other frames, if they are all still waiting for playout.
+ *
+ * The lost frame is either still pending as a copy of the next frame and gets
+ * overwritten in place, or it is the last frame of the group and is enqueued.
+ */
+static void sink_handle_parity(AtollaSinkPrivate* sink, uint8_t first_frame_idx, uint8_t group_size, MemBlock parity, UdpEndpoint* sender)
+{
+    if(sink->state != ATOLLA_SINK_STATE_LENT ||
+       !udp_endpoint_equal(sender, &sink->borrower_endpoint) ||
+       group_size == 0 || group_size > 128 ||
+       parity.size == 0)
+    {
+        // Parity is redundant information, ignore it if it cannot be used
+        return;
+    }
+
+    size_t frame_size = sink->recovered_frame.capacity;
+    size_t recover_len = (parity.size < frame_size) ? parity.size : frame_size;
+
+    int missing_count = 0;
+    uint8_t missing_frame_idx = 0;
+    uint8_t* missing_frame = NULL;
+
+    for(int i = 0; i < group_size; ++i)
+    {
+        uint8_t frame_idx = (first_frame_idx + i) % 256;
+        int ahead = bounded_diff(sink->last_enqueued_frame_idx, frame_idx, 256);
+        uint8_t* frame;
+
+        if(ahead > 0 && ahead <= 128)
+        {
+            // Not received yet, can only be recovered if it is the next one
+            ++missing_count;
+            missing_frame_idx = frame_idx;
+            missing_frame = NULL;
+        }
+        else if(!sink_pending_frame(sink, frame_idx, &frame))
+        {
+            // Already displayed, too late to recover anything in this group
+            return;
+        }
+        else if(sink->frame_missing[frame_idx])
+        {
+            ++missing_count;
+            missing_frame_idx = frame_idx;
+            missing_frame = frame;
+        }
+
+        if(missing_count > 1)
+        {
+            return;
+        }
+    }
+
+    if(missing_count == 0)
+    {
+        return;
+    }
+
+    uint8_t* recovered = (uint8_t*) sink->recovered_frame.data;
+    memcpy(recovered, parity.data, recover_len);
+
+    for(int i = 0; i < group_size; ++i)
+    {
+        uint8_t frame_idx = (first_frame_idx + i) % 256;
+        uint8_t* frame;
+        if(frame_idx != missing_frame_idx && sink_pending_frame(sink, frame_idx, &frame))
+        {
+            for(size_t b = 0; b < recover_len; ++b)
+            {
+                recovered[b] ^= frame[b];
+            }
+        }
+    }
+
+    if(missing_frame != NULL)
+    {
+        mem_fill_with_pattern(missing_frame, frame_size, recovered, recover_len);
+        sink->frame_missing[missing_frame_idx] = false;
+        if(sink->lost_frames > 0) { --sink->lost_frames; }
+        ++sink->stats.fec_recovered_frames;
+    }
+    else
+    {
+        // The frame was lost, but is recovered before the gap was even noticed
+        // Presentation time is unknown in timed sessions, assume the frame follows the one before
+        unsigned int pts = (sink->last_enqueued_frame_idx >= 0) ? (sink->frame_pts[sink->last_enqueued_frame_idx] + sink->frame_duration_ms) : 0;
+        sink_enqueue(sink, mem_block_make(recovered, recover_len), false, pts);
+        ++sink->stats.lost_frames;
+        ++sink->stats.fec_recovered_frames;
+    }
+}
+
+/**
+ * Replaces the copy filling in for a lost frame with the frame itself, if it
+ * arrived before the copy was displayed. Late duplicates of frames that were
+ * not lost are ignored.
+ */
+static void sink_handle_late_frame(AtollaSinkPrivate* sink, uint8_t frame_idx, MemBlock frame)
 {
-    fill_with_pattern(
+    if(!sink->frame_missing[frame_idx])
+    {
+        return;
+    }
+
+    sink->frame_missing[frame_idx] = false;
+
+    uint8_t* pending_frame;
+    if(sink_pending_frame(sink, frame_idx, &pending_frame))
+    {
+        mem_fill_with_pattern(pending_frame, sink->lights_count * color_channel_count, frame.data, frame.size);
+        if(sink->lost_frames > 0) { --sink->lost_frames; }
+        ++sink->stats.late_recovered_frames;
+    }
+    else
+    {
+        TRACE_RECORD(&sink->trace, TRACE_EVENT_DROPPED, frame_idx, TRACE_DROP_TOO_LATE);
+        ++sink->stats.too_late_frames;
+    }
+}
+
+/**
+ * Obtains a pointer to the frame with the given index if it is still waiting
+ * in the buffer for playout, otherwise returns false.
+ */
+static bool sink_pending_frame(AtollaSinkPrivate* sink, uint8_t frame_idx, uint8_t** frame)
+{
+    size_t frame_size = sink->lights_count * color_channel_count;
+    size_t pending_count = sink->pending_frames.len / frame_size;
+
+    // Zero for the newest frame in the buffer
+    size_t age = (sink->last_enqueued_frame_idx - frame_idx + 256) % 256;
+    if(sink->last_enqueued_frame_idx < 0 || age >= pending_count)
+    {
+        return false;
+    }
+
+    size_t offset = (pending_count - 1 - age) * frame_size;
+    return mem_ring_peek_at(&sink->pending_frames, offset, (void**) frame, frame_size);
+}
+
+/**
+ * Appends the frame to the buffer, or returns false if the buffer is full and
+ * the frame was dropped. The presentation time is only used in timed sessions.
+ */
+static bool sink_enqueue(AtollaSinkPrivate* sink, MemBlock frame, bool missing, unsigned int pts)
+{
+    mem_fill_with_pattern(
         sink->received_frame.data, sink->received_frame.capacity,
         frame.data, frame.size
     );
 
     if(mem_ring_enqueue(&sink->pending_frames, sink->received_frame.data, sink->received_frame.capacity)) {
         sink->last_enqueued_frame_idx = (sink->last_enqueued_frame_idx + 1) % 256;
+        sink->frame_missing[sink->last_enqueued_frame_idx] = missing;
+        sink->frame_nack_time[sink->last_enqueued_frame_idx] = NULL_TIME;
+        sink->frame_pts[sink->last_enqueued_frame_idx] = pts;
+        TRACE_RECORD(
+            &sink->trace,
+            missing ? TRACE_EVENT_FILLED : TRACE_EVENT_ENQUEUED,
+            sink->last_enqueued_frame_idx,
+            sink->pending_frames.len / sink->received_frame.capacity
+        );
+        return true;
+    } else {
+        TRACE_RECORD(&sink->trace, TRACE_EVENT_DROPPED, (sink->last_enqueued_frame_idx + 1) % 256, TRACE_DROP_BUFFER_FULL);
+        return false;
+    }
+}
+
+/**
+ * Makes the last pending frame that is due the current frame in timed sessions.
+ * The first frame is shown right away and anchors the presentation times to
+ * the clock of the sink, unless the borrower syncs clocks. Then presentation
+ * times refer to the clock of the source and frames are due when the
+ * synchronized clock reaches them, so that sinks with sources on the same
+ * clock show frames with the same presentation time at the same time. Copies
+ * filling in for lost frames are skipped. Frames that are not due yet stay
+ * pending, and the current frame stays as it is
+ * while nothing is pending, so still scenes need no new frames.
+ *
+ * Returns false if no frame was shown yet.
+ */
+static bool sink_play_timed(AtollaSinkPrivate* sink)
+{
+    const size_t frame_size = sink->current_frame.capacity;
+    const unsigned int now = time_now();
+    int dequeued_count = 0;
+
+    unsigned int origin = sink->time_origin;
+    if(sink->borrower_syncs)
+    {
+        if(sink->clock_rtt < 0)
+        {
+            // Nothing is due before the source clock is known
+            return sink->time_origin != NULL_TIME;
+        }
+
+        origin = (unsigned int) -sink->clock_offset;
+        if(origin == NULL_TIME)
+        {
+            // Offset is valid, but means no origin, a millisecond does not matter
+            --origin;
+        }
+    }
+
+    while(sink->pending_frames.len >= frame_size)
+    {
+        size_t pending_count = sink->pending_frames.len / frame_size;
+        uint8_t next_frame_idx = (uint8_t) ((sink->last_enqueued_frame_idx - (int) pending_count + 1 + 256) % 256);
+        unsigned int pts = sink->frame_pts[next_frame_idx];
+
+        if(origin == NULL_TIME)
+        {
+            origin = now - pts;
+        }
+        else if((int) (now - origin - pts) < 0)
+        {
+            break;
+        }
+
+        if(sink->frame_missing[next_frame_idx] && sink->time_origin != NULL_TIME)
+        {
+            // Rather than showing the next frame early, hold the current one
+            // until the next frame is due, which keeps sinks in lockstep
+            mem_ring_drop(&sink->pending_frames, frame_size);
+        }
+        else
+        {
+            mem_ring_dequeue(&sink->pending_frames, sink->current_frame.data, sink->current_frame.capacity);
+        }
+        sink->time_origin = origin;
+        ++dequeued_count;
+    }
+
+#ifdef ATOLLA_ENABLE_TRACE
+    sink_trace_dequeued(sink, dequeued_count);
+#endif
+
+    return sink->time_origin != NULL_TIME;
+}
+
+#ifdef ATOLLA_ENABLE_TRACE
+/**
+ * Records the frame that became current after dequeuing the given amount of
+ * frames, and the frames before it that were skipped over without being shown.
+ */
+static void sink_trace_dequeued(AtollaSinkPrivate* sink, int dequeued_count)
+{
+    if(dequeued_count == 0)
+    {
+        return;
+    }
+
+    size_t pending_count = sink->pending_frames.len / sink->current_frame.capacity;
+    int current_frame_idx = (int) ((sink->last_enqueued_frame_idx - pending_count + 256) % 256);
+
+    for(int skipped = dequeued_count - 1; skipped > 0; --skipped)
+    {
+        trace_ring_record(&sink->trace, TRACE_EVENT_DROPPED, (current_frame_idx - skipped + 256) % 256, TRACE_DROP_SKIPPED);
+    }
+
+    trace_ring_record(&sink->trace, TRACE_EVENT_CURRENT, current_frame_idx, pending_count);
+}
+#endif
+
+/**
+ * Updates jitter statistics for the receiver report after receiving
+ * a frame that is the given amount of frames ahead of the last enqueued frame
+ * and was expected to arrive the given amount of milliseconds after it.
+ */
+static void sink_record_arrival(AtollaSinkPrivate* sink, int frame_idx_diff, int expected_ms)
+{
+    if(frame_idx_diff == 0)
+    {
+        // Duplicate of the last frame, not informative for jitter
+        return;
     }
+
+    unsigned int now = time_now();
+
+    if(sink->last_enqueue_recv_time != NULL_TIME)
+    {
+        // Interarrival jitter as in RFC 3550, using the frame duration as the
+        // expected distance between frames unless they carry timestamps
+        int expected = expected_ms;
+        int actual = now - sink->last_enqueue_recv_time;
+        int deviation = (actual > expected) ? (actual - expected) : (expected - actual);
+        sink->jitter += deviation - ((sink->jitter + 8) / 16);
+    }
+
+    sink->last_enqueue_recv_time = now;
+}
+
+/**
+ * Remembers the ID of a message from the borrower, so it can be echoed back to
+ * the source with the next report for round trip time measurement.
+ */
+static void sink_record_borrower_msg(AtollaSinkPrivate* sink, uint16_t msg_id)
+{
+    sink->last_borrower_msg_id = msg_id;
+    sink->last_borrower_msg_time = time_now();
 }
 
 static void sink_send(AtollaSinkPrivate* sink)
@@ -378,14 +1133,142 @@ static void sink_send(AtollaSinkPrivate* sink)
         {
             sink_send_lent(sink);
         }
+
+        if(sink->borrower_accepts_nack && (time_now() - sink->last_nack_time) >= nack_interval)
+        {
+            sink_send_nack(sink);
+        }
+
+        unsigned int interval = (sink->sync_count < sync_samples) ? sync_interval_initial : sync_interval;
+        if(sink->borrower_syncs && (time_now() - sink->last_sync_time) >= interval)
+        {
+            sink_send_sync(sink);
+        }
     }
 }
 
+/**
+ * Asks the borrower for its clock, the answer is evaluated in sink_handle_sync.
+ */
+static void sink_send_sync(AtollaSinkPrivate* sink)
+{
+    sink->last_sync_time = time_now();
+    MemBlock* sync_msg = msg_builder_sync(&sink->builder, sink->last_sync_time, 0);
+    udp_socket_send_to(&sink->socket, sync_msg->data, sync_msg->size, &sink->borrower_endpoint);
+}
+
+/**
+ * Evaluates the answer of the borrower to a sync message, which holds the
+ * time the sink sent it and the time of the source clock when answering.
+ *
+ * Like NTP, the source clock is assumed to have been read halfway through the
+ * round trip. Of the recent exchanges, the one with the shortest round trip
+ * was delayed the least by queues on the way, so its offset is used.
+ */
+static void sink_handle_sync(AtollaSinkPrivate* sink, uint32_t ping_time_ms, uint32_t pong_time_ms, UdpEndpoint* sender)
+{
+    if(sink->state != ATOLLA_SINK_STATE_LENT ||
+       !sink->borrower_syncs ||
+       !udp_endpoint_equal(sender, &sink->borrower_endpoint))
+    {
+        return;
+    }
+
+    const unsigned int rtt = time_now() - ping_time_ms;
+    if(rtt > drop_timeout)
+    {
+        // Not an answer to a recent ping, e.g. from a borrow before
+        return;
+    }
+
+    const size_t slot = sink->sync_count % sync_samples;
+    sink->sync_rtts[slot] = rtt;
+    sink->sync_offsets[slot] = (int) (pong_time_ms - (ping_time_ms + rtt / 2));
+    ++sink->sync_count;
+
+    const size_t count = (sink->sync_count < sync_samples) ? sink->sync_count : sync_samples;
+    size_t best = 0;
+    for(size_t i = 1; i < count; ++i)
+    {
+        if(sink->sync_rtts[i] < sink->sync_rtts[best])
+        {
+            best = i;
+        }
+    }
+
+    sink->clock_offset = sink->sync_offsets[best];
+    sink->clock_rtt = (int) sink->sync_rtts[best];
+}
+
 static void sink_send_lent(AtollaSinkPrivate* sink)
 {
-    MemBlock* lent_msg = msg_builder_lent(&sink->builder);
+    unsigned int now = time_now();
+
+    size_t frame_size = sink->lights_count * color_channel_count;
+    size_t buffered_frames = sink->pending_frames.len / frame_size;
+    if(buffered_frames > 255) { buffered_frames = 255; }
+
+    // The frame before the oldest frame in the buffer is the one currently shown
+    int played_frame_idx = (((sink->last_enqueued_frame_idx - (int) buffered_frames) % 256) + 256) % 256;
+
+    unsigned int jitter_ms = sink->jitter / 16;
+    if(jitter_ms > 65535) { jitter_ms = 65535; }
+
+    unsigned int echo_delay_ms = now - sink->last_borrower_msg_time;
+    if(echo_delay_ms > 65535) { echo_delay_ms = 65535; }
+
+    MemBlock* lent_msg = msg_builder_lent_report(
+        &sink->builder,
+        (uint8_t) buffered_frames,
+        (uint8_t) played_frame_idx,
+        (uint16_t) sink->lost_frames,
+        (uint16_t) jitter_ms,
+        sink->last_borrower_msg_id,
+        (uint16_t) echo_delay_ms
+    );
     udp_socket_send_to(&sink->socket, lent_msg->data, lent_msg->size, &sink->borrower_endpoint);
-    sink->last_send_lent_time = time_now();
+    sink->last_send_lent_time = now;
+}
+
+/**
+ * Asks the borrower to send lost frames again that are still waiting for
+ * playout, oldest first, unless they have been asked for recently.
+ */
+static void sink_send_nack(AtollaSinkPrivate* sink)
+{
+    unsigned int now = time_now();
+    sink->last_nack_time = now;
+
+    if(sink->last_enqueued_frame_idx < 0)
+    {
+        return;
+    }
+
+    size_t frame_size = sink->lights_count * color_channel_count;
+    size_t pending_count = sink->pending_frames.len / frame_size;
+
+    uint8_t frame_idxs[nack_frames_max];
+    size_t frame_idxs_count = 0;
+
+    for(size_t age = pending_count; age > 0 && frame_idxs_count < nack_frames_max; --age)
+    {
+        uint8_t frame_idx = (sink->last_enqueued_frame_idx - (int) (age - 1) + 256) % 256;
+        unsigned int nack_time = sink->frame_nack_time[frame_idx];
+
+        if(sink->frame_missing[frame_idx] &&
+           (nack_time == NULL_TIME || (now - nack_time) >= nack_retry_interval))
+        {
+            frame_idxs[frame_idxs_count++] = frame_idx;
+            sink->frame_nack_time[frame_idx] = now;
+        }
+    }
+
+    if(frame_idxs_count > 0)
+    {
+        MemBlock* nack_msg = msg_builder_nack(&sink->builder, frame_idxs, frame_idxs_count);
+        udp_socket_send_to(&sink->socket, nack_msg->data, nack_msg->size, &sink->borrower_endpoint);
+        ++sink->stats.sent_nacks;
+    }
 }
 
 static void sink_send_fail(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code)
@@ -399,9 +1282,37 @@ static void sink_send_fail_to(AtollaSinkPrivate* sink, uint16_t offending_msg_id
     udp_socket_send_to(&sink->socket, lent_msg->data, lent_msg->size, to);
 }
 
+/**
+ * Ends the borrow and lends the sink to the next source waiting in line, if
+ * any, otherwise opens it for new borrowers.
+ */
 static void sink_drop_borrow(AtollaSinkPrivate* sink)
 {
     sink->state = ATOLLA_SINK_STATE_OPEN;
+
+    sink_forget_stale_waiters(sink);
+    const bool has_next = sink->waiters_count > 0;
+    SinkWaiter next = sink->waiters[0];
+    if(has_next)
+    {
+        sink_remove_waiter(sink, 0);
+    }
+
+    // Frames of the last borrower must not be played for the next one, unless
+    // it takes over playout from the last borrower. Presentation times of
+    // timed frames would not make sense to it, so they are not handed over.
+    const bool handover = has_next && (next.flags & MSG_BORROW_FLAG_HANDOVER) != 0 && !sink->timed;
+    if(!handover)
+    {
+        mem_ring_drop(&sink->pending_frames, sink->pending_frames.len);
+    }
+
+    if(has_next)
+    {
+        sink_lend(sink, next.msg_id, next.frame_length_ms, next.flags, &next.endpoint, handover);
+        // The next borrower was last heard of when it last asked to borrow
+        sink->last_recv_time = next.last_borrow_time;
+    }
 }
 
 static void sink_panic(AtollaSinkPrivate* sink, const char* error_msg) {
@@ -410,29 +1321,6 @@ static void sink_panic(AtollaSinkPrivate* sink, const char* error_msg) {
     sink->error_msg = error_msg;
 }
 
-static void fill_with_pattern(void* target, size_t target_len, void* pattern, size_t pattern_len)
-{
-    if(target_len == 0) return;
-    if(pattern_len == 0) return;
-
-    uint8_t* offset_target = (uint8_t*) target;
-
-    while(target_len > 0)
-    {
-        if(pattern_len >= target_len)
-        {
-            memcpy(offset_target, pattern, target_len);
-            target_len = 0;
-        }
-        else
-        {
-            memcpy(offset_target, pattern, pattern_len);
-            offset_target += pattern_len;
-            target_len -= pattern_len;
-        }
-    }
-}
-
 static int bounded_diff(int from, int to, int cap)
 {
     if(to < from)
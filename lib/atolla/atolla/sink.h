@@ -3,6 +3,9 @@
 
 #include "primitives.h"
 
+// Sender of injected datagrams, see udp_socket/udp_socket.h
+struct UdpEndpoint;
+
 enum AtollaSinkState
 {
     // Sink is in a state of error that it cannot recover from
@@ -45,6 +48,78 @@ struct AtollaSinkSpec
 };
 typedef struct AtollaSinkSpec AtollaSinkSpec;
 
+/**
+ * Holds statistics about the frames received by a sink since it was made, as
+ * obtained with atolla_sink_stats.
+ */
+struct AtollaSinkStats
+{
+    /**
+     * Amount of frames received in time and in order.
+     */
+    unsigned int received_frames;
+    /**
+     * Amount of frames that did not arrive in order and were filled in with
+     * copies of the next frame.
+     */
+    unsigned int lost_frames;
+    /**
+     * Amount of lost frames that were reconstructed from parity before being
+     * displayed.
+     */
+    unsigned int fec_recovered_frames;
+    /**
+     * Amount of lost frames that arrived late, e.g. after being retransmitted
+     * in response to a NACK, but before being displayed.
+     */
+    unsigned int late_recovered_frames;
+    /**
+     * Amount of lost frames that arrived after their copy was already
+     * displayed.
+     */
+    unsigned int too_late_frames;
+    /**
+     * Amount of NACK messages sent to sources to ask for lost frames.
+     */
+    unsigned int sent_nacks;
+    /**
+     * Amount of datagrams received from any source.
+     */
+    unsigned int received_packets;
+    /**
+     * Amount of received datagrams that were truncated or otherwise malformed,
+     * or that contained messages of unknown type.
+     */
+    unsigned int malformed_packets;
+    /**
+     * Amount of frames waiting in the buffer for playout right now.
+     */
+    unsigned int buffered_frames;
+    /**
+     * Milliseconds since the last datagram from the borrower, or -1 if the
+     * sink is not lent. The borrow is dropped once this exceeds the drop
+     * timeout.
+     */
+    int last_recv_age_ms;
+    /**
+     * Estimated clock of the source minus the clock of the sink in
+     * milliseconds, if the borrower syncs clocks, otherwise zero.
+     */
+    int clock_offset_ms;
+    /**
+     * Round trip time of the sync exchange that clock_offset_ms was estimated
+     * from, half of which bounds its error, or -1 if the borrower does not sync
+     * clocks or no answer arrived yet.
+     */
+    int clock_rtt_ms;
+    /**
+     * Amount of sources waiting in line to borrow the sink once the current
+     * borrower releases it or times out.
+     */
+    unsigned int waiting_sources;
+};
+typedef struct AtollaSinkStats AtollaSinkStats;
+
 /**
  * Intializes and creates a new sink.
  */
@@ -86,4 +161,46 @@ const char* atolla_sink_error_msg(AtollaSink sink);
  */
 bool atolla_sink_get(AtollaSink sink, void* frame, size_t frame_len);
 
+/**
+ * Writes statistics about the frames received by the sink into the given struct.
+ */
+void atolla_sink_stats(AtollaSink sink, AtollaSinkStats* stats);
+
+/**
+ * Starts writing every datagram the sink receives or gets injected into a
+ * capture file at the given path, along with the arrival time and the sender,
+ * replacing a capture that was running before. See capture/capture.h for the
+ * file format.
+ *
+ * Returns false if the file could not be created, or if captures are not
+ * supported on the platform.
+ */
+bool atolla_sink_capture_start(AtollaSink sink, const char* path);
+
+/**
+ * Finishes the running capture, if any. Also done by atolla_sink_free.
+ */
+void atolla_sink_capture_stop(AtollaSink sink);
+
+/**
+ * Evaluates the given datagram as if it had just been received from the
+ * socket and sent by the given sender, e.g. to replay a capture without going
+ * through the network. Replies are sent to the sender over the socket.
+ *
+ * Returns false without evaluating the datagram if the sink is in error state.
+ */
+bool atolla_sink_inject(AtollaSink sink, const void* datagram, size_t datagram_len, const struct UdpEndpoint* sender);
+
+#ifdef ATOLLA_ENABLE_TRACE
+/**
+ * Writes the most recent events recorded for the frames received and played
+ * by this sink as Chrome trace JSON into buf, see trace_ring_json in
+ * trace/trace.h for the format and the meaning of the parameters and return
+ * value.
+ *
+ * Only available if compiled with ATOLLA_ENABLE_TRACE.
+ */
+size_t atolla_sink_trace_json(AtollaSink sink, int pid, const char* process_name, char* buf, size_t buf_len);
+#endif
+
 #endif // ATOLLA_SINK_H
@@ -1,13 +1,16 @@
 #include "source.h"
-#include "error_codes.h"
+#include "error_msg.h"
 #include "../msg/builder.h"
 #include "../msg/iter.h"
+#include "../show/show.h"
 #include "../test/assert.h"
 #include "../time/now.h"
 #include "../time/sleep.h"
+#include "../trace/trace.h"
 #include "../udp_socket/udp_socket.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef ATOLLA_SOURCE_RECV_BUF_LEN
 /**
@@ -18,15 +21,70 @@
 #define ATOLLA_SOURCE_RECV_BUF_LEN 32
 #endif
 
+#ifndef ATOLLA_SOURCE_MAX_DATAGRAM_LEN
+/**
+ * Determines the maximum size of datagrams that multiple queued frames are
+ * coalesced into. Frames that are larger on their own are still sent in a
+ * datagram of their own.
+ *
+ * The default fits into the receive buffer of a sink with default settings.
+ */
+#define ATOLLA_SOURCE_MAX_DATAGRAM_LEN 1024
+#endif
+
+#ifndef ATOLLA_SOURCE_MAX_COALESCED_FRAMES
+/**
+ * Determines how many queued frames can be coalesced into a single datagram
+ * at most.
+ */
+#define ATOLLA_SOURCE_MAX_COALESCED_FRAMES 32
+#endif
+
+#if (2 * ATOLLA_SOURCE_MAX_COALESCED_FRAMES) > UDP_SOCKET_MAX_PACKET_PARTS
+#error "Coalesced frames need two packet parts each, increase UDP_SOCKET_MAX_PACKET_PARTS"
+#endif
+
 static const size_t recv_buf_len = ATOLLA_SOURCE_RECV_BUF_LEN;
+static const size_t max_datagram_len = ATOLLA_SOURCE_MAX_DATAGRAM_LEN;
+static const int max_coalesced_frames = ATOLLA_SOURCE_MAX_COALESCED_FRAMES;
 static const unsigned int retry_timeout_ms_default = 100;
 static const unsigned int disconnect_timeout_ms_default = 750;
 static const int max_buffered_frames_default = 16;
+static const int max_queued_frames_default = 16;
 static const int blocking_make_refresh_interval = 5;
+/** Milliseconds to wait before retrying when queued frames could not be sent, e.g. with a full socket buffer */
+static const int blocked_send_retry_interval = 1;
+/** Release messages sent when freeing, more than one in case some get lost */
+static const int release_send_count = 3;
+/** Milliseconds between the release messages, so they do not get lost together */
+static const unsigned int release_send_interval = 2;
+/** Amount of sent message IDs for which the send time is remembered for round trip time measurement */
+static const size_t sent_msg_history_len = 32;
+/**
+ * Receiver reports move the estimated time of the last frame by one over this
+ * fraction of the difference to the reported time, so single reports that are
+ * off due to scheduling noise in the sink do not cause spikes in frame rate.
+ */
+static const int pacing_correction_divisor = 4;
+/**
+ * Timed frames are sent again after this many milliseconds without sending, so
+ * that sinks do not drop the borrow during still scenes.
+ */
+static const unsigned int timed_keepalive_interval = 500;
 /** Special time value meant to represent no time set */
 // FIXME this is actually a valid point in time, maybe use unions with use flag?
 static const unsigned int NULL_TIME = ~0;
 
+/** A frame that was sent before and can be sent again if reported lost */
+struct SourceSentFrame
+{
+    int frame_idx;
+    /** Presentation time of timed frames */
+    unsigned int pts;
+    MemBlock frame;
+};
+typedef struct SourceSentFrame SourceSentFrame;
+
 struct AtollaSourcePrivate
 {
     AtollaSourceState state;
@@ -40,30 +98,129 @@ struct AtollaSourcePrivate
     int max_buffered_frames;
     unsigned int retry_timeout_ms;
     unsigned int disconnect_timeout_ms;
+    unsigned short sink_port;
+    /** Set while waiting for atolla_source_resolved with defer_resolve */
+    bool resolving;
 
     unsigned int first_borrow_time;
     unsigned int last_borrow_time;
     unsigned int last_frame_time;
     unsigned int last_recv_lent_time;
 
+    // Frames accepted by atolla_source_put_queued that have not been sent yet,
+    // the slots keep their memory so that queueing does not allocate
+    MemBlock* queue;
+    int queue_capacity;
+    int queue_front;
+    int queue_len;
+    // Headers of the enqueue messages coalesced into the datagram being sent
+    uint8_t coalesced_headers[ATOLLA_SOURCE_MAX_COALESCED_FRAMES][MSG_BUILDER_ENQUEUE_HEADER_LEN];
+
+    // Send times of recent messages, indexed by message ID modulo history length
+    uint16_t sent_msg_ids[sent_msg_history_len];
+    unsigned int sent_msg_times[sent_msg_history_len];
+    /** Smoothed round trip time in eighths of a millisecond, or -1 if unknown */
+    int srtt;
+    uint16_t last_report_lost_frames;
+    AtollaSourceStats stats;
+
+    // Forward error correction, XOR of the frames sent in the current group
+    int fec_group_size;
+    MemBlock fec_parity;
+    int fec_group_len;
+    uint8_t fec_group_first_frame_idx;
+    bool fec_group_uniform;
+    /**
+     * Set after receiving the first report. Sinks sending reports also
+     * understand parity and release messages, older sinks reject them.
+     */
+    bool sink_sends_reports;
+
+    // Copies of the last sent frames for retransmission, indexed by frame index
+    // modulo max_buffered_frames, or NULL if retransmission is disabled
+    SourceSentFrame* history;
+
+    /** Whether the sink syncs its clock to the source, see sync_clock in the spec */
+    bool sync_clock;
+
+    // Waiting in line while the sink is lent to another source
+    bool queue_borrow;
+    bool handover;
+    /** Position in line from the last QUEUED message, or -1 if not waiting in line */
+    int queue_position;
+    unsigned int last_recv_queued_time;
+
+    // Frames sent with atolla_source_put_timed
+    bool timed;
+    /** Time at which the presentation time of frames was zero */
+    unsigned int timed_epoch;
+    /** Presentation times of the last max_buffered_frames timed frames, indexed by timed_sent_count modulo max_buffered_frames */
+    unsigned int* timed_pts;
+    unsigned int timed_sent_count;
+    /** Copy of the last timed frame, sent again while no new frames are put */
+    MemBlock timed_last_frame;
+    uint8_t timed_last_frame_idx;
+    unsigned int timed_last_send_time;
+
+#ifdef ATOLLA_SHOW_SUPPORTED
+    /** Show streamed with atolla_source_stream_show, or NULL */
+    ShowReader* show;
+    bool show_loop;
+    // Frames read from the show that have not been sent yet, pointing into
+    // the show, read again only after all of them were sent
+    MemBlock show_pending[ATOLLA_SOURCE_MAX_COALESCED_FRAMES];
+    int show_pending_front;
+    int show_pending_len;
+#endif
+
+#ifdef ATOLLA_ENABLE_TRACE
+    TraceRing trace;
+#endif
+
     const char* error_msg;
 };
 typedef struct AtollaSourcePrivate AtollaSourcePrivate;
 
 static AtollaSourcePrivate* source_private_make(const AtollaSourceSpec* spec);
 static void source_await_make_completion(AtollaSourcePrivate* source);
+static void source_connect(AtollaSourcePrivate* source, const char* sink_address);
 static void source_send_borrow(AtollaSourcePrivate* source);
 static void source_update(AtollaSourcePrivate* source);
 static void source_iterate_recv_buf(AtollaSourcePrivate* sink, size_t received_bytes);
 static void source_lent(AtollaSourcePrivate* source);
+static void source_handle_queued(AtollaSourcePrivate* source, uint8_t position);
+static void source_handle_report(AtollaSourcePrivate* source, const MsgDecodedLent* report);
+static void source_correct_pacing(AtollaSourcePrivate* source, uint8_t played_frame_idx);
+static void source_record_sent_msg(AtollaSourcePrivate* source);
+static void source_frame_sent(AtollaSourcePrivate* source, void* frame, size_t frame_len);
+static void source_history_add(AtollaSourcePrivate* source, uint8_t frame_idx, void* frame, size_t frame_len);
+static void source_handle_nack(AtollaSourcePrivate* source, const MsgDecodedNack* nack);
+static void source_handle_sync(AtollaSourcePrivate* source, const MsgDecodedSync* sync);
+static void source_fec_add(AtollaSourcePrivate* source, uint8_t frame_idx, void* frame, size_t frame_len);
+static void source_send_parity(AtollaSourcePrivate* source);
 static void source_fail(AtollaSourcePrivate* source, const char* error_msg);
+static void source_send_release(AtollaSourcePrivate* source);
 static void source_receive(AtollaSourcePrivate* source);
 static void source_manage_borrow_packet_loss(AtollaSourcePrivate* source);
 static void source_ensure_lent_resent(AtollaSourcePrivate* source);
+static void source_send_queued(AtollaSourcePrivate* source);
+static int source_timed_wait(AtollaSourcePrivate* source, unsigned int pts);
+static bool source_send_timed(AtollaSourcePrivate* source, uint8_t frame_idx, unsigned int pts, void* frame, size_t frame_len);
+static void source_send_timed_keepalive(AtollaSourcePrivate* source);
+#ifdef ATOLLA_SHOW_SUPPORTED
+static void source_send_show(AtollaSourcePrivate* source);
+static int source_read_show(AtollaSourcePrivate* source);
+#endif
+static bool source_send_frame(AtollaSourcePrivate* source, void* frame, size_t frame_len);
+static int source_send_coalesced(AtollaSourcePrivate* source, MemBlock* frames, int frames_capacity, int front, int max_frames);
+static void source_advance_frame(AtollaSourcePrivate* source);
+static int source_ready_count(AtollaSourcePrivate* source);
 
 AtollaSource atolla_source_make(const AtollaSourceSpec* spec)
 {
     assert(spec->sink_port >= 0 && spec->sink_port < 65536);
+    assert(spec->fec_group_size >= 0 && spec->fec_group_size <= 128);
+    assert(spec->async_make || !spec->defer_resolve);
 
     AtollaSourcePrivate* source = source_private_make(spec);
 
@@ -72,19 +229,12 @@ AtollaSource atolla_source_make(const AtollaSourceSpec* spec)
     UdpSocketResult result;
     
     result = udp_socket_init(&source->sock);
-    if(result.code == UDP_SOCKET_OK) {
-        result = udp_socket_set_receiver(&source->sock, spec->sink_hostname, (unsigned short) spec->sink_port);
-        if(result.code == UDP_SOCKET_OK) {
-            // If hostname could be resolved, send first borrow
-            source->first_borrow_time = time_now();
-            source_send_borrow(source);
-        } else {
-            // If resolving failed, immediately enter error state
-            source->state = ATOLLA_SOURCE_STATE_ERROR;
-            source_fail(source, "Sink hostname could not be resolved.");
-        }
-    } else {
+    if(result.code != UDP_SOCKET_OK) {
         source_fail(source, "Sink could not bind to port.");
+    } else if(spec->defer_resolve) {
+        source->resolving = true;
+    } else {
+        source_connect(source, spec->sink_hostname);
     }
 
     if(!spec->async_make)
@@ -106,14 +256,114 @@ static AtollaSourcePrivate* source_private_make(const AtollaSourceSpec* spec)
     source->max_buffered_frames = (spec->max_buffered_frames == 0) ? max_buffered_frames_default : spec->max_buffered_frames;
     source->retry_timeout_ms = (spec->retry_timeout_ms == 0) ? retry_timeout_ms_default : spec->retry_timeout_ms;
     source->disconnect_timeout_ms = (spec->disconnect_timeout_ms == 0) ? disconnect_timeout_ms_default : spec->disconnect_timeout_ms;
+    source->sink_port = (unsigned short) spec->sink_port;
+    source->resolving = false;
 
     source->first_borrow_time = 0;
     source->last_borrow_time = 0;
     source->last_frame_time = 0;
 
+    source->queue_capacity = (spec->max_queued_frames == 0) ? max_queued_frames_default : spec->max_queued_frames;
+    source->queue = (MemBlock*) calloc(source->queue_capacity, sizeof(MemBlock));
+    assert(source->queue != NULL);
+    source->queue_front = 0;
+    source->queue_len = 0;
+
+    memset(source->sent_msg_ids, 0, sizeof(source->sent_msg_ids));
+    memset(source->sent_msg_times, 0, sizeof(source->sent_msg_times));
+    source->srtt = -1;
+    source->last_report_lost_frames = 0;
+    memset(&source->stats, 0, sizeof(AtollaSourceStats));
+    source->stats.rtt_ms = -1;
+    source->stats.sink_played_frame_idx = -1;
+
+    source->fec_group_size = spec->fec_group_size;
+    source->fec_parity = mem_block_alloc(0);
+    source->fec_group_len = 0;
+    source->fec_group_first_frame_idx = 0;
+    source->fec_group_uniform = true;
+    source->sink_sends_reports = false;
+
+    if(spec->retransmit_lost_frames)
+    {
+        source->history = (SourceSentFrame*) calloc(source->max_buffered_frames, sizeof(SourceSentFrame));
+        assert(source->history != NULL);
+        for(int i = 0; i < source->max_buffered_frames; ++i)
+        {
+            source->history[i].frame_idx = -1;
+        }
+    }
+    else
+    {
+        source->history = NULL;
+    }
+
+    source->sync_clock = spec->sync_clock;
+
+    source->queue_borrow = spec->queue_borrow || spec->handover;
+    source->handover = spec->handover;
+    source->queue_position = -1;
+    source->last_recv_queued_time = 0;
+
+    source->timed = false;
+    source->timed_epoch = 0;
+    source->timed_pts = NULL;
+    source->timed_sent_count = 0;
+    source->timed_last_frame = mem_block_alloc(0);
+    source->timed_last_frame_idx = 0;
+    source->timed_last_send_time = 0;
+
+#ifdef ATOLLA_SHOW_SUPPORTED
+    source->show = NULL;
+    source->show_loop = false;
+    source->show_pending_front = 0;
+    source->show_pending_len = 0;
+#endif
+
+#ifdef ATOLLA_ENABLE_TRACE
+    source->trace = trace_ring_alloc(ATOLLA_TRACE_CAPACITY);
+#endif
+
     return source;
 }
 
+static void source_connect(AtollaSourcePrivate* source, const char* sink_address)
+{
+    UdpSocketResult result = udp_socket_set_receiver(&source->sock, sink_address, source->sink_port);
+    if(result.code == UDP_SOCKET_OK) {
+        // If hostname could be resolved, send first borrow
+        source->first_borrow_time = time_now();
+        source_send_borrow(source);
+    } else {
+        // If resolving failed, immediately enter error state
+        source->state = ATOLLA_SOURCE_STATE_ERROR;
+        source_fail(source, "Sink hostname could not be resolved.");
+    }
+}
+
+bool atolla_source_resolved(AtollaSource source_handle, const char* sink_address)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    if(!source->resolving)
+    {
+        return false;
+    }
+
+    source->resolving = false;
+
+    if(sink_address == NULL)
+    {
+        source_fail(source, "Sink hostname could not be resolved.");
+    }
+    else
+    {
+        source_connect(source, sink_address);
+    }
+
+    return true;
+}
+
 static void source_await_make_completion(AtollaSourcePrivate* source)
 {
     while(source->state == ATOLLA_SOURCE_STATE_WAITING)
@@ -130,7 +380,35 @@ void atolla_source_free(AtollaSource source_handle)
 {
     AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
 
+    atolla_source_stop_show(source_handle);
+
+    source_send_release(source);
     udp_socket_free(&source->sock);
+    msg_builder_free(&source->builder);
+
+    for(int i = 0; i < source->queue_capacity; ++i)
+    {
+        mem_block_free(&source->queue[i]);
+    }
+    free(source->queue);
+
+    mem_block_free(&source->fec_parity);
+
+    if(source->history != NULL)
+    {
+        for(int i = 0; i < source->max_buffered_frames; ++i)
+        {
+            mem_block_free(&source->history[i].frame);
+        }
+        free(source->history);
+    }
+
+    free(source->timed_pts);
+    mem_block_free(&source->timed_last_frame);
+
+#ifdef ATOLLA_ENABLE_TRACE
+    trace_ring_free(&source->trace);
+#endif
 
     free(source);
 }
@@ -169,18 +447,7 @@ int atolla_source_put_ready_count(AtollaSource source_handle)
     }
     else
     {
-        assert(source->state == ATOLLA_SOURCE_STATE_OPEN);
-
-        if(source->last_frame_time == NULL_TIME)
-        {
-            // If connected, but no frame was enqueued yet, report maximum lag
-            return source->max_buffered_frames;
-        }
-        else
-        {
-            // Otherwise, calculate lag based on the time of the last enqueued frame
-            return (time_now() - source->last_frame_time) / source->frame_duration_ms;
-        }
+        return source_ready_count(source);
     }
 }
 
@@ -203,7 +470,7 @@ int atolla_source_put_ready_timeout(AtollaSource source_handle)
     }
     else
     {
-        int readyCount = (time_now() - source->last_frame_time) / source->frame_duration_ms;
+        int readyCount = source_ready_count(source);
 
         if(readyCount > 0) {
             return 0;
@@ -224,176 +491,1063 @@ bool atolla_source_put(AtollaSource source_handle, void* frame, size_t frame_len
         return false;
     }
 
+    TRACE_RECORD(&source->trace, TRACE_EVENT_PUT, (source->next_frame_idx + source->queue_len) % 256, source->queue_len);
+
     // If the receiving device has no space in the buffer to hold new frames,
-    // wait until the next frame was dequeued in the sink
-    int timeout = atolla_source_put_ready_timeout(source_handle);
-    if(timeout > 0)
+    // wait until the next frame was dequeued in the sink. Frames that were
+    // queued before have to be sent first to preserve their order.
+    bool stalled = false;
+    while(source->queue_len > 0 || source_ready_count(source) == 0)
     {
-        time_sleep(timeout);
+        int timeout = atolla_source_put_ready_timeout(source_handle);
+        if(timeout < 0)
+        {
+            return false;
+        }
+        else if(timeout > 0)
+        {
+            time_sleep(timeout);
+        }
+        else if(stalled)
+        {
+            // The sink has room but sending failed, do not spin on the socket
+            time_sleep(blocked_send_retry_interval);
+        }
+
+        const int queue_len = source->queue_len;
+        source_update(source);
+
+        if(source->state != ATOLLA_SOURCE_STATE_OPEN)
+        {
+            return false;
+        }
+
+        stalled = timeout == 0 && source->queue_len > 0 && source->queue_len == queue_len;
     }
 
-    MemBlock* enqueue_msg = msg_builder_enqueue(&source->builder, source->next_frame_idx, frame, frame_len);
-    UdpSocketResult send_result = udp_socket_send(&source->sock, enqueue_msg->data, enqueue_msg->size);
-    if(send_result.code != UDP_SOCKET_OK)
+    return source_send_frame(source, frame, frame_len);
+}
+
+bool atolla_source_put_timed(AtollaSource source_handle, void* frame, size_t frame_len, unsigned int presentation_time_ms)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    source_update(source);
+
+    if(source->state != ATOLLA_SOURCE_STATE_OPEN)
     {
         return false;
     }
-    else
+
+    if(!source->timed)
     {
-        source->next_frame_idx = (source->next_frame_idx + 1) % 256;
-        
-        if(source->last_frame_time == NULL_TIME)
-        {
-            source->last_frame_time = time_now() - (source->max_buffered_frames - 1) * source->frame_duration_ms;
-        }
-        else
+        // The first frame is due right away, unless the sink follows our clock
+        source->timed = true;
+        source->timed_epoch = source->sync_clock ? 0 : (time_now() - presentation_time_ms);
+        source->timed_pts = (unsigned int*) calloc(source->max_buffered_frames, sizeof(unsigned int));
+        assert(source->timed_pts != NULL);
+    }
+
+    TRACE_RECORD(&source->trace, TRACE_EVENT_PUT, source->next_frame_idx, 0);
+
+    int timeout;
+    while((timeout = source_timed_wait(source, presentation_time_ms)) > 0)
+    {
+        // Wake up at least once per frame duration to keep evaluating reports
+        time_sleep(((unsigned int) timeout < source->frame_duration_ms) ? timeout : source->frame_duration_ms);
+
+        source_update(source);
+
+        if(source->state != ATOLLA_SOURCE_STATE_OPEN)
         {
-            // Otherwise, advance the last frame time, so we get closer to the point where no more
-            // frame can be enqueued
-            source->last_frame_time += source->frame_duration_ms;
+            return false;
         }
-    
-        return true;   
     }
-}
 
-static void source_send_borrow(AtollaSourcePrivate* source)
-{
-    source->last_borrow_time = time_now();
-    MemBlock* borrow_msg = msg_builder_borrow(&source->builder, source->frame_duration_ms, source->max_buffered_frames);
-    udp_socket_send(&source->sock, borrow_msg->data, borrow_msg->size);
+    uint8_t frame_idx = (uint8_t) source->next_frame_idx;
+    if(!source_send_timed(source, frame_idx, presentation_time_ms, frame, frame_len))
+    {
+        return false;
+    }
+
+    source->timed_pts[source->timed_sent_count % source->max_buffered_frames] = presentation_time_ms;
+    ++source->timed_sent_count;
+    if(source->history != NULL)
+    {
+        source->history[frame_idx % source->max_buffered_frames].pts = presentation_time_ms;
+    }
+
+    // Only allocates if no frame this large was put before
+    mem_block_resize(&source->timed_last_frame, frame_len);
+    memcpy(source->timed_last_frame.data, frame, frame_len);
+    source->timed_last_frame_idx = frame_idx;
+
+    source_frame_sent(source, frame, frame_len);
+    return true;
 }
 
-static void source_update(AtollaSourcePrivate* source)
+unsigned int atolla_source_clock_ms(AtollaSource source_handle)
 {
-    source_receive(source);
-    source_manage_borrow_packet_loss(source);
-    source_ensure_lent_resent(source);
+    // All sources share the clock, the handle leaves room for per source clocks
+    (void) source_handle;
+    return time_now();
 }
 
-static void source_receive(AtollaSourcePrivate* source)
+/**
+ * Calculates how many milliseconds to wait before a timed frame with the given
+ * presentation time can be sent without overflowing the buffer of the sink.
+ */
+static int source_timed_wait(AtollaSourcePrivate* source, unsigned int pts)
 {
-    size_t received_len;
-    UdpSocketResult result;
+    const unsigned int session_now = time_now() - source->timed_epoch;
 
-    result = udp_socket_receive(
-        &source->sock,
-        source->recv_buf, recv_buf_len,
-        &received_len,
-        false
-    );
+    // Do not send frames further ahead than the sink buffers
+    int wait = (int) (pts - session_now) - source->max_buffered_frames * (int) source->frame_duration_ms;
 
-    if(result.code == UDP_SOCKET_OK)
+    // Wait for the frame sent max_buffered_frames ago to be shown
+    if(source->timed_sent_count >= (unsigned int) source->max_buffered_frames)
     {
-        source_iterate_recv_buf(source, received_len);
+        unsigned int oldest_pts = source->timed_pts[source->timed_sent_count % source->max_buffered_frames];
+        int oldest_wait = (int) (oldest_pts - session_now);
+        if(oldest_wait > wait)
+        {
+            wait = oldest_wait;
+        }
     }
+
+    return (wait > 0) ? wait : 0;
 }
 
-static void source_manage_borrow_packet_loss(AtollaSourcePrivate* source)
+/**
+ * Sends a timed enqueue message for the frame, without advancing the frame
+ * index.
+ */
+static bool source_send_timed(AtollaSourcePrivate* source, uint8_t frame_idx, unsigned int pts, void* frame, size_t frame_len)
 {
-    if(source->state == ATOLLA_SOURCE_STATE_WAITING)
+    MemBlock* enqueue_header = msg_builder_enqueue_timed_header(&source->builder, frame_idx, pts, frame_len);
+    source_record_sent_msg(source);
+    TRACE_RECORD(&source->trace, TRACE_EVENT_BUILT, frame_idx, 0);
+    UdpPacketPart parts[] = {
+        { enqueue_header->data, enqueue_header->size },
+        { frame, frame_len }
+    };
+    UdpSocketResult send_result = udp_socket_sendv(&source->sock, parts, sizeof(parts) / sizeof(UdpPacketPart));
+    if(send_result.code != UDP_SOCKET_OK)
     {
-        unsigned int now = time_now();
-        unsigned int time_since_first_borrow = now - source->first_borrow_time;
-        unsigned int time_since_last_borrow = now - source->last_borrow_time;
-
-        if(time_since_first_borrow > source->disconnect_timeout_ms)
-        {
-            // If no lent message was received after the disconnect timeout,
-            // enter unrecoverable error state
-            source_fail(source, "Tried to borrow the sink, but the attempt timed out.");
-        }
-        else if(time_since_last_borrow > source->retry_timeout_ms)
-        {
-            // If no lent message was received after the retry timeout, try borrowing again
-            source_send_borrow(source);
-        }
+        return false;
     }
+
+    source->timed_last_send_time = time_now();
+    return true;
 }
 
-static void source_ensure_lent_resent(AtollaSourcePrivate* source)
+/**
+ * Sends the last timed frame again with its original frame index after some
+ * time without sending. Sinks ignore it if they already have it, and it keeps
+ * them from dropping the borrow while the scene stands still.
+ */
+static void source_send_timed_keepalive(AtollaSourcePrivate* source)
 {
-    if(source->state == ATOLLA_SOURCE_STATE_OPEN &&
-       (time_now() - source->last_recv_lent_time) >= source->disconnect_timeout_ms)
+    if(!source->timed ||
+       source->timed_sent_count == 0 ||
+       source->state != ATOLLA_SOURCE_STATE_OPEN ||
+       (time_now() - source->timed_last_send_time) < timed_keepalive_interval)
     {
-        source_fail(source, "The connection to the sink was lost.");
+        return;
     }
+
+    unsigned int last_pts = source->timed_pts[(source->timed_sent_count - 1) % source->max_buffered_frames];
+    source_send_timed(
+        source,
+        source->timed_last_frame_idx,
+        last_pts,
+        source->timed_last_frame.data,
+        source->timed_last_frame.size
+    );
 }
 
-static void source_iterate_recv_buf(AtollaSourcePrivate* source, size_t received_bytes)
+int atolla_source_put_many(AtollaSource source_handle, void* const* frames, const size_t* frame_lens, int frame_count)
 {
-    MsgIter iter = msg_iter_make(source->recv_buf, received_bytes);
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    source_update(source);
+
+    // Queued frames are sent by the update if there is room, if some are left,
+    // the given frames have to wait behind them
+    if(source->state != ATOLLA_SOURCE_STATE_OPEN || source->queue_len > 0)
+    {
+        return 0;
+    }
 
-    for(; msg_iter_has_msg(&iter); msg_iter_next(&iter))
+    int ready_count = source_ready_count(source);
+    int max_frames = (ready_count < frame_count) ? ready_count : frame_count;
+    int sent_count = 0;
+
+    for(int i = 0; i < max_frames; ++i)
     {
-        MsgType type = msg_iter_type(&iter);
+        TRACE_RECORD(&source->trace, TRACE_EVENT_PUT, (source->next_frame_idx + i) % 256, 0);
+    }
 
-        switch(type)
+    while(sent_count < max_frames)
+    {
+        // Views of the next frames, so they can be sent like queued frames
+        MemBlock views[ATOLLA_SOURCE_MAX_COALESCED_FRAMES];
+        int view_count = max_frames - sent_count;
+        if(view_count > max_coalesced_frames)
         {
-            case MSG_TYPE_LENT:
-            {
-                source_lent(source);
-                break;
-            }
+            view_count = max_coalesced_frames;
+        }
 
-            case MSG_TYPE_FAIL:
-            {
-                switch(msg_iter_fail_error_code(&iter))
-                {
-                    case ATOLLA_ERROR_CODE_NOT_BORROWED:
-                        source_fail(source, "The sink signalled that is not currently borrowed by this source.");
-                        break;
+        for(int i = 0; i < view_count; ++i)
+        {
+            views[i] = mem_block_make(frames[sent_count + i], frame_lens[sent_count + i]);
+        }
+
+        int sent_now = source_send_coalesced(source, views, view_count, 0, view_count);
+        if(sent_now == 0)
+        {
+            break;
+        }
+        sent_count += sent_now;
+    }
+
+    return sent_count;
+}
 
-                    case ATOLLA_ERROR_CODE_REQUESTED_BUFFER_TOO_LARGE:
-                        source_fail(source, "The sink does not have enough memory for a frame queue of the requested length.");
-                        break;
+bool atolla_source_put_queued(AtollaSource source_handle, void* frame, size_t frame_len)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    if(source->state == ATOLLA_SOURCE_STATE_ERROR ||
+       source->queue_len == source->queue_capacity)
+    {
+        return false;
+    }
 
-                    case ATOLLA_ERROR_CODE_REQUESTED_FRAME_DURATION_TOO_SHORT:
-                        source_fail(source, "The sink cannot accomodate the reqest for the given frame duration because it is too short. Try a shorter frame duration.");
-                        break;
+    TRACE_RECORD(&source->trace, TRACE_EVENT_PUT, (source->next_frame_idx + source->queue_len) % 256, source->queue_len);
 
-                    case ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE:
-                        source_fail(source, "The sink refused a request to borrow or enqueue because it is currently lent to another source. Try again later, when the other source has stopped transmission.");
-                        break;
+    int back = (source->queue_front + source->queue_len) % source->queue_capacity;
+    MemBlock* slot = &source->queue[back];
 
-                    case ATOLLA_ERROR_CODE_BAD_MSG:
-                        source_fail(source, "The sink signalled that it could not understand a message or that a message contained a not further specified invalid value. This might be due to incompatible versions of the atolla protocol.");
-                        break;
+    // Only allocates if the slot never held a frame this large before
+    mem_block_resize(slot, frame_len);
+    memcpy(slot->data, frame, frame_len);
 
-                    case ATOLLA_ERROR_CODE_TIMEOUT:
-                        source_fail(source, "The sink signalled that it did not receive packets for so long, it deems the connection no longer working. This might be due to bad signal quality or the source failing to enqueue frames for too long.");
-                        break;
+    ++source->queue_len;
 
-                    default:
-                        source_fail(source, "The sink signalled an unrecoverable error state.");
-                        break;
-                }
+    return true;
+}
 
-                
-                break;
-            }
+int atolla_source_queue_length(AtollaSource source_handle)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+    return source->queue_len;
+}
 
-            default:
-            {
-                source_fail(source, "Malformed or unknown message type received from sink. This might be due to incompatible versions of the atolla protocol.");
-                break;
-            }
-        }
-    }
+int atolla_source_queue_capacity(AtollaSource source_handle)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+    return source->queue_capacity;
 }
 
-static void source_lent(AtollaSourcePrivate* source)
+bool atolla_source_stream_show(AtollaSource source_handle, const char* path, bool loop)
 {
-    if(source->state == ATOLLA_SOURCE_STATE_WAITING)
+#ifdef ATOLLA_SHOW_SUPPORTED
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    atolla_source_stop_show(source_handle);
+
+    if(source->state == ATOLLA_SOURCE_STATE_ERROR)
     {
-        source->state = ATOLLA_SOURCE_STATE_OPEN;
-        source->last_frame_time = NULL_TIME;
-        source->last_recv_lent_time = time_now();
+        return false;
     }
-    else if(source->state == ATOLLA_SOURCE_STATE_OPEN)
+
+    ShowReader* show = (ShowReader*) malloc(sizeof(ShowReader));
+    assert(show != NULL);
+
+    // Read frames have to stay valid until sent, at most one datagram full
+    if(!show_reader_open(show, path, max_coalesced_frames))
     {
-        source->last_recv_lent_time = time_now();
+        free(show);
+        return false;
     }
+
+    if(show->frame_duration_ms != source->frame_duration_ms)
+    {
+        show_reader_close(show);
+        free(show);
+        return false;
+    }
+
+    source->show = show;
+    source->show_loop = loop;
+    source->show_pending_front = 0;
+    source->show_pending_len = 0;
+
+    source_send_show(source);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void atolla_source_stop_show(AtollaSource source_handle)
+{
+#ifdef ATOLLA_SHOW_SUPPORTED
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    if(source->show != NULL)
+    {
+        show_reader_close(source->show);
+        free(source->show);
+        source->show = NULL;
+        source->show_pending_len = 0;
+    }
+#endif
+}
+
+int atolla_source_show_frames_left(AtollaSource source_handle)
+{
+#ifdef ATOLLA_SHOW_SUPPORTED
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    if(source->show == NULL || source->state == ATOLLA_SOURCE_STATE_ERROR)
+    {
+        return 0;
+    }
+
+    return (int) (source->show->frame_count - source->show->next_frame) + source->show_pending_len;
+#else
+    return 0;
+#endif
+}
+
+#ifdef ATOLLA_ENABLE_TRACE
+size_t atolla_source_trace_json(AtollaSource source_handle, int pid, const char* process_name, char* buf, size_t buf_len)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+    return trace_ring_json(&source->trace, pid, process_name, buf, buf_len);
+}
+#endif
+
+void atolla_source_stats(AtollaSource source_handle, AtollaSourceStats* stats)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    *stats = source->stats;
+
+    if(source->state == ATOLLA_SOURCE_STATE_OPEN && source->last_frame_time != NULL_TIME)
+    {
+        int since_last_frame = (int) (time_now() - source->last_frame_time);
+        int buffered = source->max_buffered_frames - since_last_frame / (int) source->frame_duration_ms;
+        stats->estimated_buffered_frames = (buffered > 0) ? buffered : 0;
+    }
+    else
+    {
+        stats->estimated_buffered_frames = 0;
+    }
+
+    stats->last_lent_age_ms = (source->state == ATOLLA_SOURCE_STATE_OPEN)
+                                  ? (int) (time_now() - source->last_recv_lent_time)
+                                  : -1;
+
+    stats->queue_position = (source->state == ATOLLA_SOURCE_STATE_WAITING) ? source->queue_position : -1;
+}
+
+/**
+ * Sends as many queued frames as the sink is estimated to have room for.
+ * Frames that are ready at the same time are coalesced into as few datagrams
+ * as possible.
+ */
+static void source_send_queued(AtollaSourcePrivate* source)
+{
+    if(source->state != ATOLLA_SOURCE_STATE_OPEN)
+    {
+        return;
+    }
+
+    while(source->queue_len > 0)
+    {
+        int ready_count = source_ready_count(source);
+        if(ready_count == 0)
+        {
+            break;
+        }
+
+        int max_frames = (ready_count < source->queue_len) ? ready_count : source->queue_len;
+        int sent_count = source_send_coalesced(source, source->queue, source->queue_capacity, source->queue_front, max_frames);
+        if(sent_count == 0)
+        {
+            // Try again with the next update, e.g. if the send buffer is full
+            break;
+        }
+
+        source->queue_front = (source->queue_front + sent_count) % source->queue_capacity;
+        source->queue_len -= sent_count;
+    }
+}
+
+#ifdef ATOLLA_SHOW_SUPPORTED
+/**
+ * Sends as many frames of the streamed show as the sink is estimated to have
+ * room for, after all queued frames were sent. Frames are sent from where the
+ * show keeps them, without copying them first.
+ */
+static void source_send_show(AtollaSourcePrivate* source)
+{
+    if(source->show == NULL ||
+       source->state != ATOLLA_SOURCE_STATE_OPEN ||
+       source->queue_len > 0)
+    {
+        return;
+    }
+
+    while(true)
+    {
+        int ready_count = source_ready_count(source);
+        if(ready_count == 0)
+        {
+            break;
+        }
+
+        if(source->show_pending_len == 0 && source_read_show(source) == 0)
+        {
+            break;
+        }
+
+        int max_frames = (ready_count < source->show_pending_len) ? ready_count : source->show_pending_len;
+        int sent_count = source_send_coalesced(source, source->show_pending, max_coalesced_frames, source->show_pending_front, max_frames);
+        if(sent_count == 0)
+        {
+            // Try again with the next update, e.g. if the send buffer is full
+            break;
+        }
+
+        source->show_pending_front = (source->show_pending_front + sent_count) % max_coalesced_frames;
+        source->show_pending_len -= sent_count;
+    }
+}
+
+/**
+ * Reads as many frames from the show as fit into a datagram, starting over
+ * at the end if looping, and returns how many frames were read.
+ */
+static int source_read_show(AtollaSourcePrivate* source)
+{
+    ShowReader* show = source->show;
+    const size_t frame_len = show->lights_count * 3;
+    const uint8_t* frame;
+
+    source->show_pending_front = 0;
+    source->show_pending_len = 0;
+
+    while(source->show_pending_len < max_coalesced_frames)
+    {
+        if(!show_reader_next(show, &frame))
+        {
+            // Only rewinds once, so empty or broken shows do not loop forever
+            if(!source->show_loop || show->next_frame == 0 || source->show_pending_len > 0)
+            {
+                break;
+            }
+            show_reader_rewind(show);
+            if(!show_reader_next(show, &frame))
+            {
+                break;
+            }
+        }
+
+        source->show_pending[source->show_pending_len] = mem_block_make((void*) frame, frame_len);
+        ++source->show_pending_len;
+
+        if(source->show_pending_len * (MSG_BUILDER_ENQUEUE_HEADER_LEN + frame_len) >= max_datagram_len)
+        {
+            break;
+        }
+    }
+
+    return source->show_pending_len;
+}
+#endif
+
+/**
+ * Sends up to max_frames frames from the ring of frames_capacity frames,
+ * starting at front, in a single datagram, with one enqueue message per frame,
+ * and returns how many frames were sent. The ring itself is not modified.
+ */
+static int source_send_coalesced(AtollaSourcePrivate* source, MemBlock* frames, int frames_capacity, int front, int max_frames)
+{
+    UdpPacketPart parts[2 * ATOLLA_SOURCE_MAX_COALESCED_FRAMES];
+    size_t datagram_len = 0;
+    int frame_count = 0;
+
+    while(frame_count < max_frames && frame_count < max_coalesced_frames)
+    {
+        MemBlock* frame = &frames[(front + frame_count) % frames_capacity];
+        size_t msg_len = MSG_BUILDER_ENQUEUE_HEADER_LEN + frame->size;
+
+        // Always send at least one frame, even if it does not fit on its own
+        if(frame_count > 0 && (datagram_len + msg_len) > max_datagram_len)
+        {
+            break;
+        }
+
+        uint8_t frame_idx = (source->next_frame_idx + frame_count) % 256;
+        MemBlock* header = msg_builder_enqueue_header(&source->builder, frame_idx, frame->size);
+        assert(header->size == MSG_BUILDER_ENQUEUE_HEADER_LEN);
+        source_record_sent_msg(source);
+        TRACE_RECORD(&source->trace, TRACE_EVENT_BUILT, frame_idx, 0);
+        memcpy(source->coalesced_headers[frame_count], header->data, MSG_BUILDER_ENQUEUE_HEADER_LEN);
+
+        parts[2 * frame_count].data = source->coalesced_headers[frame_count];
+        parts[2 * frame_count].size = MSG_BUILDER_ENQUEUE_HEADER_LEN;
+        parts[2 * frame_count + 1].data = frame->data;
+        parts[2 * frame_count + 1].size = frame->size;
+
+        datagram_len += msg_len;
+        ++frame_count;
+    }
+
+    UdpSocketResult send_result = udp_socket_sendv(&source->sock, parts, 2 * frame_count);
+    if(send_result.code != UDP_SOCKET_OK)
+    {
+        return 0;
+    }
+
+    for(int i = 0; i < frame_count; ++i)
+    {
+        MemBlock* frame = &frames[(front + i) % frames_capacity];
+        source_frame_sent(source, frame->data, frame->size);
+    }
+
+    return frame_count;
+}
+
+/**
+ * Sends the given frame to the sink immediately and advances the time of the
+ * last frame.
+ */
+static bool source_send_frame(AtollaSourcePrivate* source, void* frame, size_t frame_len)
+{
+    // Send header and frame as parts of the same packet, so the frame is
+    // only copied once, directly into the kernel
+    MemBlock* enqueue_header = msg_builder_enqueue_header(&source->builder, source->next_frame_idx, frame_len);
+    source_record_sent_msg(source);
+    TRACE_RECORD(&source->trace, TRACE_EVENT_BUILT, source->next_frame_idx, 0);
+    UdpPacketPart parts[] = {
+        { enqueue_header->data, enqueue_header->size },
+        { frame, frame_len }
+    };
+    UdpSocketResult send_result = udp_socket_sendv(&source->sock, parts, sizeof(parts) / sizeof(UdpPacketPart));
+    if(send_result.code != UDP_SOCKET_OK)
+    {
+        return false;
+    }
+    else
+    {
+        source_frame_sent(source, frame, frame_len);
+        return true;
+    }
+}
+
+/**
+ * Remembers a frame that was just sent with the next frame index for error
+ * correction and advances to the next frame.
+ */
+static void source_frame_sent(AtollaSourcePrivate* source, void* frame, size_t frame_len)
+{
+    TRACE_RECORD(&source->trace, TRACE_EVENT_SENT, source->next_frame_idx, 0);
+    source_fec_add(source, source->next_frame_idx, frame, frame_len);
+    source_history_add(source, source->next_frame_idx, frame, frame_len);
+    source_advance_frame(source);
+}
+
+/**
+ * Advances frame index and the time of the last frame after a frame was sent.
+ */
+static void source_advance_frame(AtollaSourcePrivate* source)
+{
+    source->next_frame_idx = (source->next_frame_idx + 1) % 256;
+    ++source->stats.sent_frames;
+
+    if(source->last_frame_time == NULL_TIME)
+    {
+        source->last_frame_time = time_now() - (source->max_buffered_frames - 1) * source->frame_duration_ms;
+    }
+    else
+    {
+        // Otherwise, advance the last frame time, so we get closer to the point where no more
+        // frame can be enqueued
+        source->last_frame_time += source->frame_duration_ms;
+    }
+}
+
+/**
+ * Keeps a copy of a frame that was just sent, if retransmission is enabled.
+ */
+static void source_history_add(AtollaSourcePrivate* source, uint8_t frame_idx, void* frame, size_t frame_len)
+{
+    if(source->history == NULL)
+    {
+        return;
+    }
+
+    SourceSentFrame* entry = &source->history[frame_idx % source->max_buffered_frames];
+    entry->frame_idx = frame_idx;
+    // Only allocates if the entry never held a frame this large before
+    mem_block_resize(&entry->frame, frame_len);
+    memcpy(entry->frame.data, frame, frame_len);
+}
+
+/**
+ * Sends the frames reported as lost in a NACK message again, with their
+ * original frame index, if they are still in the history.
+ */
+static void source_handle_nack(AtollaSourcePrivate* source, const MsgDecodedNack* nack)
+{
+    ++source->stats.received_nacks;
+
+    if(source->history == NULL || source->state != ATOLLA_SOURCE_STATE_OPEN)
+    {
+        return;
+    }
+
+    for(size_t i = 0; i < nack->count; ++i)
+    {
+        uint8_t frame_idx = nack->frame_idxs[i];
+        SourceSentFrame* entry = &source->history[frame_idx % source->max_buffered_frames];
+        if(entry->frame_idx != frame_idx)
+        {
+            // Too old, the sink should have displayed the frame long ago
+            continue;
+        }
+
+        MemBlock* enqueue_header = source->timed ?
+            msg_builder_enqueue_timed_header(&source->builder, frame_idx, entry->pts, entry->frame.size) :
+            msg_builder_enqueue_header(&source->builder, frame_idx, entry->frame.size);
+        source_record_sent_msg(source);
+        UdpPacketPart parts[] = {
+            { enqueue_header->data, enqueue_header->size },
+            { entry->frame.data, entry->frame.size }
+        };
+        UdpSocketResult send_result = udp_socket_sendv(&source->sock, parts, sizeof(parts) / sizeof(UdpPacketPart));
+        if(send_result.code == UDP_SOCKET_OK)
+        {
+            TRACE_RECORD(&source->trace, TRACE_EVENT_RETRANSMITTED, frame_idx, 0);
+            ++source->stats.retransmitted_frames;
+        }
+    }
+}
+
+/**
+ * Answers a sync message of the sink right away with the current time.
+ */
+static void source_handle_sync(AtollaSourcePrivate* source, const MsgDecodedSync* sync)
+{
+    if(!source->sync_clock)
+    {
+        return;
+    }
+
+    MemBlock* sync_msg = msg_builder_sync(&source->builder, sync->ping_time_ms, time_now());
+    source_record_sent_msg(source);
+    udp_socket_send(&source->sock, sync_msg->data, sync_msg->size);
+}
+
+/**
+ * Adds a frame that was just sent to the parity of the current group of
+ * frames, and sends the parity if the group is complete.
+ */
+static void source_fec_add(AtollaSourcePrivate* source, uint8_t frame_idx, void* frame, size_t frame_len)
+{
+    if(source->fec_group_size == 0)
+    {
+        return;
+    }
+
+    if(source->fec_group_len == 0)
+    {
+        mem_block_resize(&source->fec_parity, frame_len);
+        memcpy(source->fec_parity.data, frame, frame_len);
+        source->fec_group_first_frame_idx = frame_idx;
+        source->fec_group_uniform = true;
+    }
+    else if(frame_len != source->fec_parity.size)
+    {
+        // Lost frames could not be reconstructed, do not send parity for this group
+        source->fec_group_uniform = false;
+    }
+    else
+    {
+        uint8_t* parity = (uint8_t*) source->fec_parity.data;
+        const uint8_t* frame_bytes = (const uint8_t*) frame;
+        for(size_t i = 0; i < frame_len; ++i)
+        {
+            parity[i] ^= frame_bytes[i];
+        }
+    }
+
+    ++source->fec_group_len;
+
+    if(source->fec_group_len == source->fec_group_size)
+    {
+        if(source->fec_group_uniform && source->sink_sends_reports)
+        {
+            source_send_parity(source);
+        }
+        source->fec_group_len = 0;
+    }
+}
+
+static void source_send_parity(AtollaSourcePrivate* source)
+{
+    MemBlock* parity_msg = msg_builder_parity(
+        &source->builder,
+        source->fec_group_first_frame_idx,
+        (uint8_t) source->fec_group_size,
+        source->fec_parity.data,
+        source->fec_parity.size
+    );
+    source_record_sent_msg(source);
+    // Parity is redundant, so there is no need to handle failure
+    udp_socket_send(&source->sock, parity_msg->data, parity_msg->size);
+}
+
+/**
+ * Calculates how many frames can be sent to the sink right now without
+ * evaluating incoming packets first.
+ */
+static int source_ready_count(AtollaSourcePrivate* source)
+{
+    assert(source->state == ATOLLA_SOURCE_STATE_OPEN);
+
+    if(source->last_frame_time == NULL_TIME)
+    {
+        // If connected, but no frame was enqueued yet, report maximum lag
+        return source->max_buffered_frames;
+    }
+    else
+    {
+        // Otherwise, calculate lag based on the time of the last enqueued frame,
+        // which might lie in the future after the sink reported a full buffer
+        int since_last_frame = (int) (time_now() - source->last_frame_time);
+        return (since_last_frame > 0) ? (since_last_frame / (int) source->frame_duration_ms) : 0;
+    }
+}
+
+/**
+ * Tells the sink that it can be borrowed by others again, if it was borrowed
+ * or is about to be. Blocks for a few milliseconds between the repetitions.
+ */
+static void source_send_release(AtollaSourcePrivate* source)
+{
+    // Sinks that told the place in line know release messages too
+    const bool sink_understands = source->sink_sends_reports || source->queue_position >= 0;
+    if(source->resolving || !sink_understands ||
+       (source->state != ATOLLA_SOURCE_STATE_OPEN && source->state != ATOLLA_SOURCE_STATE_WAITING))
+    {
+        return;
+    }
+
+    for(int i = 0; i < release_send_count; ++i)
+    {
+        if(i > 0)
+        {
+            time_sleep(release_send_interval);
+        }
+
+        MemBlock* release_msg = msg_builder_release(&source->builder);
+        udp_socket_send(&source->sock, release_msg->data, release_msg->size);
+    }
+}
+
+static void source_send_borrow(AtollaSourcePrivate* source)
+{
+    source->last_borrow_time = time_now();
+    uint8_t flags = (source->history != NULL) ? MSG_BORROW_FLAG_NACK : 0;
+    if(source->sync_clock)
+    {
+        flags |= MSG_BORROW_FLAG_SYNC;
+    }
+    if(source->queue_borrow)
+    {
+        flags |= MSG_BORROW_FLAG_QUEUE;
+    }
+    if(source->handover)
+    {
+        flags |= MSG_BORROW_FLAG_HANDOVER;
+    }
+    MemBlock* borrow_msg = msg_builder_borrow(&source->builder, source->frame_duration_ms, source->max_buffered_frames, flags);
+    source_record_sent_msg(source);
+    udp_socket_send(&source->sock, borrow_msg->data, borrow_msg->size);
+}
+
+static void source_update(AtollaSourcePrivate* source)
+{
+    // The sink cannot be contacted before its address is known
+    if(source->resolving)
+    {
+        return;
+    }
+
+    source_receive(source);
+    source_manage_borrow_packet_loss(source);
+    source_ensure_lent_resent(source);
+    source_send_queued(source);
+#ifdef ATOLLA_SHOW_SUPPORTED
+    source_send_show(source);
+#endif
+    source_send_timed_keepalive(source);
+}
+
+static void source_receive(AtollaSourcePrivate* source)
+{
+    size_t received_len;
+    UdpSocketResult result;
+
+    result = udp_socket_receive(
+        &source->sock,
+        source->recv_buf, recv_buf_len,
+        &received_len,
+        false
+    );
+
+    if(result.code == UDP_SOCKET_OK)
+    {
+        source_iterate_recv_buf(source, received_len);
+    }
+}
+
+static void source_manage_borrow_packet_loss(AtollaSourcePrivate* source)
+{
+    if(source->state == ATOLLA_SOURCE_STATE_WAITING)
+    {
+        unsigned int now = time_now();
+        unsigned int time_since_first_borrow = now - source->first_borrow_time;
+        unsigned int time_since_last_borrow = now - source->last_borrow_time;
+        // While waiting in line, every confirmation of the place in line counts
+        bool queued_recently = source->queue_position >= 0 &&
+                               (now - source->last_recv_queued_time) <= source->disconnect_timeout_ms;
+
+        if(time_since_first_borrow > source->disconnect_timeout_ms && !queued_recently)
+        {
+            // If no lent message was received after the disconnect timeout,
+            // enter unrecoverable error state
+            source_fail(source, "Tried to borrow the sink, but the attempt timed out.");
+        }
+        else if(time_since_last_borrow > source->retry_timeout_ms)
+        {
+            // If no lent message was received after the retry timeout, try borrowing again
+            source_send_borrow(source);
+        }
+    }
+}
+
+static void source_ensure_lent_resent(AtollaSourcePrivate* source)
+{
+    if(source->state == ATOLLA_SOURCE_STATE_OPEN &&
+       (time_now() - source->last_recv_lent_time) >= source->disconnect_timeout_ms)
+    {
+        source_fail(source, "The connection to the sink was lost.");
+    }
+}
+
+static void source_iterate_recv_buf(AtollaSourcePrivate* source, size_t received_bytes)
+{
+    MsgIter iter = msg_iter_make(source->recv_buf, received_bytes);
+    MsgDecoded msg;
+    MsgDecodeResult result;
+
+    while((result = msg_iter_decode(&iter, &msg)) == MSG_DECODE_OK)
+    {
+        switch(msg.type)
+        {
+            case MSG_TYPE_LENT:
+            {
+                source_lent(source);
+                if(source->state == ATOLLA_SOURCE_STATE_OPEN && msg.as.lent.has_report)
+                {
+                    source_handle_report(source, &msg.as.lent);
+                }
+                break;
+            }
+
+            case MSG_TYPE_NACK:
+            {
+                source_handle_nack(source, &msg.as.nack);
+                break;
+            }
+
+            case MSG_TYPE_SYNC:
+            {
+                source_handle_sync(source, &msg.as.sync);
+                break;
+            }
+
+            case MSG_TYPE_QUEUED:
+            {
+                source_handle_queued(source, msg.as.queued.position);
+                break;
+            }
+
+            case MSG_TYPE_FAIL:
+            {
+                source_fail(source, atolla_error_code_msg(msg.as.fail.error_code));
+                break;
+            }
+
+            default:
+            {
+                result = MSG_DECODE_MALFORMED;
+                break;
+            }
+        }
+
+        if(result != MSG_DECODE_OK)
+        {
+            break;
+        }
+    }
+
+    if(result == MSG_DECODE_MALFORMED)
+    {
+        source_fail(source, "Malformed or unknown message type received from sink. This might be due to incompatible versions of the atolla protocol.");
+    }
+}
+
+static void source_lent(AtollaSourcePrivate* source)
+{
+    if(source->state == ATOLLA_SOURCE_STATE_WAITING)
+    {
+        source->state = ATOLLA_SOURCE_STATE_OPEN;
+        source->last_frame_time = NULL_TIME;
+        source->last_recv_lent_time = time_now();
+        source->queue_position = -1;
+    }
+    else if(source->state == ATOLLA_SOURCE_STATE_OPEN)
+    {
+        source->last_recv_lent_time = time_now();
+    }
+}
+
+/**
+ * Remembers the place in line while the sink is lent to another source. Borrow
+ * messages are sent again as usual until the sink lends itself to this source.
+ */
+static void source_handle_queued(AtollaSourcePrivate* source, uint8_t position)
+{
+    if(source->state == ATOLLA_SOURCE_STATE_WAITING)
+    {
+        source->queue_position = position;
+        source->last_recv_queued_time = time_now();
+    }
+}
+
+/**
+ * Evaluates the receiver report attached to a LENT message, updating round
+ * trip time, statistics and the estimated buffer occupancy of the sink.
+ */
+static void source_handle_report(AtollaSourcePrivate* source, const MsgDecodedLent* report)
+{
+    unsigned int now = time_now();
+
+    uint16_t echo_msg_id = report->echo_msg_id;
+    size_t history_idx = echo_msg_id % sent_msg_history_len;
+    if(source->sent_msg_ids[history_idx] == echo_msg_id)
+    {
+        // Time the message spent in the sink is not part of the round trip
+        unsigned int since_sent = now - source->sent_msg_times[history_idx];
+        unsigned int echo_delay = report->echo_delay_ms;
+        int sample = (since_sent > echo_delay) ? (int) (since_sent - echo_delay) : 0;
+
+        // Smoothed like the TCP round trip time in RFC 6298
+        if(source->srtt < 0)
+        {
+            source->srtt = sample * 8;
+        }
+        else
+        {
+            source->srtt += sample - (source->srtt / 8);
+        }
+        source->stats.rtt_ms = source->srtt / 8;
+    }
+
+    uint16_t lost_frames = report->lost_frames;
+    source->stats.sink_lost_frames += (uint16_t) (lost_frames - source->last_report_lost_frames);
+    source->last_report_lost_frames = lost_frames;
+
+    uint8_t played_frame_idx = report->played_frame_idx;
+    source->stats.sink_buffered_frames = report->buffered_frames;
+    source->stats.sink_played_frame_idx = played_frame_idx;
+    source->stats.sink_jitter_ms = report->jitter_ms;
+    ++source->stats.received_reports;
+    source->sink_sends_reports = true;
+
+    source_correct_pacing(source, played_frame_idx);
+}
+
+/**
+ * Moves the time of the last frame towards the time implied by the frame
+ * that the sink reported to have most recently played, so the estimate of
+ * free space in the sink does not drift off due to clock drift or lost frames.
+ */
+static void source_correct_pacing(AtollaSourcePrivate* source, uint8_t played_frame_idx)
+{
+    if(source->last_frame_time == NULL_TIME)
+    {
+        // Nothing sent yet, so there is nothing to correct
+        return;
+    }
+
+    int last_sent_frame_idx = (source->next_frame_idx + 255) % 256;
+    int outstanding = (last_sent_frame_idx - played_frame_idx + 256) % 256;
+    if(outstanding > 128)
+    {
+        // Played frame is ahead of the last sent frame, the report must be
+        // outdated, so ignore it
+        return;
+    }
+
+    unsigned int now = time_now();
+    int frame_duration = source->frame_duration_ms;
+    int one_way_delay = (source->srtt < 0) ? 0 : (source->srtt / 16);
+
+    // Remaining display time of the outstanding frames, assuming the report was
+    // sent half a round trip ago, in the middle of showing the played frame
+    int remaining = outstanding * frame_duration + frame_duration / 2 - one_way_delay;
+    int max_remaining = source->max_buffered_frames * frame_duration;
+    if(remaining < 0) { remaining = 0; }
+
+    // If the sink holds more than max_buffered_frames, e.g. because it stopped
+    // displaying for a while, this lies in the future and pauses sending until
+    // the sink caught up
+    unsigned int reported_last_frame_time = now - max_remaining + remaining;
+    int error = (int) (reported_last_frame_time - source->last_frame_time);
+    int correction = (remaining > max_remaining) ? error : (error / pacing_correction_divisor);
+
+    // Never move the last frame time before the point where the sink would
+    // run empty
+    unsigned int corrected = source->last_frame_time + correction;
+    if((int) (now - corrected) > max_remaining)
+    {
+        corrected = now - max_remaining;
+    }
+
+    source->stats.pacing_correction_ms = (int) (corrected - source->last_frame_time);
+    source->last_frame_time = corrected;
+}
+
+/**
+ * Remembers the send time of the message that was last generated by the
+ * builder, so a later receiver report echoing its ID yields the round trip time.
+ */
+static void source_record_sent_msg(AtollaSourcePrivate* source)
+{
+    uint16_t msg_id = (uint16_t) (source->builder.next_msg_id - 1);
+    size_t history_idx = msg_id % sent_msg_history_len;
+    source->sent_msg_ids[history_idx] = msg_id;
+    source->sent_msg_times[history_idx] = time_now();
 }
 
 static void source_fail(AtollaSourcePrivate* source, const char* error_msg)
@@ -87,6 +87,51 @@ struct AtollaSourceSpec
      * A value of zero lets the implementation pick a default value.
      */
     int disconnect_timeout_ms;
+    /**
+     * Determines how many frames can be held by the source in the queue of
+     * frames passed to atolla_source_put_queued that have not been sent yet.
+     *
+     * A value of zero lets the implementation pick a default value.
+     */
+    int max_queued_frames;
+    /**
+     * Enables forward error correction if greater than zero. After every
+     * fec_group_size frames, the source then additionally sends a parity
+     * message holding the XOR of the frames in the group. If a single frame of
+     * the group gets lost on the way, the sink can reconstruct it from the
+     * other frames and the parity, as long as it has not been displayed yet.
+     *
+     * Smaller groups recover more losses at the cost of more bandwidth, e.g. a
+     * group size of 4 sends 25% more data. Groups should be smaller than
+     * max_buffered_frames, so the frames of a group are still buffered in the
+     * sink when the parity arrives. Parity is only sent for groups of frames of
+     * equal length, and only to sinks that support it.
+     *
+     * A value of zero disables forward error correction. Maximum is 128.
+     */
+    int fec_group_size;
+    /**
+     * If set to true, the source keeps copies of the last max_buffered_frames
+     * frames it sent, and sends them again if the sink reports them as lost
+     * with a NACK message. The sink only asks for frames that are still
+     * waiting for playout, so this works best with a deep buffer that leaves
+     * enough time for a round trip before a lost frame is due.
+     *
+     * If set to false, the sink fills in lost frames with copies of the next
+     * frame, or reconstructs them from parity if fec_group_size is set.
+     */
+    bool retransmit_lost_frames;
+    /**
+     * If set to true, atolla_source_make does not resolve sink_hostname itself,
+     * since resolving may block for a long time. The source is then made in
+     * state ATOLLA_SOURCE_STATE_WAITING without contacting the sink, until the
+     * caller has resolved the hostname, e.g. asynchronously, and passes the
+     * result to atolla_source_resolved. Disconnect timeouts only start after
+     * that.
+     *
+     * Requires async_make to be set to true.
+     */
+    bool defer_resolve;
     /**
      * If set to true, atolla_source_make will not await completion of the
      * borrowing process before returning from atolla_source_make. After returning,
@@ -101,9 +146,121 @@ struct AtollaSourceSpec
      * or ATOLLA_SOURCE_STATE_ERROR.
      */
     bool async_make;
+    /**
+     * If set to true, the sink synchronizes its clock to the clock of the
+     * source, and presentation times passed to atolla_source_put_timed refer
+     * to the clock of the source as returned by atolla_source_clock_ms,
+     * instead of to the first frame.
+     *
+     * Sinks borrowed by sources on the same machine, or on machines with
+     * synchronized clocks, then show frames with the same presentation time
+     * at the same time, in lockstep. Presentation times should lie some frame
+     * durations in the future, so that frames arrive before they are due.
+     */
+    bool sync_clock;
+    /**
+     * If set to true and the sink is lent to another source, the source waits
+     * in line instead of failing with an error. It stays in state
+     * ATOLLA_SOURCE_STATE_WAITING until the other source and the sources
+     * before it in line released the sink or timed out. Without async_make,
+     * atolla_source_make blocks for that long.
+     *
+     * The disconnect timeout only applies to the answers of the sink that
+     * confirm the place in line. If the line is full, the source fails as if
+     * this was false.
+     */
+    bool queue_borrow;
+    /**
+     * If set to true, the source waits in line like with queue_borrow, and
+     * when it is next, frames of the source before it that are still waiting
+     * for playout are played first instead of being dropped. The frames put
+     * right after the source opened fill up the buffer of the sink behind
+     * them, so that playout switches over at a frame boundary without a gap.
+     *
+     * The remaining frames of the other source are played with the frame
+     * duration of this source. Frames of timed sessions and frames before
+     * timed sessions are not handed over.
+     */
+    bool handover;
 };
 typedef struct AtollaSourceSpec AtollaSourceSpec;
 
+/**
+ * Holds statistics about the connection of a source to its sink, as obtained
+ * with atolla_source_stats.
+ *
+ * Values prefixed with sink_ are taken from the most recent receiver report
+ * that the sink attached to its LENT messages. Sinks report their state about
+ * every 500 milliseconds.
+ */
+struct AtollaSourceStats
+{
+    /**
+     * Amount of frames sent to the sink since the source was made.
+     */
+    unsigned int sent_frames;
+    /**
+     * Amount of frames sent again after the sink reported them as lost.
+     */
+    unsigned int retransmitted_frames;
+    /**
+     * Amount of NACK messages received from the sink.
+     */
+    unsigned int received_nacks;
+    /**
+     * Amount of receiver reports received from the sink. If zero, the sink_
+     * values and the round trip time are not known yet.
+     */
+    unsigned int received_reports;
+    /**
+     * Smoothed round trip time between source and sink in milliseconds, or
+     * -1 if not measured yet.
+     */
+    int rtt_ms;
+    /**
+     * Amount of frames that the source estimates to be buffered in the sink
+     * right now, including frames that are still on their way.
+     */
+    int estimated_buffered_frames;
+    /**
+     * Amount of milliseconds by which the most recent receiver report moved
+     * the estimated time of the last frame. Positive values mean that the sink
+     * played frames faster than expected by the source, which will then send
+     * frames earlier to compensate.
+     */
+    int pacing_correction_ms;
+    /**
+     * Amount of frames waiting in the buffer of the sink.
+     */
+    int sink_buffered_frames;
+    /**
+     * Index of the frame most recently taken out of the buffer of the sink for
+     * displaying, or -1 if no report was received yet.
+     */
+    int sink_played_frame_idx;
+    /**
+     * Total amount of frames that never arrived in the sink and were replaced
+     * with copies of the next received frame.
+     */
+    unsigned int sink_lost_frames;
+    /**
+     * Interarrival jitter of frames in milliseconds, as measured by the sink.
+     */
+    int sink_jitter_ms;
+    /**
+     * Milliseconds since the sink last confirmed the borrow with a LENT
+     * message, or -1 if the source is not open. The source fails once this
+     * exceeds disconnect_timeout_ms.
+     */
+    int last_lent_age_ms;
+    /**
+     * Amount of sources before this one in line for the sink with
+     * queue_borrow or handover, or -1 if the source is not waiting in line.
+     */
+    int queue_position;
+};
+typedef struct AtollaSourceStats AtollaSourceStats;
+
 /**
  * Creates a new atolla source using the parameters in the given spec struct.
  *
@@ -118,10 +275,32 @@ typedef struct AtollaSourceSpec AtollaSourceSpec;
  */
 AtollaSource atolla_source_make(const AtollaSourceSpec* spec);
 
+/**
+ * Completes making a source with defer_resolve set, passing the address of
+ * the sink that the caller resolved from sink_hostname as a numeric IPv4 or
+ * IPv6 address string. The source then starts borrowing the sink with the port
+ * from the spec.
+ *
+ * Passing NULL signals that the hostname could not be resolved, the source
+ * then enters ATOLLA_SOURCE_STATE_ERROR.
+ *
+ * Returns false and does nothing if the source was not made with
+ * defer_resolve or was already resolved.
+ */
+bool atolla_source_resolved(AtollaSource source, const char* sink_address);
+
 /**
  * Orderly shuts down the source first and then frees associated resources.
  * The source referenced by the given source handle may not be used again
  * after calling this function unless it is re-initialized with atolla_source_make.
+ *
+ * A borrowed sink is told with a few release messages that it can be borrowed
+ * again right away, which blocks for a few milliseconds. Sinks that predate
+ * release messages are not sent any and are free again after their timeout.
+ * The sink discards frames still waiting for playout, unless the next source
+ * in line set handover, so callers that want them shown should otherwise wait
+ * for max_buffered_frames frame durations before freeing. Sources waiting in
+ * line give up their place.
  */
 void atolla_source_free(AtollaSource source);
 
@@ -183,7 +362,144 @@ int atolla_source_put_ready_timeout(AtollaSource source);
  * If the source is in waiting state, that is, if the sink has not responded
  * to the borrow request from the source yet, this function will return false
  * and not try to enqueue the frame.
+ *
+ * If frames passed to atolla_source_put_queued are still waiting in the queue,
+ * they are sent before the given frame, blocking until the sink has room for
+ * all of them.
  */
 bool atolla_source_put(AtollaSource source, void* frame, size_t frame_len);
 
+/**
+ * Sends up to frame_count frames to the sink at once, where the frame with
+ * index i starts at frames[i] and is frame_lens[i] bytes long. Only as many
+ * frames are sent as the sink has room for right now, with a single state
+ * update and as few datagrams as possible, coalescing frames like queued
+ * frames. The call never blocks.
+ *
+ * Returns the amount of frames sent from the front of the given frames, which
+ * is zero if the source is not open or if frames passed to
+ * atolla_source_put_queued are still waiting to be sent. The remaining frames
+ * can be passed again after atolla_source_put_ready_timeout milliseconds, or
+ * be queued with atolla_source_put_queued.
+ */
+int atolla_source_put_many(AtollaSource source, void* const* frames, const size_t* frame_lens, int frame_count);
+
+/**
+ * Sends the given frame to be shown at the given presentation time, in
+ * milliseconds since an epoch of the caller's choosing, e.g. the position in
+ * an animation. The sink shows frames at their presentation time rather than
+ * one per frame duration and holds the last frame until the next one is due,
+ * so frames only need to be sent when the scene changes. Presentation times
+ * must not decrease from frame to frame.
+ *
+ * The first call shows the frame right away, later frames are shown relative
+ * to it. If sync_clock is set, presentation times instead refer to the clock
+ * returned by atolla_source_clock_ms. The call blocks until the frame is due
+ * in less than max_buffered_frames frame durations, and until the frame sent
+ * max_buffered_frames frames before is due, so the sink has room for it.
+ *
+ * While no new frames are put, the last frame is sent again every now and
+ * then during calls to atolla_source_state and the other functions that
+ * evaluate incoming packets, so that the sink keeps being borrowed and a lost
+ * last frame is repaired. These functions should therefore still be called
+ * regularly during still scenes.
+ *
+ * Frames put with this function should not be mixed with frames passed to
+ * the other put functions or streamed from shows. Returns false if the source
+ * is not in open state or sending failed.
+ */
+bool atolla_source_put_timed(AtollaSource source, void* frame, size_t frame_len, unsigned int presentation_time_ms);
+
+/**
+ * Returns the current time of the clock that presentation times refer to if
+ * sync_clock is set, in milliseconds. The clock is the same for all sources
+ * on a machine.
+ */
+unsigned int atolla_source_clock_ms(AtollaSource source);
+
+/**
+ * Appends a copy of the given frame to the queue of frames owned by the source
+ * and returns immediately, without blocking and without sending anything.
+ *
+ * Queued frames are sent in order during subsequent calls to atolla_source_state,
+ * atolla_source_put_ready_count, atolla_source_put_ready_timeout and
+ * atolla_source_put, as soon as the sink is estimated to have room for them.
+ * The frames are paced at frame_duration_ms intervals from the time the first
+ * frame was sent, so these functions should be called again after the amount of
+ * milliseconds returned by atolla_source_put_ready_timeout for as long as the
+ * queue is not empty. Frames queued while the source is still waiting for the
+ * sink are sent once the sink has been borrowed.
+ *
+ * Returns false if the frame could not be queued, either because the source is
+ * in error state or because the queue already holds max_queued_frames frames.
+ * In the latter case, the caller should retry after the next frame was sent.
+ *
+ * The frames in the queue keep their memory after sending, so queueing frames
+ * of the same size repeatedly does not allocate memory.
+ */
+bool atolla_source_put_queued(AtollaSource source, void* frame, size_t frame_len);
+
+/**
+ * Returns the amount of frames in the queue of the source that have been
+ * passed to atolla_source_put_queued but not sent yet.
+ */
+int atolla_source_queue_length(AtollaSource source);
+
+/**
+ * Returns the maximum amount of frames that the queue of the source can hold.
+ * If atolla_source_queue_length returns this value, atolla_source_put_queued
+ * will refuse additional frames.
+ */
+int atolla_source_queue_capacity(AtollaSource source);
+
+/**
+ * Writes statistics about the connection to the sink into the given struct.
+ *
+ * This function does not evaluate incoming packets, so the statistics reflect
+ * the state as of the last call to any of the other source functions.
+ */
+void atolla_source_stats(AtollaSource source, AtollaSourceStats* stats);
+
+/**
+ * Streams the pre-rendered frames of the show file at path to the sink,
+ * replacing a show that was streamed before. See show/show.h for the format.
+ *
+ * The file is memory mapped and the frames are sent straight from the mapping,
+ * or for delta compressed shows from a few frames decoded in advance, so
+ * streaming does not allocate memory or copy frames per frame. Frames are sent
+ * like frames passed to atolla_source_put_queued, during subsequent calls to
+ * atolla_source_state and the other functions that evaluate incoming packets,
+ * and after all frames that were queued before. If loop is true, the show
+ * starts over after the last frame until atolla_source_stop_show is called.
+ *
+ * Returns false if the source is in error state, if the file could not be read
+ * as a show, if the frame duration of the show differs from the one of the
+ * source, or if shows are not supported on the platform.
+ */
+bool atolla_source_stream_show(AtollaSource source, const char* path, bool loop);
+
+/**
+ * Stops streaming the show and unmaps it, frames that were already sent are
+ * still played by the sink. Also done by atolla_source_free.
+ */
+void atolla_source_stop_show(AtollaSource source);
+
+/**
+ * Returns the amount of frames of the current pass over the streamed show
+ * that have not been sent yet, or zero if no show is streamed or the source
+ * is in error state.
+ */
+int atolla_source_show_frames_left(AtollaSource source);
+
+#ifdef ATOLLA_ENABLE_TRACE
+/**
+ * Writes the most recent events recorded for the frames of this source as
+ * Chrome trace JSON into buf, see trace_ring_json in trace/trace.h for the
+ * format and the meaning of the parameters and return value.
+ *
+ * Only available if compiled with ATOLLA_ENABLE_TRACE.
+ */
+size_t atolla_source_trace_json(AtollaSource source, int pid, const char* process_name, char* buf, size_t buf_len);
+#endif
+
 #endif // ATOLLA_SOURCE_H
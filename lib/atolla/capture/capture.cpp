@@ -0,0 +1,310 @@
+#include "capture.h"
+
+#ifdef ATOLLA_CAPTURE_SUPPORTED
+
+#include "../time/gettime.h"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char capture_magic[8] = { 'A', 'T', 'L', 'C', 'A', 'P', '0', '1' };
+/** Files grow in steps of at least this many bytes, so most appends only copy */
+static const size_t capture_grow_min = 1024 * 1024;
+
+static bool capture_writer_reserve(CaptureWriter* writer, size_t len);
+static uint64_t capture_now_us();
+static void capture_put_u16(uint8_t* at, uint16_t value);
+static void capture_put_u32(uint8_t* at, uint32_t value);
+static void capture_put_u64(uint8_t* at, uint64_t value);
+static uint16_t capture_get_u16(const uint8_t* at);
+static uint32_t capture_get_u32(const uint8_t* at);
+static uint64_t capture_get_u64(const uint8_t* at);
+static size_t capture_align(size_t len);
+
+bool capture_writer_open(CaptureWriter* writer, const char* path, unsigned int lights_count)
+{
+    writer->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    writer->map = NULL;
+    writer->map_len = 0;
+    writer->used_len = 0;
+    writer->start_time_us = capture_now_us();
+
+    if(writer->fd < 0)
+    {
+        return false;
+    }
+
+    if(!capture_writer_reserve(writer, CAPTURE_HEADER_LEN))
+    {
+        close(writer->fd);
+        writer->fd = -1;
+        return false;
+    }
+
+    memcpy(writer->map, capture_magic, sizeof(capture_magic));
+    capture_put_u32(writer->map + 8, lights_count);
+    writer->used_len = CAPTURE_HEADER_LEN;
+    capture_put_u64(writer->map + 16, writer->used_len);
+
+    return true;
+}
+
+bool capture_writer_append(CaptureWriter* writer, const void* datagram, size_t datagram_len, const UdpEndpoint* sender)
+{
+    const size_t record_len = CAPTURE_RECORD_HEADER_LEN + capture_align(datagram_len);
+
+    if(!capture_writer_reserve(writer, writer->used_len + record_len))
+    {
+        return false;
+    }
+
+    uint8_t* record = writer->map + writer->used_len;
+    memset(record, 0, record_len);
+
+    capture_put_u64(record, capture_now_us() - writer->start_time_us);
+    capture_put_u32(record + 8, (uint32_t) datagram_len);
+
+    if(sender->addr.ss_family == AF_INET)
+    {
+        const struct sockaddr_in* in = (const struct sockaddr_in*) &sender->addr;
+        capture_put_u16(record + 12, ntohs(in->sin_port));
+        capture_put_u16(record + 14, 4);
+        memcpy(record + 16, &in->sin_addr, 4);
+    }
+    else if(sender->addr.ss_family == AF_INET6)
+    {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*) &sender->addr;
+        capture_put_u16(record + 12, ntohs(in6->sin6_port));
+        capture_put_u16(record + 14, 6);
+        memcpy(record + 16, &in6->sin6_addr, 16);
+    }
+
+    memcpy(record + CAPTURE_RECORD_HEADER_LEN, datagram, datagram_len);
+
+    // Only now the record becomes part of the capture
+    writer->used_len += record_len;
+    capture_put_u64(writer->map + 16, writer->used_len);
+
+    return true;
+}
+
+void capture_writer_close(CaptureWriter* writer)
+{
+    if(writer->map != NULL)
+    {
+        munmap(writer->map, writer->map_len);
+        writer->map = NULL;
+    }
+
+    if(writer->fd >= 0)
+    {
+        if(ftruncate(writer->fd, (off_t) writer->used_len) != 0)
+        {
+            // Still readable, the header tells where the records end
+        }
+        close(writer->fd);
+        writer->fd = -1;
+    }
+}
+
+bool capture_reader_open(CaptureReader* reader, const char* path)
+{
+    struct stat file_stat;
+
+    reader->map = NULL;
+    reader->map_len = 0;
+    reader->fd = open(path, O_RDONLY);
+    if(reader->fd < 0)
+    {
+        return false;
+    }
+
+    if(fstat(reader->fd, &file_stat) != 0 || file_stat.st_size < CAPTURE_HEADER_LEN)
+    {
+        capture_reader_close(reader);
+        return false;
+    }
+
+    reader->map_len = (size_t) file_stat.st_size;
+    void* map = mmap(NULL, reader->map_len, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if(map == MAP_FAILED)
+    {
+        reader->map_len = 0;
+        capture_reader_close(reader);
+        return false;
+    }
+    reader->map = (const uint8_t*) map;
+
+    if(memcmp(reader->map, capture_magic, sizeof(capture_magic)) != 0)
+    {
+        capture_reader_close(reader);
+        return false;
+    }
+
+    reader->lights_count = capture_get_u32(reader->map + 8);
+    reader->used_len = (size_t) capture_get_u64(reader->map + 16);
+    if(reader->used_len > reader->map_len)
+    {
+        reader->used_len = reader->map_len;
+    }
+    reader->pos = CAPTURE_HEADER_LEN;
+
+    return true;
+}
+
+bool capture_reader_next(CaptureReader* reader, CaptureRecord* record)
+{
+    if(reader->pos + CAPTURE_RECORD_HEADER_LEN > reader->used_len)
+    {
+        return false;
+    }
+
+    const uint8_t* at = reader->map + reader->pos;
+    const size_t datagram_len = capture_get_u32(at + 8);
+    const size_t record_len = CAPTURE_RECORD_HEADER_LEN + capture_align(datagram_len);
+
+    if(record_len > reader->used_len - reader->pos)
+    {
+        return false;
+    }
+
+    record->time_us = capture_get_u64(at);
+    record->datagram = at + CAPTURE_RECORD_HEADER_LEN;
+    record->datagram_len = datagram_len;
+
+    memset(&record->sender, 0, sizeof(record->sender));
+    const uint16_t port = capture_get_u16(at + 12);
+    if(capture_get_u16(at + 14) == 6)
+    {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*) &record->sender.addr;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        memcpy(&in6->sin6_addr, at + 16, 16);
+        record->sender.addr_len = sizeof(struct sockaddr_in6);
+    }
+    else
+    {
+        struct sockaddr_in* in = (struct sockaddr_in*) &record->sender.addr;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        memcpy(&in->sin_addr, at + 16, 4);
+        record->sender.addr_len = sizeof(struct sockaddr_in);
+    }
+
+    reader->pos += record_len;
+    return true;
+}
+
+void capture_reader_rewind(CaptureReader* reader)
+{
+    reader->pos = CAPTURE_HEADER_LEN;
+}
+
+void capture_reader_close(CaptureReader* reader)
+{
+    if(reader->map != NULL)
+    {
+        munmap((void*) reader->map, reader->map_len);
+        reader->map = NULL;
+    }
+
+    if(reader->fd >= 0)
+    {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
+
+/**
+ * Grows file and mapping so that at least len bytes are mapped.
+ */
+static bool capture_writer_reserve(CaptureWriter* writer, size_t len)
+{
+    if(len <= writer->map_len)
+    {
+        return true;
+    }
+
+    size_t new_len = writer->map_len * 2;
+    if(new_len < capture_grow_min)
+    {
+        new_len = capture_grow_min;
+    }
+    while(new_len < len)
+    {
+        new_len *= 2;
+    }
+
+    if(ftruncate(writer->fd, (off_t) new_len) != 0)
+    {
+        return false;
+    }
+
+    void* map = mmap(NULL, new_len, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0);
+    if(map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    if(writer->map != NULL)
+    {
+        munmap(writer->map, writer->map_len);
+    }
+
+    writer->map = (uint8_t*) map;
+    writer->map_len = new_len;
+    return true;
+}
+
+static uint64_t capture_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec) * 1000000 +
+           ts.tv_nsec / 1000;
+}
+
+static void capture_put_u16(uint8_t* at, uint16_t value)
+{
+    at[0] = (uint8_t) value;
+    at[1] = (uint8_t) (value >> 8);
+}
+
+static void capture_put_u32(uint8_t* at, uint32_t value)
+{
+    capture_put_u16(at, (uint16_t) value);
+    capture_put_u16(at + 2, (uint16_t) (value >> 16));
+}
+
+static void capture_put_u64(uint8_t* at, uint64_t value)
+{
+    capture_put_u32(at, (uint32_t) value);
+    capture_put_u32(at + 4, (uint32_t) (value >> 32));
+}
+
+static uint16_t capture_get_u16(const uint8_t* at)
+{
+    return (uint16_t) (at[0] | (at[1] << 8));
+}
+
+static uint32_t capture_get_u32(const uint8_t* at)
+{
+    return capture_get_u16(at) | (((uint32_t) capture_get_u16(at + 2)) << 16);
+}
+
+static uint64_t capture_get_u64(const uint8_t* at)
+{
+    return capture_get_u32(at) | (((uint64_t) capture_get_u32(at + 4)) << 32);
+}
+
+static size_t capture_align(size_t len)
+{
+    return (len + 7) & ~((size_t) 7);
+}
+
+#endif // ATOLLA_CAPTURE_SUPPORTED
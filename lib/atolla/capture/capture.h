@@ -0,0 +1,119 @@
+#ifndef CAPTURE_CAPTURE_H
+#define CAPTURE_CAPTURE_H
+
+#include "../atolla/primitives.h"
+#include "../udp_socket/udp_socket.h"
+
+/**
+ * Captures are files holding received datagrams with their arrival time and
+ * sender, so that traffic seen in the field can be replayed into a sink.
+ *
+ * Files start with a header of capture_header_len bytes:
+ *
+ *    0   8 bytes   magic "ATLCAP01"
+ *    8   u32       lights count of the capturing sink
+ *    12  u32       reserved, zero
+ *    16  u64       length in bytes of header and records written so far
+ *    24  u64       reserved, zero
+ *
+ * followed by records, each starting at a multiple of 8 bytes:
+ *
+ *    0   u64       arrival time in microseconds since the capture started
+ *    8   u32       datagram length
+ *    12  u16       sender port
+ *    14  u16       sender address family, 4 or 6
+ *    16  16 bytes  sender address, IPv4 addresses use the first 4 bytes
+ *    32            datagram, padded with zeros to a multiple of 8 bytes
+ *
+ * All numbers are little endian. Files are written through a memory mapping
+ * that grows as needed, and the length in the header is only advanced after a
+ * record is complete, so a capture cut short by a crash can still be read up
+ * to its last complete record.
+ *
+ * Captures need memory mapped files and are only available if the platform
+ * defines ATOLLA_CAPTURE_SUPPORTED, which is not the case on ESP8266 and
+ * Windows.
+ */
+
+#if !defined(ARDUINO_ARCH_ESP8266) && !defined(_WIN32) && !defined(WIN32)
+    #define ATOLLA_CAPTURE_SUPPORTED
+#endif
+
+#define CAPTURE_HEADER_LEN 32
+#define CAPTURE_RECORD_HEADER_LEN 32
+
+struct CaptureWriter
+{
+    int fd;
+    uint8_t* map;
+    size_t map_len;
+    size_t used_len;
+    uint64_t start_time_us;
+};
+typedef struct CaptureWriter CaptureWriter;
+
+struct CaptureReader
+{
+    int fd;
+    const uint8_t* map;
+    size_t map_len;
+    /** Length of header and complete records according to the header */
+    size_t used_len;
+    size_t pos;
+    unsigned int lights_count;
+};
+typedef struct CaptureReader CaptureReader;
+
+struct CaptureRecord
+{
+    uint64_t time_us;
+    /** Points into the memory mapping of the reader */
+    const uint8_t* datagram;
+    size_t datagram_len;
+    UdpEndpoint sender;
+};
+typedef struct CaptureRecord CaptureRecord;
+
+#ifdef ATOLLA_CAPTURE_SUPPORTED
+
+/**
+ * Creates or truncates the file at path and prepares it for appending records
+ * received by a sink with the given amount of lights. Returns false if the
+ * file could not be created or mapped.
+ */
+bool capture_writer_open(CaptureWriter* writer, const char* path, unsigned int lights_count);
+
+/**
+ * Appends a datagram with the current time and the given sender, growing the
+ * file if needed. Returns false if the file could not be grown, in which case
+ * the record is not written.
+ */
+bool capture_writer_append(CaptureWriter* writer, const void* datagram, size_t datagram_len, const UdpEndpoint* sender);
+
+/**
+ * Unmaps the file and truncates it to the records actually written.
+ */
+void capture_writer_close(CaptureWriter* writer);
+
+/**
+ * Maps the capture at path for reading. Returns false if the file could not
+ * be opened or is not a capture.
+ */
+bool capture_reader_open(CaptureReader* reader, const char* path);
+
+/**
+ * Reads the next record into record and returns true, or returns false after
+ * the last complete record.
+ */
+bool capture_reader_next(CaptureReader* reader, CaptureRecord* record);
+
+/**
+ * Starts reading from the first record again.
+ */
+void capture_reader_rewind(CaptureReader* reader);
+
+void capture_reader_close(CaptureReader* reader);
+
+#endif // ATOLLA_CAPTURE_SUPPORTED
+
+#endif // CAPTURE_CAPTURE_H
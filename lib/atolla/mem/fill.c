@@ -0,0 +1,26 @@
+#include "fill.h"
+
+#include <string.h>
+
+void mem_fill_with_pattern(void* target, size_t target_len, const void* pattern, size_t pattern_len)
+{
+    if(target_len == 0) return;
+    if(pattern_len == 0) return;
+
+    uint8_t* offset_target = (uint8_t*) target;
+
+    while(target_len > 0)
+    {
+        if(pattern_len >= target_len)
+        {
+            memcpy(offset_target, pattern, target_len);
+            target_len = 0;
+        }
+        else
+        {
+            memcpy(offset_target, pattern, pattern_len);
+            offset_target += pattern_len;
+            target_len -= pattern_len;
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef MEM_FILL_H
+#define MEM_FILL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+
+/**
+ * Fills target_len bytes at target with repetitions of the pattern_len bytes
+ * at pattern. The last repetition is cut short if target_len is not a multiple
+ * of pattern_len. Does nothing if either length is zero.
+ */
+void mem_fill_with_pattern(void* target, size_t target_len, const void* pattern, size_t pattern_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_FILL_H
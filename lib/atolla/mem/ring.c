@@ -33,6 +33,19 @@
     return true;
  }
  
+ bool mem_ring_peek_at(MemRing* ring, size_t offset, void** peek_addr, size_t peek_len)
+ {
+    if(ring->len < (offset + peek_len)) {
+        return false;
+    }
+
+    size_t at = (ring->front + offset) % ring->buf.size;
+    MemBlock block = mem_block_slice(&ring->buf, at, peek_len);
+    *peek_addr = block.data;
+
+    return true;
+ }
+ 
  bool mem_ring_dequeue(MemRing* ring, void* out_buf, size_t out_buf_len)
  {
     if(ring->len < out_buf_len) return false;
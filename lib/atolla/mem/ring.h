@@ -40,6 +40,20 @@ bool mem_ring_is_empty(MemRing* ring);
  */
 bool mem_ring_peek(MemRing* ring, void** peek_addr, size_t peek_len);
 
+/**
+ * Like mem_ring_peek, but obtains a reference to peek_len bytes starting at the
+ * given byte offset from the oldest byte in the queue, e.g. to modify an
+ * element that has been enqueued before.
+ *
+ * Note that the capacity has to be a multiple of the peek_len and offset has to
+ * be a multiple of peek_len in order for this function to correctly wrap around
+ * the end of the buffer.
+ *
+ * If the queue holds less than offset + peek_len bytes, returns false, otherwise
+ * true.
+ */
+bool mem_ring_peek_at(MemRing* ring, size_t offset, void** peek_addr, size_t peek_len);
+
 /**
  * Copies the oldest buf_len bytes into the given buffer and discards the data in
  * the queue after copying, making room for enqueuing.
@@ -8,6 +8,19 @@ static const size_t header_len = sizeof(uint8_t)  + // message type
                                  sizeof(uint16_t) + // message ID
                                  sizeof(uint16_t);  // payload size
 
+static const size_t enqueue_header_len = sizeof(uint8_t)  + // message type
+                                         sizeof(uint16_t) + // message ID
+                                         sizeof(uint16_t) + // payload size
+                                         sizeof(uint8_t)  + // frame index
+                                         sizeof(uint16_t);  // frame size
+
+static const size_t enqueue_timed_header_len = sizeof(uint8_t)  + // message type
+                                               sizeof(uint16_t) + // message ID
+                                               sizeof(uint16_t) + // payload size
+                                               sizeof(uint8_t)  + // frame index
+                                               sizeof(uint32_t) + // presentation time
+                                               sizeof(uint16_t);  // frame size
+
 static const size_t max_payload_len = 65535;
 
 static const size_t initial_block_capacity = 32;
@@ -19,6 +32,13 @@ static MemBlock* build(
     size_t payload_len
 );
 
+static MemBlock* build_enqueue_header(
+    MsgBuilder* builder,
+    uint8_t frame_idx,
+    size_t frame_len,
+    size_t msg_buf_len
+);
+
 static void set_uint8(
     MemBlock* msg_buf,
     size_t byte_offset,
@@ -31,6 +51,12 @@ static void set_uint16(
     uint16_t value
 );
 
+static void set_uint32(
+    MemBlock* msg_buf,
+    size_t byte_offset,
+    uint32_t value
+);
+
 static void set_data(
     MemBlock* msg_buf,
     size_t byte_offset,
@@ -77,10 +103,11 @@ static MemBlock* build(
 MemBlock* msg_builder_borrow(
     MsgBuilder* builder,
     uint8_t frame_length,
-    uint8_t buffer_length
+    uint8_t buffer_length,
+    uint8_t flags
 )
 {
-    uint8_t payload[] = { frame_length, buffer_length };
+    uint8_t payload[] = { frame_length, buffer_length, flags };
     size_t payload_len = sizeof(payload) / sizeof(uint8_t);
     return build(builder, MSG_TYPE_BORROW, payload, payload_len);
 }
@@ -92,6 +119,32 @@ MemBlock* msg_builder_lent(
     return build(builder, MSG_TYPE_LENT, NULL, 0);
 }
 
+MemBlock* msg_builder_lent_report(
+    MsgBuilder* builder,
+    uint8_t buffered_frames,
+    uint8_t played_frame_idx,
+    uint16_t lost_frames,
+    uint16_t jitter_ms,
+    uint16_t echo_msg_id,
+    uint16_t echo_delay_ms
+)
+{
+    uint8_t payload[10] = {
+        buffered_frames,
+        played_frame_idx,
+        mem_uint16_byte_low(lost_frames),
+        mem_uint16_byte_high(lost_frames),
+        mem_uint16_byte_low(jitter_ms),
+        mem_uint16_byte_high(jitter_ms),
+        mem_uint16_byte_low(echo_msg_id),
+        mem_uint16_byte_high(echo_msg_id),
+        mem_uint16_byte_low(echo_delay_ms),
+        mem_uint16_byte_high(echo_delay_ms)
+    };
+    const size_t payload_len = sizeof(payload) / sizeof(uint8_t);
+    return build(builder, MSG_TYPE_LENT, payload, payload_len);
+}
+
 MemBlock* msg_builder_enqueue(
     MsgBuilder* builder,
     uint8_t frame_idx,
@@ -99,18 +152,190 @@ MemBlock* msg_builder_enqueue(
     size_t frame_len
 )
 {
-    const size_t frame_idx_len = sizeof(uint8_t);
-    const size_t frame_len_len = sizeof(uint16_t);
-    const size_t payload_len = frame_idx_len + frame_len_len + frame_len;
-    uint8_t payload[payload_len];
-    payload[0] = frame_idx;
-    payload[1] = mem_uint16_byte_low(frame_len);
-    payload[2] = mem_uint16_byte_high(frame_len);
-    
-    void* payload_frame = (void*) &payload[3];
-    memcpy(payload_frame, frame, frame_len);    
+    MemBlock* block = build_enqueue_header(builder, frame_idx, frame_len, enqueue_header_len + frame_len);
+
+    if(frame_len > 0) {
+        void* frame_ptr = ((uint8_t*) block->data) + enqueue_header_len;
+        memcpy(frame_ptr, frame, frame_len);
+    }
+
+    return block;
+}
+
+MemBlock* msg_builder_enqueue_header(
+    MsgBuilder* builder,
+    uint8_t frame_idx,
+    size_t frame_len
+)
+{
+    return build_enqueue_header(builder, frame_idx, frame_len, enqueue_header_len);
+}
+
+/**
+ * Writes the header of an enqueue message for a frame of the given length into
+ * the message buffer after resizing it to msg_buf_len bytes, which leaves room
+ * for the frame to be written by the caller, if desired.
+ */
+static MemBlock* build_enqueue_header(
+    MsgBuilder* builder,
+    uint8_t frame_idx,
+    size_t frame_len,
+    size_t msg_buf_len
+)
+{
+    const size_t payload_len = sizeof(uint8_t) + sizeof(uint16_t) + frame_len;
+    assert(payload_len <= max_payload_len);
+    assert(msg_buf_len >= enqueue_header_len);
+    assert(enqueue_header_len == MSG_BUILDER_ENQUEUE_HEADER_LEN);
+
+    MemBlock* block = &builder->msg_buf;
+
+    mem_block_resize(block, msg_buf_len);
+
+    set_uint8(block, 0, (uint8_t) MSG_TYPE_ENQUEUE);
+    set_uint16(block, 1, builder->next_msg_id++);
+    set_uint16(block, 3, (uint16_t) payload_len);
+    set_uint8(block, 5, frame_idx);
+    set_uint16(block, 6, (uint16_t) frame_len);
+
+    return block;
+}
+
+MemBlock* msg_builder_enqueue_timed_header(
+    MsgBuilder* builder,
+    uint8_t frame_idx,
+    uint32_t presentation_time_ms,
+    size_t frame_len
+)
+{
+    const size_t payload_len = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t) + frame_len;
+    assert(payload_len <= max_payload_len);
+    assert(enqueue_timed_header_len == MSG_BUILDER_ENQUEUE_TIMED_HEADER_LEN);
+
+    MemBlock* block = &builder->msg_buf;
+
+    mem_block_resize(block, enqueue_timed_header_len);
+
+    set_uint8(block, 0, (uint8_t) MSG_TYPE_ENQUEUE_TIMED);
+    set_uint16(block, 1, builder->next_msg_id++);
+    set_uint16(block, 3, (uint16_t) payload_len);
+    set_uint8(block, 5, frame_idx);
+    set_uint32(block, 6, presentation_time_ms);
+    set_uint16(block, 10, (uint16_t) frame_len);
+
+    return block;
+}
+
+MemBlock* msg_builder_parity(
+    MsgBuilder* builder,
+    uint8_t first_frame_idx,
+    uint8_t group_size,
+    void* parity,
+    size_t parity_len
+)
+{
+    const size_t payload_len = sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint16_t) + parity_len;
+    assert(payload_len <= max_payload_len);
+
+    MemBlock* block = &builder->msg_buf;
+
+    mem_block_resize(block, header_len + payload_len);
+
+    set_uint8(block, 0, (uint8_t) MSG_TYPE_PARITY);
+    set_uint16(block, 1, builder->next_msg_id++);
+    set_uint16(block, 3, (uint16_t) payload_len);
+    set_uint8(block, 5, first_frame_idx);
+    set_uint8(block, 6, group_size);
+    set_uint16(block, 7, (uint16_t) parity_len);
+
+    if(parity_len > 0) {
+        void* parity_ptr = ((uint8_t*) block->data) + header_len + 4;
+        memcpy(parity_ptr, parity, parity_len);
+    }
+
+    return block;
+}
+
+MemBlock* msg_builder_nack(
+    MsgBuilder* builder,
+    uint8_t* frame_idxs,
+    size_t frame_idxs_count
+)
+{
+    assert(frame_idxs_count <= 255);
+
+    const size_t payload_len = sizeof(uint8_t) + frame_idxs_count;
+
+    MemBlock* block = &builder->msg_buf;
+
+    mem_block_resize(block, header_len + payload_len);
+
+    set_uint8(block, 0, (uint8_t) MSG_TYPE_NACK);
+    set_uint16(block, 1, builder->next_msg_id++);
+    set_uint16(block, 3, (uint16_t) payload_len);
+    set_uint8(block, 5, (uint8_t) frame_idxs_count);
+
+    if(frame_idxs_count > 0) {
+        void* idxs_ptr = ((uint8_t*) block->data) + header_len + 1;
+        memcpy(idxs_ptr, frame_idxs, frame_idxs_count);
+    }
+
+    return block;
+}
+
+MemBlock* msg_builder_sync(
+    MsgBuilder* builder,
+    uint32_t ping_time_ms,
+    uint32_t pong_time_ms
+)
+{
+    const size_t payload_len = 2 * sizeof(uint32_t);
+
+    MemBlock* block = &builder->msg_buf;
+
+    mem_block_resize(block, header_len + payload_len);
+
+    set_uint8(block, 0, (uint8_t) MSG_TYPE_SYNC);
+    set_uint16(block, 1, builder->next_msg_id++);
+    set_uint16(block, 3, (uint16_t) payload_len);
+    set_uint32(block, 5, ping_time_ms);
+    set_uint32(block, 9, pong_time_ms);
+
+    return block;
+}
+
+MemBlock* msg_builder_release(
+    MsgBuilder* builder
+)
+{
+    MemBlock* block = &builder->msg_buf;
+
+    mem_block_resize(block, header_len);
+
+    set_uint8(block, 0, (uint8_t) MSG_TYPE_RELEASE);
+    set_uint16(block, 1, builder->next_msg_id++);
+    set_uint16(block, 3, 0);
+
+    return block;
+}
+
+MemBlock* msg_builder_queued(
+    MsgBuilder* builder,
+    uint8_t position
+)
+{
+    const size_t payload_len = 1;
+
+    MemBlock* block = &builder->msg_buf;
+
+    mem_block_resize(block, header_len + payload_len);
+
+    set_uint8(block, 0, (uint8_t) MSG_TYPE_QUEUED);
+    set_uint16(block, 1, builder->next_msg_id++);
+    set_uint16(block, 3, (uint16_t) payload_len);
+    set_uint8(block, 5, position);
 
-    return build(builder, MSG_TYPE_ENQUEUE, payload, payload_len);
+    return block;
 }
 
 MemBlock* msg_builder_fail(
@@ -151,6 +376,20 @@ static void set_uint16(
     target[1] = mem_uint16_byte_high(value);
 }
 
+static void set_uint32(
+    MemBlock* block,
+    size_t byte_offset,
+    uint32_t value
+)
+{
+    assert(block->size >= (byte_offset + sizeof(uint32_t)));
+    uint8_t* target = ((uint8_t*) block->data) + byte_offset;
+    target[0] = (uint8_t) value;
+    target[1] = (uint8_t) (value >> 8);
+    target[2] = (uint8_t) (value >> 16);
+    target[3] = (uint8_t) (value >> 24);
+}
+
 static void set_data(
     MemBlock* block,
     size_t byte_offset,
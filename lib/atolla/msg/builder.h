@@ -8,6 +8,16 @@ extern "C" {
 #include "../atolla/primitives.h"
 #include "../mem/block.h"
 
+/**
+ * Size in bytes of the headers generated by msg_builder_enqueue_header.
+ */
+#define MSG_BUILDER_ENQUEUE_HEADER_LEN 8
+
+/**
+ * Size in bytes of the headers generated by msg_builder_enqueue_timed_header.
+ */
+#define MSG_BUILDER_ENQUEUE_TIMED_HEADER_LEN 12
+
 /**
  * Assembles atolla messages in an internal memory block that is managed by the
  * builder.
@@ -48,8 +58,8 @@ void msg_builder_free(
 );
 
 /**
- * Generates and returns a borrow message containing the given frame length and
- * buffer size.
+ * Generates and returns a borrow message containing the given frame length,
+ * buffer size and flags, which are a combination of MsgBorrowFlag values.
  *
  * The returned memory block references internal memory of the message builder
  * and is only valid until the next message generation function is called with
@@ -58,7 +68,8 @@ void msg_builder_free(
 MemBlock* msg_builder_borrow(
     MsgBuilder* builder,
     uint8_t frame_length,
-    uint8_t buffer_length
+    uint8_t buffer_length,
+    uint8_t flags
 );
 
 /**
@@ -72,6 +83,31 @@ MemBlock* msg_builder_lent(
     MsgBuilder* builder
 );
 
+/**
+ * Generates and returns a lent message that additionally carries a receiver
+ * report, telling the source about the state of the sink.
+ *
+ * The report contains the amount of frames currently waiting in the buffer of
+ * the sink, the index of the frame that was most recently taken out of the
+ * buffer for displaying, the total amount of frames that never arrived in the
+ * sink, the interarrival jitter of frames in milliseconds and the ID of the
+ * most recently received message of the source, together with the time in
+ * milliseconds that passed since it was received.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_lent_report(
+    MsgBuilder* builder,
+    uint8_t buffered_frames,
+    uint8_t played_frame_idx,
+    uint16_t lost_frames,
+    uint16_t jitter_ms,
+    uint16_t echo_msg_id,
+    uint16_t echo_delay_ms
+);
+
 /**
  * Generates and returns an enqueue message containing the given frame. Note
  * that the maximum size of a frame is 65535 bytes, which is equivalent to
@@ -88,6 +124,118 @@ MemBlock* msg_builder_enqueue(
     size_t frame_len
 );
 
+/**
+ * Generates and returns only the header of an enqueue message for a frame of
+ * the given length. The complete message consists of the returned header
+ * immediately followed by the frame_len bytes of the frame, e.g. when sending
+ * both as separate parts of the same packet. This way, the frame does not have
+ * to be copied into the builder.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_enqueue_header(
+    MsgBuilder* builder,
+    uint8_t frame_idx,
+    size_t frame_len
+);
+
+/**
+ * Generates and returns only the header of a timed enqueue message for a frame
+ * of the given length, which is like an enqueue message, but additionally
+ * carries the time in milliseconds at which the frame should be presented,
+ * relative to an epoch chosen by the source for the session. Sinks then show
+ * frames at their presentation time instead of one per frame duration.
+ *
+ * The complete message consists of the returned header immediately followed
+ * by the frame_len bytes of the frame.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_enqueue_timed_header(
+    MsgBuilder* builder,
+    uint8_t frame_idx,
+    uint32_t presentation_time_ms,
+    size_t frame_len
+);
+
+/**
+ * Generates and returns a parity message for the group of group_size frames
+ * starting at first_frame_idx. The parity is the bytewise XOR of all frames in
+ * the group, which must all have a length of parity_len bytes. A sink can use
+ * it to reconstruct a single frame of the group that it did not receive.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_parity(
+    MsgBuilder* builder,
+    uint8_t first_frame_idx,
+    uint8_t group_size,
+    void* parity,
+    size_t parity_len
+);
+
+/**
+ * Generates and returns a nack message, asking the source to send the frames
+ * with the given indexes again. At most 255 frame indexes can be sent with a
+ * single message.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_nack(
+    MsgBuilder* builder,
+    uint8_t* frame_idxs,
+    size_t frame_idxs_count
+);
+
+/**
+ * Generates and returns a sync message for estimating the offset between the
+ * clocks of a sink and a source. Sinks send it with their current time in
+ * ping_time_ms and zero in pong_time_ms, sources answer right away with the
+ * ping time echoed back and their own current time in pong_time_ms.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_sync(
+    MsgBuilder* builder,
+    uint32_t ping_time_ms,
+    uint32_t pong_time_ms
+);
+
+/**
+ * Generates and returns a release message, which a source sends when it is
+ * done with a sink, so that the sink can be borrowed again right away.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_release(
+    MsgBuilder* builder
+);
+
+/**
+ * Generates and returns a queued message, which a sink sends in response to
+ * a borrow message with MSG_BORROW_FLAG_QUEUE while it is lent to another
+ * source. The position in line is zero for the source that is next.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_queued(
+    MsgBuilder* builder,
+    uint8_t position
+);
 
 /**
  * Generates and returns a fail message with the given causing message ID and
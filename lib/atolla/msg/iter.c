@@ -1,10 +1,12 @@
 #include "iter.h"
-#include "../test/assert.h"
-#include "../mem/uint16le.h"
 #include <string.h>
 
-static MemBlock msg_iter_payload(MsgIter* iter);
-static uint16_t msg_iter_payload_length(MsgIter* iter);
+static uint16_t read_uint16(const uint8_t* bytes);
+static uint32_t read_uint32(const uint8_t* bytes);
+static bool decode_payload(MsgDecoded* msg, const uint8_t* payload, size_t payload_len);
+
+static const size_t header_len = 5;
+static const size_t lent_report_len = 10;
 
 MsgIter msg_iter_make(
     void* msg_buffer,
@@ -24,101 +26,141 @@ bool msg_iter_has_msg(MsgIter* iter)
     return iter->msg_buf_start < iter->msg_buf_end;
 }
 
-void msg_iter_next(MsgIter* iter)
+MsgDecodeResult msg_iter_decode(MsgIter* iter, MsgDecoded* msg)
 {
-    assert(msg_iter_has_msg(iter));
-
-    size_t msg_len = 5 + msg_iter_payload_length(iter);
-    iter->msg_buf_start += msg_len;
+    if(!msg_iter_has_msg(iter))
+    {
+        return MSG_DECODE_END;
+    }
+
+    const uint8_t* start = iter->msg_buf_start;
+    const size_t remaining = iter->msg_buf_end - iter->msg_buf_start;
+
+    if(remaining < header_len)
+    {
+        iter->msg_buf_start = iter->msg_buf_end;
+        return MSG_DECODE_MALFORMED;
+    }
+
+    const size_t payload_len = read_uint16(start + 3);
+    if(payload_len > remaining - header_len)
+    {
+        iter->msg_buf_start = iter->msg_buf_end;
+        return MSG_DECODE_MALFORMED;
+    }
+
+    msg->type = (MsgType) start[0];
+    msg->msg_id = read_uint16(start + 1);
+
+    if(!decode_payload(msg, start + header_len, payload_len))
+    {
+        iter->msg_buf_start = iter->msg_buf_end;
+        return MSG_DECODE_MALFORMED;
+    }
+
+    iter->msg_buf_start += header_len + payload_len;
+    return MSG_DECODE_OK;
 }
 
-MsgType msg_iter_type(MsgIter* iter)
+/**
+ * Reads the fields of the payload for the type already set in msg and returns
+ * false if the payload is too short for the type.
+ */
+static bool decode_payload(MsgDecoded* msg, const uint8_t* payload, size_t payload_len)
 {
-    assert(msg_iter_has_msg(iter));
-
-    uint8_t msg_type_byte = iter->msg_buf_start[0];
-    assert((msg_type_byte >= 0 && msg_type_byte <= 2) || msg_type_byte == 255);
-    return (MsgType) msg_type_byte;
+    switch(msg->type)
+    {
+        case MSG_TYPE_BORROW:
+            if(payload_len < 2) { return false; }
+            msg->as.borrow.frame_length_ms = payload[0];
+            msg->as.borrow.buffer_length = payload[1];
+            msg->as.borrow.flags = (payload_len >= 3) ? payload[2] : 0;
+            return true;
+
+        case MSG_TYPE_LENT:
+            memset(&msg->as.lent, 0, sizeof(msg->as.lent));
+            // Sinks that predate reports send empty LENT messages
+            if(payload_len >= lent_report_len)
+            {
+                msg->as.lent.has_report = true;
+                msg->as.lent.buffered_frames = payload[0];
+                msg->as.lent.played_frame_idx = payload[1];
+                msg->as.lent.lost_frames = read_uint16(payload + 2);
+                msg->as.lent.jitter_ms = read_uint16(payload + 4);
+                msg->as.lent.echo_msg_id = read_uint16(payload + 6);
+                msg->as.lent.echo_delay_ms = read_uint16(payload + 8);
+            }
+            return true;
+
+        case MSG_TYPE_ENQUEUE:
+            // Frame index followed by the frame length, which has to agree
+            // with the payload length
+            if(payload_len < 3 || read_uint16(payload + 1) != payload_len - 3) { return false; }
+            msg->as.enqueue.frame_idx = payload[0];
+            msg->as.enqueue.presentation_time_ms = 0;
+            msg->as.enqueue.frame = mem_block_make((void*) (payload + 3), payload_len - 3);
+            return true;
+
+        case MSG_TYPE_ENQUEUE_TIMED:
+            // Like ENQUEUE, with the presentation time after the frame index
+            if(payload_len < 7 || read_uint16(payload + 5) != payload_len - 7) { return false; }
+            msg->as.enqueue.frame_idx = payload[0];
+            msg->as.enqueue.presentation_time_ms = read_uint32(payload + 1);
+            msg->as.enqueue.frame = mem_block_make((void*) (payload + 7), payload_len - 7);
+            return true;
+
+        case MSG_TYPE_PARITY:
+            // First frame index, group size and the parity length
+            if(payload_len < 4 || read_uint16(payload + 2) != payload_len - 4) { return false; }
+            msg->as.parity.first_frame_idx = payload[0];
+            msg->as.parity.group_size = payload[1];
+            msg->as.parity.data = mem_block_make((void*) (payload + 4), payload_len - 4);
+            return true;
+
+        case MSG_TYPE_NACK:
+        {
+            if(payload_len < 1) { return false; }
+            // Do not trust the count if the message is shorter than announced
+            size_t count = payload[0];
+            msg->as.nack.count = (uint8_t) ((count < payload_len) ? count : payload_len - 1);
+            msg->as.nack.frame_idxs = payload + 1;
+            return true;
+        }
+
+        case MSG_TYPE_SYNC:
+            if(payload_len < 8) { return false; }
+            msg->as.sync.ping_time_ms = read_uint32(payload);
+            msg->as.sync.pong_time_ms = read_uint32(payload + 4);
+            return true;
+
+        case MSG_TYPE_RELEASE:
+            // No payload
+            return true;
+
+        case MSG_TYPE_QUEUED:
+            if(payload_len < 1) { return false; }
+            msg->as.queued.position = payload[0];
+            return true;
+
+        case MSG_TYPE_FAIL:
+            if(payload_len < 3) { return false; }
+            msg->as.fail.offending_msg_id = read_uint16(payload);
+            msg->as.fail.error_code = payload[2];
+            return true;
+
+        default:
+            // Unknown to this version, but well formed enough to skip
+            return true;
+    }
 }
 
-uint16_t msg_iter_msg_id(MsgIter* iter)
+static uint16_t read_uint16(const uint8_t* bytes)
 {
-    assert(msg_iter_has_msg(iter));
-
-    uint16_t msg_id;
-    memcpy(&msg_id, iter->msg_buf_start + 1, 2);
-
-    return mem_uint16le_from(msg_id);
-}
-
-static uint16_t msg_iter_payload_length(MsgIter* iter)
-{
-    assert(msg_iter_has_msg(iter));
-
-    uint16_t payload_length;
-    memcpy(&payload_length, iter->msg_buf_start + 3, 2);
-
-    return mem_uint16le_from(payload_length);
-}
-
-static MemBlock msg_iter_payload(MsgIter* iter)
-{
-    assert(msg_iter_has_msg(iter));
-
-    uint16_t payload_len;
-    memcpy(&payload_len, iter->msg_buf_start + 3, 2);
-    payload_len = mem_uint16le_from(payload_len);
-
-    void* payload = iter->msg_buf_start + 5;
-
-    return mem_block_make(payload, payload_len);
-}
-
-uint8_t msg_iter_borrow_frame_length(MsgIter* iter)
-{
-    assert(msg_iter_type(iter) == MSG_TYPE_BORROW);
-    MemBlock payload = msg_iter_payload(iter);
-    return ((uint8_t*) payload.data)[0];
-}
-
-uint8_t msg_iter_borrow_buffer_length(MsgIter* iter)
-{
-    assert(msg_iter_type(iter) == MSG_TYPE_BORROW);
-    MemBlock payload = msg_iter_payload(iter);
-    return ((uint8_t*) payload.data)[1];
-}
-
-uint8_t msg_iter_enqueue_frame_idx(MsgIter* iter)
-{
-    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE);
-    MemBlock payload = msg_iter_payload(iter);
-    return ((uint8_t*) payload.data)[0];
-}
-
-MemBlock msg_iter_enqueue_frame(MsgIter* iter)
-{
-    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE);
-    MemBlock payload = msg_iter_payload(iter);
-    return mem_block_slice(&payload, 3, payload.size-3);
-}
-
-uint16_t msg_iter_fail_offending_msg_id(MsgIter* iter)
-{
-    assert(msg_iter_type(iter) == MSG_TYPE_FAIL);
-    MemBlock payload = msg_iter_payload(iter);
-
-    uint16_t offending_msg_id;
-    memcpy(&offending_msg_id, payload.data, 2);
-    offending_msg_id = mem_uint16le_from(offending_msg_id);
-
-    return offending_msg_id;
+    // Little endian regardless of the platform, and without alignment
+    return (uint16_t) (bytes[0] | (bytes[1] << 8));
 }
 
-uint8_t msg_iter_fail_error_code(MsgIter* iter)
+static uint32_t read_uint32(const uint8_t* bytes)
 {
-    assert(msg_iter_type(iter) == MSG_TYPE_FAIL);
-    MemBlock payload = msg_iter_payload(iter);
-    uint16_t* offending_msg_id_ptr = (uint16_t*) payload.data;
-    uint8_t* error_code_ptr = (uint8_t*) (offending_msg_id_ptr + 1);
-    return *error_code_ptr;
+    return ((uint32_t) read_uint16(bytes)) | (((uint32_t) read_uint16(bytes + 2)) << 16);
 }
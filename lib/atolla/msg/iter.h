@@ -14,10 +14,8 @@ extern "C" {
  * An instance is typically created with assigning the return value of
  * msg_iter_make.
  *
- * To select the next message use the msg_iter_next function. If it is called
- * after reading the last message or if the buffer was empty to begin with,
- * all functions other than msg_iter_has_msg have undefined behavior, though
- * protected with asserts in debug builds.
+ * Messages are read with msg_iter_decode, which moves the iterator to the
+ * next message.
  */
 struct MsgIter
 {
@@ -26,117 +24,152 @@ struct MsgIter
 };
 typedef struct MsgIter MsgIter;
 
-/**
- * Returns a newly initialized message iterator currently pointing to the first
- * message in the buffer.
- */
-MsgIter msg_iter_make(
-    void* msg_buffer,
-    size_t msg_buffer_size
-);
+enum MsgDecodeResult
+{
+    /** A message was decoded */
+    MSG_DECODE_OK,
+    /** There are no more messages in the buffer */
+    MSG_DECODE_END,
+    /**
+     * The rest of the buffer does not hold a valid message, e.g. because the
+     * datagram was truncated or its header announces more payload than there
+     * is, or the payload is too short for the message type
+     */
+    MSG_DECODE_MALFORMED
+};
+typedef enum MsgDecodeResult MsgDecodeResult;
 
-/**
- * Checks whether the iterator currently points to a message.
- *
- * The iterator does not point to a message if either the buffer was empty to
- * begin with or if msg_iter_next has been called after the last message in the
- * buffer.
- */
-bool msg_iter_has_msg(MsgIter* iter);
+struct MsgDecodedBorrow
+{
+    uint8_t frame_length_ms;
+    uint8_t buffer_length;
+    /** Zero if sent by a source that predates flags */
+    uint8_t flags;
+};
+typedef struct MsgDecodedBorrow MsgDecodedBorrow;
 
-/**
- * Selects the next message in the buffer. This function should not be called
- * if msg_iter_has_msg has already returned false.
- */
-void msg_iter_next(MsgIter* iter);
+struct MsgDecodedLent
+{
+    /** If false, all other fields are zero */
+    bool has_report;
+    uint8_t buffered_frames;
+    uint8_t played_frame_idx;
+    uint16_t lost_frames;
+    uint16_t jitter_ms;
+    uint16_t echo_msg_id;
+    uint16_t echo_delay_ms;
+};
+typedef struct MsgDecodedLent MsgDecodedLent;
 
-/**
- * Returns the message type of the currently selected message.
- *
- * If the iterator is already at the end of the buffer, the behavior of this
- * function is undefined. Do not call it with an iterator if msg_iter_has_msg
- * returns false.
- */
-MsgType msg_iter_type(MsgIter* iter);
+struct MsgDecodedEnqueue
+{
+    uint8_t frame_idx;
+    /** Set for ENQUEUE_TIMED messages, zero for ENQUEUE messages */
+    uint32_t presentation_time_ms;
+    /** Points into the decoded buffer */
+    MemBlock frame;
+};
+typedef struct MsgDecodedEnqueue MsgDecodedEnqueue;
 
-/**
- * Gets the message ID of the currently selected message in native byte order.
- *
- * If the iterator is already at the end of the buffer, the behavior of this
- * function is undefined. Do not call it with an iterator if msg_iter_has_msg
- * returns false.
- */
-uint16_t msg_iter_msg_id(MsgIter* iter);
+struct MsgDecodedParity
+{
+    uint8_t first_frame_idx;
+    uint8_t group_size;
+    /** Points into the decoded buffer */
+    MemBlock data;
+};
+typedef struct MsgDecodedParity MsgDecodedParity;
 
-/**
- * Get the frame length of a currently selected BORROW message.
- *
- * If the iterator is already at the end of the buffer, or if the currently
- * selected message has a type different from MSG_TYPE_BORROW, the behavior of
- * this function is undefined. Do not call it with an iterator if
- * msg_iter_has_msg returns false or if msg_iter_type returns a type different
- * from MSG_TYPE_BORROW.
- */
-uint8_t msg_iter_borrow_frame_length(MsgIter* iter);
+struct MsgDecodedNack
+{
+    /** Never more than the frame indexes actually contained in the message */
+    uint8_t count;
+    /** Points into the decoded buffer */
+    const uint8_t* frame_idxs;
+};
+typedef struct MsgDecodedNack MsgDecodedNack;
 
-/**
- * Get the buffer length of a currently selected BORROW message. If no message is
- * selected or if the currently selected message has a different type, the
- * behavior of this function is undefined.
- *
- * If the iterator is already at the end of the buffer, or if the currently
- * selected message has a type different from MSG_TYPE_BORROW, the behavior of
- * this function is undefined. Do not call it with an iterator if
- * msg_iter_has_msg returns false or if msg_iter_type returns a type different
- * from MSG_TYPE_BORROW.
- */
-uint8_t msg_iter_borrow_buffer_length(MsgIter* iter);
+struct MsgDecodedSync
+{
+    /** Clock of the sink when it sent the ping */
+    uint32_t ping_time_ms;
+    /** Clock of the source when it answered, zero in pings */
+    uint32_t pong_time_ms;
+};
+typedef struct MsgDecodedSync MsgDecodedSync;
+
+struct MsgDecodedQueued
+{
+    /** Zero for the source that borrows the sink next */
+    uint8_t position;
+};
+typedef struct MsgDecodedQueued MsgDecodedQueued;
+
+struct MsgDecodedFail
+{
+    uint16_t offending_msg_id;
+    uint8_t error_code;
+};
+typedef struct MsgDecodedFail MsgDecodedFail;
 
 /**
- * Get the contained frame index of a currently selected ENQUEUE message.
+ * A message with its header and payload parsed into fields. Only the member
+ * matching the type is set.
  *
- * If the iterator is already at the end of the buffer, or if the currently
- * selected message has a type different from MSG_TYPE_ENQUEUE, the behavior of
- * this function is undefined. Do not call it with an iterator if
- * msg_iter_has_msg returns false or if msg_iter_type returns a type different
- * from MSG_TYPE_ENQUEUE.
+ * Messages of types unknown to this version of the protocol are decoded with
+ * their type byte in type and only the header set, so that callers can skip
+ * or reject them.
  */
-uint8_t msg_iter_enqueue_frame_idx(MsgIter* iter);
+struct MsgDecoded
+{
+    MsgType type;
+    uint16_t msg_id;
+    union
+    {
+        MsgDecodedBorrow borrow;
+        MsgDecodedLent lent;
+        /** Set for both ENQUEUE and ENQUEUE_TIMED messages */
+        MsgDecodedEnqueue enqueue;
+        MsgDecodedParity parity;
+        MsgDecodedNack nack;
+        MsgDecodedSync sync;
+        MsgDecodedQueued queued;
+        MsgDecodedFail fail;
+    } as;
+};
+typedef struct MsgDecoded MsgDecoded;
 
 /**
- * Get the contained frame of a currently selected ENQUEUE message.
- *
- * If the iterator is already at the end of the buffer, or if the currently
- * selected message has a type different from MSG_TYPE_ENQUEUE, the behavior of
- * this function is undefined. Do not call it with an iterator if
- * msg_iter_has_msg returns false or if msg_iter_type returns a type different
- * from MSG_TYPE_ENQUEUE.
+ * Returns a newly initialized message iterator currently pointing to the first
+ * message in the given buffer, if any.
  */
-MemBlock msg_iter_enqueue_frame(MsgIter* iter);
+MsgIter msg_iter_make(
+    void* msg_buffer,
+    size_t msg_buffer_size
+);
 
 /**
- * Get a previously sent message ID that a currently selected FAIL message
- * refers to.
- *
- * If the iterator is already at the end of the buffer, or if the currently
- * selected message has a type different from MSG_TYPE_FAIL, the behavior of
- * this function is undefined. Do not call it with an iterator if
- * msg_iter_has_msg returns false or if msg_iter_type returns a type different
- * from MSG_TYPE_FAIL.
+ * Checks whether there are bytes left that could hold another message.
  */
-uint16_t msg_iter_fail_offending_msg_id(MsgIter* iter);
+bool msg_iter_has_msg(MsgIter* iter);
 
 /**
- * Get an error code specifying which type of error occurred, that caused the
- * currently selected FAIL message to be sent.
+ * Parses the header and payload of the current message in a single pass into
+ * msg and moves the iterator to the next message.
+ *
+ * Before reading anything, the header and the announced payload length are
+ * checked against the end of the buffer, and the payload length against the
+ * minimum for the message type. If the checks fail, MSG_DECODE_MALFORMED is
+ * returned and the iterator is moved to the end, since the boundaries of any
+ * following messages cannot be trusted either. Otherwise, MSG_DECODE_OK is
+ * returned, or MSG_DECODE_END if there were no more messages.
+ *
+ * Decoding a buffer is therefore typically done with:
  *
- * If the iterator is already at the end of the buffer, or if the currently
- * selected message has a type different from MSG_TYPE_FAIL, the behavior of
- * this function is undefined. Do not call it with an iterator if
- * msg_iter_has_msg returns false or if msg_iter_type returns a type different
- * from MSG_TYPE_FAIL.
+ *    MsgDecoded msg;
+ *    while(msg_iter_decode(&iter, &msg) == MSG_DECODE_OK) { ... }
  */
-uint8_t msg_iter_fail_error_code(MsgIter* iter);
+MsgDecodeResult msg_iter_decode(MsgIter* iter, MsgDecoded* msg);
 
 #ifdef __cplusplus
 }
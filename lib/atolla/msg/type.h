@@ -6,8 +6,41 @@ enum MsgType
     MSG_TYPE_BORROW = 0,
     MSG_TYPE_LENT = 1,
     MSG_TYPE_ENQUEUE = 2,
+    MSG_TYPE_PARITY = 3,
+    MSG_TYPE_NACK = 4,
+    MSG_TYPE_ENQUEUE_TIMED = 5,
+    MSG_TYPE_SYNC = 6,
+    MSG_TYPE_RELEASE = 7,
+    MSG_TYPE_QUEUED = 8,
     MSG_TYPE_FAIL = 255
 };
 typedef enum MsgType MsgType;
 
+/**
+ * Flags that a source can set in the BORROW message to announce optional
+ * protocol features it understands.
+ */
+enum MsgBorrowFlag
+{
+    /** The source accepts NACK messages and retransmits lost frames */
+    MSG_BORROW_FLAG_NACK = 1,
+    /**
+     * The source answers SYNC messages and the presentation times of its
+     * timed frames refer to its own clock
+     */
+    MSG_BORROW_FLAG_SYNC = 2,
+    /**
+     * Rather than failing while the sink is lent to another source, the
+     * source waits in line and is told its position with QUEUED messages
+     */
+    MSG_BORROW_FLAG_QUEUE = 4,
+    /**
+     * When the source is next in line, frames of the source before that are
+     * still waiting for playout are played before its own frames rather than
+     * being dropped. Only has an effect with MSG_BORROW_FLAG_QUEUE.
+     */
+    MSG_BORROW_FLAG_HANDOVER = 8
+};
+typedef enum MsgBorrowFlag MsgBorrowFlag;
+
 #endif // MSG_TYPE_H
@@ -0,0 +1,335 @@
+#include "show.h"
+
+#ifdef ATOLLA_SHOW_SUPPORTED
+
+#include "../test/assert.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char show_magic[8] = { 'A', 'T', 'L', 'S', 'H', 'O', 'W', '1' };
+static const size_t show_span_header_len = 8;
+/**
+ * Unchanged bytes between changed bytes are written as part of a single span
+ * if there are no more than this many, since a new span costs that much too.
+ */
+static const size_t show_span_gap = 8;
+
+static size_t show_next_span(const uint8_t* frame, const uint8_t* last_frame, size_t frame_len, size_t from, size_t* span_len);
+static bool show_put_u32(FILE* file, uint32_t value);
+static uint32_t show_get_u32(const uint8_t* at);
+
+bool show_reader_open(ShowReader* reader, const char* path, unsigned int keep_frames)
+{
+    struct stat file_stat;
+
+    memset(reader, 0, sizeof(ShowReader));
+    reader->fd = open(path, O_RDONLY);
+    if(reader->fd < 0)
+    {
+        return false;
+    }
+
+    if(fstat(reader->fd, &file_stat) != 0 || file_stat.st_size < SHOW_HEADER_LEN)
+    {
+        show_reader_close(reader);
+        return false;
+    }
+
+    reader->map_len = (size_t) file_stat.st_size;
+    void* map = mmap(NULL, reader->map_len, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if(map == MAP_FAILED)
+    {
+        reader->map_len = 0;
+        show_reader_close(reader);
+        return false;
+    }
+    reader->map = (const uint8_t*) map;
+
+    reader->lights_count = show_get_u32(reader->map + 8);
+    reader->frame_duration_ms = show_get_u32(reader->map + 12);
+    reader->frame_count = show_get_u32(reader->map + 16);
+    reader->flags = show_get_u32(reader->map + 20);
+
+    if(memcmp(reader->map, show_magic, sizeof(show_magic)) != 0 || reader->lights_count == 0)
+    {
+        show_reader_close(reader);
+        return false;
+    }
+
+    const size_t frame_len = reader->lights_count * 3;
+    if(reader->flags & SHOW_FLAG_DELTA)
+    {
+        reader->decoded_count = (keep_frames > 0) ? (keep_frames + 1) : 1;
+        reader->decoded = (uint8_t*) malloc(reader->decoded_count * frame_len);
+        assert(reader->decoded != NULL);
+    }
+    else
+    {
+        // Only play the frames that made it into the file
+        size_t complete_frames = (reader->map_len - SHOW_HEADER_LEN) / frame_len;
+        if(reader->frame_count > complete_frames)
+        {
+            reader->frame_count = (unsigned int) complete_frames;
+        }
+    }
+
+    show_reader_rewind(reader);
+
+    return true;
+}
+
+bool show_reader_next(ShowReader* reader, const uint8_t** frame)
+{
+    const size_t frame_len = reader->lights_count * 3;
+
+    if(reader->next_frame >= reader->frame_count)
+    {
+        return false;
+    }
+
+    if(reader->decoded == NULL)
+    {
+        *frame = reader->map + reader->pos;
+        reader->pos += frame_len;
+        ++reader->next_frame;
+        return true;
+    }
+
+    if(reader->map_len - reader->pos < 4)
+    {
+        reader->next_frame = reader->frame_count;
+        return false;
+    }
+
+    const size_t spans_len = show_get_u32(reader->map + reader->pos);
+    const uint8_t* spans = reader->map + reader->pos + 4;
+    const uint8_t* spans_end = spans + spans_len;
+    if(spans_len > reader->map_len - reader->pos - 4)
+    {
+        reader->next_frame = reader->frame_count;
+        return false;
+    }
+
+    // Starts from a copy of the frame before, which is black for the first
+    uint8_t* dest = reader->decoded + (reader->next_frame % reader->decoded_count) * frame_len;
+    if(reader->next_frame == 0)
+    {
+        memset(dest, 0, frame_len);
+    }
+    else if(reader->decoded_count > 1)
+    {
+        const uint8_t* last = reader->decoded + ((reader->next_frame - 1) % reader->decoded_count) * frame_len;
+        memcpy(dest, last, frame_len);
+    }
+
+    while(spans < spans_end)
+    {
+        if((size_t) (spans_end - spans) < show_span_header_len)
+        {
+            reader->next_frame = reader->frame_count;
+            return false;
+        }
+
+        const size_t offset = show_get_u32(spans);
+        const size_t len = show_get_u32(spans + 4);
+        spans += show_span_header_len;
+
+        if(offset > frame_len || len > frame_len - offset || len > (size_t) (spans_end - spans))
+        {
+            reader->next_frame = reader->frame_count;
+            return false;
+        }
+
+        memcpy(dest + offset, spans, len);
+        spans += len;
+    }
+
+    *frame = dest;
+    reader->pos += 4 + spans_len;
+    ++reader->next_frame;
+    return true;
+}
+
+void show_reader_rewind(ShowReader* reader)
+{
+    reader->pos = SHOW_HEADER_LEN;
+    reader->next_frame = 0;
+}
+
+void show_reader_close(ShowReader* reader)
+{
+    free(reader->decoded);
+    reader->decoded = NULL;
+
+    if(reader->map != NULL)
+    {
+        munmap((void*) reader->map, reader->map_len);
+        reader->map = NULL;
+    }
+
+    if(reader->fd >= 0)
+    {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
+
+bool show_writer_open(ShowWriter* writer, const char* path, unsigned int lights_count, unsigned int frame_duration_ms, bool delta)
+{
+    assert(lights_count > 0);
+
+    writer->lights_count = lights_count;
+    writer->frame_count = 0;
+    writer->last_frame = NULL;
+    writer->file = fopen(path, "wb");
+    if(writer->file == NULL)
+    {
+        return false;
+    }
+
+    if(delta)
+    {
+        writer->last_frame = (uint8_t*) calloc(lights_count, 3);
+        assert(writer->last_frame != NULL);
+    }
+
+    // Frame count is written when closing
+    uint8_t reserved[8] = { 0 };
+    bool ok = fwrite(show_magic, sizeof(show_magic), 1, writer->file) == 1 &&
+              show_put_u32(writer->file, lights_count) &&
+              show_put_u32(writer->file, frame_duration_ms) &&
+              show_put_u32(writer->file, 0) &&
+              show_put_u32(writer->file, delta ? SHOW_FLAG_DELTA : 0) &&
+              fwrite(reserved, sizeof(reserved), 1, writer->file) == 1;
+
+    if(!ok)
+    {
+        show_writer_close(writer);
+    }
+
+    return ok;
+}
+
+bool show_writer_append(ShowWriter* writer, const uint8_t* frame)
+{
+    const size_t frame_len = writer->lights_count * 3;
+
+    if(writer->last_frame == NULL)
+    {
+        if(fwrite(frame, frame_len, 1, writer->file) != 1)
+        {
+            return false;
+        }
+        ++writer->frame_count;
+        return true;
+    }
+
+    size_t spans_len = 0;
+    size_t span_len = 0;
+    size_t offset = show_next_span(frame, writer->last_frame, frame_len, 0, &span_len);
+    while(offset < frame_len)
+    {
+        spans_len += show_span_header_len + span_len;
+        offset = show_next_span(frame, writer->last_frame, frame_len, offset + span_len, &span_len);
+    }
+
+    if(!show_put_u32(writer->file, (uint32_t) spans_len))
+    {
+        return false;
+    }
+
+    offset = show_next_span(frame, writer->last_frame, frame_len, 0, &span_len);
+    while(offset < frame_len)
+    {
+        if(!show_put_u32(writer->file, (uint32_t) offset) ||
+           !show_put_u32(writer->file, (uint32_t) span_len) ||
+           fwrite(frame + offset, span_len, 1, writer->file) != 1)
+        {
+            return false;
+        }
+        offset = show_next_span(frame, writer->last_frame, frame_len, offset + span_len, &span_len);
+    }
+
+    memcpy(writer->last_frame, frame, frame_len);
+    ++writer->frame_count;
+    return true;
+}
+
+bool show_writer_close(ShowWriter* writer)
+{
+    bool ok = false;
+
+    if(writer->file != NULL)
+    {
+        ok = fseek(writer->file, 16, SEEK_SET) == 0 &&
+             show_put_u32(writer->file, writer->frame_count);
+        ok = (fclose(writer->file) == 0) && ok;
+        writer->file = NULL;
+    }
+
+    free(writer->last_frame);
+    writer->last_frame = NULL;
+
+    return ok;
+}
+
+/**
+ * Finds the next span of changed bytes at or after from and returns its
+ * offset, or returns frame_len if nothing changed after from.
+ */
+static size_t show_next_span(const uint8_t* frame, const uint8_t* last_frame, size_t frame_len, size_t from, size_t* span_len)
+{
+    while(from < frame_len && frame[from] == last_frame[from])
+    {
+        ++from;
+    }
+
+    if(from == frame_len)
+    {
+        return frame_len;
+    }
+
+    size_t end = from + 1;
+    size_t unchanged = 0;
+    for(size_t i = end; i < frame_len && unchanged < show_span_gap; ++i)
+    {
+        if(frame[i] != last_frame[i])
+        {
+            end = i + 1;
+            unchanged = 0;
+        }
+        else
+        {
+            ++unchanged;
+        }
+    }
+
+    *span_len = end - from;
+    return from;
+}
+
+static bool show_put_u32(FILE* file, uint32_t value)
+{
+    uint8_t bytes[4] = {
+        (uint8_t) value,
+        (uint8_t) (value >> 8),
+        (uint8_t) (value >> 16),
+        (uint8_t) (value >> 24)
+    };
+    return fwrite(bytes, sizeof(bytes), 1, file) == 1;
+}
+
+static uint32_t show_get_u32(const uint8_t* at)
+{
+    return ((uint32_t) at[0]) |
+           (((uint32_t) at[1]) << 8) |
+           (((uint32_t) at[2]) << 16) |
+           (((uint32_t) at[3]) << 24);
+}
+
+#endif // ATOLLA_SHOW_SUPPORTED
@@ -0,0 +1,124 @@
+#ifndef SHOW_SHOW_H
+#define SHOW_SHOW_H
+
+#include "../atolla/primitives.h"
+
+#include <stdio.h>
+
+/**
+ * Shows are files holding pre-rendered frames, so that fixed animations can
+ * be streamed to a sink without painting them again on every run.
+ *
+ * Files start with a header of SHOW_HEADER_LEN bytes:
+ *
+ *    0   8 bytes   magic "ATLSHOW1"
+ *    8   u32       lights count, every frame holds three times as many bytes
+ *    12  u32       frame duration in milliseconds
+ *    16  u32       amount of frames
+ *    20  u32       flags, see SHOW_FLAG_DELTA
+ *    24  u64       reserved, zero
+ *
+ * Without flags, the frames follow the header back to back as RGB triplets,
+ * so they can be sent straight from a memory mapping of the file.
+ *
+ * With SHOW_FLAG_DELTA, every frame instead starts with a u32 length of the
+ * spans that follow, each span consisting of
+ *
+ *    0   u32       offset of the span in the frame in bytes
+ *    4   u32       length of the span in bytes
+ *    8             the bytes of the frame at the offset
+ *
+ * and all bytes outside of the spans are the same as in the frame before.
+ * The frame before the first frame is black. Still scenes then take up only
+ * four bytes per frame.
+ *
+ * All numbers are little endian. Reading shows needs memory mapped files and
+ * is only available if the platform defines ATOLLA_SHOW_SUPPORTED, which is
+ * not the case on ESP8266 and Windows.
+ */
+
+#if !defined(ARDUINO_ARCH_ESP8266) && !defined(_WIN32) && !defined(WIN32)
+    #define ATOLLA_SHOW_SUPPORTED
+#endif
+
+#define SHOW_HEADER_LEN 32
+#define SHOW_FLAG_DELTA 1
+
+struct ShowReader
+{
+    int fd;
+    const uint8_t* map;
+    size_t map_len;
+    unsigned int lights_count;
+    unsigned int frame_duration_ms;
+    unsigned int frame_count;
+    uint32_t flags;
+    /** Offset of the next frame in the mapping */
+    size_t pos;
+    /** Index of the next frame, up to frame_count */
+    unsigned int next_frame;
+    /**
+     * Ring of decoded frames for shows with SHOW_FLAG_DELTA, otherwise NULL
+     * and frames point into the mapping.
+     */
+    uint8_t* decoded;
+    unsigned int decoded_count;
+};
+typedef struct ShowReader ShowReader;
+
+struct ShowWriter
+{
+    FILE* file;
+    unsigned int lights_count;
+    unsigned int frame_count;
+    /** Last written frame, for shows with SHOW_FLAG_DELTA, otherwise NULL */
+    uint8_t* last_frame;
+};
+typedef struct ShowWriter ShowWriter;
+
+#ifdef ATOLLA_SHOW_SUPPORTED
+
+/**
+ * Maps the show at path for reading. Frames returned by show_reader_next stay
+ * valid until the reader is closed, or for shows with SHOW_FLAG_DELTA, until
+ * show_reader_next was called keep_frames more times. Returns false if the
+ * file could not be opened or is not a show.
+ */
+bool show_reader_open(ShowReader* reader, const char* path, unsigned int keep_frames);
+
+/**
+ * Points frame at the next frame of lights_count RGB triplets and returns
+ * true, or returns false after the last frame or if the rest of the file is
+ * malformed. Decoding frames with SHOW_FLAG_DELTA does not allocate memory.
+ */
+bool show_reader_next(ShowReader* reader, const uint8_t** frame);
+
+/**
+ * Starts reading from the first frame again.
+ */
+void show_reader_rewind(ShowReader* reader);
+
+void show_reader_close(ShowReader* reader);
+
+/**
+ * Creates or truncates the file at path to write frames of the given amount
+ * of lights into, optionally only storing the changes to the frame before as
+ * with SHOW_FLAG_DELTA. Returns false if the file could not be created.
+ */
+bool show_writer_open(ShowWriter* writer, const char* path, unsigned int lights_count, unsigned int frame_duration_ms, bool delta);
+
+/**
+ * Appends a frame of lights_count RGB triplets, returns false if writing
+ * failed.
+ */
+bool show_writer_append(ShowWriter* writer, const uint8_t* frame);
+
+/**
+ * Writes the amount of frames into the header and closes the file, returns
+ * false if writing failed.
+ */
+bool show_writer_close(ShowWriter* writer);
+
+#endif // ATOLLA_SHOW_SUPPORTED
+
+#endif // SHOW_SHOW_H
@@ -0,0 +1,181 @@
+#include "trace.h"
+
+#ifdef ATOLLA_ENABLE_TRACE
+
+#include "../test/assert.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef ARDUINO_ARCH_ESP8266
+    #include <Arduino.h>
+#else
+    #include "../time/gettime.h"
+#endif
+
+/** Events are shown on separate tracks per stage of the frame */
+enum TraceTrack
+{
+    TRACE_TRACK_PUT = 1,
+    TRACE_TRACK_NETWORK = 2,
+    TRACE_TRACK_PLAYOUT = 3
+};
+
+struct TraceEventInfo
+{
+    const char* name;
+    int track;
+    /** Name of arg in the output, or NULL if arg is not used */
+    const char* arg_name;
+    /** Whether arg is the amount of pending frames, also output as a counter */
+    bool arg_is_pending;
+};
+
+static const struct TraceEventInfo event_infos[] = {
+    { "put", TRACE_TRACK_PUT, "queued", false },
+    { "built", TRACE_TRACK_NETWORK, NULL, false },
+    { "sent", TRACE_TRACK_NETWORK, NULL, false },
+    { "retransmitted", TRACE_TRACK_NETWORK, NULL, false },
+    { "received", TRACE_TRACK_NETWORK, "ahead", false },
+    { "enqueued", TRACE_TRACK_NETWORK, "pending", true },
+    { "filled", TRACE_TRACK_NETWORK, "pending", true },
+    { "current", TRACE_TRACK_PLAYOUT, "pending", true },
+    { "dropped", TRACE_TRACK_PLAYOUT, NULL, false }
+};
+static const size_t event_infos_count = sizeof(event_infos) / sizeof(event_infos[0]);
+
+static const char* drop_reasons[] = { "buffer_full", "skipped", "too_late" };
+static const size_t drop_reasons_count = sizeof(drop_reasons) / sizeof(drop_reasons[0]);
+
+static uint64_t trace_now_us();
+static void trace_append(char* buf, size_t buf_len, size_t* len, const char* format, ...);
+
+TraceRing trace_ring_alloc(size_t capacity)
+{
+    TraceRing ring;
+
+    assert(capacity > 0);
+
+    ring.events = (TraceEvent*) calloc(capacity, sizeof(TraceEvent));
+    assert(ring.events != NULL);
+    ring.capacity = capacity;
+    ring.count = 0;
+
+    return ring;
+}
+
+void trace_ring_free(TraceRing* ring)
+{
+    free(ring->events);
+    ring->events = NULL;
+    ring->capacity = 0;
+    ring->count = 0;
+}
+
+void trace_ring_record(TraceRing* ring, TraceEventType type, uint8_t frame_idx, uint16_t arg)
+{
+    TraceEvent* event = &ring->events[ring->count % ring->capacity];
+    event->time_us = trace_now_us();
+    event->type = (uint8_t) type;
+    event->frame_idx = frame_idx;
+    event->arg = arg;
+    ++ring->count;
+}
+
+size_t trace_ring_json(const TraceRing* ring, int pid, const char* process_name, char* buf, size_t buf_len)
+{
+    size_t len = 0;
+    size_t first = (ring->count > ring->capacity) ? (ring->count - ring->capacity) : 0;
+
+    if(buf_len > 0)
+    {
+        buf[0] = '\0';
+    }
+
+    trace_append(buf, buf_len, &len,
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"put\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"network\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"playout\"}}",
+        pid, process_name,
+        pid, TRACE_TRACK_PUT,
+        pid, TRACE_TRACK_NETWORK,
+        pid, TRACE_TRACK_PLAYOUT
+    );
+
+    for(size_t i = first; i < ring->count; ++i)
+    {
+        const TraceEvent* event = &ring->events[i % ring->capacity];
+        if(event->type >= event_infos_count)
+        {
+            continue;
+        }
+
+        const struct TraceEventInfo* info = &event_infos[event->type];
+        unsigned long long ts = (unsigned long long) event->time_us;
+
+        trace_append(buf, buf_len, &len,
+            ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%d,\"args\":{\"frame_idx\":%u",
+            info->name, ts, pid, info->track, (unsigned int) event->frame_idx
+        );
+
+        if(event->type == TRACE_EVENT_DROPPED)
+        {
+            const char* reason = (event->arg < drop_reasons_count) ? drop_reasons[event->arg] : "unknown";
+            trace_append(buf, buf_len, &len, ",\"reason\":\"%s\"", reason);
+        }
+        else if(info->arg_name != NULL)
+        {
+            trace_append(buf, buf_len, &len, ",\"%s\":%u", info->arg_name, (unsigned int) event->arg);
+        }
+
+        trace_append(buf, buf_len, &len, "}}");
+
+        if(info->arg_is_pending)
+        {
+            trace_append(buf, buf_len, &len,
+                ",\n{\"name\":\"pending_frames\",\"ph\":\"C\",\"ts\":%llu,\"pid\":%d,\"args\":{\"frames\":%u}}",
+                ts, pid, (unsigned int) event->arg
+            );
+        }
+    }
+
+    return len;
+}
+
+/**
+ * Appends formatted text at *len if it fits into the buffer, and advances *len
+ * by the length of the text even if it does not, like snprintf.
+ */
+static void trace_append(char* buf, size_t buf_len, size_t* len, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+
+    char* dest = (*len < buf_len) ? (buf + *len) : NULL;
+    size_t dest_len = (*len < buf_len) ? (buf_len - *len) : 0;
+    int written = vsnprintf(dest, dest_len, format, args);
+
+    va_end(args);
+
+    if(written > 0)
+    {
+        *len += (size_t) written;
+    }
+}
+
+static uint64_t trace_now_us()
+{
+#ifdef ARDUINO_ARCH_ESP8266
+    return micros();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec) * 1000000 +
+           ts.tv_nsec / 1000;
+#endif
+}
+
+#endif // ATOLLA_ENABLE_TRACE
@@ -0,0 +1,117 @@
+#ifndef TRACE_TRACE_H
+#define TRACE_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+
+/**
+ * Tracing records what happens to every frame in sources and sinks with a
+ * timestamp in microseconds, so that stutter can be attributed to painting,
+ * pacing, the network, the buffer or playout.
+ *
+ * It is only compiled in if ATOLLA_ENABLE_TRACE is defined, otherwise the
+ * TRACE_RECORD instrumentation points expand to nothing and no memory is
+ * reserved for events.
+ */
+
+#ifndef ATOLLA_TRACE_CAPACITY
+/**
+ * Amount of events kept per source or sink, older events are overwritten.
+ * Events take 16 bytes each.
+ */
+#define ATOLLA_TRACE_CAPACITY 4096
+#endif
+
+#ifdef ATOLLA_ENABLE_TRACE
+    #define TRACE_RECORD(ring, type, frame_idx, arg) trace_ring_record((ring), (type), (frame_idx), (arg))
+#else
+    #define TRACE_RECORD(ring, type, frame_idx, arg) ((void) 0)
+#endif
+
+enum TraceEventType
+{
+    /** A frame was passed to the source, arg is the amount of queued frames before it */
+    TRACE_EVENT_PUT,
+    /** The enqueue message of a frame was built */
+    TRACE_EVENT_BUILT,
+    /** A frame was handed to the socket */
+    TRACE_EVENT_SENT,
+    /** A frame was sent again after a NACK */
+    TRACE_EVENT_RETRANSMITTED,
+    /** A frame arrived at the sink, arg is how many frames it is ahead of the last one */
+    TRACE_EVENT_RECEIVED,
+    /** A frame entered the pending frames of the sink, arg is the amount of pending frames */
+    TRACE_EVENT_ENQUEUED,
+    /** A copy of a later frame filled in for a lost frame, arg is the amount of pending frames */
+    TRACE_EVENT_FILLED,
+    /** A frame became the current frame of the sink, arg is the amount of pending frames */
+    TRACE_EVENT_CURRENT,
+    /** A frame was discarded without being shown, arg is a TraceDropReason */
+    TRACE_EVENT_DROPPED
+};
+typedef enum TraceEventType TraceEventType;
+
+enum TraceDropReason
+{
+    /** The pending frames of the sink were full */
+    TRACE_DROP_BUFFER_FULL,
+    /** Playout was behind and skipped over the frame */
+    TRACE_DROP_SKIPPED,
+    /** A retransmitted frame arrived after the copy filling in for it was shown */
+    TRACE_DROP_TOO_LATE
+};
+typedef enum TraceDropReason TraceDropReason;
+
+struct TraceEvent
+{
+    /** Microseconds on the monotonic clock, shared by all instances in a process */
+    uint64_t time_us;
+    uint8_t type;
+    uint8_t frame_idx;
+    uint16_t arg;
+};
+typedef struct TraceEvent TraceEvent;
+
+struct TraceRing
+{
+    TraceEvent* events;
+    size_t capacity;
+    /** Total events recorded, the newest is at (count - 1) % capacity */
+    size_t count;
+};
+typedef struct TraceRing TraceRing;
+
+/**
+ * Allocates a trace ring holding the given amount of events, so recording
+ * never allocates.
+ */
+TraceRing trace_ring_alloc(size_t capacity);
+
+void trace_ring_free(TraceRing* ring);
+
+/**
+ * Records an event with the current time, overwriting the oldest event if the
+ * ring is full.
+ */
+void trace_ring_record(TraceRing* ring, TraceEventType type, uint8_t frame_idx, uint16_t arg);
+
+/**
+ * Writes the recorded events from oldest to newest as comma separated objects
+ * of the Chrome trace event format, which the Chrome trace viewer and Perfetto
+ * can open after joining the output of all instances with commas and wrapping
+ * it in brackets. The pid and process_name tell instances apart in the viewer.
+ *
+ * Like snprintf, at most buf_len - 1 characters and a terminating zero are
+ * written, and the length of the complete output is returned, so a return
+ * value of buf_len or more means the output was truncated.
+ */
+size_t trace_ring_json(const TraceRing* ring, int pid, const char* process_name, char* buf, size_t buf_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_TRACE_H
@@ -17,6 +17,7 @@
 
     // Everywhere else, use bsd sockets
     #include <sys/socket.h>
+    #include <sys/uio.h>
     #include <netinet/in.h>
     #include <fcntl.h>
     #include <netdb.h>
@@ -73,6 +73,26 @@ struct UdpSocketResult
 };
 typedef struct UdpSocketResult UdpSocketResult;
 
+/**
+ * References one part of a packet that is assembled from multiple buffers by
+ * the vectored send functions, e.g. a message header followed by the payload
+ * provided by the caller.
+ */
+struct UdpPacketPart
+{
+    void* data;
+    size_t size;
+};
+typedef struct UdpPacketPart UdpPacketPart;
+
+#ifndef UDP_SOCKET_MAX_PACKET_PARTS
+/**
+ * Maximum amount of parts a packet can be assembled from with the vectored
+ * send functions.
+ */
+#define UDP_SOCKET_MAX_PACKET_PARTS 64
+#endif
+
 #if defined(ARDUINO_ARCH_ESP8266)
     #include <Arduino.h>
     #include <WiFiUdp.h>
@@ -250,6 +270,45 @@ UdpSocketResult udp_socket_send(UdpSocket* socket, void* packet_data, size_t pac
  */
  UdpSocketResult udp_socket_send_to(UdpSocket* socket, void* packet_data, size_t packet_data_len, UdpEndpoint* to);
 
+/**
+ * Works like <code>udp_socket_send</code>, but the packet is assembled from
+ * the <code>parts_count</code> buffers in the <code>parts</code> array, in
+ * order. The buffers are gathered directly by the operating system, so no
+ * intermediate copy of the packet is made in user space.
+ *
+ * At most <code>UDP_SOCKET_MAX_PACKET_PARTS</code> parts can be passed and
+ * the total size of the parts must be greater than zero.
+ */
+UdpSocketResult udp_socket_sendv(UdpSocket* socket, UdpPacketPart* parts, size_t parts_count);
+
+/**
+ * Works like <code>udp_socket_send_to</code>, but the packet is assembled from
+ * the <code>parts_count</code> buffers in the <code>parts</code> array, in
+ * order, like in <code>udp_socket_sendv</code>.
+ *
+ * If <code>to</code> is <code>NULL</code>, the packet is sent to the receiver
+ * set with the last successful call to <code>udp_socket_set_receiver</code>.
+ */
+UdpSocketResult udp_socket_sendv_to(UdpSocket* socket, UdpPacketPart* parts, size_t parts_count, UdpEndpoint* to);
+
+/**
+ * Sends the same packet, assembled from the given parts like in
+ * <code>udp_socket_sendv</code>, to each of the <code>to_count</code>
+ * endpoints in the <code>to</code> array. Where supported by the operating
+ * system, the packets are handed to the kernel in batches with a single system
+ * call, e.g. with <code>sendmmsg</code> on Linux. On other systems, this is
+ * equivalent to calling <code>udp_socket_sendv_to</code> for each endpoint.
+ *
+ * A failed send to one endpoint does not prevent sending to the remaining
+ * endpoints. If <code>results</code> is not <code>NULL</code>, it must point
+ * to an array of <code>to_count</code> results, which is filled with the
+ * outcome of sending to the endpoint with the same index.
+ *
+ * The returned result holds <code>UDP_SOCKET_OK</code> if the packet could be
+ * sent to all endpoints. Otherwise, it holds the first error that occurred.
+ */
+UdpSocketResult udp_socket_sendv_to_many(UdpSocket* socket, UdpPacketPart* parts, size_t parts_count, UdpEndpoint* to, size_t to_count, UdpSocketResult* results);
+
 /**
  * TODO document
  *
@@ -267,6 +326,21 @@ UdpSocketResult udp_socket_receive_from(UdpSocket* socket, void* packet_buffer,
 
 UdpSocketResult udp_socket_receive(UdpSocket* socket, void* packet_buffer, size_t packet_buffer_capacity, size_t* received_byte_count, bool set_sender_as_receiver);
 
+/**
+ * Resolves the given hostname and port into an endpoint that can be used as a
+ * receiver with <code>udp_socket_send_to</code> or to compare against the
+ * sender of received packets with <code>udp_endpoint_equal</code>.
+ *
+ * Name resolution is performed with the same criteria as in
+ * <code>udp_socket_set_receiver</code>. If the hostname resolves to multiple
+ * addresses, the first one is used.
+ *
+ * The result of the operation will be signalled with the returned UdpSocketResult
+ * structure. If the hostname could not be resolved, the <code>code</code> property
+ * will hold <code>UDP_SOCKET_ERR_RESOLVE_HOSTNAME_FAILED</code>.
+ */
+UdpSocketResult udp_endpoint_resolve(UdpEndpoint* endpoint, const char* hostname, unsigned short port);
+
 bool udp_endpoint_equal(UdpEndpoint* a, UdpEndpoint* b);
 
 #endif /* _udp_socket_h_ */
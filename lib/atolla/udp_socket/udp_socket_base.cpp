@@ -23,3 +23,8 @@ UdpSocketResult udp_socket_send(UdpSocket* socket, void* packet_data, size_t pac
 {
     return udp_socket_send_to(socket, packet_data, packet_data_len, NULL);
 }
+
+UdpSocketResult udp_socket_sendv(UdpSocket* socket, UdpPacketPart* parts, size_t parts_count)
+{
+    return udp_socket_sendv_to(socket, parts, parts_count, NULL);
+}
@@ -17,6 +17,19 @@ static UdpSocketResult udp_socket_close(UdpSocket* socket);
 static UdpSocketResult udp_socket_initialize_socket_support(UdpSocket* socket);
 static UdpSocketResult udp_socket_create_socket(UdpSocket* sock, unsigned short port);
 static UdpSocketResult udp_socket_set_socket_nonblocking(UdpSocket* socket);
+static UdpSocketResult udp_socket_lookup(const char* hostname, unsigned short port, struct addrinfo** first_result);
+static UdpSocketResult udp_socket_send_error_result(int error);
+static size_t udp_socket_parts_size(UdpPacketPart* parts, size_t parts_count);
+#if !defined(_WIN32) && !defined(WIN32)
+static void udp_socket_parts_to_iovec(UdpPacketPart* parts, size_t parts_count, struct iovec* iov);
+#endif
+
+#ifndef UDP_SOCKET_SEND_BATCH_LEN
+/**
+ * Maximum amount of packets handed to the kernel with a single call to sendmmsg.
+ */
+#define UDP_SOCKET_SEND_BATCH_LEN 32
+#endif
 
 #if defined(_WIN32) || defined(WIN32)
     WSADATA WsaData;
@@ -244,7 +257,7 @@ static UdpSocketResult udp_socket_close(UdpSocket* socket)
     return make_success_result();
 }
 
-UdpSocketResult udp_socket_set_receiver(UdpSocket* socket, const char* hostname, unsigned short port_short)
+UdpSocketResult udp_socket_set_receiver(UdpSocket* socket, const char* hostname, unsigned short port)
 {
     if(socket == NULL)
     {
@@ -254,12 +267,78 @@ UdpSocketResult udp_socket_set_receiver(UdpSocket* socket, const char* hostname,
         );
     }
 
+    struct addrinfo* first_result = NULL;
+
+    UdpSocketResult lookup_result = udp_socket_lookup(hostname, port, &first_result);
+    if(lookup_result.code != UDP_SOCKET_OK)
+    {
+        return lookup_result;
+    }
+
+    struct addrinfo* curr_result = first_result;
+    int error;
+
+    do
+    {
+        assert(curr_result->ai_socktype == SOCK_DGRAM);
+        assert(curr_result->ai_protocol == IPPROTO_UDP);
+
+        error = connect(
+            socket->socket_handle,
+            curr_result->ai_addr,
+            curr_result->ai_addrlen
+        );
+
+        curr_result = curr_result->ai_next;
+    }
+    while(error != 0 && curr_result != NULL);
+
+    freeaddrinfo(first_result);
+
+    if (error != 0)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_CONNECT_FAILED,
+            strerror(errno)
+        );
+    }
+
+    return make_success_result();
+}
+
+UdpSocketResult udp_endpoint_resolve(UdpEndpoint* endpoint, const char* hostname, unsigned short port)
+{
+    assert(endpoint != NULL);
+
+    struct addrinfo* first_result = NULL;
+
+    UdpSocketResult lookup_result = udp_socket_lookup(hostname, port, &first_result);
+    if(lookup_result.code != UDP_SOCKET_OK)
+    {
+        return lookup_result;
+    }
+
+    assert(first_result->ai_addrlen <= sizeof(endpoint->addr));
+
+    memset(endpoint, 0, sizeof(UdpEndpoint));
+    memcpy(&endpoint->addr, first_result->ai_addr, first_result->ai_addrlen);
+    endpoint->addr_len = first_result->ai_addrlen;
+
+    freeaddrinfo(first_result);
+
+    return make_success_result();
+}
+
+/**
+ * Looks up the addresses for the given hostname and port. On success, the
+ * caller is responsible for calling freeaddrinfo on the returned list.
+ */
+static UdpSocketResult udp_socket_lookup(const char* hostname, unsigned short port_short, struct addrinfo** first_result)
+{
     // A two-byte number can be a maximum of five characters in a string plus one \0
     char port[6];
     sprintf(port, "%hu", port_short);
 
-    struct addrinfo* first_result = NULL;
-
     struct addrinfo criteria;
     memset(&criteria, 0, sizeof criteria);
     // IPv6 only, map to ipv4 if necessary
@@ -283,7 +362,7 @@ UdpSocketResult udp_socket_set_receiver(UdpSocket* socket, const char* hostname,
         hostname,
         port,
         &criteria,
-        &first_result
+        first_result
     );
 
     if (error != 0)
@@ -303,37 +382,8 @@ UdpSocketResult udp_socket_set_receiver(UdpSocket* socket, const char* hostname,
             );
         }
     }
-    else
-    {
-        struct addrinfo* curr_result = first_result;
-
-        assert(first_result != NULL);
-
-        do
-        {
-            assert(curr_result->ai_socktype == SOCK_DGRAM);
-            assert(curr_result->ai_protocol == IPPROTO_UDP);
-
-            error = connect(
-                socket->socket_handle,
-                curr_result->ai_addr,
-                curr_result->ai_addrlen
-            );
-
-            curr_result = curr_result->ai_next;
-        }
-        while(error != 0 && curr_result != NULL);
-
-        freeaddrinfo(first_result);
 
-        if (error != 0)
-        {
-            return make_err_result(
-                UDP_SOCKET_ERR_CONNECT_FAILED,
-                strerror(errno)
-            );
-        }
-    }
+    assert(*first_result != NULL);
 
     return make_success_result();
 }
@@ -473,46 +523,226 @@ UdpSocketResult udp_socket_send_to(UdpSocket* socket, void* packet_data, size_t
 
     if(sent_bytes == -1)
     {
-        if(errno == EACCES)
+        return udp_socket_send_error_result(errno);
+    }
+
+    assert(((size_t) sent_bytes) == packet_data_len);
+
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_sendv_to(UdpSocket* socket, UdpPacketPart* parts, size_t parts_count, UdpEndpoint* to)
+{
+    assert(parts != NULL);
+    assert(parts_count > 0 && parts_count <= UDP_SOCKET_MAX_PACKET_PARTS);
+
+    if(socket == NULL)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SOCKET_IS_NULL,
+            msg_socket_is_null
+        );
+    }
+
+    size_t packet_data_len = udp_socket_parts_size(parts, parts_count);
+    assert(packet_data_len > 0);
+
+#if defined(_WIN32) || defined(WIN32)
+
+    WSABUF bufs[UDP_SOCKET_MAX_PACKET_PARTS];
+    for(size_t i = 0; i < parts_count; ++i)
+    {
+        bufs[i].buf = (char*) parts[i].data;
+        bufs[i].len = (ULONG) parts[i].size;
+    }
+
+    DWORD sent_bytes = 0;
+    int error = WSASendTo(
+        socket->socket_handle,
+        bufs, (DWORD) parts_count,
+        &sent_bytes,
+        0,
+        to ? (const struct sockaddr*) &to->addr : NULL,
+        to ? to->addr_len : 0,
+        NULL, NULL
+    );
+
+    if(error != 0)
+    {
+        return udp_socket_send_error_result(WSAGetLastError());
+    }
+
+#else
+
+    struct iovec iov[UDP_SOCKET_MAX_PACKET_PARTS];
+    udp_socket_parts_to_iovec(parts, parts_count, iov);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = to ? &to->addr : NULL;
+    msg.msg_namelen = to ? to->addr_len : 0;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = parts_count;
+
+    ssize_t sent_bytes = sendmsg(socket->socket_handle, &msg, 0);
+
+    if(sent_bytes == -1)
+    {
+        return udp_socket_send_error_result(errno);
+    }
+
+#endif
+
+    assert(((size_t) sent_bytes) == packet_data_len);
+
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_sendv_to_many(UdpSocket* socket, UdpPacketPart* parts, size_t parts_count, UdpEndpoint* to, size_t to_count, UdpSocketResult* results)
+{
+    assert(parts != NULL);
+    assert(parts_count > 0 && parts_count <= UDP_SOCKET_MAX_PACKET_PARTS);
+    assert(to != NULL || to_count == 0);
+
+    if(socket == NULL)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SOCKET_IS_NULL,
+            msg_socket_is_null
+        );
+    }
+
+    UdpSocketResult first_error = make_success_result();
+
+#if defined(__linux__)
+
+    // All messages in the batch share the same parts
+    struct iovec iov[UDP_SOCKET_MAX_PACKET_PARTS];
+    udp_socket_parts_to_iovec(parts, parts_count, iov);
+
+    struct mmsghdr batch[UDP_SOCKET_SEND_BATCH_LEN];
+
+    size_t next = 0;
+    while(next < to_count)
+    {
+        const size_t batch_len = (to_count - next) < UDP_SOCKET_SEND_BATCH_LEN
+                                    ? (to_count - next)
+                                    : UDP_SOCKET_SEND_BATCH_LEN;
+
+        memset(batch, 0, batch_len * sizeof(struct mmsghdr));
+        for(size_t i = 0; i < batch_len; ++i)
         {
-            return make_err_result(
-                UDP_SOCKET_ERR_BAD_BROADCAST,
-                msg_bad_braodcast
-            );
+            batch[i].msg_hdr.msg_name = &to[next + i].addr;
+            batch[i].msg_hdr.msg_namelen = to[next + i].addr_len;
+            batch[i].msg_hdr.msg_iov = iov;
+            batch[i].msg_hdr.msg_iovlen = parts_count;
         }
-        else if(errno == EAGAIN || errno == EWOULDBLOCK)
+
+        int sent_count = sendmmsg(socket->socket_handle, batch, batch_len, 0);
+
+        UdpSocketResult result;
+        if(sent_count < 0)
         {
-            return make_err_result(
-                UDP_SOCKET_ERR_WOULDBLOCK,
-                msg_wouldblock
-            );
+            // The first packet in the batch could not be sent, report the
+            // error for that endpoint and go on with the rest of the batch
+            result = udp_socket_send_error_result(errno);
+            sent_count = 0;
         }
-        else if(errno == EDESTADDRREQ)
+        else
         {
-            return make_err_result(
-                UDP_SOCKET_ERR_NO_RECEIVER,
-                msg_no_receiver
-            );
+            result = make_success_result();
         }
-        else if(errno == EMSGSIZE)
+
+        for(int i = 0; i < sent_count; ++i)
         {
-            return make_err_result(
-                UDP_SOCKET_ERR_PACKET_TOO_BIG,
-                msg_packet_too_big
-            );
+            if(results) { results[next + i] = make_success_result(); }
         }
-        else
+        next += sent_count;
+
+        if(result.code != UDP_SOCKET_OK)
         {
-            return make_err_result(
-                UDP_SOCKET_ERR_SEND_FAILED,
-                strerror(errno)
-            );
+            if(results) { results[next] = result; }
+            if(first_error.code == UDP_SOCKET_OK) { first_error = result; }
+            ++next;
         }
     }
 
-    assert(((size_t) sent_bytes) == packet_data_len);
+#else
 
-    return make_success_result();
+    for(size_t i = 0; i < to_count; ++i)
+    {
+        UdpSocketResult result = udp_socket_sendv_to(socket, parts, parts_count, &to[i]);
+        if(results) { results[i] = result; }
+        if(result.code != UDP_SOCKET_OK && first_error.code == UDP_SOCKET_OK)
+        {
+            first_error = result;
+        }
+    }
+
+#endif
+
+    return first_error;
+}
+
+static size_t udp_socket_parts_size(UdpPacketPart* parts, size_t parts_count)
+{
+    size_t size = 0;
+    for(size_t i = 0; i < parts_count; ++i)
+    {
+        assert(parts[i].data != NULL || parts[i].size == 0);
+        size += parts[i].size;
+    }
+    return size;
+}
+
+#if !defined(_WIN32) && !defined(WIN32)
+static void udp_socket_parts_to_iovec(UdpPacketPart* parts, size_t parts_count, struct iovec* iov)
+{
+    for(size_t i = 0; i < parts_count; ++i)
+    {
+        iov[i].iov_base = parts[i].data;
+        iov[i].iov_len = parts[i].size;
+    }
+}
+#endif
+
+static UdpSocketResult udp_socket_send_error_result(int error)
+{
+    if(error == EACCES)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_BAD_BROADCAST,
+            msg_bad_braodcast
+        );
+    }
+    else if(error == EAGAIN || error == EWOULDBLOCK)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_WOULDBLOCK,
+            msg_wouldblock
+        );
+    }
+    else if(error == EDESTADDRREQ)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_NO_RECEIVER,
+            msg_no_receiver
+        );
+    }
+    else if(error == EMSGSIZE)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_PACKET_TOO_BIG,
+            msg_packet_too_big
+        );
+    }
+    else
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SEND_FAILED,
+            strerror(error)
+        );
+    }
 }
 
 bool udp_endpoint_equal(UdpEndpoint* a, UdpEndpoint* b)
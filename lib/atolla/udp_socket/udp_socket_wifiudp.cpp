@@ -1,6 +1,7 @@
 #if defined(ARDUINO_ARCH_ESP8266)
 
 #include <Arduino.h>
+#include <ESP8266WiFi.h>
 #include <WifiUdp.h>
 #include "../test/assert.h"
 #include "udp_socket_results_internal.h"
@@ -11,6 +12,8 @@ static bool has_receiver;
 static uint16_t receiver_port;
 static IPAddress receiver;
 
+static const char* msg_resolve_hostname_failed = "Failed to resolve the given hostname";
+
 UdpSocketResult udp_socket_init_on_port(UdpSocket* socket, unsigned short port)
 {
     if(socket == NULL)
@@ -51,7 +54,35 @@ UdpSocketResult udp_socket_free(UdpSocket* socket)
 
 UdpSocketResult udp_socket_set_receiver(UdpSocket* socket, const char* hostname, unsigned short port)
 {
-    assert(false); // Not implemented yet
+    UdpEndpoint endpoint;
+
+    UdpSocketResult result = udp_endpoint_resolve(&endpoint, hostname, port);
+    if(result.code != UDP_SOCKET_OK)
+    {
+        return result;
+    }
+
+    return udp_socket_set_endpoint(socket, &endpoint);
+}
+
+UdpSocketResult udp_endpoint_resolve(UdpEndpoint* endpoint, const char* hostname, unsigned short port)
+{
+    assert(endpoint != NULL);
+
+    // Numeric addresses are parsed without asking the DNS server
+    IPAddress address;
+    if(hostname == NULL || !WiFi.hostByName(hostname, address))
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_RESOLVE_HOSTNAME_FAILED,
+            msg_resolve_hostname_failed
+        );
+    }
+
+    endpoint->address = address;
+    endpoint->port = port;
+
+    return make_success_result();
 }
 
 UdpSocketResult udp_socket_set_endpoint(UdpSocket* socket, UdpEndpoint* endpoint)
@@ -129,6 +160,64 @@ UdpSocketResult udp_socket_send_to(UdpSocket* socket, void* packet_data, size_t
     return make_success_result();
 }
 
+UdpSocketResult udp_socket_sendv_to(UdpSocket* socket, UdpPacketPart* parts, size_t parts_count, UdpEndpoint* to)
+{
+    assert(parts != NULL);
+    assert(parts_count > 0);
+
+    if(socket == NULL)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SOCKET_IS_NULL,
+            msg_socket_is_null
+        );
+    }
+
+    if(to == NULL)
+    {
+        if(has_receiver)
+        {
+            Udp.beginPacket(receiver, receiver_port);
+        }
+        else
+        {
+            return make_err_result(
+                UDP_SOCKET_ERR_NO_RECEIVER,
+                msg_no_receiver
+            );
+        }
+    }
+    else
+    {
+        Udp.beginPacket(to->address, to->port);
+    }
+
+    for(size_t i = 0; i < parts_count; ++i)
+    {
+        Udp.write((const uint8_t*) parts[i].data, parts[i].size);
+    }
+    Udp.endPacket();
+
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_sendv_to_many(UdpSocket* socket, UdpPacketPart* parts, size_t parts_count, UdpEndpoint* to, size_t to_count, UdpSocketResult* results)
+{
+    UdpSocketResult first_error = make_success_result();
+
+    for(size_t i = 0; i < to_count; ++i)
+    {
+        UdpSocketResult result = udp_socket_sendv_to(socket, parts, parts_count, &to[i]);
+        if(results) { results[i] = result; }
+        if(result.code != UDP_SOCKET_OK && first_error.code == UDP_SOCKET_OK)
+        {
+            first_error = result;
+        }
+    }
+
+    return first_error;
+}
+
  UdpSocketResult udp_socket_receive_from(UdpSocket* socket, void* packet_buffer, size_t packet_buffer_capacity, size_t* received_byte_count, UdpEndpoint* sender)
 {
     assert(packet_buffer != NULL);
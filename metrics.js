@@ -0,0 +1,154 @@
+const http = require('http')
+
+const defaultPort = 9464
+const defaultHost = '127.0.0.1'
+
+// Stats properties exported for sinks and sources, with the name, type and
+// help text of the metric, a factor converting the value to base units, and
+// for values that may be negative, a check whether the value is known
+const sinkMetrics = [
+  ['receivedPackets', 'atolla_sink_received_packets_total', 'counter', 'Datagrams received from any source'],
+  ['malformedPackets', 'atolla_sink_malformed_packets_total', 'counter', 'Datagrams that were malformed or contained unknown messages'],
+  ['receivedFrames', 'atolla_sink_received_frames_total', 'counter', 'Frames received in time and in order'],
+  ['lostFrames', 'atolla_sink_lost_frames_total', 'counter', 'Gaps filled in with copies of the next frame'],
+  ['fecRecoveredFrames', 'atolla_sink_fec_recovered_frames_total', 'counter', 'Lost frames reconstructed from parity'],
+  ['lateRecoveredFrames', 'atolla_sink_late_recovered_frames_total', 'counter', 'Lost frames that arrived late but in time for playout'],
+  ['tooLateFrames', 'atolla_sink_too_late_frames_total', 'counter', 'Lost frames that arrived after their copy was shown'],
+  ['sentNacks', 'atolla_sink_sent_nacks_total', 'counter', 'NACK messages sent to ask for lost frames'],
+  ['bufferedFrames', 'atolla_sink_buffered_frames', 'gauge', 'Frames waiting in the buffer for playout'],
+  ['lastRecvAgeMs', 'atolla_sink_last_receive_age_seconds', 'gauge', 'Time since the last datagram while lent', 0.001],
+  ['clockOffsetMs', 'atolla_sink_clock_offset_seconds', 'gauge', 'Estimated source clock minus sink clock while synced to the borrower', 0.001, (stats) => stats.clockRttMs >= 0],
+  ['clockRttMs', 'atolla_sink_clock_rtt_seconds', 'gauge', 'Round trip of the clock sync exchange the source clock is estimated from', 0.001],
+  ['waitingSources', 'atolla_sink_waiting_sources', 'gauge', 'Sources waiting in line to borrow the sink']
+]
+
+const sourceMetrics = [
+  ['sentFrames', 'atolla_source_sent_frames_total', 'counter', 'Frames sent to the sink'],
+  ['retransmittedFrames', 'atolla_source_retransmitted_frames_total', 'counter', 'Frames sent again after a NACK'],
+  ['receivedNacks', 'atolla_source_received_nacks_total', 'counter', 'NACK messages received from the sink'],
+  ['receivedReports', 'atolla_source_received_reports_total', 'counter', 'Receiver reports received from the sink'],
+  ['rttMs', 'atolla_source_rtt_seconds', 'gauge', 'Smoothed round trip time to the sink', 0.001],
+  ['estimatedBufferedFrames', 'atolla_source_estimated_buffered_frames', 'gauge', 'Frames estimated to be buffered in the sink'],
+  ['sinkBufferedFrames', 'atolla_source_sink_buffered_frames', 'gauge', 'Frames buffered in the sink as of the last report'],
+  ['sinkLostFrames', 'atolla_source_sink_lost_frames_total', 'counter', 'Frames the sink reported as lost'],
+  ['sinkJitterMs', 'atolla_source_sink_jitter_seconds', 'gauge', 'Interarrival jitter measured by the sink', 0.001],
+  ['lastLentAgeMs', 'atolla_source_last_lent_age_seconds', 'gauge', 'Time since the sink last confirmed the borrow', 0.001],
+  ['queuePosition', 'atolla_source_queue_position', 'gauge', 'Sources before this one in line for the sink, -1 if not waiting in line']
+]
+
+const sinkStates = ['ATOLLA_SINK_STATE_OPEN', 'ATOLLA_SINK_STATE_LENT', 'ATOLLA_SINK_STATE_ERROR']
+const sourceStates = ['ATOLLA_SOURCE_STATE_WAITING', 'ATOLLA_SOURCE_STATE_OPEN', 'ATOLLA_SOURCE_STATE_ERROR', 'ATOLLA_SOURCE_STATE_CLOSED']
+
+/**
+ * Serves the statistics of sinks and sources in the Prometheus text format
+ * over HTTP, by default at http://127.0.0.1:9464/metrics. Only localhost is
+ * listened on unless another host is given.
+ *
+ * Sinks and sources created with atolla.sink and atolla.source are added
+ * with a name, which becomes the instance label of their metrics:
+ *
+ *    const exporter = atolla.metrics({ port: 9464 })
+ *    exporter.add('stage-left', atolla.sink({ port: 10042, lightsCount: 30 }))
+ *
+ * Statistics are only read while answering a scrape, each sink or source with
+ * a single copy of its counters, so nothing is done between scrapes and the
+ * frame loop is never waited for. Values of -1 meaning unknown, e.g. the
+ * round trip time before the first report, are left out.
+ */
+module.exports = function metrics (spec) {
+  spec = spec || {}
+  const port = (spec.port === undefined) ? defaultPort : spec.port
+  const host = spec.host || defaultHost
+  const instances = new Map()
+
+  const server = http.createServer(handleRequest)
+  server.listen(port, host)
+
+  return {
+    server,
+    /**
+     * Exports the metrics of the given sink or source with the given name as
+     * instance label, replacing anything added with the same name before.
+     */
+    add (name, instance) {
+      if (!instance || typeof instance.stats !== 'function') {
+        throw new TypeError('Only sinks and sources can be added to metrics')
+      }
+      instances.set(String(name), instance)
+    },
+    remove (name) {
+      instances.delete(String(name))
+    },
+    /**
+     * Returns the current metrics in the Prometheus text format.
+     */
+    text,
+    close () {
+      server.close()
+    }
+  }
+
+  function handleRequest (req, res) {
+    if (req.method !== 'GET' || req.url.split('?')[0] !== '/metrics') {
+      res.writeHead(404, { 'Content-Type': 'text/plain' })
+      res.end('Not found, metrics are at /metrics\n')
+      return
+    }
+
+    const body = text()
+    res.writeHead(200, {
+      'Content-Type': 'text/plain; version=0.0.4; charset=utf-8',
+      'Content-Length': Buffer.byteLength(body)
+    })
+    res.end(body)
+  }
+
+  function text () {
+    const sinks = []
+    const sources = []
+
+    for (const [name, instance] of instances) {
+      const stats = instance.stats()
+      if (!stats) { continue } // Closed
+
+      const sample = { label: `instance="${escapeLabel(name)}"`, stats, state: instance.state }
+      if ('sentFrames' in stats) {
+        sources.push(sample)
+      } else {
+        sinks.push(sample)
+      }
+    }
+
+    return format(sinkMetrics, 'atolla_sink_state', sinkStates, sinks) +
+           format(sourceMetrics, 'atolla_source_state', sourceStates, sources)
+  }
+}
+
+function format (metrics, stateName, states, samples) {
+  if (samples.length === 0) { return '' }
+
+  let out = ''
+
+  for (const [prop, name, type, help, scale, known] of metrics) {
+    out += `# HELP ${name} ${help}\n# TYPE ${name} ${type}\n`
+    for (const { label, stats } of samples) {
+      const value = stats[prop]
+      if (typeof value === 'number' && (known ? known(stats) : value >= 0)) {
+        out += `${name}{${label}} ${value * (scale || 1)}\n`
+      }
+    }
+  }
+
+  out += `# HELP ${stateName} Current state, 1 for the state the instance is in\n# TYPE ${stateName} gauge\n`
+  for (const { label, state } of samples) {
+    for (const s of states) {
+      out += `${stateName}{${label},state="${s}"} ${s === state ? 1 : 0}\n`
+    }
+  }
+
+  return out
+}
+
+function escapeLabel (value) {
+  return value.replace(/\\/g, '\\\\').replace(/"/g, '\\"').replace(/\n/g, '\\n')
+}
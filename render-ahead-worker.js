@@ -0,0 +1,85 @@
+const { workerData } = require('worker_threads')
+const { controlViews } = require('./render-ahead')
+
+const {
+  painterModule,
+  workerIdx,
+  workerCount,
+  slotCount,
+  slotLength,
+  frameDurationSeconds,
+  frames,
+  control
+} = workerData
+
+const painter = require(painterModule)
+const { closed, expected, filled, lengths } = controlViews(control, slotCount)
+
+// One view per slot, created once so painting allocates nothing
+const views = []
+for (let slot = 0; slot < slotCount; ++slot) {
+  views.push(new Uint8Array(frames, slot * slotLength, slotLength))
+}
+
+render()
+
+/**
+ * Renders frames ahead of time until the pool is closed. Workers take turns,
+ * so worker w renders the frames w, w + n, w + 2n and so on, each into the slot
+ * frameIdx % slotCount as soon as the source has consumed the previous frame
+ * in that slot.
+ */
+function render () {
+  for (let frameIdx = workerIdx; ; frameIdx += workerCount) {
+    const slot = frameIdx % slotCount
+
+    for (let slotFrame = Atomics.load(expected, slot); slotFrame !== frameIdx; slotFrame = Atomics.load(expected, slot)) {
+      if (Atomics.load(closed, 0) !== 0) {
+        return
+      }
+      Atomics.wait(expected, slot, slotFrame)
+    }
+
+    if (Atomics.load(closed, 0) !== 0) {
+      return
+    }
+
+    Atomics.store(lengths, slot, paint(frameIdx * frameDurationSeconds, views[slot]))
+    Atomics.store(filled, slot, frameIdx)
+  }
+}
+
+/**
+ * Lets the painter draw into the given frame view and returns the amount of
+ * bytes that should be sent.
+ *
+ * Painters are expected to write colors into the view and return nothing, or
+ * the view itself. For convenience, painters may also return a Uint8Array or a
+ * plain array of RGB triplets, which will then be copied into the view. Returned
+ * colors that are shorter than the frame are sent as is and will be repeated by
+ * the sink.
+ *
+ * CSS strings are not supported here, since the native color parser cannot be
+ * loaded into worker threads.
+ */
+function paint (time, view) {
+  const painted = painter(time, view)
+
+  if (painted === undefined || painted === view) {
+    return view.length
+  }
+
+  const length = (painted instanceof Uint8Array || Array.isArray(painted))
+                    ? Math.min(painted.length - painted.length % 3, view.length)
+                    : 0
+
+  if (length === 0) {
+    view[0] = view[1] = view[2] = 0
+    return 3
+  }
+
+  for (let i = 0; i < length; ++i) {
+    view[i] = painted[i]
+  }
+  return length
+}
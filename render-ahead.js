@@ -0,0 +1,124 @@
+const { Worker } = require('worker_threads')
+const os = require('os')
+const path = require('path')
+
+const workerScript = path.join(__dirname, 'render-ahead-worker.js')
+
+/**
+ * Creates a pool of worker threads that call the painter exported by the
+ * module at painterModule ahead of time, so that slow painters do not stall
+ * the main thread and frames are ready when the source can send them.
+ *
+ * Frames are rendered into slotCount preallocated slots of a SharedArrayBuffer
+ * in the order of their timestamps. The source consumes them from the same
+ * memory, so nothing is copied or allocated per frame. Use peek to obtain the
+ * slot of the next frame, if already rendered, then send views[slot] with
+ * lengths[slot] bytes and call advance to hand the slot back to the workers.
+ *
+ * Painter modules export a function that receives the time in seconds and a
+ * Uint8Array to write the RGB triplets of the frame into:
+ *
+ *    module.exports = function paint (time, frame) {
+ *      const brightness = 255 * Math.abs(Math.sin(time))
+ *      frame.fill(brightness)
+ *    }
+ *
+ * If a worker fails, e.g. because the painter threw, onError is called with
+ * the message. Frames of that worker never become ready, so the pool should
+ * be closed then.
+ */
+module.exports = renderAhead
+module.exports.controlViews = controlViews
+
+function renderAhead (spec) {
+  const painterModule = require.resolve(path.resolve(spec.painterModule))
+  const frameDurationSeconds = spec.frameDurationMs / 1000
+  const slotLength = 3 * spec.lightsCount
+  const workerCount = spec.workerCount || Math.max(1, os.cpus().length - 1)
+  const slotCount = Math.max(spec.slotCount || 0, workerCount)
+  const onError = (typeof spec.onError === 'function') ? spec.onError : () => {}
+
+  if (!(slotLength > 0)) {
+    throw new TypeError('lightsCount must be a positive number for rendering ahead')
+  }
+
+  const frames = new SharedArrayBuffer(slotCount * slotLength)
+  const control = new SharedArrayBuffer(4 + 12 * slotCount)
+  const { closed, expected, filled, lengths } = controlViews(control, slotCount)
+
+  const views = []
+  for (let slot = 0; slot < slotCount; ++slot) {
+    views.push(new Uint8Array(frames, slot * slotLength, slotLength))
+    expected[slot] = slot
+    filled[slot] = -1
+  }
+
+  const workers = []
+  for (let workerIdx = 0; workerIdx < workerCount; ++workerIdx) {
+    const worker = new Worker(workerScript, {
+      workerData: {
+        painterModule,
+        workerIdx,
+        workerCount,
+        slotCount,
+        slotLength,
+        frameDurationSeconds,
+        frames,
+        control
+      }
+    })
+    worker.on('error', (err) => onError(err.message))
+    workers.push(worker)
+  }
+
+  // Index of the next frame to be consumed by the source
+  let nextFrameIdx = 0
+
+  return {
+    views,
+    lengths,
+    /**
+     * Returns the slot of the next frame if it has been rendered, otherwise -1.
+     */
+    peek () {
+      const slot = nextFrameIdx % slotCount
+      return (Atomics.load(filled, slot) === nextFrameIdx) ? slot : -1
+    },
+    /**
+     * Releases the slot of the current frame so that workers can render into
+     * it again and moves on to the next frame.
+     */
+    advance () {
+      const slot = nextFrameIdx % slotCount
+      Atomics.store(expected, slot, nextFrameIdx + slotCount)
+      Atomics.notify(expected, slot)
+      ++nextFrameIdx
+    },
+    /**
+     * Stops all workers, no more frames will be rendered afterwards.
+     */
+    close () {
+      Atomics.store(closed, 0, 1)
+      for (let slot = 0; slot < slotCount; ++slot) {
+        Atomics.notify(expected, slot)
+      }
+      workers.forEach((worker) => worker.terminate())
+      workers.length = 0
+    }
+  }
+}
+
+/**
+ * Gets typed views into the control block shared between the pool and its
+ * workers: a closed flag, then for each slot the index of the frame that may
+ * be rendered into it, the index of the frame it currently holds and the
+ * amount of bytes to send from it.
+ */
+function controlViews (control, slotCount) {
+  return {
+    closed: new Int32Array(control, 0, 1),
+    expected: new Int32Array(control, 4, slotCount),
+    filled: new Int32Array(control, 4 + 4 * slotCount, slotCount),
+    lengths: new Int32Array(control, 4 + 8 * slotCount, slotCount)
+  }
+}
@@ -0,0 +1,123 @@
+#include "resolver.h"
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace atolla;
+
+// Time in milliseconds that a successfully resolved address is reused
+static const uint64_t resolveCacheTtlMs = 60000;
+
+struct ResolveWaiter {
+    ResolveCallback callback;
+    void* data;
+};
+
+struct ResolveCacheEntry {
+    // Empty if not resolved yet or if the last lookup failed
+    std::string address;
+    uint64_t resolvedTime;
+    bool pending;
+    std::vector<ResolveWaiter> waiters;
+};
+
+static std::map<std::string, ResolveCacheEntry> cache;
+
+static bool IsNumericAddress(const char* hostname);
+
+void Resolver::Resolve(const char* hostname, ResolveCallback callback, void* data) {
+    if(IsNumericAddress(hostname)) {
+        callback(data, hostname);
+        return;
+    }
+
+    uv_loop_t* loop = uv_default_loop();
+    ResolveCacheEntry& entry = cache[hostname];
+
+    if(!entry.pending && !entry.address.empty() &&
+       (uv_now(loop) - entry.resolvedTime) < resolveCacheTtlMs) {
+        callback(data, entry.address.c_str());
+        return;
+    }
+
+    ResolveWaiter waiter = { callback, data };
+    entry.waiters.push_back(waiter);
+
+    if(entry.pending) {
+        // Will be called back with the result of the lookup already running
+        return;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    uv_getaddrinfo_t* req = new uv_getaddrinfo_t;
+    req->data = new std::string(hostname);
+    entry.pending = true;
+
+    int err = uv_getaddrinfo(loop, req, OnResolved, hostname, NULL, &hints);
+    if(err != 0) {
+        // Could not even start the lookup, fail like a failed lookup would
+        OnResolved(req, err, NULL);
+    }
+}
+
+void Resolver::Cancel(void* data) {
+    for(std::map<std::string, ResolveCacheEntry>::iterator it = cache.begin(); it != cache.end(); ++it) {
+        std::vector<ResolveWaiter>& waiters = it->second.waiters;
+        for(size_t i = 0; i < waiters.size();) {
+            if(waiters[i].data == data) {
+                waiters.erase(waiters.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+    }
+}
+
+void Resolver::OnResolved(uv_getaddrinfo_t* req, int status, struct addrinfo* res) {
+    std::string* hostname = static_cast<std::string*>(req->data);
+    ResolveCacheEntry& entry = cache[*hostname];
+
+    entry.address.clear();
+    if(status == 0 && res != NULL) {
+        char address[64];
+        int err;
+        if(res->ai_family == AF_INET6) {
+            err = uv_ip6_name(reinterpret_cast<struct sockaddr_in6*>(res->ai_addr), address, sizeof(address));
+        } else {
+            err = uv_ip4_name(reinterpret_cast<struct sockaddr_in*>(res->ai_addr), address, sizeof(address));
+        }
+
+        if(err == 0) {
+            entry.address = address;
+            entry.resolvedTime = uv_now(uv_default_loop());
+        }
+    }
+    entry.pending = false;
+
+    // Callbacks may resolve again or cancel, so work on a copy of the waiters
+    std::vector<ResolveWaiter> waiters;
+    waiters.swap(entry.waiters);
+    std::string address = entry.address;
+
+    uv_freeaddrinfo(res);
+    delete hostname;
+    delete req;
+
+    for(size_t i = 0; i < waiters.size(); ++i) {
+        waiters[i].callback(waiters[i].data, address.empty() ? NULL : address.c_str());
+    }
+}
+
+static bool IsNumericAddress(const char* hostname) {
+    unsigned char addr[sizeof(struct in6_addr)];
+    return uv_inet_pton(AF_INET, hostname, addr) == 0 ||
+           uv_inet_pton(AF_INET6, hostname, addr) == 0;
+}
@@ -0,0 +1,40 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <uv.h>
+
+namespace atolla {
+  /**
+   * Called with the numeric address a hostname resolved to, or with NULL if it
+   * could not be resolved. The address is only valid during the call.
+   */
+  typedef void (*ResolveCallback)(void* data, const char* address);
+
+  /**
+   * Resolves hostnames on the libuv threadpool instead of blocking the event
+   * loop. Results are cached per hostname for a while and concurrent requests
+   * for the same hostname share a single lookup, so many sources connecting to
+   * the same sinks only resolve once, while different hosts resolve in
+   * parallel.
+   */
+  class Resolver {
+  public:
+    /**
+     * Resolves the given hostname and calls back with the result. If the
+     * hostname is a numeric address or cached, the callback is invoked before
+     * returning, otherwise from the event loop once the lookup is done.
+     */
+    static void Resolve(const char* hostname, ResolveCallback callback, void* data);
+
+    /**
+     * Cancels all pending callbacks with the given data, e.g. before freeing
+     * the data.
+     */
+    static void Cancel(void* data);
+
+  private:
+    static void OnResolved(uv_getaddrinfo_t* req, int status, struct addrinfo* res);
+  };
+}
+
+#endif // RESOLVER_H
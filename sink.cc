@@ -2,6 +2,7 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <vector>
 
 using namespace v8;
 using namespace atolla;
@@ -29,6 +30,12 @@ void Sink::Init(Handle<Object> exports) {
   NODE_SET_PROTOTYPE_METHOD(tpl, "state", State);
   NODE_SET_PROTOTYPE_METHOD(tpl, "errorMsg", ErrorMsg);
   NODE_SET_PROTOTYPE_METHOD(tpl, "get", Get);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "stats", Stats);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "capture", Capture);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "stopCapture", StopCapture);
+#ifdef ATOLLA_ENABLE_TRACE
+  NODE_SET_PROTOTYPE_METHOD(tpl, "trace", Trace);
+#endif
 
   constructor.Reset(isolate, tpl->GetFunction());
   exports->Set(String::NewFromUtf8(isolate, "Sink"),
@@ -170,3 +177,83 @@ void Sink::Get(const FunctionCallbackInfo<Value>& args) {
 
     args.GetReturnValue().Set(Boolean::New(isolate, ok));
 }
+
+void Sink::Stats(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Sink* obj = ObjectWrap::Unwrap<Sink>(args.Holder());
+
+    AtollaSinkStats stats;
+    atolla_sink_stats(obj->atollaSink, &stats);
+
+    Local<Object> statsObj = Object::New(isolate);
+    statsObj->Set(String::NewFromUtf8(isolate, "receivedFrames"), Number::New(isolate, stats.received_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "lostFrames"), Number::New(isolate, stats.lost_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "fecRecoveredFrames"), Number::New(isolate, stats.fec_recovered_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "lateRecoveredFrames"), Number::New(isolate, stats.late_recovered_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "tooLateFrames"), Number::New(isolate, stats.too_late_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "sentNacks"), Number::New(isolate, stats.sent_nacks));
+    statsObj->Set(String::NewFromUtf8(isolate, "receivedPackets"), Number::New(isolate, stats.received_packets));
+    statsObj->Set(String::NewFromUtf8(isolate, "malformedPackets"), Number::New(isolate, stats.malformed_packets));
+    statsObj->Set(String::NewFromUtf8(isolate, "bufferedFrames"), Number::New(isolate, stats.buffered_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "lastRecvAgeMs"), Number::New(isolate, stats.last_recv_age_ms));
+    statsObj->Set(String::NewFromUtf8(isolate, "clockOffsetMs"), Number::New(isolate, stats.clock_offset_ms));
+    statsObj->Set(String::NewFromUtf8(isolate, "clockRttMs"), Number::New(isolate, stats.clock_rtt_ms));
+    statsObj->Set(String::NewFromUtf8(isolate, "waitingSources"), Number::New(isolate, stats.waiting_sources));
+
+    args.GetReturnValue().Set(statsObj);
+}
+
+/**
+ * Starts capturing received datagrams into the file at the path given as the
+ * first argument, returns false if the file could not be created or captures
+ * are not supported on the platform.
+ */
+void Sink::Capture(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Sink* obj = ObjectWrap::Unwrap<Sink>(args.Holder());
+
+    if(!args[0]->IsString()) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Capture path is not a string")));
+        return;
+    }
+
+    String::Utf8Value path(args[0]);
+    bool ok = atolla_sink_capture_start(obj->atollaSink, *path);
+
+    args.GetReturnValue().Set(Boolean::New(isolate, ok));
+}
+
+void Sink::StopCapture(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Sink* obj = ObjectWrap::Unwrap<Sink>(args.Holder());
+    atolla_sink_capture_stop(obj->atollaSink);
+}
+
+#ifdef ATOLLA_ENABLE_TRACE
+/**
+ * Returns the recent frame events as comma separated Chrome trace events,
+ * with the process ID given as the first argument, so that the events of
+ * multiple instances can be joined with commas and wrapped in brackets.
+ */
+void Sink::Trace(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Sink* obj = ObjectWrap::Unwrap<Sink>(args.Holder());
+    int pid = (args.Length() > 0 && args[0]->IsNumber()) ? (int) args[0]->NumberValue() : 1;
+
+    size_t len = atolla_sink_trace_json(obj->atollaSink, pid, "sink", NULL, 0);
+    std::vector<char> json(len + 1);
+    atolla_sink_trace_json(obj->atollaSink, pid, "sink", json.data(), json.size());
+
+    args.GetReturnValue().Set(String::NewFromUtf8(isolate, json.data(), String::kNormalString, (int) len));
+}
+#endif
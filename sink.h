@@ -19,6 +19,12 @@ namespace atolla {
     static void State(const v8::FunctionCallbackInfo<v8::Value>& args);
     static void ErrorMsg(const v8::FunctionCallbackInfo<v8::Value>& args);
     static void Get(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void Stats(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void Capture(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void StopCapture(const v8::FunctionCallbackInfo<v8::Value>& args);
+#ifdef ATOLLA_ENABLE_TRACE
+    static void Trace(const v8::FunctionCallbackInfo<v8::Value>& args);
+#endif
     static v8::Persistent<v8::Function> constructor;
 
     static bool ParseSpecFromArgs(const v8::FunctionCallbackInfo<v8::Value>& args, AtollaSinkSpec& spec);
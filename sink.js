@@ -45,7 +45,29 @@ module.exports = function sink (spec) {
     get state () {
       return lastState
     },
-    close () { sink = undefined }
+    /**
+     * Returns an object with statistics about received, lost and recovered
+     * frames, or undefined after closing the sink.
+     */
+    stats () {
+      return sink ? sink.stats() : undefined
+    },
+    /**
+     * Records every received datagram with its arrival time and sender into
+     * the file at the given path, until stopCapture or close is called. The
+     * capture can be replayed with bench/replay.cpp. Returns false if the
+     * file could not be created, or on Windows.
+     */
+    capture (path) {
+      return sink ? sink.capture(path) : false
+    },
+    stopCapture () {
+      if (sink) { sink.stopCapture() }
+    },
+    close () {
+      if (sink) { sink.stopCapture() }
+      sink = undefined
+    }
   }
 
   /**
@@ -1,4 +1,5 @@
 #include "source.h"
+#include "resolver.h"
 
 #include <cstring>
 #include <cstdlib>
@@ -8,12 +9,59 @@ using namespace atolla;
 
 Persistent<Function> Source::constructor;
 
+// Poll interval for the pump timer while the source is still waiting for the sink
+static const uint64_t pumpWaitingIntervalMs = 10;
+// Frames in a single call to putMany, the sink cannot buffer more than that
+static const int maxPutManyFrames = 255;
+
 Source::Source(const AtollaSourceSpec* spec) {
   atollaSource = atolla_source_make(spec);
+
+  pumpTimer = new uv_timer_t;
+  uv_timer_init(uv_default_loop(), pumpTimer);
+  pumpTimer->data = this;
+  queuedFrames = 0;
+
+  // Stays waiting without blocking the event loop until the sink is resolved
+  Resolver::Resolve(spec->sink_hostname, Resolved, this);
 }
 
 Source::~Source() {
+  Free();
+}
+
+/**
+ * Frees the atolla source, stops the pump and drops the promises that are
+ * still pending. Does nothing if the source has already been freed.
+ */
+void Source::Free() {
+  if(atollaSource.internal == NULL) {
+    return;
+  }
+
+  Resolver::Cancel(this);
+
+  // The timer handle outlives the source until libuv is done closing it
+  uv_timer_stop(pumpTimer);
+  pumpTimer->data = NULL;
+  uv_close(reinterpret_cast<uv_handle_t*>(pumpTimer), [](uv_handle_t* handle) {
+    delete reinterpret_cast<uv_timer_t*>(handle);
+  });
+
+  // Promises of frames that were never sent will not settle anymore
+  for(size_t i = 0; i < queuedPuts.size(); ++i) {
+    queuedPuts[i].resolver->Reset();
+    delete queuedPuts[i].resolver;
+  }
+  for(size_t i = 0; i < overflowPuts.size(); ++i) {
+    overflowPuts[i].resolver->Reset();
+    delete overflowPuts[i].resolver;
+  }
+  queuedPuts.clear();
+  overflowPuts.clear();
+
   atolla_source_free(atollaSource);
+  atollaSource.internal = NULL;
 }
 
 void Source::Init(Handle<Object> exports) {
@@ -29,6 +77,18 @@ void Source::Init(Handle<Object> exports) {
   NODE_SET_PROTOTYPE_METHOD(tpl, "putReadyCount", PutReadyCount);
   NODE_SET_PROTOTYPE_METHOD(tpl, "putReadyTimeout", PutReadyTimeout);
   NODE_SET_PROTOTYPE_METHOD(tpl, "put", Put);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "putQueued", PutQueued);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "putAsync", PutAsync);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "putMany", PutMany);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "putTimed", PutTimed);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "clockMs", ClockMs);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "queueLength", QueueLength);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "queueCapacity", QueueCapacity);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "stats", Stats);
+  NODE_SET_PROTOTYPE_METHOD(tpl, "close", Close);
+#ifdef ATOLLA_ENABLE_TRACE
+  NODE_SET_PROTOTYPE_METHOD(tpl, "trace", Trace);
+#endif
   NODE_SET_PROTOTYPE_METHOD(tpl, "errorMsg", ErrorMsg);
 
   constructor.Reset(isolate, tpl->GetFunction());
@@ -201,12 +261,131 @@ bool Source::ParseSpecFromArgs(const FunctionCallbackInfo<Value>& args, AtollaSo
       }
   }
 
+  MaybeLocal<Value> maxQueuedFramesMaybeVal = spec->Get(context, String::NewFromUtf8(isolate, "maxQueuedFrames"));
+  int maxQueuedFrames;
+  if(maxQueuedFramesMaybeVal.IsEmpty()) {
+      // Let implementation pick default value
+      maxQueuedFrames = 0;
+  } else {
+      Local<Value> maxQueuedFramesVal = maxQueuedFramesMaybeVal.ToLocalChecked();
+
+      if(maxQueuedFramesVal->IsUndefined() || maxQueuedFramesVal->IsNull()) {
+          // Let implementation pick default value
+          maxQueuedFrames = 0;
+      } else if(!maxQueuedFramesVal->IsNumber()) {
+          isolate->ThrowException(
+              Exception::TypeError(
+                  String::NewFromUtf8(isolate, "maxQueuedFrames property must have a value of type Number")));
+          return false;
+      } else {
+          maxQueuedFrames = (int) maxQueuedFramesVal->NumberValue();
+          if(maxQueuedFrames < 0 || maxQueuedFrames > 1024)
+          {
+              isolate->ThrowException(
+                  Exception::TypeError(
+                      String::NewFromUtf8(isolate, "maxQueuedFrames property must be in range 0..1024")));
+              return false;
+          }
+      }
+  }
+
+  MaybeLocal<Value> fecGroupSizeMaybeVal = spec->Get(context, String::NewFromUtf8(isolate, "fecGroupSize"));
+  int fecGroupSize;
+  if(fecGroupSizeMaybeVal.IsEmpty()) {
+      // Forward error correction is disabled by default
+      fecGroupSize = 0;
+  } else {
+      Local<Value> fecGroupSizeVal = fecGroupSizeMaybeVal.ToLocalChecked();
+
+      if(fecGroupSizeVal->IsUndefined() || fecGroupSizeVal->IsNull()) {
+          // Forward error correction is disabled by default
+          fecGroupSize = 0;
+      } else if(!fecGroupSizeVal->IsNumber()) {
+          isolate->ThrowException(
+              Exception::TypeError(
+                  String::NewFromUtf8(isolate, "fecGroupSize property must have a value of type Number")));
+          return false;
+      } else {
+          fecGroupSize = (int) fecGroupSizeVal->NumberValue();
+          if(fecGroupSize < 0 || fecGroupSize > 128)
+          {
+              isolate->ThrowException(
+                  Exception::TypeError(
+                      String::NewFromUtf8(isolate, "fecGroupSize property must be in range 0..128")));
+              return false;
+          }
+      }
+  }
+
+  Local<Value> retransmitVal = spec->Get(context, String::NewFromUtf8(isolate, "retransmitLostFrames")).ToLocalChecked();
+  bool retransmit;
+  if(retransmitVal->IsUndefined() || retransmitVal->IsNull()) {
+      // Retransmission is disabled by default
+      retransmit = false;
+  } else if(!retransmitVal->IsBoolean()) {
+      isolate->ThrowException(
+          Exception::TypeError(
+              String::NewFromUtf8(isolate, "retransmitLostFrames property must have a value of type Boolean")));
+      return false;
+  } else {
+      retransmit = retransmitVal->BooleanValue();
+  }
+
+  Local<Value> queueBorrowVal = spec->Get(context, String::NewFromUtf8(isolate, "queueBorrow")).ToLocalChecked();
+  bool queueBorrow;
+  if(queueBorrowVal->IsUndefined() || queueBorrowVal->IsNull()) {
+      // Fail if the sink is lent to another source by default
+      queueBorrow = false;
+  } else if(!queueBorrowVal->IsBoolean()) {
+      isolate->ThrowException(
+          Exception::TypeError(
+              String::NewFromUtf8(isolate, "queueBorrow property must have a value of type Boolean")));
+      return false;
+  } else {
+      queueBorrow = queueBorrowVal->BooleanValue();
+  }
+
+  Local<Value> handoverVal = spec->Get(context, String::NewFromUtf8(isolate, "handover")).ToLocalChecked();
+  bool handover;
+  if(handoverVal->IsUndefined() || handoverVal->IsNull()) {
+      // Frames of the source before are dropped by default
+      handover = false;
+  } else if(!handoverVal->IsBoolean()) {
+      isolate->ThrowException(
+          Exception::TypeError(
+              String::NewFromUtf8(isolate, "handover property must have a value of type Boolean")));
+      return false;
+  } else {
+      handover = handoverVal->BooleanValue();
+  }
+
+  Local<Value> syncClockVal = spec->Get(context, String::NewFromUtf8(isolate, "syncClock")).ToLocalChecked();
+  bool syncClock;
+  if(syncClockVal->IsUndefined() || syncClockVal->IsNull()) {
+      // Presentation times are relative to the first timed frame by default
+      syncClock = false;
+  } else if(!syncClockVal->IsBoolean()) {
+      isolate->ThrowException(
+          Exception::TypeError(
+              String::NewFromUtf8(isolate, "syncClock property must have a value of type Boolean")));
+      return false;
+  } else {
+      syncClock = syncClockVal->BooleanValue();
+  }
+
   parsed.sink_hostname = strdup(*String::Utf8Value(hostnameVal->ToString()));
   parsed.sink_port = (int) portVal->NumberValue();
   parsed.frame_duration_ms = (int) frameDurationVal->NumberValue();
   parsed.max_buffered_frames = maxBufferedFrames;
   parsed.retry_timeout_ms = retryTimeout;
   parsed.disconnect_timeout_ms = disconnectTimeout;
+  parsed.max_queued_frames = maxQueuedFrames;
+  parsed.fec_group_size = fecGroupSize;
+  parsed.retransmit_lost_frames = retransmit;
+  parsed.sync_clock = syncClock;
+  parsed.queue_borrow = queueBorrow;
+  parsed.handover = handover;
+  parsed.defer_resolve = true;
   parsed.async_make = true;
 
   return true;
@@ -216,7 +395,10 @@ void Source::State(const FunctionCallbackInfo<Value>& args) {
   Isolate* isolate = Isolate::GetCurrent();
   HandleScope scope(isolate);
 
-  Source* obj = ObjectWrap::Unwrap<Source>(args.Holder());
+  Source* obj = UnwrapOpen(args);
+  if(obj == NULL) {
+    return;
+  }
 
   AtollaSourceState state = atolla_source_state(obj->atollaSource);
   const char* stateStr = NULL;
@@ -241,7 +423,10 @@ void Source::ErrorMsg(const v8::FunctionCallbackInfo<v8::Value>& args) {
     Isolate* isolate = Isolate::GetCurrent();
     HandleScope scope(isolate);
   
-    Source* obj = ObjectWrap::Unwrap<Source>(args.Holder());
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
   
     const char* msg = atolla_source_error_msg(obj->atollaSource);
   
@@ -252,7 +437,10 @@ void Source::PutReadyCount(const v8::FunctionCallbackInfo<v8::Value>& args) {
     Isolate* isolate = Isolate::GetCurrent();
     HandleScope scope(isolate);
   
-    Source* obj = ObjectWrap::Unwrap<Source>(args.Holder());
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
   
     double count = atolla_source_put_ready_count(obj->atollaSource);
   
@@ -263,7 +451,10 @@ void Source::PutReadyTimeout(const v8::FunctionCallbackInfo<v8::Value>& args) {
     Isolate* isolate = Isolate::GetCurrent();
     HandleScope scope(isolate);
   
-    Source* obj = ObjectWrap::Unwrap<Source>(args.Holder());
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
   
     double timeout = atolla_source_put_ready_timeout(obj->atollaSource);
   
@@ -274,7 +465,68 @@ void Source::Put(const v8::FunctionCallbackInfo<v8::Value>& args) {
     Isolate* isolate = Isolate::GetCurrent();
     HandleScope scope(isolate);
   
-    Source* obj = ObjectWrap::Unwrap<Source>(args.Holder());
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+
+    if(args.Length() < 1) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "No frame argument given")));
+        return;
+    }
+
+    if(!args[0]->IsUint8Array()) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Frame argument is not a Uint8Array")));
+        return;
+    }
+
+    Local<Uint8Array> ui8 = args[0].As<Uint8Array>();
+    v8::ArrayBuffer::Contents ui8_c = ui8->Buffer()->GetContents();
+    const size_t ui8_offset = ui8->ByteOffset();
+    const size_t ui8_length = ui8->ByteLength();
+    char* const ui8_data = static_cast<char*>(ui8_c.Data()) + ui8_offset;
+    if (ui8_length > 0)
+      assert(ui8_data != nullptr);
+
+    // Optionally only send the first bytes, so callers can reuse a single
+    // view of a frame with varying lengths without creating subarrays
+    size_t frame_length = ui8_length;
+    if(args.Length() >= 2 && !args[1]->IsUndefined()) {
+        if(!args[1]->IsNumber()) {
+            isolate->ThrowException(
+                Exception::TypeError(
+                    String::NewFromUtf8(isolate, "Frame length argument must be of type Number")));
+            return;
+        }
+
+        double length = args[1]->NumberValue();
+        if(length < 0 || length > ui8_length) {
+            isolate->ThrowException(
+                Exception::TypeError(
+                    String::NewFromUtf8(isolate, "Frame length argument must be in range 0..frame.length")));
+            return;
+        }
+
+        frame_length = (size_t) length;
+    }
+
+    bool ok = atolla_source_put(obj->atollaSource, ui8_data, frame_length);
+  
+    args.GetReturnValue().Set(Boolean::New(isolate, ok));
+}
+
+void Source::PutQueued(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+  
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
 
     if(args.Length() < 1) {
         isolate->ThrowException(
@@ -298,7 +550,466 @@ void Source::Put(const v8::FunctionCallbackInfo<v8::Value>& args) {
     if (ui8_length > 0)
       assert(ui8_data != nullptr);
 
-    bool ok = atolla_source_put(obj->atollaSource, ui8_data, ui8_length);
+    // Only copies the frame, sending happens later in the pump timer, so that
+    // frames queued in the same tick are all sent at once. Frames waiting for
+    // room after putAsync go first.
+    bool ok = obj->overflowPuts.empty() &&
+              atolla_source_put_queued(obj->atollaSource, ui8_data, ui8_length);
+    if(ok) {
+        ++obj->queuedFrames;
+        obj->SchedulePump(0);
+    }
+  
+    args.GetReturnValue().Set(Boolean::New(isolate, ok));
+}
+
+/**
+ * putTimed(frame, presentationTimeMs) sends the frame to be shown at the given
+ * presentation time, which refers to the clock returned by clockMs if the
+ * source was created with syncClock, or else to the first timed frame. Might
+ * block like put while the sink has no room.
+ */
+void Source::PutTimed(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+  
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+
+    if(args.Length() < 2) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Frame and presentation time arguments required")));
+        return;
+    }
+
+    if(!args[0]->IsUint8Array()) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Frame argument is not a Uint8Array")));
+        return;
+    }
+
+    if(!args[1]->IsNumber() || args[1]->NumberValue() < 0) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Presentation time argument must be a non-negative Number")));
+        return;
+    }
+
+    Local<Uint8Array> ui8 = args[0].As<Uint8Array>();
+    v8::ArrayBuffer::Contents ui8_c = ui8->Buffer()->GetContents();
+    const size_t ui8_offset = ui8->ByteOffset();
+    const size_t ui8_length = ui8->ByteLength();
+    char* const ui8_data = static_cast<char*>(ui8_c.Data()) + ui8_offset;
+    if (ui8_length > 0)
+      assert(ui8_data != nullptr);
+
+    const unsigned int presentationTimeMs = (unsigned int) args[1]->NumberValue();
+    bool ok = atolla_source_put_timed(obj->atollaSource, ui8_data, ui8_length, presentationTimeMs);
   
     args.GetReturnValue().Set(Boolean::New(isolate, ok));
 }
+
+void Source::ClockMs(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+  
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+  
+    double clock = atolla_source_clock_ms(obj->atollaSource);
+  
+    args.GetReturnValue().Set(Number::New(isolate, clock));
+}
+
+/**
+ * putAsync(frame) queues the frame like putQueued, but returns a Promise that
+ * resolves to true once the frame has actually been sent, or to false if the
+ * source failed before sending it. If the queue is full, the frame waits for
+ * room instead of being refused. No call ever sleeps, sending is paced by the
+ * pump timer.
+ */
+void Source::PutAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+  
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+
+    if(args.Length() < 1) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "No frame argument given")));
+        return;
+    }
+
+    if(!args[0]->IsUint8Array()) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Frame argument is not a Uint8Array")));
+        return;
+    }
+
+    Local<Uint8Array> ui8 = args[0].As<Uint8Array>();
+    v8::ArrayBuffer::Contents ui8_c = ui8->Buffer()->GetContents();
+    const size_t ui8_offset = ui8->ByteOffset();
+    const size_t ui8_length = ui8->ByteLength();
+    char* const ui8_data = static_cast<char*>(ui8_c.Data()) + ui8_offset;
+    if (ui8_length > 0)
+      assert(ui8_data != nullptr);
+
+    Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate);
+    args.GetReturnValue().Set(resolver->GetPromise());
+
+    if(atolla_source_state(obj->atollaSource) == ATOLLA_SOURCE_STATE_ERROR) {
+        resolver->Resolve(Boolean::New(isolate, false));
+        return;
+    }
+
+    PendingPut pending;
+    pending.resolver = new Persistent<Promise::Resolver>(isolate, resolver);
+
+    if(obj->overflowPuts.empty() &&
+       atolla_source_put_queued(obj->atollaSource, ui8_data, ui8_length)) {
+        pending.frameSeq = ++obj->queuedFrames;
+        obj->queuedPuts.push_back(pending);
+    } else {
+        pending.frameSeq = 0;
+        pending.frame.assign(ui8_data, ui8_data + ui8_length);
+        obj->overflowPuts.push_back(pending);
+    }
+
+    obj->SchedulePump(0);
+}
+
+/**
+ * putMany(frames, frameCount) passes frameCount frames to the source at once,
+ * either as a single Uint8Array holding frames of equal length back to back,
+ * or as an array of Uint8Arrays, of which the first frameCount are used if
+ * given. Frames the sink has room for are sent right away with a single state
+ * update and in as few datagrams as possible, the rest is queued like with
+ * putQueued. Never sleeps and returns how many frames were accepted, counting
+ * from the first one.
+ */
+void Source::PutMany(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+  
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+
+    if(args.Length() < 1) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "No frames argument given")));
+        return;
+    }
+
+    if(!args[0]->IsUint8Array() && !args[0]->IsArray()) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Frames argument is neither a Uint8Array nor an Array")));
+        return;
+    }
+
+    double frameCount;
+    if(args.Length() >= 2 && !args[1]->IsUndefined()) {
+        if(!args[1]->IsNumber()) {
+            isolate->ThrowException(
+                Exception::TypeError(
+                    String::NewFromUtf8(isolate, "Frame count argument must be of type Number")));
+            return;
+        }
+        frameCount = args[1]->NumberValue();
+    } else if(args[0]->IsArray()) {
+        frameCount = args[0].As<Array>()->Length();
+    } else {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Frame count argument is required for a contiguous buffer")));
+        return;
+    }
+
+    if(frameCount < 0 || frameCount > maxPutManyFrames || frameCount != (double) (int) frameCount) {
+        isolate->ThrowException(
+            Exception::TypeError(
+                String::NewFromUtf8(isolate, "Frame count argument must be an integer in range 0..255")));
+        return;
+    }
+
+    const int count = (int) frameCount;
+    void* frames[maxPutManyFrames];
+    size_t frameLens[maxPutManyFrames];
+
+    if(args[0]->IsUint8Array()) {
+        Local<Uint8Array> ui8 = args[0].As<Uint8Array>();
+        v8::ArrayBuffer::Contents ui8_c = ui8->Buffer()->GetContents();
+        const size_t ui8_offset = ui8->ByteOffset();
+        const size_t ui8_length = ui8->ByteLength();
+        char* const ui8_data = static_cast<char*>(ui8_c.Data()) + ui8_offset;
+        if (ui8_length > 0)
+          assert(ui8_data != nullptr);
+
+        if(count > 0 && ui8_length % count != 0) {
+            isolate->ThrowException(
+                Exception::TypeError(
+                    String::NewFromUtf8(isolate, "Frames length must be a multiple of the frame count")));
+            return;
+        }
+
+        const size_t frameLen = (count > 0) ? ui8_length / count : 0;
+        for(int i = 0; i < count; ++i) {
+            frames[i] = ui8_data + i * frameLen;
+            frameLens[i] = frameLen;
+        }
+    } else {
+        Local<Array> array = args[0].As<Array>();
+        if(count > (int) array->Length()) {
+            isolate->ThrowException(
+                Exception::TypeError(
+                    String::NewFromUtf8(isolate, "Frame count argument exceeds the length of the frames array")));
+            return;
+        }
+
+        for(int i = 0; i < count; ++i) {
+            Local<Value> frame = array->Get(i);
+            if(!frame->IsUint8Array()) {
+                isolate->ThrowException(
+                    Exception::TypeError(
+                        String::NewFromUtf8(isolate, "Frames array contains an element that is not a Uint8Array")));
+                return;
+            }
+
+            Local<Uint8Array> ui8 = frame.As<Uint8Array>();
+            v8::ArrayBuffer::Contents ui8_c = ui8->Buffer()->GetContents();
+            frames[i] = static_cast<char*>(ui8_c.Data()) + ui8->ByteOffset();
+            frameLens[i] = ui8->ByteLength();
+        }
+    }
+
+    // Frames waiting for room after putAsync go first, sending some of the
+    // given frames right away would overtake them
+    int accepted = 0;
+    if(obj->overflowPuts.empty()) {
+        accepted = atolla_source_put_many(obj->atollaSource, frames, frameLens, count);
+
+        while(accepted < count &&
+              atolla_source_put_queued(obj->atollaSource, frames[accepted], frameLens[accepted])) {
+            ++obj->queuedFrames;
+            ++accepted;
+        }
+
+        if(atolla_source_queue_length(obj->atollaSource) > 0) {
+            obj->SchedulePump(0);
+        }
+    }
+
+    args.GetReturnValue().Set(Number::New(isolate, accepted));
+}
+
+void Source::QueueLength(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+  
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+  
+    double length = atolla_source_queue_length(obj->atollaSource);
+  
+    args.GetReturnValue().Set(Number::New(isolate, length));
+}
+
+void Source::QueueCapacity(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+  
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+  
+    double capacity = atolla_source_queue_capacity(obj->atollaSource);
+  
+    args.GetReturnValue().Set(Number::New(isolate, capacity));
+}
+
+void Source::Stats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+  
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+  
+    AtollaSourceStats stats;
+    atolla_source_stats(obj->atollaSource, &stats);
+
+    Local<Object> statsObj = Object::New(isolate);
+    statsObj->Set(String::NewFromUtf8(isolate, "sentFrames"), Number::New(isolate, stats.sent_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "retransmittedFrames"), Number::New(isolate, stats.retransmitted_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "receivedNacks"), Number::New(isolate, stats.received_nacks));
+    statsObj->Set(String::NewFromUtf8(isolate, "receivedReports"), Number::New(isolate, stats.received_reports));
+    statsObj->Set(String::NewFromUtf8(isolate, "rttMs"), Number::New(isolate, stats.rtt_ms));
+    statsObj->Set(String::NewFromUtf8(isolate, "estimatedBufferedFrames"), Number::New(isolate, stats.estimated_buffered_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "pacingCorrectionMs"), Number::New(isolate, stats.pacing_correction_ms));
+    statsObj->Set(String::NewFromUtf8(isolate, "sinkBufferedFrames"), Number::New(isolate, stats.sink_buffered_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "sinkPlayedFrameIdx"), Number::New(isolate, stats.sink_played_frame_idx));
+    statsObj->Set(String::NewFromUtf8(isolate, "sinkLostFrames"), Number::New(isolate, stats.sink_lost_frames));
+    statsObj->Set(String::NewFromUtf8(isolate, "sinkJitterMs"), Number::New(isolate, stats.sink_jitter_ms));
+    statsObj->Set(String::NewFromUtf8(isolate, "lastLentAgeMs"), Number::New(isolate, stats.last_lent_age_ms));
+    statsObj->Set(String::NewFromUtf8(isolate, "queuePosition"), Number::New(isolate, stats.queue_position));
+  
+    args.GetReturnValue().Set(statsObj);
+}
+
+#ifdef ATOLLA_ENABLE_TRACE
+/**
+ * Returns the recent frame events as comma separated Chrome trace events,
+ * with the process ID given as the first argument, so that the events of
+ * multiple instances can be joined with commas and wrapped in brackets.
+ */
+void Source::Trace(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    Source* obj = UnwrapOpen(args);
+    if(obj == NULL) {
+        return;
+    }
+    int pid = (args.Length() > 0 && args[0]->IsNumber()) ? (int) args[0]->NumberValue() : 1;
+
+    size_t len = atolla_source_trace_json(obj->atollaSource, pid, "source", NULL, 0);
+    std::vector<char> json(len + 1);
+    atolla_source_trace_json(obj->atollaSource, pid, "source", json.data(), json.size());
+
+    args.GetReturnValue().Set(String::NewFromUtf8(isolate, json.data(), String::kNormalString, (int) len));
+}
+#endif
+
+/**
+ * close() frees the source right away instead of waiting for the garbage
+ * collector, so that the sink is released at once. Promises of frames that
+ * have not been sent yet resolve to false. Calling any other method after
+ * closing throws, closing again does nothing.
+ */
+void Source::Close(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Source* obj = ObjectWrap::Unwrap<Source>(args.Holder());
+
+    if(obj->atollaSource.internal != NULL) {
+        obj->SettlePutPromises(ATOLLA_SOURCE_STATE_ERROR);
+        obj->Free();
+    }
+}
+
+/**
+ * Unwraps the source of a method call, or throws and returns NULL if the
+ * source has already been closed.
+ */
+Source* Source::UnwrapOpen(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    Source* obj = ObjectWrap::Unwrap<Source>(args.Holder());
+
+    if(obj->atollaSource.internal == NULL) {
+        Isolate* isolate = args.GetIsolate();
+        isolate->ThrowException(
+            Exception::Error(
+                String::NewFromUtf8(isolate, "Source has already been closed")));
+        return NULL;
+    }
+
+    return obj;
+}
+
+void Source::Resolved(void* data, const char* address) {
+    Source* obj = static_cast<Source*>(data);
+    atolla_source_resolved(obj->atollaSource, address);
+}
+
+void Source::SchedulePump(uint64_t timeoutMs) {
+    // An already scheduled pump will pick up the new frames as well
+    if(!uv_is_active(reinterpret_cast<uv_handle_t*>(pumpTimer))) {
+        uv_timer_start(pumpTimer, Pump, timeoutMs, 0);
+    }
+}
+
+void Source::Pump(uv_timer_t* timer) {
+    Source* obj = static_cast<Source*>(timer->data);
+    if(obj == NULL) {
+        return; // Source is being destroyed
+    }
+
+    // Updating the state sends all queued frames the sink has room for
+    AtollaSourceState state = atolla_source_state(obj->atollaSource);
+    if(obj->SettlePutPromises(state)) {
+        // Called from the pump timer rather than from JS, so promise reactions
+        // would otherwise wait for the next unrelated callback
+        Isolate::GetCurrent()->RunMicrotasks();
+    }
+
+    if(state != ATOLLA_SOURCE_STATE_ERROR && atolla_source_queue_length(obj->atollaSource) > 0) {
+        // A zero timeout with frames left means sending failed, retry shortly
+        int timeout = atolla_source_put_ready_timeout(obj->atollaSource);
+        obj->SchedulePump((timeout < 0) ? pumpWaitingIntervalMs : (uint64_t) (timeout > 0 ? timeout : 1));
+    }
+}
+
+/**
+ * Resolves the promises of frames that have been sent since the last call and
+ * moves frames waiting for room into the queue. If the source failed, all
+ * remaining promises resolve to false. Returns whether any promise settled.
+ */
+bool Source::SettlePutPromises(AtollaSourceState state) {
+    if(queuedPuts.empty() && overflowPuts.empty()) {
+        return false;
+    }
+
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+
+    const bool failed = state == ATOLLA_SOURCE_STATE_ERROR;
+    const uint64_t sentFrames = queuedFrames - atolla_source_queue_length(atollaSource);
+    bool settled = false;
+
+    while(!queuedPuts.empty() && (failed || queuedPuts.front().frameSeq <= sentFrames)) {
+        PendingPut& pending = queuedPuts.front();
+        Local<Promise::Resolver> resolver = Local<Promise::Resolver>::New(isolate, *pending.resolver);
+        resolver->Resolve(Boolean::New(isolate, pending.frameSeq <= sentFrames));
+        pending.resolver->Reset();
+        delete pending.resolver;
+        queuedPuts.pop_front();
+        settled = true;
+    }
+
+    while(!overflowPuts.empty()) {
+        PendingPut& pending = overflowPuts.front();
+
+        if(failed) {
+            Local<Promise::Resolver> resolver = Local<Promise::Resolver>::New(isolate, *pending.resolver);
+            resolver->Resolve(Boolean::New(isolate, false));
+            pending.resolver->Reset();
+            delete pending.resolver;
+            settled = true;
+        } else if(atolla_source_put_queued(atollaSource, pending.frame.data(), pending.frame.size())) {
+            pending.frameSeq = ++queuedFrames;
+            pending.frame.clear();
+            queuedPuts.push_back(pending);
+        } else {
+            break; // Still no room, try again after the next frame was sent
+        }
+
+        overflowPuts.pop_front();
+    }
+
+    return settled;
+}
@@ -3,6 +3,10 @@
 
 #include <node.h>
 #include <node_object_wrap.h>
+#include <uv.h>
+
+#include <deque>
+#include <vector>
 
 #include "lib/atolla/atolla/source.h"
 
@@ -21,11 +25,48 @@ namespace atolla {
     static void PutReadyCount(const v8::FunctionCallbackInfo<v8::Value>& args);
     static void PutReadyTimeout(const v8::FunctionCallbackInfo<v8::Value>& args);
     static void Put(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void PutQueued(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void PutAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void PutMany(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void PutTimed(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void ClockMs(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void QueueLength(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void QueueCapacity(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void Stats(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void Close(const v8::FunctionCallbackInfo<v8::Value>& args);
+#ifdef ATOLLA_ENABLE_TRACE
+    static void Trace(const v8::FunctionCallbackInfo<v8::Value>& args);
+#endif
     static v8::Persistent<v8::Function> constructor;
 
+    static Source* UnwrapOpen(const v8::FunctionCallbackInfo<v8::Value>& args);
     static bool ParseSpecFromArgs(const v8::FunctionCallbackInfo<v8::Value>& args, AtollaSourceSpec& spec);
+
+    void SchedulePump(uint64_t timeoutMs);
+    static void Pump(uv_timer_t* timer);
+    static void Resolved(void* data, const char* address);
+    bool SettlePutPromises(AtollaSourceState state);
+    void Free();
+
+    // Promise returned by putAsync for a frame that has not been sent yet
+    struct PendingPut {
+      v8::Persistent<v8::Promise::Resolver>* resolver;
+      // Value of queuedFrames after queueing the frame, so it has been sent
+      // when queuedFrames minus the queue length reaches it
+      uint64_t frameSeq;
+      // Copy of the frame while it waits for room in the queue
+      std::vector<char> frame;
+    };
     
     AtollaSource atollaSource;
+    // Sends queued frames at the right time without blocking the event loop
+    uv_timer_t* pumpTimer;
+    // Total amount of frames passed to atolla_source_put_queued
+    uint64_t queuedFrames;
+    // Frames in the queue of the source, in order
+    std::deque<PendingPut> queuedPuts;
+    // Frames passed to putAsync while the queue was full, in order
+    std::deque<PendingPut> overflowPuts;
   };
 }
 
@@ -1,5 +1,6 @@
 const { Source } = require('./build/Release/atolla')
 const toUint8ArrayColors = require('./to-uint8-colors')
+const renderAhead = require('./render-ahead')
 
 const defaultColor = new Uint8Array([0, 0, 0])
 const defaultPainter = () => defaultColor
@@ -13,6 +14,46 @@ const noop = () => {}
  * painter function. The frequency of calls to the painter is decided upon calling
  * source by the values of frameDurationMs and maxBufferedFrames in the spec.
  *
+ * On lossy networks, setting fecGroupSize to e.g. 4 makes the source send
+ * parity information after every 4 frames, allowing the sink to reconstruct a
+ * single lost frame out of each group instead of repeating the next frame.
+ * With a deep buffer, setting retransmitLostFrames to true additionally lets
+ * the sink ask for lost frames again while they are still waiting for playout.
+ *
+ * If the sink may be lent to another source, e.g. a show controller that is
+ * about to be replaced, setting queueBorrow to true makes the source wait in
+ * line in state ATOLLA_SOURCE_STATE_WAITING instead of failing, until the
+ * other source is stopped or times out. Setting handover to true additionally
+ * lets the frames of the other source play out first, so that playout
+ * switches over to this source at a frame boundary without going dark.
+ *
+ * Setting syncClock to true makes the sink follow the clock of the source, so
+ * that frames sent with the native putTimed at the same presentation time,
+ * as read from clockMs, show at the same time on all sinks of sources sharing
+ * that clock. Sinks report the estimated offset as clockOffsetMs.
+ *
+ * Painters that take a significant time to run can be moved off the main thread
+ * by passing the path of a module exporting the painter as painterModule
+ * instead of a painter function, along with lightsCount. The painter is then
+ * called ahead of time on renderWorkers worker threads, each frame receiving a
+ * preallocated Uint8Array to write colors into, and up to renderAheadFrames
+ * frames are kept ready for sending. If the painter throws, the source reports
+ * the error with onError and closes. See render-ahead.js for details.
+ *
+ * Alternatively, an effect created with atolla.effect can be passed instead
+ * of a painter. Effects are evaluated natively into a reused frame buffer and
+ * only their parameters need to be changed from JS. See effect.js.
+ *
+ * To push frames from asynchronous code instead, set painter to null and call
+ * putAsync for every frame. The returned promise resolves once the frame has
+ * been sent, so awaiting it paces the producer at the frame rate without ever
+ * blocking the event loop:
+ *
+ *    const src = source({ hostname: 'localhost', port: 10042, frameDurationMs: 20, painter: null })
+ *    for await (const frame of frames()) {
+ *      await src.putAsync(frame)
+ *    }
+ *
  *    import { source } from 'atolla'
  *
  *    // Stream a sine-like animation to a sink running at localhost
@@ -35,9 +76,13 @@ module.exports = function source (spec) {
 
   const frameDurationSeconds = spec.frameDurationMs / 1000
 
-  let painter = (typeof spec.painter === 'function')
-                    ? spec.painter
-                    : defaultPainter
+  let painter = toPainter(spec.painter)
+
+  const effect = spec.effect
+
+  let pool = (typeof spec.painterModule === 'string')
+                ? createPool()
+                : undefined
 
   let onStateChange = (typeof spec.onStateChange === 'function')
                           ? spec.onStateChange
@@ -55,6 +100,18 @@ module.exports = function source (spec) {
   // to the painter function when requesting a new frame
   let time = 0
 
+  // Reused for effects and for painters that return anything other than a
+  // Uint8Array, so that producing colors does not allocate for every frame
+  let frameBuffer = new Uint8Array(effect ? 3 * effect.lightsCount() : 3)
+
+  // Views of frameBuffer, one per frame, when rendering several effect frames
+  // at once to pass them to putMany
+  let effectFrames = []
+
+  // Resolves to false on close, so that pending putAsync promises settle
+  let resolveClosed
+  const closed = new Promise((resolve) => { resolveClosed = () => resolve(false) })
+
   let updateTimeout
   let lastState
   let errorMsg
@@ -66,7 +123,7 @@ module.exports = function source (spec) {
       return painter
     },
     set painter (newPainter) {
-      painter = (typeof newPainter === 'function') ? newPainter : defaultPainter
+      painter = toPainter(newPainter)
     },
     get state () {
       return lastState
@@ -74,22 +131,55 @@ module.exports = function source (spec) {
     get errorMessage () {
       return errorMsg
     },
+    /**
+     * Returns an object with statistics about the connection to the sink, such
+     * as the round trip time and the amount of frames buffered and lost in the
+     * sink, or undefined after closing the source.
+     */
+    stats () {
+      return source ? source.stats() : undefined
+    },
+    /**
+     * Sends the given colors as the next frame without blocking and returns a
+     * promise that resolves to true once the frame has been sent, or to false
+     * if it could not be sent because the source failed or was closed. Frames
+     * queue up until the sink has room for them, even before the sink has
+     * been borrowed. Intended for sources with a null painter.
+     */
+    putAsync (colors) {
+      const frame = toUint8ArrayColors(colors) || defaultColor
+      return source
+                ? Promise.race([ source.putAsync(frame), closed ])
+                : Promise.resolve(false)
+    },
     /**
      * Frees associated resources of the source. The source will cease to call
      * the painter after calling this function.
      */
     close () {
-      if (lastState !== 'ATOLLA_SOURCE_STATE_CLOSED') {
-        const oldState = lastState
-        if (updateTimeout) {
-          clearTimeout(updateTimeout)
-          updateTimeout = undefined
-        }
-        source = undefined
-        errorMsg = undefined
-        lastState = 'ATOLLA_SOURCE_STATE_CLOSED'
-        onStateChange('ATOLLA_SOURCE_STATE_CLOSED', oldState)
+      closeSource()
+    }
+  }
+
+  function closeSource () {
+    if (lastState !== 'ATOLLA_SOURCE_STATE_CLOSED') {
+      const oldState = lastState
+      if (updateTimeout) {
+        clearTimeout(updateTimeout)
+        updateTimeout = undefined
       }
+      if (pool) {
+        pool.close()
+        pool = undefined
+      }
+      // Release the sink right away rather than whenever the native source
+      // gets garbage collected
+      source.close()
+      source = undefined
+      resolveClosed()
+      errorMsg = undefined
+      lastState = 'ATOLLA_SOURCE_STATE_CLOSED'
+      onStateChange('ATOLLA_SOURCE_STATE_CLOSED', oldState)
     }
   }
 
@@ -100,6 +190,9 @@ module.exports = function source (spec) {
 
     if (lastState && state !== lastState) {
       handleStateChange(state, lastState)
+      if (!source) {
+        return // Closed from one of the callbacks
+      }
     }
 
     switch (state) {
@@ -136,19 +229,132 @@ module.exports = function source (spec) {
   }
 
   function stream () {
+    if (!painter && !effect && !pool) {
+      // Frames are pushed with putAsync, only keep track of the state
+      scheduleUpdate(10)
+      return
+    }
+
+    if (effect && !pool) {
+      const readyCount = source.putReadyCount()
+      if (readyCount > 0) {
+        putEffectFrames(readyCount)
+      }
+      scheduleUpdate(source.putReadyTimeout())
+      return
+    }
+
     for (let readyCount = source.putReadyCount(); readyCount > 0; readyCount = source.putReadyCount()) {
-      putFrame()
+      if (!putFrame()) {
+        // Next frame not rendered yet, check back soon
+        scheduleUpdate(1)
+        return
+      }
     }
 
     scheduleUpdate(source.putReadyTimeout())
   }
 
   function putFrame () {
-    let painted = toUint8ArrayColors(painter(time)) || defaultColor
+    if (pool) {
+      return putRenderedFrame()
+    }
 
-    if (source.put(painted)) {
+    if (putPaintedFrame(painter(time))) {
       time += frameDurationSeconds
     }
+    return true
+  }
+
+  /**
+   * Renders all frames the sink has room for in one go and hands them to the
+   * source with a single call, which sends them in as few datagrams as
+   * possible.
+   */
+  function putEffectFrames (readyCount) {
+    const frameLength = 3 * effect.lightsCount()
+
+    if (effectFrames.length < readyCount) {
+      frameBuffer = new Uint8Array(readyCount * frameLength)
+      effectFrames = []
+      for (let i = 0; i < readyCount; ++i) {
+        effectFrames.push(frameBuffer.subarray(i * frameLength, (i + 1) * frameLength))
+      }
+    }
+
+    for (let i = 0; i < readyCount; ++i) {
+      effect.render(time + i * frameDurationSeconds, effectFrames[i])
+    }
+
+    time += source.putMany(effectFrames, readyCount) * frameDurationSeconds
+  }
+
+  function putPaintedFrame (painted) {
+    const length = toUint8ArrayColors.byteLength(painted)
+
+    if (length === 0) {
+      return source.put(defaultColor)
+    } else if (painted instanceof Uint8Array) {
+      return source.put(painted)
+    }
+
+    if (length > frameBuffer.length) {
+      frameBuffer = new Uint8Array(length)
+    }
+
+    const written = toUint8ArrayColors.into(painted, frameBuffer)
+    return (written > 0)
+              ? source.put(frameBuffer, written)
+              : source.put(defaultColor)
+  }
+
+  function toPainter (painter) {
+    if (painter === null) {
+      return null
+    }
+    return (typeof painter === 'function') ? painter : defaultPainter
+  }
+
+  function putRenderedFrame () {
+    const slot = pool.peek()
+    if (slot === -1) {
+      return false
+    }
+
+    if (source.put(pool.views[slot], Atomics.load(pool.lengths, slot))) {
+      pool.advance()
+    }
+    return true
+  }
+
+  function createPool () {
+    const maxBufferedFrames = spec.maxBufferedFrames || 16
+    const workerCount = spec.renderWorkers
+    const slotCount = spec.renderAheadFrames ||
+                        Math.max(2 * (workerCount || 1), maxBufferedFrames)
+
+    return renderAhead({
+      painterModule: spec.painterModule,
+      lightsCount: spec.lightsCount,
+      frameDurationMs: spec.frameDurationMs,
+      workerCount,
+      slotCount,
+      onError: failRendering
+    })
+  }
+
+  /**
+   * Closes the source when a render worker failed, e.g. because the painter
+   * threw, since the frames of that worker would never become ready.
+   */
+  function failRendering (msg) {
+    if (!pool) {
+      return // Already closed, possibly after another worker failed
+    }
+
+    closeSource()
+    errorMsg = msg
+    onError(msg)
   }
 
   function scheduleUpdate (ms) {
@@ -1,4 +1,4 @@
-const tinycolor = require('tinycolor2')
+const { parseColors } = require('./build/Release/atolla')
 
 /**
  * Converts the given value to an Uint8Array of color-triplets. If parsing failed,
@@ -18,10 +18,13 @@ const tinycolor = require('tinycolor2')
  * color triplets, assuming that each string represents a CSS color. If any of the
  * contained colors is invalid, the return value will be the value undefined.
  *
- * If plain string given, it will be parsed by tinycolor and converted to a single
+ * If plain string given, it will be parsed as a CSS color and converted to a single
  * RGB triplet returned as a three-component Uint8Array. If the color is invalid,
  * undefined will be returned instead of the array.
  *
+ * CSS colors are parsed natively and may be hex colors, rgb(), rgba(), hsl(),
+ * hsla() or named colors.
+ *
  * @param {*} convertee the value to obtain colors from, can be one of CSS string,
  *                      flat array of RGB triplets, flat array of CSS strings, typed
  *                      Uint8Array with RGB triplets
@@ -34,35 +37,71 @@ module.exports = function toUint8Colors (convertee) {
               : undefined
   }
 
-  if (typeof convertee === 'string') {
-    const color = tinycolor(convertee)
+  const length = byteLength(convertee)
+  if (length === 0) {
+    return undefined
+  }
+
+  const colors = new Uint8Array(length)
+  return (into(convertee, colors) === length) ? colors : undefined
+}
+
+module.exports.into = into
+module.exports.byteLength = byteLength
+
+/**
+ * Converts the given value like toUint8Colors, but writes the color triplets
+ * into the given target Uint8Array instead of allocating a new one, so the
+ * same target can be reused for every frame. All CSS strings in an array are
+ * parsed in a single native call.
+ *
+ * Returns the amount of bytes written to the front of target, or -1 if the
+ * value could not be converted. Throws a RangeError if target is shorter than
+ * byteLength(convertee).
+ */
+function into (convertee, target) {
+  const length = byteLength(convertee)
+  if (length === 0) {
+    return -1
+  }
+
+  if (length > target.length) {
+    throw new RangeError('Target Uint8Array is too small for the given colors')
+  }
+
+  if (convertee instanceof Uint8Array) {
+    target.set(convertee)
+    return length
+  }
 
-    if (!color.isValid()) {
-      return undefined
-    }
+  if (typeof convertee === 'string' || typeof convertee[0] === 'string') {
+    return parseColors(convertee, target)
+  }
 
-    const { r, g, b } = color.toRgb()
-    return new Uint8Array([ r, g, b ])
+  for (let i = 0; i < length; ++i) {
+    target[i] = convertee[i]
   }
+  return length
+}
 
-  if (Array.isArray(convertee)) {
-    if(typeof convertee[0] === 'number') {
-      return (convertee.length >= 3 && convertee.length % 3 === 0)
-                ? new Uint8Array(convertee)
-                : undefined
-    } else if(typeof convertee[0] === 'string') {
-      let allValid = true
+/**
+ * Gets the amount of bytes needed to hold the color triplets of the given
+ * value, or 0 if it is not convertible. Validity of CSS colors is not checked.
+ */
+function byteLength (convertee) {
+  if (typeof convertee === 'string') {
+    return 3
+  }
 
-      const colors = convertee.reduce((convertee, next) => {
-        const color = tinycolor(next)
-        allValid = allValid && color.isValid()
-        const { r, g, b } = color.toRgb()
-        convertee.concat([r, g, b])
-      }, [])
+  if (convertee instanceof Uint8Array || (Array.isArray(convertee) && typeof convertee[0] === 'number')) {
+    return (convertee.length >= 3 && convertee.length % 3 === 0)
+              ? convertee.length
+              : 0
+  }
 
-      return allValid ? new Uint8Array(colors) : undefined
-    }
+  if (Array.isArray(convertee) && typeof convertee[0] === 'string') {
+    return 3 * convertee.length
   }
 
-  return undefined
+  return 0
 }